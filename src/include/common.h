@@ -31,6 +31,7 @@ typedef enum : uint8_t
     TLM_RATIO_1_4,
     TLM_RATIO_1_2,
     TLM_RATIO_DISARMED, // TLM_RATIO_STD when disarmed, TLM_RATIO_NO_TLM when armed
+    TLM_RATIO_AUTO,     // Between TLM_RATIO_STD and more telemetry, following the RX backlog and uplink LQ
 } expresslrs_tlm_ratio_e;
 
 typedef enum
@@ -57,6 +57,7 @@ static int timeout()
 }
 
 device_t ADC_device = {
+    .name = "ADC",
     .initialize = nullptr,
     .start = start,
     .event = nullptr,
@@ -110,6 +110,7 @@ static int timeout()
 }
 
 device_t AnalogVbat_device = {
+    .name = "AnalogVbat",
     .initialize = initialize,
     .start = start,
     .event = nullptr,
@@ -90,6 +90,7 @@ static int event()
 }
 
 device_t BLE_device = {
+    .name = "BLE",
     .initialize = initialize,
     .start = nullptr,
     .event = event,
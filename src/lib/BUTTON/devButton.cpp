@@ -113,6 +113,7 @@ static int timeout()
 }
 
 device_t Button_device = {
+    .name = "Button",
     .initialize = initialize,
     .start = start,
     .event = event,
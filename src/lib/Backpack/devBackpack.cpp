@@ -512,6 +512,7 @@ static int event()
 }
 
 device_t Backpack_device = {
+    .name = "Backpack",
     .initialize = initialize,
     .start = start,
     .event = event,
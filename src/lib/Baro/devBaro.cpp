@@ -183,6 +183,7 @@ static int timeout()
 }
 
 device_t Baro_device = {
+    .name = "Baro",
     .initialize = initialize,
     .start = start,
     .event = nullptr,
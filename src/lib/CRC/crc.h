@@ -3,27 +3,174 @@
 
 #define crclen 256
 
+// Number of lookup tables used by the slice-by-N engines. Each slice is one
+// 256-entry table, and N bytes are folded in per step instead of just 1.
+// Slice-by-4 covers the 7 and 11 byte OTA payloads with 1-2 passes
+// plus a short byte-wise tail, slice-by-8 only pays off on CRSF sized frames.
+// The ESP8266 keeps .rodata in RAM, so it uses a single table per polynomial
+#if defined(PLATFORM_ESP8266)
+#define CRC_DEFAULT_SLICES 1
+#else
+#define CRC_DEFAULT_SLICES 4
+#endif
+
+/**
+ * Compile-time lookup table generation
+ * All the tables for a polynomial are built by the compiler and stored as a
+ * single flat array, slice k is at [k * crclen] and is the CRC of the index
+ * followed by k zero bytes
+ */
+template <unsigned... I> struct CrcIndexSeq
+{
+    typedef CrcIndexSeq<I..., (sizeof...(I) + I)...> doubled;
+};
+// Only power-of-two lengths are needed, built by doubling to keep the template depth low
+template <unsigned N> struct CrcMakeIndexSeq
+{
+    typedef typename CrcMakeIndexSeq<N / 2>::type::doubled type;
+};
+template <> struct CrcMakeIndexSeq<1>
+{
+    typedef CrcIndexSeq<0> type;
+};
+
+constexpr uint8_t crc8ShiftBits(uint8_t crc, uint8_t poly, unsigned bits)
+{
+    return bits == 0 ? crc : crc8ShiftBits((crc << 1) ^ ((crc & 0x80) ? poly : 0), poly, bits - 1);
+}
+
+// 16-bit register, narrower CRCs are processed left-aligned (MSB at bit 15)
+constexpr uint16_t crc16ShiftBits(uint16_t crc, uint16_t poly, unsigned bits)
+{
+    return bits == 0 ? crc : crc16ShiftBits((crc << 1) ^ ((crc & 0x8000) ? poly : 0), poly, bits - 1);
+}
+
+template <uint8_t poly, typename Seq> struct Crc8Table;
+template <uint8_t poly, unsigned... I> struct Crc8Table<poly, CrcIndexSeq<I...>>
+{
+    static constexpr uint8_t table[sizeof...(I)] = { crc8ShiftBits(I % crclen, poly, 8 * (I / crclen + 1))... };
+};
+template <uint8_t poly, unsigned... I>
+constexpr uint8_t Crc8Table<poly, CrcIndexSeq<I...>>::table[sizeof...(I)];
+
+template <uint16_t poly, typename Seq> struct Crc16Table;
+template <uint16_t poly, unsigned... I> struct Crc16Table<poly, CrcIndexSeq<I...>>
+{
+    static constexpr uint16_t table[sizeof...(I)] = { crc16ShiftBits((I % crclen) << 8, poly, 8 * (I / crclen + 1))... };
+};
+template <uint16_t poly, unsigned... I>
+constexpr uint16_t Crc16Table<poly, CrcIndexSeq<I...>>::table[sizeof...(I)];
+
+/**
+ * CRC8, MSB first, no reflection or final XOR
+ * @tparam poly polynomial with the implicit leading 1 removed
+ * @tparam slices number of bytes processed per table lookup step (1, 2, 4 or 8)
+ */
+template <uint8_t poly, uint8_t slices = CRC_DEFAULT_SLICES>
 class GENERIC_CRC8
 {
 private:
-    uint8_t crc8tab[crclen];
-    uint8_t crcpoly;
+    typedef Crc8Table<poly, typename CrcMakeIndexSeq<crclen * slices>::type> Tables;
 
 public:
-    explicit GENERIC_CRC8(uint8_t poly);
-    uint8_t calc(uint8_t data);
-    uint8_t calc(const uint8_t *data, uint16_t len, uint8_t crc = 0);
+    uint8_t calc(uint8_t data) const
+    {
+        return Tables::table[data];
+    }
+
+    uint8_t ICACHE_RAM_ATTR calc(const uint8_t *data, uint16_t len, uint8_t crc = 0) const
+    {
+        const uint8_t *tab = Tables::table;
+        while (len >= slices)
+        {
+            uint8_t step = tab[(slices - 1) * crclen + (crc ^ data[0])];
+            for (unsigned s = 1; s < slices; ++s)
+                step ^= tab[(slices - 1 - s) * crclen + data[s]];
+            crc = step;
+            data += slices;
+            len -= slices;
+        }
+        while (len--)
+        {
+            crc = tab[crc ^ *data++];
+        }
+        return crc;
+    }
 };
 
+/**
+ * The slice-by-N calculation for Crc2Byte and Crc2ByteRAM, on a 16-bit register with the CRC left-aligned
+ */
+template <unsigned alignShift, uint8_t slices>
+static inline uint16_t ICACHE_RAM_ATTR crc2ByteCalc(const uint16_t *tab, const uint8_t *data, uint8_t len, uint16_t crc)
+{
+    uint16_t reg = crc << alignShift;
+    // The 16-bit register spans the first two bytes of each slice, so slice-by-1 is byte-wise only
+    while (slices > 1 && len >= slices)
+    {
+        uint16_t step = tab[(slices - 1) * crclen + ((reg >> 8) ^ data[0])]
+            ^ tab[(slices - 2) * crclen + ((reg & 0xFF) ^ data[1])];
+        for (unsigned s = 2; s < slices; ++s)
+            step ^= tab[(slices - 1 - s) * crclen + data[s]];
+        reg = step;
+        data += slices;
+        len -= slices;
+    }
+    while (len--)
+    {
+        reg = (reg << 8) ^ tab[(reg >> 8) ^ *data++];
+    }
+    return reg >> alignShift;
+}
+
+/**
+ * CRC of up to 16 bits, MSB first, no reflection or final XOR
+ * Any bits in the initial crc above `bits` are ignored, the result is masked to `bits`
+ * @tparam bits width of the CRC, 8 to 16
+ * @tparam poly polynomial with the implicit leading 1 removed
+ * @tparam slices number of bytes processed per table lookup step (1, 2, 4 or 8)
+ */
+template <uint8_t bits, uint16_t poly, uint8_t slices = CRC_DEFAULT_SLICES>
 class Crc2Byte
 {
 private:
-    uint16_t _crctab[crclen];
-    uint8_t  _bits;
-    uint16_t _bitmask;
-    uint16_t _poly;
+    static_assert(bits >= 8 && bits <= 16, "Crc2Byte supports 8 to 16 bit CRCs");
+    static constexpr unsigned alignShift = 16 - bits;
+    typedef Crc16Table<(uint16_t)(poly << alignShift), typename CrcMakeIndexSeq<crclen * slices>::type> Tables;
 
 public:
-    void init(uint8_t bits, uint16_t poly);
-    uint16_t calc(uint8_t *data, uint8_t len, uint16_t crc);
+    uint16_t ICACHE_RAM_ATTR calc(const uint8_t *data, uint8_t len, uint16_t crc) const
+    {
+        return crc2ByteCalc<alignShift, slices>(Tables::table, data, len, crc);
+    }
+};
+
+/**
+ * A Crc2Byte with its tables in RAM, for the CRCs calculated in the radio ISR. The compile-time tables
+ * are in flash on the ESP32, which can not be read while the flash cache is disabled to write the config
+ * or an update, and the ISR keeps running then. The tables are built by the constructor and shared by
+ * all the instances with the same parameters.
+ * The OTA spans are only 7 and 11 bytes, so the default is a single table to keep the RAM down.
+ */
+template <uint8_t bits, uint16_t poly, uint8_t slices = 1>
+class Crc2ByteRAM
+{
+private:
+    static_assert(bits >= 8 && bits <= 16, "Crc2ByteRAM supports 8 to 16 bit CRCs");
+    static constexpr unsigned alignShift = 16 - bits;
+    static uint16_t table[crclen * slices];
+
+public:
+    Crc2ByteRAM()
+    {
+        for (unsigned i = 0; i < crclen * slices; i++)
+            table[i] = crc16ShiftBits((i % crclen) << 8, (uint16_t)(poly << alignShift), 8 * (i / crclen + 1));
+    }
+
+    uint16_t ICACHE_RAM_ATTR calc(const uint8_t *data, uint8_t len, uint16_t crc) const
+    {
+        return crc2ByteCalc<alignShift, slices>(table, data, len, crc);
+    }
 };
+template <uint8_t bits, uint16_t poly, uint8_t slices>
+WORD_ALIGNED_ATTR uint16_t Crc2ByteRAM<bits, poly, slices>::table[crclen * slices];
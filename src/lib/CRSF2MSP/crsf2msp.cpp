@@ -2,6 +2,16 @@
 
 #include "CRSFRouter.h"
 
+CROSSFIRE2MSP::CROSSFIRE2MSP()
+{
+#if defined(CRSF_MSP_TAGGED)
+    for (uint8_t i = 0; i < CRSF_MSP_TAGGED_SLOTS; i++)
+    {
+        taggedFrames[i].tag = CRSF_MSP_NO_TAG;
+    }
+#endif
+}
+
 void CROSSFIRE2MSP::reset()
 {
     pktLen = 0;
@@ -12,6 +22,15 @@ void CROSSFIRE2MSP::reset()
 
 void CROSSFIRE2MSP::parse(const uint8_t *data, const std::function<void(uint8_t *, uint32_t)> &processMSP)
 {
+    if (isTagged(data))
+    {
+#if defined(CRSF_MSP_TAGGED)
+        parseTagged(data, processMSP);
+#endif
+        return;
+    }
+    tag = CRSF_MSP_NO_TAG;
+
     const uint8_t CRSFpayloadLen = data[CRSF_FRAME_PAYLOAD_LEN_IDX] - CRSF_EXT_FRAME_PAYLOAD_LEN_SIZE_OFFSET;
     const bool error = isError(data);
     const bool newFrame = isNewFrame(data);
@@ -25,10 +44,16 @@ void CROSSFIRE2MSP::parse(const uint8_t *data, const std::function<void(uint8_t
         reset();
         return;
     }
+    if (!newFrame && (MSPvers == MSP_FRAME_UNKNOWN || frameComplete))
+    {
+        // The rest of a frame whose start was lost, or past the end of one
+        return;
+    }
 
     if (newFrame) // If it's a new frame then out a header on first
     {
         idx = 3; // skip the header start wiring at offset 3.
+        frameComplete = false;
         MSPvers = getVersion(data);
         src = data[CRSF_MSP_SRC_OFFSET];
         dest = data[CRSF_MSP_DEST_OFFSET];
@@ -56,6 +81,96 @@ void CROSSFIRE2MSP::parse(const uint8_t *data, const std::function<void(uint8_t
     }
 }
 
+#if defined(CRSF_MSP_TAGGED)
+CROSSFIRE2MSP::taggedFrame_t *CROSSFIRE2MSP::getTaggedFrame(const uint8_t frameTag, const uint8_t frameSrc, const uint8_t frameType)
+{
+    // The frame already being reassembled, else a free slot, else the one left untouched longest
+    taggedFrame_t *slot = &taggedFrames[0];
+    for (uint8_t i = 0; i < CRSF_MSP_TAGGED_SLOTS; i++)
+    {
+        taggedFrame_t *frame = &taggedFrames[i];
+        if (frame->tag == frameTag && frame->src == frameSrc && frame->type == frameType)
+        {
+            frame->lastUsed = ++taggedUse;
+            return frame;
+        }
+        if (slot->tag != CRSF_MSP_NO_TAG && (frame->tag == CRSF_MSP_NO_TAG || frame->lastUsed < slot->lastUsed))
+        {
+            slot = frame;
+        }
+    }
+    slot->tag = frameTag;
+    slot->src = frameSrc;
+    slot->type = frameType;
+    slot->received = 0;
+    slot->numChunks = 0;
+    slot->lastUsed = ++taggedUse;
+    return slot;
+}
+
+void CROSSFIRE2MSP::parseTagged(const uint8_t *data, const std::function<void(uint8_t *, uint32_t)> &processMSP)
+{
+    const uint8_t CRSFpayloadLen = data[CRSF_FRAME_PAYLOAD_LEN_IDX] - CRSF_EXT_FRAME_PAYLOAD_LEN_SIZE_OFFSET - 1;
+    const uint8_t frameTag = data[CRSF_MSP_TAG_BYTE_OFFSET] >> 4;
+    const uint8_t chunk = data[CRSF_MSP_TAG_BYTE_OFFSET] & 0b1111;
+    if (isError(data))
+    {
+        return;
+    }
+
+    taggedFrame_t *frame = getTaggedFrame(frameTag, data[CRSF_MSP_SRC_OFFSET], data[CRSF_MSP_TYPE_IDX]);
+    if (chunk == 0)
+    {
+        // The MSP header is in the first chunk, and the data is one byte further on than in an untagged chunk
+        const uint8_t headerVersion = data[CRSF_MSP_STATUS_BYTE_OFFSET] & 0b11;
+        const MSPframeType_e version = headerVersion == 2 ? MSP_FRAME_V2 : (data[CRSF_MSP_TAGGED_FRAME_OFFSET] == 0xFF ? MSP_FRAME_V1_JUMBO : MSP_FRAME_V1);
+        const uint32_t pktLen = getFrameLen(data + 1, version);
+        if (pktLen > CRSF_MSP_TAGGED_MAX_FRAME_LEN)
+        {
+            frame->tag = CRSF_MSP_NO_TAG;
+            return;
+        }
+        if (frame->numChunks != 0 && frame->pktLen != pktLen)
+        {
+            // The tag has been reused for another frame, forget the chunks of the old one
+            frame->received = 0;
+        }
+        frame->version = version;
+        frame->pktLen = pktLen;
+        frame->numChunks = (pktLen + CRSF_MSP_TAGGED_BYTES_PER_CHUNK - 1) / CRSF_MSP_TAGGED_BYTES_PER_CHUNK;
+        frame->buffer[0] = '$';
+        frame->buffer[1] = version == MSP_FRAME_V2 ? 'X' : 'M';
+        frame->buffer[2] = getHeaderDir(data);
+    }
+
+    // Chunks past the end of the frame are ignored, as is padding on the last one
+    const uint32_t offset = chunk * CRSF_MSP_TAGGED_BYTES_PER_CHUNK;
+    if (offset + 4 < MSP_FRAME_MAX_LEN)
+    {
+        const uint32_t room = MSP_FRAME_MAX_LEN - 4 - offset;
+        const uint32_t len = CRSFpayloadLen < room ? CRSFpayloadLen : room;
+        memcpy(&frame->buffer[3 + offset], &data[CRSF_MSP_TAGGED_FRAME_OFFSET], len);
+        frame->received |= bit(chunk);
+    }
+
+    const uint16_t allChunks = frame->numChunks == 16 ? 0xFFFF : bit(frame->numChunks) - 1;
+    if (frame->numChunks != 0 && (frame->received & allChunks) == allChunks)
+    {
+        frame->buffer[3 + frame->pktLen] = getChecksum(frame->buffer + 3, frame->pktLen, frame->version);
+        frame->tag = CRSF_MSP_NO_TAG;
+        tag = frameTag;
+        processMSP(frame->buffer, frame->pktLen + 4);
+        tag = CRSF_MSP_NO_TAG;
+    }
+}
+#endif
+
+bool CROSSFIRE2MSP::isTagged(const uint8_t *data)
+{
+    const uint8_t statusByte = data[CRSF_MSP_STATUS_BYTE_OFFSET];
+    return ((statusByte & 0b01100000) >> 5) == CRSF_MSP_VERSION_TAGGED;
+}
+
 bool CROSSFIRE2MSP::isNewFrame(const uint8_t *data)
 {
     const uint8_t statusByte = data[CRSF_MSP_STATUS_BYTE_OFFSET];
@@ -12,12 +12,38 @@
 class CROSSFIRE2MSP final
 {
 public:
+    CROSSFIRE2MSP();
+
     void parse(const uint8_t *data, const std::function<void(uint8_t *, uint32_t)> &processMSP); // accept crsf frame input
-    const uint8_t *getFrame() const { return outBuffer; }
+    const uint8_t *getFrame() const { return outBuffer; } // the last untagged frame
     uint32_t getFrameLen() const { return idx + 1; } // include the last byte (crc)
+    // The tag of the frame given to processMSP, CRSF_MSP_NO_TAG if it was not sent in tagged chunks
+    uint8_t getTag() const { return tag; }
     void reset();
 
 private:
+#if defined(CRSF_MSP_TAGGED)
+    // A frame being reassembled from tagged chunks, which can arrive in any order
+    typedef struct {
+        uint8_t tag;        // CRSF_MSP_NO_TAG if the slot is free
+        uint8_t src;
+        uint8_t type;
+        MSPframeType_e version;
+        uint16_t received;  // a bit for each chunk
+        uint8_t numChunks;  // known once the first chunk has arrived
+        uint32_t pktLen;
+        uint32_t lastUsed;
+        uint8_t buffer[MSP_FRAME_MAX_LEN];
+    } taggedFrame_t;
+
+    taggedFrame_t taggedFrames[CRSF_MSP_TAGGED_SLOTS];
+    uint32_t taggedUse = 0;
+
+    void parseTagged(const uint8_t *data, const std::function<void(uint8_t *, uint32_t)> &processMSP);
+    taggedFrame_t *getTaggedFrame(uint8_t frameTag, uint8_t frameSrc, uint8_t frameType);
+#endif
+    uint8_t tag = CRSF_MSP_NO_TAG;
+
     uint8_t outBuffer[MSP_FRAME_MAX_LEN] {};
     uint32_t pktLen = 0; // packet length of the incoming msp frame
     uint32_t idx = 0;    // number of bytes received in the current msp frame
@@ -28,6 +54,7 @@ private:
     MSPframeType_e MSPvers = MSP_FRAME_UNKNOWN; // need to store the MSP version since it can only be inferred from the first frame
 
     static bool isNewFrame(const uint8_t *data);
+    static bool isTagged(const uint8_t *data);
     static bool isError(const uint8_t *data);
 
     static uint8_t getSeqNumber(const uint8_t *data);
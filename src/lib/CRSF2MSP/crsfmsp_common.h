@@ -12,6 +12,20 @@
 #define MSP_FRAME_MAX_LEN 512                                               // Max MSP frame length (increase as needed)
 #define CRSF_MSP_OUT_BUFFER_DEPTH (MSP_FRAME_MAX_LEN / CRSF_MAX_PACKET_LEN) // Max number of CRSF frames to buffer
 
+// Tagged chunks, so several MSP frames can be in flight at once and their chunks interleaved or reordered.
+// The status byte's version bits hold CRSF_MSP_VERSION_TAGGED, its low two bits the MSP version (1 or 2),
+// and the byte after it the tag (high nibble) and the index of the chunk in the frame (low nibble)
+// Reassembling them takes CRSF_MSP_TAGGED_SLOTS frame buffers in every CROSSFIRE2MSP, so receiving them is only
+// built with -D CRSF_MSP_TAGGED, without it tagged chunks are dropped. Sending them needs no extra RAM.
+#define CRSF_MSP_VERSION_TAGGED 3
+#define CRSF_MSP_TAG_BYTE_OFFSET 6                                          // Tag and chunk index in CRSF packet
+#define CRSF_MSP_TAGGED_FRAME_OFFSET 7                                      // Start of MSP data in a tagged CRSF packet
+#define CRSF_MSP_TAGGED_BYTES_PER_CHUNK (CRSF_MSP_MAX_BYTES_PER_CHUNK - 1)  // Max bytes per tagged MSP chunk in CRSF packet
+#define CRSF_MSP_MAX_TAGS 16
+#define CRSF_MSP_NO_TAG 0xFF
+#define CRSF_MSP_TAGGED_SLOTS 4                                             // Tagged frames reassembled at once
+#define CRSF_MSP_TAGGED_MAX_FRAME_LEN (MSP_FRAME_MAX_LEN - 4)              // Largest tagged frame without the header and checksum, fits in 16 chunks
+
 #define CRSF_MSP_LEN_TO_ENCAP_FRAME_OFFSET (CRSF_MAX_PACKET_LEN - CRSF_MSP_MAX_BYTES_PER_CHUNK) // equals 7
 // <sync><crsf_len><crsf_cmd><dst><source><header><msp_len><msp_cmd>
 
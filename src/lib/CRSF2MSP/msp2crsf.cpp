@@ -132,6 +132,32 @@ void MSP2CROSSFIRE::parse(CRSFConnector *connector, const uint8_t *data, uint32_
     }
 }
 
+void MSP2CROSSFIRE::parseTagged(CRSFConnector *connector, const uint8_t *data, uint32_t frameLen, const uint8_t tag, const crsf_addr_e src, const crsf_addr_e dest)
+{
+    const MSPframeType_e mspVersion = getVersion(data);
+    const uint32_t MSPframeLen = getFrameLen(getPayloadLen(data, mspVersion), mspVersion);
+    if (MSPframeLen == 0 || MSPframeLen > CRSF_MSP_TAGGED_MAX_FRAME_LEN)
+    {
+        return;
+    }
+    const uint8_t numChunks = (MSPframeLen + CRSF_MSP_TAGGED_BYTES_PER_CHUNK - 1) / CRSF_MSP_TAGGED_BYTES_PER_CHUNK;
+    const uint8_t versionBits = mspVersion == MSP_FRAME_V2 ? 2 : 1;
+
+    for (uint8_t i = 0; i < numChunks; i++)
+    {
+        uint8_t packet[CRSF_MAX_PACKET_LEN] {};
+        packet[CRSF_MSP_STATUS_BYTE_OFFSET] = (CRSF_MSP_VERSION_TAGGED << 5) | getNewFrameBits(i == 0) | versionBits;
+        packet[CRSF_MSP_TAG_BYTE_OFFSET] = (tag << 4) | i;
+
+        const uint32_t startIdx = i * CRSF_MSP_TAGGED_BYTES_PER_CHUNK;
+        const uint8_t CRSFpktLen = MSPframeLen - startIdx < CRSF_MSP_TAGGED_BYTES_PER_CHUNK ? MSPframeLen - startIdx : CRSF_MSP_TAGGED_BYTES_PER_CHUNK;
+
+        memcpy(&packet[CRSF_MSP_TAGGED_FRAME_OFFSET], &data[startIdx + 3], CRSFpktLen); // we don't transmit the MSP header
+        crsfRouter.SetExtendedHeaderAndCrc((crsf_ext_header_t *)packet, getHeaderDir(data[CRSF_MSP_TYPE_IDX]), CRSFpktLen + 1 + CRSF_EXT_FRAME_PAYLOAD_LEN_SIZE_OFFSET, dest, src);
+        crsfRouter.processMessage(connector, (crsf_header_t *)packet);
+    }
+}
+
 bool MSP2CROSSFIRE::validate(const uint8_t *data, const uint32_t expectLen)
 {
     const MSPframeType_e version = getVersion(data);
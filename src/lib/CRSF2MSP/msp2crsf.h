@@ -13,6 +13,9 @@ class MSP2CROSSFIRE final
 public:
     MSP2CROSSFIRE() = default;
     void parse(CRSFConnector *connector, const uint8_t *data, uint32_t frameLen, crsf_addr_e src = CRSF_ADDRESS_CRSF_RECEIVER, crsf_addr_e dest = CRSF_ADDRESS_FLIGHT_CONTROLLER);
+    // Sends the frame in tagged chunks (see crsfmsp_common.h), the device answering must support them and reply with the same tag.
+    // Flight controllers don't, so the firmware does not send them itself, this is for a peer such as a configurator or backpack
+    void parseTagged(CRSFConnector *connector, const uint8_t *data, uint32_t frameLen, uint8_t tag, crsf_addr_e src, crsf_addr_e dest);
     static bool validate(const uint8_t *data, uint32_t expectLen);
 
 private:
@@ -0,0 +1,59 @@
+#include "msppipeline.h"
+
+MSPPipeline::MSPPipeline(const uint8_t window, const uint32_t timeoutMs)
+    : window(window < CRSF_MSP_MAX_TAGS ? window : CRSF_MSP_MAX_TAGS), timeoutMs(timeoutMs)
+{
+}
+
+bool MSPPipeline::canSend(const uint32_t now)
+{
+    for (auto &request : requests)
+    {
+        if (request.active && now - request.sentAt >= timeoutMs)
+        {
+            request.active = false;
+            count--;
+            timeouts++;
+        }
+    }
+    return count < window;
+}
+
+uint8_t MSPPipeline::startRequest(const uint16_t function, const uint32_t now)
+{
+    if (!canSend(now))
+    {
+        return CRSF_MSP_NO_TAG;
+    }
+    // Tags are handed out in turn so one is not reused until the others have been, which
+    // keeps a late response to a request that timed out from matching the next one
+    while (requests[nextTag].active)
+    {
+        nextTag = (nextTag + 1) % CRSF_MSP_MAX_TAGS;
+    }
+    const uint8_t tag = nextTag;
+    nextTag = (nextTag + 1) % CRSF_MSP_MAX_TAGS;
+    requests[tag] = {true, function, now};
+    count++;
+    return tag;
+}
+
+bool MSPPipeline::completeRequest(const uint8_t tag, const uint16_t function)
+{
+    if (tag >= CRSF_MSP_MAX_TAGS || !requests[tag].active || requests[tag].function != function)
+    {
+        return false;
+    }
+    requests[tag].active = false;
+    count--;
+    return true;
+}
+
+uint16_t MSPPipeline::getFunction(const uint8_t *frame)
+{
+    if (frame[1] == 'X')
+    {
+        return frame[4] | (frame[5] << 8);
+    }
+    return frame[4];
+}
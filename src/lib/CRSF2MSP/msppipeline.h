@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+#include "crsfmsp_common.h"
+
+/*  Keeps track of the MSP requests sent in tagged chunks which are waiting for a response,
+    so up to `window` of them can be in flight at once instead of one per link round trip.
+*/
+
+class MSPPipeline final
+{
+public:
+    MSPPipeline(uint8_t window, uint32_t timeoutMs);
+
+    // true if another request can be sent, requests which have waited longer than the timeout are given up on
+    bool canSend(uint32_t now);
+    // Returns the tag to send the request with, or CRSF_MSP_NO_TAG if the window is full
+    uint8_t startRequest(uint16_t function, uint32_t now);
+    // Returns false if the response does not match a request in flight (late, duplicated or for another function)
+    bool completeRequest(uint8_t tag, uint16_t function);
+    uint8_t inFlight() const { return count; }
+    uint32_t getTimeouts() const { return timeouts; }
+
+    // The function of a complete MSP frame
+    static uint16_t getFunction(const uint8_t *frame);
+
+private:
+    typedef struct {
+        bool active;
+        uint16_t function;
+        uint32_t sentAt;
+    } request_t;
+
+    request_t requests[CRSF_MSP_MAX_TAGS] {};
+    const uint8_t window;
+    const uint32_t timeoutMs;
+    uint8_t count = 0;
+    uint8_t nextTag = 0;
+    uint32_t timeouts = 0;
+};
@@ -0,0 +1,118 @@
+#include "CRSFCapture.h"
+
+#include <string.h>
+
+static_assert((CRSF_CAPTURE_SIZE & (CRSF_CAPTURE_SIZE - 1)) == 0, "CRSF_CAPTURE_SIZE must be a power of 2");
+
+#define CAPTURE_MASK (CRSF_CAPTURE_SIZE - 1)
+
+#if defined(CRSF_CAPTURE)
+CRSFCapture crsfCapture;
+#endif
+
+void CRSFCapture::add(const uint8_t connector, const crsfCaptureDirection_e direction, const crsf_header_t *message, const uint32_t timeUs)
+{
+    if (!enabled)
+    {
+        return;
+    }
+    const uint8_t frameLen = CRSF_FRAME_SIZE(message->frame_size);
+    if (frameLen > CRSF_MAX_PACKET_LEN)
+    {
+        return;
+    }
+    const crsfCaptureRecord_t record = {timeUs, connector, direction};
+    const uint32_t recordLen = sizeof(record) + frameLen;
+
+#if defined(PLATFORM_ESP32) && SOC_CPU_CORES_NUM > 1
+    std::lock_guard<std::mutex> lock(mutex);
+#endif
+    while (CRSF_CAPTURE_SIZE - (tail - head) < recordLen)
+    {
+        // The frame length of the oldest record is the second byte of its frame
+        const uint8_t oldLen = CRSF_FRAME_SIZE(ring[(head + sizeof(crsfCaptureRecord_t) + 1) & CAPTURE_MASK]);
+        head += sizeof(crsfCaptureRecord_t) + oldLen;
+        dropped++;
+    }
+
+    const uint8_t *parts[] = {(const uint8_t *)&record, (const uint8_t *)message};
+    const uint32_t partLens[] = {sizeof(record), frameLen};
+    for (uint8_t part = 0; part < 2; part++)
+    {
+        const uint32_t index = tail & CAPTURE_MASK;
+        const uint32_t first = CRSF_CAPTURE_SIZE - index < partLens[part] ? CRSF_CAPTURE_SIZE - index : partLens[part];
+        memcpy(&ring[index], parts[part], first);
+        memcpy(ring, parts[part] + first, partLens[part] - first);
+        tail += partLens[part];
+    }
+}
+
+void CRSFCapture::clear()
+{
+#if defined(PLATFORM_ESP32) && SOC_CPU_CORES_NUM > 1
+    std::lock_guard<std::mutex> lock(mutex);
+#endif
+    head = tail = 0;
+    dropped = 0;
+}
+
+void CRSFCapture::copyOut(const uint32_t from, uint8_t *buffer, const uint32_t len) const
+{
+    const uint32_t index = from & CAPTURE_MASK;
+    const uint32_t first = CRSF_CAPTURE_SIZE - index < len ? CRSF_CAPTURE_SIZE - index : len;
+    memcpy(buffer, &ring[index], first);
+    memcpy(buffer + first, ring, len - first);
+}
+
+uint32_t CRSFCapture::read(uint32_t offset, uint8_t *buffer, uint32_t len) const
+{
+    uint32_t copied = 0;
+    if (offset < sizeof(crsfCaptureHeader_t))
+    {
+        crsfCaptureHeader_t header = {};
+        memcpy(header.magic, CRSF_CAPTURE_MAGIC, sizeof(header.magic));
+        header.version = CRSF_CAPTURE_VERSION;
+        header.dropped = dropped;
+        copied = sizeof(header) - offset < len ? sizeof(header) - offset : len;
+        memcpy(buffer, (const uint8_t *)&header + offset, copied);
+        offset += copied;
+    }
+
+    const uint32_t used = tail - head;
+    const uint32_t ringOffset = offset - sizeof(crsfCaptureHeader_t);
+    if (copied < len && ringOffset < used)
+    {
+        const uint32_t count = used - ringOffset < len - copied ? used - ringOffset : len - copied;
+        copyOut(head + ringOffset, buffer + copied, count);
+        copied += count;
+    }
+    return copied;
+}
+
+bool CRSFCapture::next(const uint8_t *capture, const uint32_t len, uint32_t &pos, const crsfCaptureRecord_t *&record, const crsf_header_t *&message)
+{
+    if (pos == 0)
+    {
+        const auto header = (const crsfCaptureHeader_t *)capture;
+        if (len < sizeof(crsfCaptureHeader_t) || memcmp(header->magic, CRSF_CAPTURE_MAGIC, sizeof(header->magic)) != 0 || header->version != CRSF_CAPTURE_VERSION)
+        {
+            return false;
+        }
+        pos = sizeof(crsfCaptureHeader_t);
+    }
+    // A record, and the frame up to its length
+    if (pos + sizeof(crsfCaptureRecord_t) + CRSF_FRAME_NOT_COUNTED_BYTES > len)
+    {
+        return false;
+    }
+    const auto frame = (const crsf_header_t *)&capture[pos + sizeof(crsfCaptureRecord_t)];
+    const uint32_t recordLen = sizeof(crsfCaptureRecord_t) + CRSF_FRAME_SIZE(frame->frame_size);
+    if (pos + recordLen > len)
+    {
+        return false;
+    }
+    record = (const crsfCaptureRecord_t *)&capture[pos];
+    message = frame;
+    pos += recordLen;
+    return true;
+}
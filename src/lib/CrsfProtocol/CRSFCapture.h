@@ -0,0 +1,118 @@
+#ifndef CRSF_CAPTURE_H
+#define CRSF_CAPTURE_H
+
+#include "crsf_protocol.h"
+#include "targets.h"
+
+#if defined(PLATFORM_ESP32) && SOC_CPU_CORES_NUM > 1
+#include <mutex>
+#endif
+
+// Bytes of RAM kept for captured frames, must be a power of 2
+#if !defined(CRSF_CAPTURE_SIZE)
+#define CRSF_CAPTURE_SIZE 8192
+#endif
+
+#define CRSF_CAPTURE_MAGIC "ECAP"
+#define CRSF_CAPTURE_VERSION 1
+// Connector id of a frame which did not come from, or go to, a connector (an endpoint sent it)
+#define CRSF_CAPTURE_NO_CONNECTOR 0xFF
+
+typedef enum : uint8_t {
+    CRSF_CAPTURE_IN,    // received by a connector and given to CRSFRouter::processMessage()
+    CRSF_CAPTURE_OUT,   // forwarded to a connector by the router
+} crsfCaptureDirection_e;
+
+/**
+ * Start of a capture download
+ */
+typedef struct crsfCaptureHeader_s {
+    char magic[4];      // CRSF_CAPTURE_MAGIC
+    uint8_t version;    // CRSF_CAPTURE_VERSION
+    uint8_t reserved[3];
+    uint32_t dropped;   // records overwritten by newer ones since the capture was cleared
+} PACKED crsfCaptureHeader_t;
+
+/**
+ * Each record is followed by the whole frame, sync byte to CRC, its length is in the frame
+ */
+typedef struct crsfCaptureRecord_s {
+    uint32_t timeUs;    // micros() when the frame was routed
+    uint8_t connector;  // index of the connector in the router, CRSF_CAPTURE_NO_CONNECTOR if none
+    uint8_t direction;  // crsfCaptureDirection_e
+} PACKED crsfCaptureRecord_t;
+
+/**
+ * Keeps the most recent CRSF frames seen by the CRSFRouter in a RAM ring buffer, each with its
+ * time, the connector and whether it came in or went out, so the traffic of a real installation
+ * can be downloaded and replayed natively (see test_crsf_replay).
+ *
+ * When the ring is full the oldest records are dropped to make room. A download reads a
+ * crsfCaptureHeader_t and then the records oldest first, the capture should be stopped with
+ * setEnabled(false) while it is read so the records do not move underneath it.
+ */
+class CRSFCapture final
+{
+public:
+    /**
+     * Adds a frame to the capture, dropping the oldest records if there is no room for it.
+     *
+     * @param connector Index of the connector in the router, or CRSF_CAPTURE_NO_CONNECTOR
+     * @param direction If the frame came in from, or went out to, the connector
+     * @param message The frame to record
+     * @param timeUs The time of the frame in microseconds
+     */
+    void add(uint8_t connector, crsfCaptureDirection_e direction, const crsf_header_t *message, uint32_t timeUs);
+    void add(uint8_t connector, crsfCaptureDirection_e direction, const crsf_header_t *message) { add(connector, direction, message, micros()); }
+
+    void setEnabled(bool enable) { enabled = enable; }
+    bool isEnabled() const { return enabled; }
+
+    // Drop every record
+    void clear();
+
+    // Number of bytes a download takes, header included
+    uint32_t size() const { return sizeof(crsfCaptureHeader_t) + (tail - head); }
+
+    /**
+     * Copies part of the download, the header and then the records oldest first.
+     *
+     * @param offset Offset in the download to start from
+     * @param buffer Where the bytes are copied to
+     * @param len Maximum number of bytes to copy
+     * @return Number of bytes copied, 0 at the end of the download
+     */
+    uint32_t read(uint32_t offset, uint8_t *buffer, uint32_t len) const;
+
+    /**
+     * Steps through the records of a download.
+     *
+     * @param capture The downloaded capture, header included
+     * @param len Length of the download
+     * @param pos Offset of the next record, 0 to start at the first one, updated to the record after it
+     * @param record Set to the record
+     * @param message Set to the frame of the record
+     * @return false at the end of the capture, or if the download is not a valid capture
+     */
+    static bool next(const uint8_t *capture, uint32_t len, uint32_t &pos, const crsfCaptureRecord_t *&record, const crsf_header_t *&message);
+
+private:
+    uint8_t ring[CRSF_CAPTURE_SIZE];
+    // Free running, the index in the ring is masked
+    uint32_t head = 0;
+    uint32_t tail = 0;
+    uint32_t dropped = 0;
+    bool enabled = true;
+
+    void copyOut(uint32_t from, uint8_t *buffer, uint32_t len) const;
+
+#if defined(PLATFORM_ESP32) && SOC_CPU_CORES_NUM > 1
+    std::mutex mutex;
+#endif
+};
+
+#if defined(CRSF_CAPTURE)
+extern CRSFCapture crsfCapture;
+#endif
+
+#endif //CRSF_CAPTURE_H
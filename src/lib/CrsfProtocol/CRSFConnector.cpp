@@ -1,19 +1,24 @@
 #include "targets.h"
 
 #include "CRSFConnector.h"
+#include "CRSFRouter.h"
 #include "logging.h"
 
 void CRSFConnector::addDevice(const crsf_addr_e device_id)
 {
     if (device_id != 0)
     {
-        devices.insert(device_id);
+        devices[device_id / 32] |= 1U << (device_id % 32);
+        if (router)
+        {
+            router->routes[device_id] |= routeBit;
+        }
     }
 }
 
-bool CRSFConnector::forwardsTo(const crsf_addr_e device_id)
+bool CRSFConnector::forwardsTo(const crsf_addr_e device_id) const
 {
-    return devices.find(device_id) != devices.end();
+    return devices[device_id / 32] & (1U << (device_id % 32));
 }
 
 void CRSFConnector::debugCRSF(const char *str, const crsf_header_t *message)
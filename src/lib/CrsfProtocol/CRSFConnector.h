@@ -3,7 +3,7 @@
 
 #include "crsf_protocol.h"
 
-#include <set>
+class CRSFRouter;
 
 /**
  * @class CRSFConnector
@@ -22,6 +22,8 @@ public:
     /**
      * @brief Adds a device that is reachable via the connector to it's known device list.
      *
+     * If the connector has been added to a CRSFRouter, its routing table is updated as well.
+     *
      * @param device_id The CRSF address of the device to add.
      */
     void addDevice(crsf_addr_e device_id);
@@ -33,7 +35,7 @@ public:
      * @param device_id The CRSF address of the device to check.
      * @return True if the connector forwards messages to the specified device, false otherwise.
      */
-    bool forwardsTo(crsf_addr_e device_id);
+    bool forwardsTo(crsf_addr_e device_id) const;
 
     /**
      * @brief Forwards a CRSF message to its destination device.
@@ -72,7 +74,13 @@ public:
     static void debugCRSF(const char * str, const crsf_header_t * message);
 
 private:
-    std::set<crsf_addr_e> devices;
+    friend class CRSFRouter;
+
+    // One bit per CRSF address
+    uint32_t devices[256 / 32] {};
+    // The router this connector was added to, and its bit in the router's table
+    CRSFRouter *router = nullptr;
+    uint8_t routeBit = 0;
 };
 
 #endif //CRSF_CONNECTOR_H
@@ -179,27 +179,41 @@ uint8_t *CRSFEndpoint::folderParameterToArray(const folderParameter *parameter,
     return childParameters;
 }
 
-uint8_t CRSFEndpoint::sendParameter(const crsf_addr_e origin, const bool isElrs, const crsf_frame_type_e frameType, const uint8_t fieldChunk, const propertiesCommon *parameter)
+// Fletcher-16 of a parameter's entry, only used to tell whether it changed
+static uint16_t entryChecksum(const uint8_t *data, const uint8_t len)
+{
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    for (uint8_t i = 0; i < len; i++)
+    {
+        sum1 = (sum1 + data[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return (sum2 << 8) | sum1;
+}
+
+/**
+ * @brief Serializes a parameter's settings entry, leaving buffer[0] and buffer[1] for the chunk header.
+ *
+ * The entry does not depend on who asked for it, the ELRS hidden flag is applied when a chunk is sent.
+ *
+ * @return Size of the entry from buffer[2], or 0 if the type of parameter is not sent
+ */
+uint8_t CRSFEndpoint::serializeParameter(const propertiesCommon *parameter, uint8_t *buffer) const
 {
     const uint8_t dataType = parameter->type & CRSF_FIELD_TYPE_MASK;
 
     // 256 max payload + (FieldID + ChunksRemain + Parent + Type)
     // Chunk 1: (FieldID + ChunksRemain + Parent + Type) + fieldChunk0 data
     // Chunk 2-N: (FieldID + ChunksRemain) + fieldChunk1 data
-    uint8_t chunkBuffer[256 + 4];
     // Start the field payload at 2 to leave room for (FieldID + ChunksRemain)
-    chunkBuffer[2] = parameter->parent;
-    chunkBuffer[3] = dataType;
+    buffer[2] = parameter->parent;
+    buffer[3] = dataType;
     // Set the hidden flag
-    chunkBuffer[3] |= parameter->type & CRSF_FIELD_HIDDEN ? 0x80 : 0;
-    if (isElrs)
-    {
-        chunkBuffer[3] |= parameter->type & CRSF_FIELD_ELRS_HIDDEN ? 0x80 : 0;
-    }
-    uint8_t paramInformation[CRSF_MAX_PACKET_LEN];
+    buffer[3] |= parameter->type & CRSF_FIELD_HIDDEN ? 0x80 : 0;
 
-    // Copy the name to the buffer starting at chunkBuffer[4]
-    uint8_t *chunkStart = (uint8_t *)stpcpy((char *)&chunkBuffer[4], parameter->name) + 1;
+    // Copy the name to the buffer starting at buffer[4]
+    uint8_t *chunkStart = (uint8_t *)stpcpy((char *)&buffer[4], parameter->name) + 1;
     uint8_t *dataEnd;
 
     switch (dataType)
@@ -225,7 +239,7 @@ uint8_t CRSFEndpoint::sendParameter(const crsf_addr_e origin, const bool isElrs,
     case CRSF_FOLDER:
         // re-fetch the folder name, because folderStructToArray will decide whether
         // to return the fixed name or dynamic name.
-        dataEnd = folderParameterToArray((folderParameter *)parameter, &chunkBuffer[4]);
+        dataEnd = folderParameterToArray((folderParameter *)parameter, &buffer[4]);
         break;
     case CRSF_FLOAT:
     case CRSF_OUT_OF_RANGE:
@@ -236,7 +250,37 @@ uint8_t CRSFEndpoint::sendParameter(const crsf_addr_e origin, const bool isElrs,
     // dataEnd points to the end of the last string
     // -2 bytes chunk header: FieldId, ChunksRemain
     // +1 for the null on the last string
-    const uint8_t dataSize = (dataEnd - chunkBuffer) - 2 + 1;
+    return (dataEnd - buffer) - 2 + 1;
+}
+
+/**
+ * @brief Compares a freshly serialized entry with the last one, a parameter which serializes differently
+ * has changed even if no setter was called (options, names and visibility are changed directly).
+ */
+void CRSFEndpoint::checkParameterChanged(const uint8_t id, const uint8_t *entry, const uint8_t size)
+{
+    const uint16_t checksum = entryChecksum(&entry[2], size);
+    const uint64_t bit = 1ULL << id;
+    if (!(paramChecksumValid & bit))
+    {
+        // The first look at a parameter is where it starts from, not a change
+        paramChecksumValid |= bit;
+        paramChecksum[id] = checksum;
+    }
+    else if (paramChecksum[id] != checksum)
+    {
+        paramChecksum[id] = checksum;
+        paramGeneration[id] = generation + 1;
+    }
+}
+
+void CRSFEndpoint::parameterChanged(const propertiesCommon *parameter)
+{
+    paramGeneration[parameter->id] = generation + 1;
+}
+
+uint8_t CRSFEndpoint::sendChunk(const crsf_addr_e origin, const crsf_frame_type_e frameType, const uint8_t fieldId, const uint8_t fieldChunk, const uint8_t *entry, const uint8_t size, const bool hidden)
+{
     // Maximum number of chunked bytes that can be sent in one response
     // 6 bytes CRSF header/CRC: Dest, Len, Type, ExtSrc, ExtDst, CRC
     // 2 bytes chunk header: FieldId, ChunksRemain
@@ -244,20 +288,120 @@ uint8_t CRSFEndpoint::sendParameter(const crsf_addr_e origin, const bool isElrs,
     // this is for slow baud-rates to the handset
     const uint8_t chunkMax = crsfRouter.getConnectorMaxPacketSize(origin) - 6 - 2;
     // How many chunks needed to send this field (rounded up)
-    const uint8_t chunkCnt = (dataSize + chunkMax - 1) / chunkMax;
+    const uint8_t chunkCnt = (size + chunkMax - 1) / chunkMax;
+    if (fieldChunk >= chunkCnt)
+    {
+        return 0;
+    }
     // Data left to send is adjustedSize - chunks sent already
-    const uint8_t chunkSize = std::min((uint8_t)(dataSize - (fieldChunk * chunkMax)), chunkMax);
+    const uint8_t chunkSize = std::min((uint8_t)(size - (fieldChunk * chunkMax)), chunkMax);
 
-    // Move chunkStart back 2 bytes to add (FieldId + ChunksRemain) to each packet
-    chunkStart = &chunkBuffer[fieldChunk * chunkMax];
-    chunkStart[0] = parameter->id;                 // FieldId
-    chunkStart[1] = chunkCnt - (fieldChunk + 1); // ChunksRemain
-    memcpy(paramInformation + sizeof(crsf_ext_header_t), chunkStart, chunkSize + 2);
+    uint8_t paramInformation[CRSF_MAX_PACKET_LEN];
+    uint8_t *chunk = paramInformation + sizeof(crsf_ext_header_t);
+    chunk[0] = fieldId;                      // FieldId
+    chunk[1] = chunkCnt - (fieldChunk + 1); // ChunksRemain
+    memcpy(&chunk[2], &entry[2 + fieldChunk * chunkMax], chunkSize);
+    if (hidden && fieldChunk == 0)
+    {
+        chunk[3] |= 0x80;
+    }
     crsfRouter.SetExtendedHeaderAndCrc((crsf_ext_header_t *)paramInformation, frameType, CRSF_EXT_FRAME_SIZE(chunkSize + 2), origin, device_id);
     crsfRouter.deliverMessageTo(origin, (crsf_header_t *)paramInformation);
     return chunkCnt - (fieldChunk + 1);
 }
 
+uint8_t CRSFEndpoint::sendParameter(const crsf_addr_e origin, const bool isElrs, const crsf_frame_type_e frameType, const uint8_t fieldChunk, const propertiesCommon *parameter)
+{
+    // 256 max payload + (FieldID + ChunksRemain + Parent + Type)
+    uint8_t entry[256 + 4];
+    const uint8_t size = serializeParameter(parameter, entry);
+    if (size == 0)
+    {
+        return 0;
+    }
+    checkParameterChanged(parameter->id, entry, size);
+
+    const bool hidden = isElrs && (parameter->type & CRSF_FIELD_ELRS_HIDDEN);
+    return sendChunk(origin, frameType, parameter->id, fieldChunk, entry, size, hidden);
+}
+
+/**
+ * @brief Sends the ids of the parameters which changed after generation `since`, so they can be read again
+ * instead of every parameter. The entry is the current generation followed by the ids, ending in 0xFF like
+ * a folder's children. The first few changed entries which fit in one chunk are sent straight after it.
+ *
+ * The generation only moves on when a read finds new changes, so the 8 bit generation a handset holds counts
+ * its own refreshes rather than every change.
+ */
+void CRSFEndpoint::sendParameterChanges(const crsf_addr_e origin, const bool isElrs, const uint8_t since)
+{
+    uint8_t entry[256 + 4];
+    // Parameters changed without a setter only show when serialized, so look at them all
+    for (uint8_t id = 0; id <= lastParameter && paramDefinitions[id]; id++)
+    {
+        const uint8_t size = serializeParameter(paramDefinitions[id], entry);
+        if (size)
+        {
+            checkParameterChanged(id, entry, size);
+        }
+    }
+    // Changes since the last read are marked generation + 1
+    const uint16_t next = generation + 1;
+    for (uint8_t id = 0; id <= lastParameter; id++)
+    {
+        if (paramGeneration[id] == next)
+        {
+            generation = next;
+            break;
+        }
+    }
+
+    // The handset's generation is the most recent one with the same low byte
+    const uint16_t window = (uint8_t)(generation - since);
+    const uint16_t from = generation - window;
+    uint8_t changed[MAX_CRSF_PARAMETERS];
+    uint8_t changedCnt = 0;
+    for (uint8_t id = 0; id <= lastParameter; id++)
+    {
+        // Changed in (from, generation]
+        const uint16_t age = paramGeneration[id] - from;
+        if (age != 0 && age <= window)
+        {
+            changed[changedCnt++] = id;
+        }
+    }
+
+    const uint8_t chunkMax = crsfRouter.getConnectorMaxPacketSize(origin) - 6 - 2;
+    uint8_t *list = &entry[2];
+    uint8_t size = 1;
+    list[0] = (uint8_t)generation;
+    if (changedCnt + 2 > chunkMax)
+    {
+        list[size++] = CRSF_PARAMETER_CHANGES_ALL;
+        changedCnt = 0;
+    }
+    for (uint8_t i = 0; i < changedCnt; i++)
+    {
+        list[size++] = changed[i];
+    }
+    list[size++] = 0xFF;
+    sendChunk(origin, CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY, CRSF_PARAMETER_CHANGES_ID, 0, entry, size, false);
+
+    // Save the handset a round trip for each, anything left out is read as usual
+    uint8_t sent = 0;
+    for (uint8_t i = 0; i < changedCnt && sent < CRSF_PARAMETER_CHANGES_BULK; i++)
+    {
+        const propertiesCommon *parameter = paramDefinitions[changed[i]];
+        const uint8_t entrySize = serializeParameter(parameter, entry);
+        if (entrySize != 0 && entrySize <= chunkMax)
+        {
+            const bool hidden = isElrs && (parameter->type & CRSF_FIELD_ELRS_HIDDEN);
+            sendChunk(origin, CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY, parameter->id, 0, entry, entrySize, hidden);
+            sent++;
+        }
+    }
+}
+
 void CRSFEndpoint::pushResponseChunk(commandParameter *cmd, const bool isElrs)
 {
     DBGVLN("sending response for [%s] chunk=%u step=%u", cmd->common.name, nextStatusChunk, cmd->step);
@@ -298,7 +442,7 @@ void CRSFEndpoint::registerParameter(void *definition, const parameterHandlerCal
 
 void CRSFEndpoint::parameterUpdateReq(const crsf_addr_e origin, const bool isElrs, const uint8_t parameterType, const uint8_t parameterIndex, const uint8_t parameterArg)
 {
-    propertiesCommon *parameter = paramDefinitions[parameterIndex];
+    propertiesCommon *parameter = parameterIndex < MAX_CRSF_PARAMETERS ? paramDefinitions[parameterIndex] : nullptr;
     requestOrigin = origin;
 
     switch (parameterType)
@@ -328,7 +472,11 @@ void CRSFEndpoint::parameterUpdateReq(const crsf_addr_e origin, const bool isElr
 
     case CRSF_FRAMETYPE_PARAMETER_READ: {
         DBGVLN("Read parameter %u %u", fieldId, fieldChunk);
-        if (parameterIndex < MAX_CRSF_PARAMETERS && parameter)
+        if (parameterIndex == CRSF_PARAMETER_CHANGES_ID)
+        {
+            sendParameterChanges(origin, isElrs, parameterArg);
+        }
+        else if (parameterIndex < MAX_CRSF_PARAMETERS && parameter)
         {
             const auto field = (commandParameter *)parameter;
             const uint8_t dataType = field->common.type & CRSF_FIELD_TYPE_MASK;
@@ -409,7 +557,7 @@ void CRSFEndpoint::sendDeviceInformationPacket()
     device->hardwareVer = 0;                                 // unused currently by us, seen [ 0x00, 0x0b, 0x10, 0x01 ] // "Hardware: V 1.01" / "Bootloader: V 3.06"
     device->softwareVer = htobe32(VersionStrToU32(version)); // seen [ 0x00, 0x00, 0x05, 0x0f ] // "Firmware: V 5.15"
     device->fieldCnt = lastParameter;
-    device->parameterVersion = 0;
+    device->parameterVersion = CRSF_PARAMETER_VERSION;
     crsfRouter.SetExtendedHeaderAndCrc((crsf_ext_header_t *)deviceInformation, CRSF_FRAMETYPE_DEVICE_INFO, DEVICE_INFORMATION_FRAME_SIZE, requestOrigin, device_id);
     crsfRouter.deliverMessageTo(requestOrigin, (crsf_header_t *)deviceInformation);
 }
@@ -4,6 +4,14 @@
 #include "CRSFParameters.h"
 
 #define MAX_CRSF_PARAMETERS 64
+// Field id of a parameter read for the list of parameters changed since the generation in its chunk byte
+#define CRSF_PARAMETER_CHANGES_ID 0xFF
+// Sent in place of the list when it does not fit in one chunk, every parameter should be read again
+#define CRSF_PARAMETER_CHANGES_ALL 0xFE
+// Changed entries sent after the list without being asked for, kept low for the telemetry queue to the RX
+#define CRSF_PARAMETER_CHANGES_BULK 4
+// Parameter version in the device info, 1 when CRSF_PARAMETER_CHANGES_ID reads are answered
+#define CRSF_PARAMETER_VERSION 1
 
 class CRSFEndpoint {
 public:
@@ -122,13 +130,30 @@ protected:
      */
     static void filterOptions(selectionParameter *parameter, uint8_t min, uint8_t max, char *allOptions);
 
+    /**
+     * Notes that a parameter has changed, so it is listed by the next CRSF_PARAMETER_CHANGES_ID read.
+     *
+     * The set...Value methods call this when the value changes. Anything else which changes how a parameter
+     * is shown (options, names, visibility) is picked up when the parameter is next serialized.
+     *
+     * @param parameter Pointer to the parameter which changed
+     */
+    void parameterChanged(const propertiesCommon *parameter);
+
     /**
      * Sets the value of a text selection parameter in the CRSF interface.
      *
      * @param parameter Pointer to the selection parameter structure to modify
      * @param newValue The new value to set
      */
-    static void setTextSelectionValue(selectionParameter *parameter, const uint8_t newValue) { parameter->value = newValue; }
+    void setTextSelectionValue(selectionParameter *parameter, const uint8_t newValue)
+    {
+        if (parameter->value != newValue)
+        {
+            parameter->value = newValue;
+            parameterChanged(&parameter->common);
+        }
+    }
 
     /**
      * Sets an unsigned 8-bit integer value in a CRSF parameter structure.
@@ -136,7 +161,14 @@ protected:
      * @param parameter Pointer to the int8Parameter structure to modify
      * @param newValue The new unsigned 8-bit value to set
      */
-    static void setUint8Value(int8Parameter *parameter, const uint8_t newValue) { parameter->properties.u.value = newValue; }
+    void setUint8Value(int8Parameter *parameter, const uint8_t newValue)
+    {
+        if (parameter->properties.u.value != newValue)
+        {
+            parameter->properties.u.value = newValue;
+            parameterChanged(&parameter->common);
+        }
+    }
 
     /**
      * Sets a signed 8-bit integer value in a CRSF parameter structure.
@@ -144,7 +176,14 @@ protected:
      * @param parameter Pointer to the int8Parameter structure to modify
      * @param newValue The new signed 8-bit value to set
      */
-    static void setInt8Value(int8Parameter *parameter, const int8_t newValue) { parameter->properties.s.value = newValue; }
+    void setInt8Value(int8Parameter *parameter, const int8_t newValue)
+    {
+        if (parameter->properties.s.value != newValue)
+        {
+            parameter->properties.s.value = newValue;
+            parameterChanged(&parameter->common);
+        }
+    }
 
     /**
      * Sets an unsigned 16-bit integer value in a CRSF parameter structure.
@@ -153,7 +192,15 @@ protected:
      * @param parameter Pointer to the int16Parameter structure to modify
      * @param newValue The new unsigned 16-bit value to set
      */
-    static void setUint16Value(int16Parameter *parameter, const uint16_t newValue) { parameter->properties.u.value = htobe16(newValue); }
+    void setUint16Value(int16Parameter *parameter, const uint16_t newValue)
+    {
+        const auto value = htobe16(newValue);
+        if (parameter->properties.u.value != value)
+        {
+            parameter->properties.u.value = value;
+            parameterChanged(&parameter->common);
+        }
+    }
 
     /**
      * Sets a signed 16-bit integer value in a CRSF parameter structure.
@@ -162,7 +209,15 @@ protected:
      * @param parameter Pointer to the int16Parameter structure to modify
      * @param newValue The new signed 16-bit value to set
      */
-    static void setInt16Value(int16Parameter *parameter, const int16_t newValue) { parameter->properties.u.value = htobe16((uint16_t)newValue); }
+    void setInt16Value(int16Parameter *parameter, const int16_t newValue)
+    {
+        const auto value = htobe16((uint16_t)newValue);
+        if (parameter->properties.u.value != value)
+        {
+            parameter->properties.u.value = value;
+            parameterChanged(&parameter->common);
+        }
+    }
 
     /**
      * Sets a float value in a CRSF parameter structure.
@@ -171,15 +226,31 @@ protected:
      * @param parameter Pointer to the floatParameter structure to modify
      * @param newValue The new value to set as a 32-bit integer
      */
-    static void setFloatValue(floatParameter *parameter, const int32_t newValue) { parameter->properties.value = htobe32((uint32_t)newValue); }
+    void setFloatValue(floatParameter *parameter, const int32_t newValue)
+    {
+        const auto value = htobe32((uint32_t)newValue);
+        if (parameter->properties.value != value)
+        {
+            parameter->properties.value = value;
+            parameterChanged(&parameter->common);
+        }
+    }
 
     /**
      * Sets a string value in a CRSF parameter structure.
+     * Only a different pointer counts as a change, a string edited in place is noticed when it is next serialized.
      *
      * @param parameter Pointer to the stringParameter structure to modify
      * @param newValue The new string value to set
      */
-    static void setStringValue(stringParameter *parameter, const char *newValue) { parameter->value = newValue; }
+    void setStringValue(stringParameter *parameter, const char *newValue)
+    {
+        if (parameter->value != newValue)
+        {
+            parameter->value = newValue;
+            parameterChanged(&parameter->common);
+        }
+    }
 
 private:
     crsf_addr_e device_id;
@@ -193,6 +264,13 @@ private:
     uint8_t lastParameter = 0;
     uint8_t nextStatusChunk = 0;
 
+    // Bumped by a changes read which finds new changes, each parameter keeps the generation it last changed in
+    uint16_t generation = 0;
+    uint16_t paramGeneration[MAX_CRSF_PARAMETERS] {};
+    // Checksum of each parameter's entry when it was last serialized, to catch changes made without a setter
+    uint16_t paramChecksum[MAX_CRSF_PARAMETERS] {};
+    uint64_t paramChecksumValid = 0;
+
     static uint8_t *textSelectionParameterToArray(const selectionParameter *parameter, uint8_t *next);
     static uint8_t *commandParameterToArray(const commandParameter *parameter, uint8_t *next);
     static uint8_t *int8ParameterToArray(const int8Parameter *parameter, uint8_t *next);
@@ -200,7 +278,11 @@ private:
     static uint8_t *stringParameterToArray(const stringParameter *parameter, uint8_t *next);
     uint8_t *folderParameterToArray(const folderParameter *parameter, uint8_t *next) const;
 
+    uint8_t serializeParameter(const propertiesCommon *parameter, uint8_t *buffer) const;
+    void checkParameterChanged(uint8_t id, const uint8_t *entry, uint8_t size);
+    uint8_t sendChunk(crsf_addr_e origin, crsf_frame_type_e frameType, uint8_t fieldId, uint8_t fieldChunk, const uint8_t *entry, uint8_t size, bool hidden);
     uint8_t sendParameter(crsf_addr_e origin, bool isElrs, crsf_frame_type_e frameType, uint8_t fieldChunk, const propertiesCommon *parameter);
+    void sendParameterChanges(crsf_addr_e origin, bool isElrs, uint8_t since);
     void pushResponseChunk(commandParameter *cmd, bool isElrs);
 };
 
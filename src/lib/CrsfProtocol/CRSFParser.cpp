@@ -1,40 +1,137 @@
 #include "CRSFParser.h"
 
+#include <string.h>
 #include "CRSFRouter.h"
 
-void CRSFParser::processBytes(CRSFConnector *origin, const uint8_t *inputBytes, const uint16_t size, const std::function<void(const crsf_header_t *)>& foundMessage)
+// Telemetry from Betaflight/iNav starts with CRSF_SYNC_BYTE (CRSF_ADDRESS_FLIGHT_CONTROLLER)
+// from a TX module it will be addressed to CRSF_ADDRESS_RADIO_TRANSMITTER (RX used as a relay)
+// and things addressed to CRSF_ADDRESS_CRSF_RECEIVER I guess we should take too since that's us, but we'll just forward them
+static inline bool isSyncByte(const uint8_t inputByte)
 {
-    for (uint16_t i = 0; i < size; ++i)
+    return inputByte == CRSF_SYNC_BYTE || inputByte == CRSF_ADDRESS_RADIO_TRANSMITTER || inputByte == CRSF_ADDRESS_CRSF_RECEIVER;
+}
+
+static inline bool isValidLength(const uint8_t length)
+{
+    return length >= (CRSF_MIN_PACKET_LEN - CRSF_FRAME_NOT_COUNTED_BYTES) && length <= (CRSF_MAX_PACKET_LEN - CRSF_FRAME_NOT_COUNTED_BYTES);
+}
+
+// Non-zero if any byte of word is the byte repeated in pattern
+static inline uint32_t hasByte(const uint32_t word, const uint32_t pattern)
+{
+    const uint32_t x = word ^ pattern;
+    return (x - 0x01010101U) & ~x & 0x80808080U;
+}
+
+/**
+ * Offset of the next sync byte at or after pos, or size if there is none.
+ * Line noise or a stream of another protocol is skipped a word at a time.
+ */
+uint16_t CRSFParser::findSync(const uint8_t *inputBytes, uint16_t pos, const uint16_t size)
+{
+    while (pos < size && ((uintptr_t)&inputBytes[pos] & 3))
     {
-        processByte(origin, inputBytes[i], foundMessage);
+        if (isSyncByte(inputBytes[pos]))
+            return pos;
+        pos++;
     }
+    while (pos + 4 <= size)
+    {
+        uint32_t word;
+        memcpy(&word, &inputBytes[pos], sizeof(word));
+        if (hasByte(word, CRSF_SYNC_BYTE * 0x01010101U) | hasByte(word, CRSF_ADDRESS_RADIO_TRANSMITTER * 0x01010101U) | hasByte(word, CRSF_ADDRESS_CRSF_RECEIVER * 0x01010101U))
+            break;
+        pos += 4;
+    }
+    while (pos < size && !isSyncByte(inputBytes[pos]))
+    {
+        pos++;
+    }
+    return pos;
+}
+
+void CRSFParser::routeMessage(CRSFConnector *origin, const crsf_header_t *message)
+{
+    crsfRouter.processMessage(origin, message);
+}
+
+/**
+ * The next good frame in the input from pos, or nullptr once it is used up.
+ * Rejects the same bytes the byte-wise parser does, so both find the same frames.
+ */
+const crsf_header_t *CRSFParser::nextMessage(const uint8_t *inputBytes, uint16_t &pos, const uint16_t size)
+{
+    // Finish a frame which started in an earlier read
+    while (telemetry_state != TELEMETRY_IDLE && pos < size)
+    {
+        if (appendByte(inputBytes[pos++]) == BYTE_COMPLETED)
+            return (const crsf_header_t *)CRSFinBuffer;
+    }
+
+    while (pos < size)
+    {
+        pos = findSync(inputBytes, pos, size);
+        if (size - pos <= CRSF_TELEMETRY_LENGTH_INDEX)
+            break;
+
+        const uint8_t length = inputBytes[pos + CRSF_TELEMETRY_LENGTH_INDEX];
+        if (!isValidLength(length))
+        {
+            // The byte-wise parser drops the length byte as well
+            pos += CRSF_FRAME_NOT_COUNTED_BYTES;
+            continue;
+        }
+
+        const uint8_t frameLen = length + CRSF_FRAME_NOT_COUNTED_BYTES;
+        if (size - pos < frameLen)
+            break;
+
+        // The whole frame is in this read, check it where it is
+        const uint8_t *frame = &inputBytes[pos];
+        pos += frameLen;
+        if (crsfRouter.crsf_crc.calc(frame + CRSF_FRAME_NOT_COUNTED_BYTES, length - CRSF_TELEMETRY_CRC_LENGTH) == frame[frameLen - 1])
+            return (const crsf_header_t *)frame;
+    }
+
+    // Keep the start of a frame which straddles the end of this read
+    while (pos < size)
+    {
+        appendByte(inputBytes[pos++]);
+    }
+    return nullptr;
 }
 
 bool CRSFParser::processByte(CRSFConnector *origin, const uint8_t inputByte, const std::function<void(const crsf_header_t *)>& foundMessage)
+{
+    const byte_result_e result = appendByte(inputByte);
+    if (result == BYTE_COMPLETED)
+    {
+        const crsf_header_t *header = (crsf_header_t *) CRSFinBuffer;
+        routeMessage(origin, header);
+        // We have found a packet
+        if (foundMessage) foundMessage(header);
+    }
+    return result != BYTE_REJECTED;
+}
+
+CRSFParser::byte_result_e CRSFParser::appendByte(const uint8_t inputByte)
 {
     switch(telemetry_state) {
         case TELEMETRY_IDLE:
-            // Telemetry from Betaflight/iNav starts with CRSF_SYNC_BYTE (CRSF_ADDRESS_FLIGHT_CONTROLLER)
-            // from a TX module it will be addressed to CRSF_ADDRESS_RADIO_TRANSMITTER (RX used as a relay)
-            // and things addressed to CRSF_ADDRESS_CRSF_RECEIVER I guess we should take too since that's us, but we'll just forward them
-            if (inputByte == CRSF_SYNC_BYTE || inputByte == CRSF_ADDRESS_RADIO_TRANSMITTER || inputByte == CRSF_ADDRESS_CRSF_RECEIVER)
+            if (!isSyncByte(inputByte))
             {
-                inBufferIndex = 0;
-                telemetry_state = RECEIVING_LENGTH;
-                CRSFinBuffer[0] = inputByte;
-            }
-            else
-            {
-                return false;
+                return BYTE_REJECTED;
             }
+            inBufferIndex = 0;
+            telemetry_state = RECEIVING_LENGTH;
+            CRSFinBuffer[0] = inputByte;
             break;
 
         case RECEIVING_LENGTH:
-            if (inputByte < (CRSF_MIN_PACKET_LEN - CRSF_FRAME_NOT_COUNTED_BYTES) ||
-                inputByte > (CRSF_MAX_PACKET_LEN - CRSF_FRAME_NOT_COUNTED_BYTES))
+            if (!isValidLength(inputByte))
             {
                 telemetry_state = TELEMETRY_IDLE;
-                return false;
+                return BYTE_REJECTED;
             }
             telemetry_state = RECEIVING_DATA;
             CRSFinBuffer[CRSF_TELEMETRY_LENGTH_INDEX] = inputByte;
@@ -48,19 +145,10 @@ bool CRSFParser::processByte(CRSFConnector *origin, const uint8_t inputByte, con
                 // exclude first bytes (sync byte + length), skip last byte (submitted crc)
                 const uint8_t crc = crsfRouter.crsf_crc.calc(CRSFinBuffer + CRSF_FRAME_NOT_COUNTED_BYTES, CRSFinBuffer[CRSF_TELEMETRY_LENGTH_INDEX] - CRSF_TELEMETRY_CRC_LENGTH);
                 telemetry_state = TELEMETRY_IDLE;
-
-                if (inputByte == crc)
-                {
-                    const crsf_header_t *header = (crsf_header_t *) CRSFinBuffer;
-                    crsfRouter.processMessage(origin, header);
-                    // We have found a packet
-                    if (foundMessage) foundMessage(header);
-                    return true;
-                }
-                return false;
+                return inputByte == crc ? BYTE_COMPLETED : BYTE_REJECTED;
             }
             break;
     }
 
-    return true;
+    return BYTE_ACCEPTED;
 }
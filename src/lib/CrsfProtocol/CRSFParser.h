@@ -9,7 +9,27 @@
 
 class CRSFParser {
 public:
-    void processBytes(CRSFConnector *origin, const uint8_t *inputBytes, uint16_t size, const std::function<void(const crsf_header_t *)> &foundMessage = nullptr);
+    /**
+     * Parse a block of bytes read from a port, routing each frame found and passing it to foundMessage.
+     *
+     * Frames which are whole inside the block are checked and routed where they are, without a copy,
+     * only a frame which straddles two reads is gathered in CRSFinBuffer. The message passed to
+     * foundMessage is only valid until it returns.
+     */
+    template <typename F>
+    void processBytes(CRSFConnector *origin, const uint8_t *inputBytes, uint16_t size, F foundMessage)
+    {
+        uint16_t pos = 0;
+        while (const crsf_header_t *message = nextMessage(inputBytes, pos, size))
+        {
+            routeMessage(origin, message);
+            foundMessage(message);
+        }
+    }
+    void processBytes(CRSFConnector *origin, const uint8_t *inputBytes, uint16_t size)
+    {
+        processBytes(origin, inputBytes, size, [](const crsf_header_t *) {});
+    }
     bool processByte(CRSFConnector *origin, uint8_t inputByte, const std::function<void(const crsf_header_t *)>& foundMessage = nullptr);
 
     // unit testing
@@ -27,10 +47,20 @@ private:
         RECEIVING_DATA
     } telemetry_state_s;
 
+    typedef enum {
+        BYTE_REJECTED,  // not a sync byte, a bad length, or the last byte of a frame with a bad CRC
+        BYTE_ACCEPTED,
+        BYTE_COMPLETED  // the last byte of a good frame, which is in CRSFinBuffer
+    } byte_result_e;
+
     telemetry_state_s telemetry_state = TELEMETRY_IDLE;
     uint8_t inBufferIndex = 0;
     uint8_t CRSFinBuffer[CRSF_MAX_PACKET_LEN] {};
 
+    byte_result_e appendByte(uint8_t inputByte);
+    const crsf_header_t *nextMessage(const uint8_t *inputBytes, uint16_t &pos, uint16_t size);
+    static void routeMessage(CRSFConnector *origin, const crsf_header_t *message);
+    static uint16_t findSync(const uint8_t *inputBytes, uint16_t pos, uint16_t size);
 };
 
 #endif //CRSF_PARSER_H
@@ -1,26 +1,110 @@
 #include "CRSFRouter.h"
 
+#include "logging.h"
 #include "msptypes.h"
 
 elrsLinkStatistics_t linkStats {};
 
+CRSFRouter::~CRSFRouter()
+{
+    for (uint8_t i = 0; i < connectorCount; i++)
+    {
+        connectors[i]->router = nullptr;
+    }
+}
+
 void CRSFRouter::addConnector(CRSFConnector *connector)
 {
-    connectors.insert(connector);
+    if (connector->router == this)
+    {
+        return;
+    }
+    if (connectorCount == CRSF_ROUTER_MAX_CONNECTORS)
+    {
+        ERRLN("CRSF router connector table full");
+        return;
+    }
+    if (connector->router)
+    {
+        connector->router->removeConnector(connector);
+    }
+    connectors[connectorCount++] = connector;
+    connector->router = this;
+    rebuildRoutes();
 }
 
 void CRSFRouter::removeConnector(CRSFConnector *connector)
 {
-    connectors.erase(connector);
+    for (uint8_t i = 0; i < connectorCount; i++)
+    {
+        if (connectors[i] == connector)
+        {
+            connectorCount--;
+            memmove(&connectors[i], &connectors[i + 1], (connectorCount - i) * sizeof(connectors[0]));
+            connectors[connectorCount] = nullptr;
+            connector->router = nullptr;
+            connector->routeBit = 0;
+            rebuildRoutes();
+            return;
+        }
+    }
 }
 
 void CRSFRouter::addEndpoint(CRSFEndpoint *endpoint)
 {
-    endpoints.insert(endpoint);
+    for (uint8_t i = 0; i < endpointCount; i++)
+    {
+        if (endpoints[i] == endpoint)
+        {
+            return;
+        }
+    }
+    if (endpointCount == CRSF_ROUTER_MAX_ENDPOINTS)
+    {
+        ERRLN("CRSF router endpoint table full");
+        return;
+    }
+    endpoints[endpointCount++] = endpoint;
+}
+
+/**
+ * Renumber the connectors and fill the routing table from the devices each one knows about.
+ * Only done when connectors come and go, a new device only sets its connector's bit (see CRSFConnector::addDevice)
+ */
+void CRSFRouter::rebuildRoutes()
+{
+    memset(routes, 0, sizeof(routes));
+    for (uint8_t i = 0; i < connectorCount; i++)
+    {
+        CRSFConnector *connector = connectors[i];
+        connector->routeBit = 1 << i;
+        for (unsigned device = 0; device < 256; device++)
+        {
+            if (connector->forwardsTo((crsf_addr_e)device))
+            {
+                routes[device] |= connector->routeBit;
+            }
+        }
+    }
+}
+
+void CRSFRouter::forwardTo(const uint8_t index, const crsf_header_t *message) const
+{
+    if (capture)
+    {
+        capture->add(index, CRSF_CAPTURE_OUT, message);
+    }
+    connectors[index]->forwardMessage(message);
 }
 
 void CRSFRouter::processMessage(CRSFConnector *connector, const crsf_header_t *message) const
 {
+    if (capture)
+    {
+        const bool ours = connector && connector->router == this;
+        capture->add(ours ? __builtin_ctz(connector->routeBit) : CRSF_CAPTURE_NO_CONNECTOR, CRSF_CAPTURE_IN, message);
+    }
+
     if (message->type == CRSF_FRAMETYPE_HEARTBEAT)
     {
         if (connector)
@@ -38,8 +122,9 @@ void CRSFRouter::processMessage(CRSFConnector *connector, const crsf_header_t *m
         connector->addDevice(extMessage->orig_addr);
     }
 
-    for (const auto endpoint : endpoints)
+    for (uint8_t i = 0; i < endpointCount; i++)
     {
+        CRSFEndpoint *endpoint = endpoints[i];
         if (endpoint->handleRaw(message))
         {
             return;
@@ -64,38 +149,44 @@ void CRSFRouter::deliverMessage(const CRSFConnector *connector, const crsf_heade
     const crsf_frame_type_e packetType = message->type;
     const auto extMessage = (crsf_ext_header_t *)message;
 
+    const uint8_t fromBit = connector && connector->router == this ? connector->routeBit : 0;
+
     // deliver extended header messages to the connector that 'knows' about the destination device address
     if (packetType >= CRSF_FRAMETYPE_DEVICE_PING && extMessage->dest_addr != CRSF_ADDRESS_BROADCAST)
     {
-        for (const auto other : connectors)
+        const uint8_t route = routes[extMessage->dest_addr] & ~fromBit;
+        if (route)
         {
-            if (other != connector && other->forwardsTo(extMessage->dest_addr))
-            {
-                other->forwardMessage(message);
-                return;
-            }
+            forwardTo(__builtin_ctz(route), message);
+            return;
         }
     }
 
     // The destination is not known, or it's a broadcast message so deliver to all other connectors
-    for (const auto other : connectors)
+    for (uint8_t i = 0; i < connectorCount; i++)
     {
-        if (other != connector)
+        if (connectors[i] != connector)
         {
-            other->forwardMessage(message);
+            forwardTo(i, message);
         }
     }
 }
 
 void CRSFRouter::deliverMessageTo(const crsf_addr_e destination, const crsf_header_t *message) const
 {
-    for (const auto other : connectors)
+    if (destination == CRSF_ADDRESS_BROADCAST)
     {
-        if (destination == CRSF_ADDRESS_BROADCAST || other->forwardsTo(destination))
+        for (uint8_t i = 0; i < connectorCount; i++)
         {
-            other->forwardMessage(message);
-            if (destination != CRSF_ADDRESS_BROADCAST) return;
+            forwardTo(i, message);
         }
+        return;
+    }
+
+    const uint8_t route = routes[destination];
+    if (route)
+    {
+        forwardTo(__builtin_ctz(route), message);
     }
 }
 
@@ -179,12 +270,10 @@ void CRSFRouter::AddMspMessage(const mspPacket_t *packet, const crsf_addr_e dest
 
 uint8_t CRSFRouter::getConnectorMaxPacketSize(const crsf_addr_e origin) const
 {
-    for (const auto connector : connectors)
+    const uint8_t route = routes[origin];
+    if (route)
     {
-        if (connector->forwardsTo(origin))
-        {
-            return connector->GetMaxPacketBytes();
-        }
+        return connectors[__builtin_ctz(route)]->GetMaxPacketBytes();
     }
     return CRSF_MAX_PACKET_LEN;
 }
@@ -1,6 +1,7 @@
 #ifndef CRSF_ROUTER_H
 #define CRSF_ROUTER_H
 
+#include "CRSFCapture.h"
 #include "CRSFConnector.h"
 #include "CRSFEndpoint.h"
 #include "crc.h"
@@ -8,16 +9,21 @@
 
 #include <vector>
 
+// Connectors and endpoints are held in fixed arrays, the connectors are a bit each in the routing table
+#define CRSF_ROUTER_MAX_CONNECTORS 8
+#define CRSF_ROUTER_MAX_ENDPOINTS 4
+
 class CRSFRouter final
 {
 public:
     CRSFRouter() = default;
-    ~CRSFRouter() = default;
+    ~CRSFRouter();
 
     /**
      * Adds a CRSFConnector instance to the list of connectors managed by this CRSFRouter.
      *
      * Connectors are the ports that communicate with other devices in the network.
+     * A connector belongs to one router at a time, and at most CRSF_ROUTER_MAX_CONNECTORS are held.
      *
      * @param connector Pointer to the CRSFConnector that will be added to the endpoint's managed connectors.
      */
@@ -34,6 +40,7 @@ public:
      * Adds a CRSFEndpoint instance to the list of endpoints managed by this CRSFRouter.
      *
      * Endpoints are the targets of messages and are expected to process the messages that are sent to them.
+     * They are offered messages in the order they were added, at most CRSF_ROUTER_MAX_ENDPOINTS are held.
      *
      * @param endpoint Pointer to the CRSFEndpoint that will be added to the endpoint's managed endpoints.
      */
@@ -137,11 +144,29 @@ public:
 
     uint8_t getConnectorMaxPacketSize(crsf_addr_e origin) const;
 
-    GENERIC_CRC8 crsf_crc = GENERIC_CRC8(CRSF_CRC_POLY);
+    /**
+     * Records every frame given to processMessage() and every frame forwarded to a connector in the capture.
+     * The connectors are recorded by their index, in the order they were added.
+     *
+     * @param crsfCapture The capture to record the frames in, nullptr to stop recording.
+     */
+    void setCapture(CRSFCapture *crsfCapture) { capture = crsfCapture; }
+
+    GENERIC_CRC8<CRSF_CRC_POLY> crsf_crc;
 
 private:
-    std::set<CRSFConnector *> connectors;
-    std::set<CRSFEndpoint *> endpoints;
+    friend class CRSFConnector;
+
+    void rebuildRoutes();
+    void forwardTo(uint8_t index, const crsf_header_t *message) const;
+
+    CRSFConnector *connectors[CRSF_ROUTER_MAX_CONNECTORS] {};
+    CRSFEndpoint *endpoints[CRSF_ROUTER_MAX_ENDPOINTS] {};
+    uint8_t connectorCount = 0;
+    uint8_t endpointCount = 0;
+    // For each device address, a bit for every connector which forwards to it
+    uint8_t routes[256] {};
+    CRSFCapture *capture = nullptr;
 };
 
 // The global instance of the endpoint
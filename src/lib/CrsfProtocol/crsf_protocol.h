@@ -94,6 +94,7 @@ typedef enum : uint8_t {
     CRSF_COMMAND_SUBCMD_RX_BIND = 0x01,
     CRSF_COMMAND_MODEL_SELECT_ID = 0x05,
     CRSF_HANDSET_SUBCMD_TIMING = 0x10,
+    CRSF_COMMAND_SUBCMD_RX_FHSS_BLACKLIST = 0x20, // ELRS RX->TX, epoch followed by an FHSS_BLACKLIST_BYTES bitmap
 } crsf_subcommand_e;
 
 enum {
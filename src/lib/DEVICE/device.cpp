@@ -4,6 +4,9 @@
 #include "helpers.h"
 #include "device.h"
 
+#include <algorithm>
+#include <string.h>
+
 ///////////////////////////////////////
 // Even though we aren't using anything this keeps the PIO dependency analyzer happy!
 
@@ -30,7 +33,21 @@ static uint8_t deviceCount;
 static uint32_t eventFired[2] = {0, 0};
 static bool lastModelMatch[2] = {false, false};
 
-static unsigned long deviceTimeout[16] = {0};
+#define MAX_DEVICES 16
+#define NOT_SCHEDULED 0xFF
+
+static unsigned long deviceTimeout[MAX_DEVICES] = {0};
+static device_stats_t deviceStats[MAX_DEVICES];
+
+// The devices with a timeout() pending on each core, as a min-heap keyed on deviceTimeout so the
+// update only looks at the devices which are due rather than polling them all
+typedef struct {
+    uint8_t items[MAX_DEVICES];
+    uint8_t count;
+} deadline_heap_t;
+
+static deadline_heap_t deadlines[2];
+static uint8_t heapPosition[MAX_DEVICES]; // where each device is in its core's heap, or NOT_SCHEDULED
 
 #if MULTICORE
 static TaskHandle_t xDeviceTask = nullptr;
@@ -42,10 +59,116 @@ static SemaphoreHandle_t semCore0Complete = nullptr;
 #define CURRENT_CORE -1
 #endif
 
+static bool dueBefore(uint8_t a, uint8_t b)
+{
+    // Wrap safe, the deadlines are never more than INT_MAX ms apart
+    return (long)(deviceTimeout[a] - deviceTimeout[b]) < 0;
+}
+
+static void heapSet(deadline_heap_t &heap, uint8_t pos, uint8_t device)
+{
+    heap.items[pos] = device;
+    heapPosition[device] = pos;
+}
+
+static void heapSiftUp(deadline_heap_t &heap, uint8_t pos)
+{
+    const uint8_t device = heap.items[pos];
+    while (pos > 0)
+    {
+        const uint8_t parent = (pos - 1) / 2;
+        if (!dueBefore(device, heap.items[parent]))
+            break;
+        heapSet(heap, pos, heap.items[parent]);
+        pos = parent;
+    }
+    heapSet(heap, pos, device);
+}
+
+static void heapSiftDown(deadline_heap_t &heap, uint8_t pos)
+{
+    const uint8_t device = heap.items[pos];
+    for (;;)
+    {
+        uint8_t child = pos * 2 + 1;
+        if (child >= heap.count)
+            break;
+        if (child + 1 < heap.count && dueBefore(heap.items[child + 1], heap.items[child]))
+            child++;
+        if (!dueBefore(heap.items[child], device))
+            break;
+        heapSet(heap, pos, heap.items[child]);
+        pos = child;
+    }
+    heapSet(heap, pos, device);
+}
+
+static void heapRemove(deadline_heap_t &heap, uint8_t device)
+{
+    const uint8_t pos = heapPosition[device];
+    if (pos == NOT_SCHEDULED)
+        return;
+    heapPosition[device] = NOT_SCHEDULED;
+    heap.count--;
+    if (pos < heap.count)
+    {
+        // Fill the hole with the last item and move it to where it belongs
+        const uint8_t moved = heap.items[heap.count];
+        heapSet(heap, pos, moved);
+        heapSiftUp(heap, pos);
+        heapSiftDown(heap, heapPosition[moved]);
+    }
+}
+
+/**
+ * Set when the device's timeout() is next called, from a duration returned by one of its functions
+ */
+static void scheduleDevice(deadline_heap_t &heap, uint8_t device, int delay, unsigned long now)
+{
+    if (delay == DURATION_NEVER || uiDevices[device].device->timeout == nullptr)
+    {
+        deviceTimeout[device] = 0xFFFFFFFF;
+        heapRemove(heap, device);
+        return;
+    }
+    deviceTimeout[device] = now + delay;
+    if (heapPosition[device] == NOT_SCHEDULED)
+    {
+        heapSet(heap, heap.count++, device);
+        heapSiftUp(heap, heap.count - 1);
+    }
+    else
+    {
+        heapSiftUp(heap, heapPosition[device]);
+        heapSiftDown(heap, heapPosition[device]);
+    }
+}
+
+/**
+ * Call one of the device's functions, adding the time it takes to the device's statistics
+ */
+static int timedCall(uint8_t device, int (*function)())
+{
+    const unsigned long start = micros();
+    const int delay = function();
+    const uint32_t elapsed = micros() - start;
+
+    device_stats_t &stats = deviceStats[device];
+    stats.calls++;
+    stats.totalUs += elapsed;
+    if (elapsed > stats.maxUs)
+        stats.maxUs = elapsed;
+    return delay;
+}
+
 void devicesRegister(device_affinity_t *devices, uint8_t count)
 {
     uiDevices = devices;
     deviceCount = count;
+    deadlines[0].count = 0;
+    deadlines[1].count = 0;
+    memset(heapPosition, NOT_SCHEDULED, sizeof(heapPosition));
+    devicesResetStats();
 
     #if MULTICORE
         // devicesRegister() comes in on CORE 1 from setup()
@@ -94,17 +217,18 @@ void devicesInit()
 void devicesStart()
 {
     int32_t core = CURRENT_CORE;
+    deadline_heap_t &heap = deadlines[(core == -1) ? 0 : core];
     unsigned long now = millis();
 
     for(size_t i=0 ; i<deviceCount ; i++)
     {
         if (uiDevices[i].core == core || core == -1) {
-            deviceTimeout[i] = 0xFFFFFFFF;
+            int delay = DURATION_NEVER;
             if (uiDevices[i].device->start)
             {
-                int delay = (uiDevices[i].device->start)();
-                deviceTimeout[i] = delay == DURATION_NEVER ? 0xFFFFFFFF : now + delay;
+                delay = timedCall(i, uiDevices[i].device->start);
             }
+            scheduleDevice(heap, i, delay, now);
         }
     }
     #if MULTICORE
@@ -139,6 +263,7 @@ static int _devicesUpdate(unsigned long now)
 {
     const int32_t core = CURRENT_CORE;
     const int32_t coreMulti = (core == -1) ? 0 : core;
+    deadline_heap_t &heap = deadlines[coreMulti];
 
     bool newModelMatch = connectionHasModelMatch && teamraceHasModelMatch;
     uint32_t events = eventFired[coreMulti];
@@ -152,33 +277,33 @@ static int _devicesUpdate(unsigned long now)
         {
             if ((uiDevices[i].core == core || core == -1) && (uiDevices[i].device->event && (uiDevices[i].device->subscribe & events) != 0))
             {
-                int delay = (uiDevices[i].device->event)();
+                int delay = timedCall(i, uiDevices[i].device->event);
                 if (delay != DURATION_IGNORE)
                 {
-                    deviceTimeout[i] = delay == DURATION_NEVER ? 0xFFFFFFFF : now + delay;
+                    scheduleDevice(heap, i, delay, now);
                 }
             }
         }
     }
 
-    int smallest_delay = DURATION_NEVER;
-    for(size_t i=0 ; i<deviceCount ; i++)
+    // Take all the devices which are due off the heap, so each is only called once even if it asks
+    // to be called again immediately, then call them in the order they were registered as some
+    // devices rely on that
+    uint8_t due[MAX_DEVICES];
+    uint8_t dueCount = 0;
+    while (heap.count > 0 && (long)(now - deviceTimeout[heap.items[0]]) >= 0)
     {
-        if ((uiDevices[i].core == core || core == -1) && uiDevices[i].device->timeout)
-        {
-            int delay = deviceTimeout[i] == 0xFFFFFFFF ? DURATION_NEVER : (int)(deviceTimeout[i]-now);
-            if (now >= deviceTimeout[i])
-            {
-                delay = (uiDevices[i].device->timeout)();
-                deviceTimeout[i] = delay == DURATION_NEVER ? 0xFFFFFFFF : now + delay;
-            }
-            if (delay != DURATION_NEVER)
-            {
-                smallest_delay = (smallest_delay == DURATION_NEVER) ? delay : std::min(smallest_delay, delay);
-            }
-        }
+        due[dueCount] = heap.items[0];
+        heapRemove(heap, due[dueCount++]);
     }
-    return smallest_delay;
+    std::sort(due, due + dueCount);
+    for (uint8_t i=0 ; i<dueCount ; i++)
+    {
+        int delay = timedCall(due[i], uiDevices[due[i]].device->timeout);
+        scheduleDevice(heap, due[i], delay, now);
+    }
+
+    return heap.count == 0 ? DURATION_NEVER : (int)(deviceTimeout[heap.items[0]] - now);
 }
 
 void devicesUpdate(unsigned long now)
@@ -186,6 +311,23 @@ void devicesUpdate(unsigned long now)
     _devicesUpdate(now);
 }
 
+bool devicesGetStats(uint8_t index, const char *&name, device_stats_t &stats)
+{
+    if (index >= deviceCount)
+    {
+        return false;
+    }
+    name = uiDevices[index].device->name;
+    // Read from the other core while they're being updated, close enough for finding a slow device
+    stats = deviceStats[index];
+    return true;
+}
+
+void devicesResetStats()
+{
+    memset(deviceStats, 0, sizeof(deviceStats));
+}
+
 #if MULTICORE
 [[noreturn]] static void deviceTask(void *pvArgs)
 {
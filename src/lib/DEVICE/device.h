@@ -34,6 +34,11 @@ enum deviceEvent_t {
 };
 
 typedef struct {
+    /**
+     * @brief Short name of the device, used when reporting its run time statistics
+     */
+    const char *name;
+
     /**
      * @brief Called at the beginning of setup() so the device can configure IO pins etc.
      */
@@ -66,6 +71,12 @@ typedef struct {
     uint32_t subscribe;
 } device_t;
 
+typedef struct {
+  uint32_t calls;    // number of start(), event() and timeout() calls
+  uint32_t totalUs;  // microseconds spent in them
+  uint32_t maxUs;    // the longest of them
+} device_stats_t;
+
 typedef struct {
   /**
    * @brief pointer to the device handler functions
@@ -115,3 +126,18 @@ void devicesTriggerEvent(uint32_t events);
  * This destroys the FreeRTOS task running on the alternate core(s).
  */
 void devicesStop();
+
+/**
+ * @brief Get the run time statistics of a registered device, to find the ones which block the loop.
+ *
+ * @param index index of the device in the registered list
+ * @param name set to the name of the device
+ * @param stats set to the statistics of the device
+ * @return false if there is no device at the index
+ */
+bool devicesGetStats(uint8_t index, const char *&name, device_stats_t &stats);
+
+/**
+ * @brief Clear the run time statistics of all the devices.
+ */
+void devicesResetStats();
@@ -71,6 +71,21 @@ int32_t FreqCorrection_2;
 uint32_t freq_spread;
 uint32_t freq_spread_DualBand;
 
+// Register value of every channel, so a hop is a lookup and FreqCorrection is a single subtract
+uint32_t FHSSfreqRegs[FHSS_MAX_CHANNELS];
+#if defined(RADIO_LR1121)
+uint32_t FHSSfreqRegs_DualBand[FHSS_MAX_CHANNELS];
+#endif
+
+// Adaptive FHSS, the active blacklist and the channels which replace blacklisted ones
+uint8_t FHSSblacklist[FHSS_BLACKLIST_BYTES];
+uint8_t FHSSblacklistEpoch;
+uint8_t FHSSgoodChannels[FHSS_MAX_CHANNELS];
+uint8_t FHSSgoodCount;
+volatile bool FHSSblacklistPending;
+static uint8_t blacklistQueued[FHSS_BLACKLIST_BYTES];
+static uint8_t blacklistQueuedEpoch;
+
 // Variable for Dual Band radios
 bool FHSSusePrimaryFreqBand = true;
 bool FHSSuseDualBand = false;
@@ -78,23 +93,34 @@ bool FHSSuseDualBand = false;
 uint16_t primaryBandCount;
 uint16_t secondaryBandCount;
 
+static void FHSSbuildFreqRegs(const fhss_config_t *config, uint32_t spread, uint32_t *freqRegs)
+{
+    for (uint32_t channel = 0; channel < config->freq_count; channel++)
+    {
+        freqRegs[channel] = config->freq_start + (spread * channel / FREQ_SPREAD_SCALE);
+    }
+}
+
 void FHSSrandomiseFHSSsequence(const uint32_t seed)
 {
     FHSSconfig = &domains[firmwareOptions.domain];
     sync_channel = FHSSconfig->freq_count / 2;
     freq_spread = (FHSSconfig->freq_stop - FHSSconfig->freq_start) * FREQ_SPREAD_SCALE / (FHSSconfig->freq_count - 1);
     primaryBandCount = (FHSS_SEQUENCE_LEN / FHSSconfig->freq_count) * FHSSconfig->freq_count;
+    FHSSbuildFreqRegs(FHSSconfig, freq_spread, FHSSfreqRegs);
 
     DBGLN("Primary Domain %s, %u channels, sync=%u",
         FHSSconfig->domain, FHSSconfig->freq_count, sync_channel);
 
     FHSSrandomiseFHSSsequenceBuild(seed, FHSSconfig->freq_count, sync_channel, FHSSsequence);
+    FHSSresetBlacklist();
 
 #if defined(RADIO_LR1121)
     FHSSconfigDualBand = &domainsDualBand[0];
     sync_channel_DualBand = FHSSconfigDualBand->freq_count / 2;
     freq_spread_DualBand = (FHSSconfigDualBand->freq_stop - FHSSconfigDualBand->freq_start) * FREQ_SPREAD_SCALE / (FHSSconfigDualBand->freq_count - 1);
     secondaryBandCount = (FHSS_SEQUENCE_LEN / FHSSconfigDualBand->freq_count) * FHSSconfigDualBand->freq_count;
+    FHSSbuildFreqRegs(FHSSconfigDualBand, freq_spread_DualBand, FHSSfreqRegs_DualBand);
 
     DBGLN("Dual Domain %s, %u channels, sync=%u",
         FHSSconfigDualBand->domain, FHSSconfigDualBand->freq_count, sync_channel_DualBand);
@@ -105,6 +131,73 @@ void FHSSrandomiseFHSSsequence(const uint32_t seed)
 #endif
 }
 
+void FHSSsanitizeBlacklist(uint8_t *bitmap)
+{
+    // The sync channel is needed to (re)connect, and the number of channels is capped so
+    // the link always keeps hopping across most of the band
+    const uint32_t maxBlacklisted = FHSSconfig->freq_count / FHSS_BLACKLIST_MAX_DIV;
+    uint32_t blacklisted = 0;
+    for (uint32_t channel = 0; channel < FHSS_BLACKLIST_BYTES * 8; channel++)
+    {
+        if (!FHSSisBlacklisted(bitmap, channel))
+        {
+            continue;
+        }
+        if (channel >= FHSSconfig->freq_count || channel == sync_channel || blacklisted == maxBlacklisted)
+        {
+            bitmap[channel / 8] &= ~(1 << (channel % 8));
+        }
+        else
+        {
+            blacklisted++;
+        }
+    }
+}
+
+bool FHSSqueueBlacklist(const uint8_t *bitmap, const uint8_t epoch)
+{
+    if (FHSSblacklistPending)
+    {
+        return false;
+    }
+    memcpy(blacklistQueued, bitmap, sizeof(blacklistQueued));
+    FHSSsanitizeBlacklist(blacklistQueued);
+    blacklistQueuedEpoch = epoch;
+    FHSSblacklistPending = true;
+    return true;
+}
+
+void ICACHE_RAM_ATTR FHSSapplyBlacklist()
+{
+    // The replacement list is built before the new blacklist takes effect, and the ISR
+    // only ever sees valid channel numbers while it is being rebuilt
+    uint8_t goodCount = 0;
+    for (uint32_t channel = 0; channel < FHSSconfig->freq_count; channel++)
+    {
+        // The sync channel is not a replacement, to keep its share of hops the same as the TX expects
+        if (!FHSSisBlacklisted(blacklistQueued, channel) && channel != sync_channel)
+        {
+            FHSSgoodChannels[goodCount++] = channel;
+        }
+    }
+    FHSSgoodCount = goodCount;
+    memcpy(FHSSblacklist, blacklistQueued, sizeof(FHSSblacklist));
+    FHSSblacklistEpoch = blacklistQueuedEpoch;
+    FHSSblacklistPending = false;
+}
+
+void FHSSresetBlacklist()
+{
+    // Called from the main loop while the timer ISR may be hopping. Only the blacklist is cleared,
+    // FHSSgoodChannels is not read while no channel is blacklisted and the ISR rebuilds it when the
+    // next blacklist is applied
+    noInterrupts();
+    FHSSblacklistPending = false;
+    memset(FHSSblacklist, 0, sizeof(FHSSblacklist));
+    FHSSblacklistEpoch = 0;
+    interrupts();
+}
+
 /**
 Requirements:
 1. 0 every n hops
@@ -21,6 +21,12 @@
 #endif
 
 #define FHSS_SEQUENCE_LEN 256
+// Largest freq_count of any domain, sizes the per-channel register tables
+#define FHSS_MAX_CHANNELS 80
+// Adaptive FHSS blacklist, one bit per channel of the primary band
+#define FHSS_BLACKLIST_BYTES ((FHSS_MAX_CHANNELS + 7) / 8)
+// At most 1 in FHSS_BLACKLIST_MAX_DIV channels can be blacklisted, the rest are always hopped
+#define FHSS_BLACKLIST_MAX_DIV 4
 
 typedef struct {
     const char  *domain;
@@ -40,6 +46,14 @@ extern uint32_t freq_spread;
 extern uint8_t FHSSsequence[];
 extern uint_fast8_t sync_channel;
 extern const fhss_config_t *FHSSconfig;
+extern uint32_t FHSSfreqRegs[];     // Register value of each channel, before FreqCorrection
+
+// Adaptive FHSS, blacklisted primary band channels are replaced by one from FHSSgoodChannels
+extern uint8_t FHSSblacklist[];
+extern uint8_t FHSSblacklistEpoch;  // Epoch of the active blacklist, the low bit is sent in SYNC packets
+extern uint8_t FHSSgoodChannels[];
+extern uint8_t FHSSgoodCount;
+extern volatile bool FHSSblacklistPending;
 
 // DualBand Variables
 extern bool FHSSusePrimaryFreqBand;
@@ -49,11 +63,28 @@ extern uint32_t freq_spread_DualBand;
 extern uint8_t FHSSsequence_DualBand[];
 extern uint_fast8_t sync_channel_DualBand;
 extern const fhss_config_t *FHSSconfigDualBand;
+#if defined(RADIO_LR1121)
+extern uint32_t FHSSfreqRegs_DualBand[];
+#endif
 
 // create and randomise an FHSS sequence
 void FHSSrandomiseFHSSsequence(uint32_t seed);
 void FHSSrandomiseFHSSsequenceBuild(uint32_t seed, uint32_t freqCount, uint_fast8_t sync_channel, uint8_t *sequence);
 
+// Clear channels which can never be blacklisted (sync, out of range, over the limit) from a blacklist bitmap
+void FHSSsanitizeBlacklist(uint8_t *bitmap);
+// Queue a blacklist to take effect at the next hop, false if the previous one has not been applied yet
+bool FHSSqueueBlacklist(const uint8_t *bitmap, uint8_t epoch);
+// Called from FHSSgetNextFreq() to swap in a queued blacklist
+void FHSSapplyBlacklist();
+// Back to hopping every channel, epoch 0, safe to call while the timer ISR is hopping
+void FHSSresetBlacklist();
+
+static inline bool FHSSisBlacklisted(const uint8_t *bitmap, const uint8_t channel)
+{
+    return bitmap[channel / 8] & (1 << (channel % 8));
+}
+
 static inline uint32_t FHSSgetMinimumFreq(void)
 {
     return FHSSconfig->freq_start;
@@ -102,16 +133,26 @@ static inline uint16_t FHSSgetSequenceCount()
     }
 }
 
+// Register value of a secondary band channel, only radios with a second band keep a table of them
+static inline uint32_t FHSSgetDualBandFreqReg(const uint8_t channel)
+{
+#if defined(RADIO_LR1121)
+    return FHSSfreqRegs_DualBand[channel];
+#else
+    return FHSSconfigDualBand->freq_start + (freq_spread_DualBand * channel / FREQ_SPREAD_SCALE);
+#endif
+}
+
 // get the initial frequency, which is also the sync channel
 static inline uint32_t FHSSgetInitialFreq()
 {
     if (FHSSusePrimaryFreqBand)
     {
-        return FHSSconfig->freq_start + (sync_channel * freq_spread / FREQ_SPREAD_SCALE) - FreqCorrection;
+        return FHSSfreqRegs[sync_channel] - FreqCorrection;
     }
     else
     {
-        return FHSSconfigDualBand->freq_start + (sync_channel_DualBand * freq_spread_DualBand / FREQ_SPREAD_SCALE);
+        return FHSSgetDualBandFreqReg(sync_channel_DualBand);
     }
 }
 
@@ -121,6 +162,18 @@ static inline uint8_t FHSSgetCurrIndex()
     return FHSSptr;
 }
 
+// Primary band channel for a sequence index. Blacklisted channels are replaced by a good
+// channel picked from the index, so both ends pick the same one without any extra state
+static inline uint8_t FHSSgetChannel(const uint8_t index)
+{
+    const uint8_t channel = FHSSsequence[index];
+    if (FHSSisBlacklisted(FHSSblacklist, channel))
+    {
+        return FHSSgoodChannels[index % FHSSgoodCount];
+    }
+    return channel;
+}
+
 // Is the current frequency the sync frequency
 static inline uint8_t FHSSonSyncChannel()
 {
@@ -143,15 +196,21 @@ static inline void FHSSsetCurrIndex(const uint8_t value)
 // Advance the pointer to the next hop and return the frequency of that channel
 static inline uint32_t FHSSgetNextFreq()
 {
-    FHSSptr = (FHSSptr + 1) % FHSSgetSequenceCount();
+    uint8_t const next = FHSSptr + 1;
+    FHSSptr = (next < FHSSgetSequenceCount()) ? next : 0;
+
+    if (FHSSblacklistPending)
+    {
+        FHSSapplyBlacklist();
+    }
 
     if (FHSSusePrimaryFreqBand)
     {
-        return FHSSconfig->freq_start + (freq_spread * FHSSsequence[FHSSptr] / FREQ_SPREAD_SCALE) - FreqCorrection;
+        return FHSSfreqRegs[FHSSgetChannel(FHSSptr)] - FreqCorrection;
     }
     else
     {
-        return FHSSconfigDualBand->freq_start + (freq_spread_DualBand * FHSSsequence_DualBand[FHSSptr] / FREQ_SPREAD_SCALE);
+        return FHSSgetDualBandFreqReg(FHSSsequence_DualBand[FHSSptr]);
     }
 }
 
@@ -170,20 +229,22 @@ static inline const char *FHSSgetRegulatoryDomain()
 // Get frequency offset by half of the domain frequency range
 static inline uint32_t FHSSGeminiFreq(uint8_t FHSSsequenceIdx)
 {
-    uint32_t freq;
-    uint32_t numfhss = FHSSgetChannelCount();
-    uint8_t offSetIdx = (FHSSsequenceIdx + (numfhss / 2)) % numfhss; 
+    uint32_t const numfhss = FHSSgetChannelCount();
+    // FHSSsequenceIdx < numfhss, so a single subtract wraps it
+    uint32_t offSetIdx = FHSSsequenceIdx + (numfhss / 2);
+    if (offSetIdx >= numfhss)
+    {
+        offSetIdx -= numfhss;
+    }
 
     if (FHSSusePrimaryFreqBand)
     {
-        freq = FHSSconfig->freq_start + (freq_spread * offSetIdx / FREQ_SPREAD_SCALE) - FreqCorrection_2;
+        return FHSSfreqRegs[offSetIdx] - FreqCorrection_2;
     }
     else
     {
-        freq = FHSSconfigDualBand->freq_start + (freq_spread_DualBand * offSetIdx / FREQ_SPREAD_SCALE);
+        return FHSSgetDualBandFreqReg(offSetIdx);
     }
-
-    return freq;
 }
 
 static inline uint32_t FHSSgetGeminiFreq()
@@ -191,13 +252,13 @@ static inline uint32_t FHSSgetGeminiFreq()
     if (FHSSuseDualBand)
     {
         // When using Dual Band there is no need to calculate an offset frequency. Unlike Gemini with 2 frequencies in the same band.
-        return FHSSconfigDualBand->freq_start + (FHSSsequence_DualBand[FHSSptr] * freq_spread_DualBand / FREQ_SPREAD_SCALE);
+        return FHSSgetDualBandFreqReg(FHSSsequence_DualBand[FHSSptr]);
     }
     else
     {
         if (FHSSusePrimaryFreqBand)
         {
-            return FHSSGeminiFreq(FHSSsequence[FHSSgetCurrIndex()]);
+            return FHSSGeminiFreq(FHSSgetChannel(FHSSgetCurrIndex()));
         }
         else
         {
@@ -210,7 +271,7 @@ static inline uint32_t FHSSgetInitialGeminiFreq()
 {
     if (FHSSuseDualBand)
     {
-        return FHSSconfigDualBand->freq_start + (sync_channel_DualBand * freq_spread_DualBand / FREQ_SPREAD_SCALE);
+        return FHSSgetDualBandFreqReg(sync_channel_DualBand);
     }
     else
     {
@@ -0,0 +1,82 @@
+#include "FHSSquality.h"
+
+#include <string.h>
+
+void FHSSChannelQuality::reset()
+{
+    for (uint32_t channel = 0; channel < FHSS_MAX_CHANNELS; channel++)
+    {
+        success[channel] = 65535;
+        rssiAvg[channel] = 0;
+        samples[channel] = 0;
+        rssiSamples[channel] = 0;
+    }
+}
+
+uint8_t FHSSChannelQuality::buildBlacklist(uint8_t *bitmap)
+{
+    memset(bitmap, 0, FHSS_BLACKLIST_BYTES);
+
+    // Average of the channels currently being hopped
+    const uint32_t freqCount = FHSSconfig->freq_count;
+    uint32_t successSum = 0, successCount = 0;
+    int32_t rssiSum = 0, rssiCount = 0;
+    for (uint32_t channel = 0; channel < freqCount; channel++)
+    {
+        if (samples[channel] < FHSS_QUALITY_MIN_SAMPLES || FHSSisBlacklisted(FHSSblacklist, channel))
+            continue;
+        successSum += success[channel];
+        successCount++;
+        if (rssiSamples[channel])
+        {
+            rssiSum += rssiAvg[channel];
+            rssiCount++;
+        }
+    }
+    if (successCount == 0)
+        return 0;
+    const int32_t successMean = successSum / successCount;
+    const int32_t rssiMean = rssiCount ? rssiSum / rssiCount : 0;
+
+    // Candidates sorted worst first
+    uint8_t candidates[FHSS_MAX_CHANNELS];
+    uint32_t candidateCount = 0;
+    for (uint32_t channel = 0; channel < freqCount; channel++)
+    {
+        if (samples[channel] < FHSS_QUALITY_MIN_SAMPLES || channel == sync_channel)
+            continue;
+
+        // Hysteresis, a blacklisted channel has to recover more than a good channel has to drop
+        const bool wasBad = FHSSisBlacklisted(FHSSblacklist, channel);
+        if (wasBad)
+        {
+            success[channel] += (successMean - (int32_t)success[channel]) / 16;
+            rssiAvg[channel] += (rssiMean - rssiAvg[channel]) / 16;
+        }
+        const int32_t successMargin = wasBad ? FHSS_QUALITY_SUCCESS_MARGIN / 2 : FHSS_QUALITY_SUCCESS_MARGIN;
+        const int32_t rssiMargin = (wasBad ? FHSS_QUALITY_RSSI_MARGIN / 2 : FHSS_QUALITY_RSSI_MARGIN) * 16;
+
+        const bool bad = (int32_t)success[channel] < successMean - successMargin
+            || (rssiSamples[channel] && rssiCount && rssiAvg[channel] < rssiMean - rssiMargin);
+        if (!bad)
+            continue;
+
+        uint32_t idx = candidateCount++;
+        while (idx > 0 && success[candidates[idx - 1]] > success[channel])
+        {
+            candidates[idx] = candidates[idx - 1];
+            --idx;
+        }
+        candidates[idx] = channel;
+    }
+
+    const uint32_t maxBlacklisted = freqCount / FHSS_BLACKLIST_MAX_DIV;
+    if (candidateCount > maxBlacklisted)
+        candidateCount = maxBlacklisted;
+    for (uint32_t idx = 0; idx < candidateCount; idx++)
+    {
+        bitmap[candidates[idx] / 8] |= 1 << (candidates[idx] % 8);
+    }
+    FHSSsanitizeBlacklist(bitmap);
+    return candidateCount;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "FHSS.h"
+
+// Averaging of each channel's stats, new = old + (sample - old) / 2^FHSS_QUALITY_SHIFT
+#define FHSS_QUALITY_SHIFT 5
+// Minimum packets on a channel before it can be blacklisted
+#define FHSS_QUALITY_MIN_SAMPLES 16
+// A channel is bad if its success rate is this far below the average of the other channels (of 65535)
+#define FHSS_QUALITY_SUCCESS_MARGIN 13107 // 20%
+// or if its RSSI is this far below the average (dBm)
+#define FHSS_QUALITY_RSSI_MARGIN 10
+
+/**
+ * Per-channel packet success and RSSI on the RX, used to build the adaptive FHSS blacklist.
+ * Only channels which do much worse than the rest of the band are blacklisted, so a link
+ * which is weak on every channel (range) does not blacklist anything.
+ */
+class FHSSChannelQuality
+{
+public:
+    FHSSChannelQuality()
+    {
+        reset();
+    }
+
+    void reset();
+
+    /**
+     * Record the outcome of a packet slot on a channel
+     * @param rssi of the packet in dBm, ignored if not received
+     */
+    void ICACHE_RAM_ATTR update(const uint8_t channel, const bool received, const int8_t rssi)
+    {
+        const int32_t target = received ? 65535 : 0;
+        success[channel] += (target - (int32_t)success[channel]) >> FHSS_QUALITY_SHIFT;
+        if (received)
+        {
+            // RSSI is kept in 1/16 dBm, and starts from the first packet rather than from 0
+            const int32_t rssi16 = (int32_t)rssi * 16;
+            rssiAvg[channel] = (rssiSamples[channel] == 0) ? rssi16 : rssiAvg[channel] + ((rssi16 - rssiAvg[channel]) >> FHSS_QUALITY_SHIFT);
+            if (rssiSamples[channel] < 255)
+                rssiSamples[channel]++;
+        }
+        if (samples[channel] < 255)
+            samples[channel]++;
+    }
+
+    /**
+     * Build a blacklist of the worst channels, already sanitized by FHSSsanitizeBlacklist()
+     * Channels in the current FHSSblacklist are not hopped and get no new samples, so their
+     * stats are pulled back towards the average on every call to re-test them every so often
+     * @return number of channels blacklisted
+     */
+    uint8_t buildBlacklist(uint8_t *bitmap);
+
+    uint16_t getSuccess(const uint8_t channel) const { return success[channel]; }
+
+private:
+    uint16_t success[FHSS_MAX_CHANNELS];    // 65535 = every packet received
+    int16_t rssiAvg[FHSS_MAX_CHANNELS];     // 1/16 dBm
+    uint8_t samples[FHSS_MAX_CHANNELS];
+    uint8_t rssiSamples[FHSS_MAX_CHANNELS];
+};
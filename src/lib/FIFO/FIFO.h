@@ -31,18 +31,34 @@
 
 #pragma once
 
+#include <string.h>
 #include "targets.h"
 #include "logging.h"
 
+/**
+ * @brief What a push does when the data will not fit in the FIFO
+ */
+typedef enum : uint8_t {
+    FIFO_OVERFLOW_FLUSH,            // Empty the FIFO and drop the data
+    FIFO_OVERFLOW_DROP_NEWEST,      // Keep what is queued, push the bytes which fit and drop the rest
+    FIFO_OVERFLOW_DROP_OLDEST_FRAME,// Pop 8-bit length-prefixed "packets" from the head until the data fits
+    FIFO_OVERFLOW_REJECT            // Push nothing, the caller can try again later
+} fifoOverflow_e;
+
 /**
  * @brief A FIFO which can be made thread/SMP safe using coarse-grained locking via `lock`/`unlock` methods.
  *
  * The FIFO also has helper methods for pushing/popping 16-bit size prefixes to the FIFO. This is useful
  * for FIFOs that are used to hold "packets" of data.
  *
- * @tparam FIFO_SIZE size of the FIFO in bytes
+ * Bulk pushes and pops are copied in at most two pieces, split where the buffer wraps, and
+ * `peekSpan`/`commitPop` and `reserveSpan`/`commitPush` give access to the data in place, so it
+ * can be written to or read from a port without going through a temporary buffer.
+ *
+ * @tparam FIFO_SIZE size of the FIFO in bytes, a power of 2 is indexed with a mask
+ * @tparam OVERFLOW_POLICY what a push does if the data will not fit
  */
-template <uint32_t FIFO_SIZE>
+template <uint32_t FIFO_SIZE, fifoOverflow_e OVERFLOW_POLICY = FIFO_OVERFLOW_FLUSH>
 class FIFO
 {
 private:
@@ -50,10 +66,49 @@ private:
     uint32_t head = 0;
     uint32_t tail = 0;
     uint32_t numElements = 0;
+    uint32_t overflows = 0;
 #if defined(PLATFORM_ESP32)
     portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
 #endif
 
+    static constexpr bool IS_POWER_OF_2 = (FIFO_SIZE & (FIFO_SIZE - 1)) == 0;
+
+    static ICACHE_RAM_ATTR uint32_t wrap(const uint32_t index)
+    {
+        return IS_POWER_OF_2 ? index & (FIFO_SIZE - 1) : index % FIFO_SIZE;
+    }
+
+    /**
+     * @brief Apply the overflow policy when `len` bytes will not fit
+     *
+     * @return the number of bytes which can now be pushed, either `len` or fewer if the data is to be cut short
+     */
+    ICACHE_RAM_ATTR uint32_t overflow(const uint32_t len)
+    {
+        overflows++;
+        switch (OVERFLOW_POLICY)
+        {
+        case FIFO_OVERFLOW_DROP_NEWEST:
+            return FIFO_SIZE - numElements;
+        case FIFO_OVERFLOW_DROP_OLDEST_FRAME:
+            if (len > FIFO_SIZE)
+            {
+                return 0;
+            }
+            while (FIFO_SIZE - numElements < len)
+            {
+                skip(pop());
+            }
+            return len;
+        case FIFO_OVERFLOW_REJECT:
+            return 0;
+        default:
+            ERRLN("Buffer full, will flush");
+            flush();
+            return 0;
+        }
+    }
+
 public:
     /**
      * @brief lock the FIFO so no other code should interact with the FIFO.
@@ -83,60 +138,61 @@ public:
     }
 
     /**
-     * @brief Push a single byte to the FIFO, FIFO is flushed if this byte will not fit and the byte is not pushed
+     * @brief Push a single byte to the FIFO. If it will not fit the overflow policy is applied, by default
+     * the FIFO is flushed and the byte is not pushed
      *
      * @param data
+     * @return true if the byte was pushed
      */
-    ICACHE_RAM_ATTR void push(const uint8_t data)
+    ICACHE_RAM_ATTR bool push(const uint8_t data)
     {
-        if (numElements == FIFO_SIZE)
-        {
-            ERRLN("Buffer full, will flush");
-            flush();
-            return;
-        }
-        else
+        if (numElements == FIFO_SIZE && overflow(1) == 0)
         {
-            numElements++;
-            buffer[tail] = data;
-            tail = (tail + 1) % FIFO_SIZE;
+            return false;
         }
+        numElements++;
+        buffer[tail] = data;
+        tail = wrap(tail + 1);
+        return true;
     }
 
     /**
-     * @brief Push all bytes to FIFO, if all the bytes will not fit then the FIFO is flushed and no bytes are pushed
+     * @brief Push all bytes to FIFO. If all the bytes will not fit the overflow policy is applied, by default
+     * the FIFO is flushed and no bytes are pushed
      *
      * @param data pointer to the bytes to be pushed onto the FIFO
      * @param len number of bytes in `data` to push
+     * @return true if all the bytes were pushed
      */
-    ICACHE_RAM_ATTR void pushBytes(const uint8_t *data, const uint16_t len)
+    ICACHE_RAM_ATTR bool pushBytes(const uint8_t *data, const uint16_t len)
     {
+        uint32_t count = len;
         if (numElements + len > FIFO_SIZE)
         {
-            ERRLN("Buffer full, will flush");
-            flush();
-            return;
-        }
-        for (int i = 0; i < len; i++)
-        {
-            buffer[tail] = data[i];
-            tail = (tail + 1) % FIFO_SIZE;
+            count = overflow(len);
         }
-        numElements += len;
+        const uint32_t first = std::min(count, FIFO_SIZE - tail);
+        memcpy(&buffer[tail], data, first);
+        memcpy(buffer, data + first, count - first);
+        tail = wrap(tail + count);
+        numElements += count;
+        return count == len;
     }
 
     /**
-     * @brief Push all bytes to FIFO, if all the bytes will not fit then the FIFO is flushed and no bytes are pushed.
+     * @brief Push all bytes to FIFO, if all the bytes will not fit then the overflow policy is applied.
      * This is performed under locking so the whole call is atomic.
      *
      * @param data pointer to the bytes to be pushed onto the FIFO
      * @param len number of bytes in `data` to push
+     * @return true if all the bytes were pushed
      */
-    ICACHE_RAM_ATTR void atomicPushBytes(const uint8_t *data, const uint16_t len)
+    ICACHE_RAM_ATTR bool atomicPushBytes(const uint8_t *data, const uint16_t len)
     {
         lock();
-        pushBytes(data, len);
+        const bool pushed = pushBytes(data, len);
         unlock();
+        return pushed;
     }
 
     /**
@@ -152,7 +208,7 @@ public:
         }
         numElements--;
         uint8_t data = buffer[head];
-        head = (head + 1) % FIFO_SIZE;
+        head = wrap(head + 1);
         return data;
     }
 
@@ -172,11 +228,58 @@ public:
             return;
         }
         numElements -= len;
-        for (int i = 0; i < len; i++)
-        {
-            data[i] = buffer[head];
-            head = (head + 1) % FIFO_SIZE;
-        }
+        const uint32_t first = std::min((uint32_t)len, FIFO_SIZE - head);
+        memcpy(data, &buffer[head], first);
+        memcpy(data + first, buffer, len - first);
+        head = wrap(head + len);
+    }
+
+    /**
+     * @brief Get the bytes at the head of the FIFO which are contiguous in its buffer, without removing them.
+     * If the data wraps then the rest is returned by the next call, after `commitPop`.
+     * Only the code popping from the FIFO may use the span, and it is valid until the bytes are popped.
+     *
+     * @param data set to point at the first byte in the FIFO
+     * @return the number of bytes which can be read from `data`
+     */
+    ICACHE_RAM_ATTR uint16_t peekSpan(const uint8_t *&data) const
+    {
+        data = &buffer[head];
+        return std::min(numElements, FIFO_SIZE - head);
+    }
+
+    /**
+     * @brief Remove `len` bytes from the head of the FIFO, after they have been used from `peekSpan`
+     *
+     * @param len number of bytes to remove
+     */
+    ICACHE_RAM_ATTR void commitPop(const uint16_t len)
+    {
+        skip(len);
+    }
+
+    /**
+     * @brief Get the free space after the tail of the FIFO which is contiguous in its buffer, so data can be
+     * read straight into it. Only the code pushing to the FIFO may use the span, nothing is pushed until `commitPush`.
+     *
+     * @param data set to point at where the next byte pushed goes
+     * @return the number of bytes which can be written to `data`
+     */
+    ICACHE_RAM_ATTR uint16_t reserveSpan(uint8_t *&data)
+    {
+        data = &buffer[tail];
+        return std::min(FIFO_SIZE - numElements, FIFO_SIZE - tail);
+    }
+
+    /**
+     * @brief Add `len` bytes written into the span from `reserveSpan` to the tail of the FIFO
+     *
+     * @param len number of bytes written, at most what `reserveSpan` returned
+     */
+    ICACHE_RAM_ATTR void commitPush(const uint16_t len)
+    {
+        tail = wrap(tail + len);
+        numElements += len;
     }
 
     /**
@@ -238,7 +341,7 @@ public:
     {
         if (size() > 1)
         {
-            return (uint16_t)buffer[head] + ((uint16_t)buffer[(head + 1) % FIFO_SIZE] << 8);
+            return (uint16_t)buffer[head] + ((uint16_t)buffer[wrap(head + 1)] << 8);
         }
         return 0;
     }
@@ -267,6 +370,14 @@ public:
         numElements = 0;
     }
 
+    /**
+     * @brief return the number of pushes which did not fit, whatever the overflow policy did with them
+     */
+    ICACHE_RAM_ATTR uint32_t getOverflows() const
+    {
+        return overflows;
+    }
+
     /**
      * @brief Check to see if the FIFO can accept the number of bytes in the parameter
      *
@@ -294,9 +405,7 @@ public:
         }
         while(!available(requiredSize))
         {
-            uint8_t len = pop();
-            head = (head + len) % FIFO_SIZE;
-            numElements -= len;
+            skip(pop());
         }
         return true;
     }
@@ -310,7 +419,7 @@ public:
      */
     ICACHE_RAM_ATTR uint8_t operator [](const uint16_t index) const
     {
-        return buffer[(head + index) % FIFO_SIZE];
+        return buffer[wrap(head + index)];
     }
 
     /**
@@ -322,7 +431,7 @@ public:
      */
     ICACHE_RAM_ATTR void set(const uint16_t index, const uint8_t value)
     {
-        buffer[(head + index) % FIFO_SIZE] = value;
+        buffer[wrap(head + index)] = value;
     }
 
     /**
@@ -337,6 +446,6 @@ public:
     {
         uint32_t skipCount = std::min((uint32_t)len, numElements);
         numElements -= skipCount;
-        head = (head + skipCount) % FIFO_SIZE;
+        head = wrap(head + skipCount);
     }
 };
\ No newline at end of file
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <atomic>
+#include <string.h>
+#include "targets.h"
+
+// The producer's and consumer's indexes are kept at least this many bytes apart, so they are not in the same cache line
+#if !defined(SPSC_CACHE_LINE)
+#if defined(TARGET_NATIVE)
+#define SPSC_CACHE_LINE 64
+#else
+#define SPSC_CACHE_LINE 32
+#endif
+#endif
+
+/**
+ * @brief A lock-free ring buffer for exactly one producer and one consumer, which can be on different
+ * cores or one of them an ISR.
+ *
+ * Only the producer moves the tail and only the consumer moves the head, each publishing its index with
+ * release ordering after it has written or read the data, so neither side ever waits for the other and no
+ * critical section or interrupt masking is needed. The indexes run freely and are masked into the buffer,
+ * which is why the size must be a power of 2.
+ *
+ * The methods are marked with the side which may call them. Calling a producer method from two places at
+ * once, or a consumer method, corrupts the ring; use a locked `FIFO` where there is more than one of either.
+ *
+ * @tparam RING_SIZE size of the ring in bytes, a power of 2
+ */
+template <uint32_t RING_SIZE>
+class SPSCRing
+{
+    static_assert(RING_SIZE != 0 && (RING_SIZE & (RING_SIZE - 1)) == 0, "SPSCRing size must be a power of 2");
+    static_assert(RING_SIZE <= 32768, "SPSCRing sizes are returned as 16 bits");
+
+public:
+    /**
+     * @brief Producer: push a single byte
+     *
+     * @return true if there was room for it
+     */
+    ICACHE_RAM_ATTR bool push(const uint8_t data)
+    {
+        return pushBytes(&data, 1);
+    }
+
+    /**
+     * @brief Producer: push all the bytes, or none of them if they will not all fit
+     *
+     * @param data pointer to the bytes to be pushed
+     * @param len number of bytes in `data` to push
+     * @return true if the bytes were pushed
+     */
+    ICACHE_RAM_ATTR bool pushBytes(const uint8_t *data, const uint16_t len)
+    {
+        if (len > free())
+        {
+            return false;
+        }
+        write(0, data, len);
+        commitPush(len);
+        return true;
+    }
+
+    /**
+     * @brief Producer: the number of bytes which can be pushed
+     */
+    ICACHE_RAM_ATTR uint16_t free() const
+    {
+        return RING_SIZE - (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire));
+    }
+
+    /**
+     * @brief Producer: get the free space after the tail which is contiguous in the buffer, so data can be
+     * read straight into it. Nothing is seen by the consumer until `commitPush`.
+     *
+     * @param data set to point at where the next byte pushed goes
+     * @return the number of bytes which can be written to `data`
+     */
+    ICACHE_RAM_ATTR uint16_t reserveSpan(uint8_t *&data)
+    {
+        const uint32_t index = tail.load(std::memory_order_relaxed) & MASK;
+        data = &buffer[index];
+        const uint16_t space = free();
+        return space < RING_SIZE - index ? space : RING_SIZE - index;
+    }
+
+    /**
+     * @brief Producer: publish `len` bytes written into the span from `reserveSpan`
+     */
+    ICACHE_RAM_ATTR void commitPush(const uint16_t len)
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + len, std::memory_order_release);
+    }
+
+    /**
+     * @brief Consumer: pop a single byte (returns 0 if the ring is empty)
+     */
+    ICACHE_RAM_ATTR uint8_t pop()
+    {
+        uint8_t data = 0;
+        popBytes(&data, 1);
+        return data;
+    }
+
+    /**
+     * @brief Consumer: pop `len` bytes into the buffer pointed to by `data`, or nothing if there are not that many
+     *
+     * @param data pointer to a buffer where the bytes are popped into
+     * @param len number of bytes to pop
+     * @return true if the bytes were popped
+     */
+    ICACHE_RAM_ATTR bool popBytes(uint8_t *data, const uint16_t len)
+    {
+        if (readable() < len)
+        {
+            return false;
+        }
+        read(0, data, len);
+        commitPop(len);
+        return true;
+    }
+
+    /**
+     * @brief Consumer: get the bytes at the head which are contiguous in the buffer, without removing them.
+     * If the data wraps then the rest is returned by the next call, after `commitPop`.
+     *
+     * @param data set to point at the first byte in the ring
+     * @return the number of bytes which can be read from `data`
+     */
+    ICACHE_RAM_ATTR uint16_t peekSpan(const uint8_t *&data)
+    {
+        const uint16_t used = readable();
+        const uint32_t index = head.load(std::memory_order_relaxed) & MASK;
+        data = &buffer[index];
+        return used < RING_SIZE - index ? used : RING_SIZE - index;
+    }
+
+    /**
+     * @brief Consumer: remove `len` bytes from the head, after they have been used from `peekSpan`
+     */
+    ICACHE_RAM_ATTR void commitPop(const uint16_t len)
+    {
+        head.store(head.load(std::memory_order_relaxed) + len, std::memory_order_release);
+    }
+
+    /**
+     * @brief Consumer: the number of bytes which can be popped, after dropping them all if a flush was asked for
+     */
+    ICACHE_RAM_ATTR uint16_t readable()
+    {
+        const uint32_t end = tail.load(std::memory_order_acquire);
+        if (clearRequested.load(std::memory_order_acquire))
+        {
+            clearRequested.store(false, std::memory_order_relaxed);
+            head.store(end, std::memory_order_release);
+        }
+        return end - head.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Either side: the number of bytes in the ring. Only an estimate for the producer, as the consumer
+     * may be removing bytes at the same time.
+     */
+    ICACHE_RAM_ATTR uint16_t size() const
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Either side: empty the ring. The bytes are dropped by the consumer the next time it reads,
+     * along with anything pushed in the meantime.
+     */
+    ICACHE_RAM_ATTR void flush()
+    {
+        clearRequested.store(true, std::memory_order_release);
+    }
+
+protected:
+    static constexpr uint32_t MASK = RING_SIZE - 1;
+
+    /**
+     * @brief Producer: copy bytes to `offset` past the tail, without publishing them
+     */
+    ICACHE_RAM_ATTR void write(const uint32_t offset, const uint8_t *data, const uint32_t len)
+    {
+        const uint32_t index = (tail.load(std::memory_order_relaxed) + offset) & MASK;
+        const uint32_t first = RING_SIZE - index < len ? RING_SIZE - index : len;
+        memcpy(&buffer[index], data, first);
+        memcpy(buffer, data + first, len - first);
+    }
+
+    /**
+     * @brief Consumer: copy bytes from `offset` past the head, without removing them
+     */
+    ICACHE_RAM_ATTR void read(const uint32_t offset, uint8_t *data, const uint32_t len) const
+    {
+        const uint32_t index = (head.load(std::memory_order_relaxed) + offset) & MASK;
+        const uint32_t first = RING_SIZE - index < len ? RING_SIZE - index : len;
+        memcpy(data, &buffer[index], first);
+        memcpy(data + first, buffer, len - first);
+    }
+
+private:
+    std::atomic<uint32_t> head {0};     // only written by the consumer
+    uint8_t headPad[SPSC_CACHE_LINE - sizeof(std::atomic<uint32_t>)];
+    std::atomic<uint32_t> tail {0};     // only written by the producer
+    std::atomic<bool> clearRequested {false};
+    uint8_t tailPad[SPSC_CACHE_LINE - sizeof(std::atomic<uint32_t>) - sizeof(std::atomic<bool>)];
+    uint8_t buffer[RING_SIZE];
+};
+
+/**
+ * @brief An SPSCRing which holds whole messages of up to 65535 bytes, each with a 16-bit size prefix.
+ * A message is published in one go, so the consumer never sees part of one.
+ *
+ * @tparam RING_SIZE size of the ring in bytes, including the prefixes, a power of 2
+ */
+template <uint32_t RING_SIZE>
+class SPSCFrameRing : private SPSCRing<RING_SIZE>
+{
+    using Ring = SPSCRing<RING_SIZE>;
+
+public:
+    using Ring::flush;
+    using Ring::size;
+    using Ring::free;
+    using Ring::readable;
+
+    /**
+     * @brief Producer: push a message, or nothing if it and its prefix will not fit
+     *
+     * @return true if the message was pushed
+     */
+    ICACHE_RAM_ATTR bool pushFrame(const uint8_t *data, const uint16_t len)
+    {
+        if ((uint32_t)len + sizeof(uint16_t) > Ring::free())
+        {
+            return false;
+        }
+        const uint8_t prefix[sizeof(uint16_t)] = {(uint8_t)len, (uint8_t)(len >> 8)};
+        Ring::write(0, prefix, sizeof(prefix));
+        Ring::write(sizeof(prefix), data, len);
+        Ring::commitPush(sizeof(prefix) + len);
+        return true;
+    }
+
+    /**
+     * @brief Consumer: the size of the message at the head, without removing it
+     *
+     * @return the size of the message, or 0 if there is none
+     */
+    ICACHE_RAM_ATTR uint16_t peekFrameSize()
+    {
+        if (Ring::readable() < sizeof(uint16_t))
+        {
+            return 0;
+        }
+        uint8_t prefix[sizeof(uint16_t)];
+        Ring::read(0, prefix, sizeof(prefix));
+        return prefix[0] | (prefix[1] << 8);
+    }
+
+    /**
+     * @brief Consumer: pop the message at the head. A message larger than `maxLen` is dropped.
+     *
+     * @param data pointer to a buffer of `maxLen` bytes where the message is popped into
+     * @return the size of the message, or 0 if there was none or it was dropped
+     */
+    ICACHE_RAM_ATTR uint16_t popFrame(uint8_t *data, const uint16_t maxLen)
+    {
+        const uint16_t len = peekFrameSize();
+        if (Ring::readable() < sizeof(uint16_t))
+        {
+            return 0;
+        }
+        if (len <= maxLen)
+        {
+            Ring::read(sizeof(uint16_t), data, len);
+        }
+        Ring::commitPop(sizeof(uint16_t) + len);
+        return len <= maxLen ? len : 0;
+    }
+};
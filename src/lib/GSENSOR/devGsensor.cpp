@@ -63,6 +63,7 @@ static int timeout()
 }
 
 device_t Gsensor_device = {
+    .name = "Gsensor",
     .initialize = initialize,
     .start = start,
     .event = NULL,
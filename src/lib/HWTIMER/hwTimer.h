@@ -9,6 +9,14 @@
 #define TimerIntervalUSDefault 20000
 #endif
 
+// Timer ticks per microsecond, HWtimerInterval, PhaseShift and FreqOffset are in ticks.
+// The RX (and anything on the ESP8266) counts in 1/5us steps for a finer FreqOffset
+#if defined(TARGET_TX) && !defined(PLATFORM_ESP8266)
+#define HWTIMER_TICKS_PER_US 1
+#else
+#define HWTIMER_TICKS_PER_US 5
+#endif
+
 /**
  * @brief Hardware abstraction for the hardware timer to provide precise timing
  *
@@ -73,6 +81,11 @@ public:
      */
     static ICACHE_RAM_ATTR void inline decFreqOffset() { FreqOffset--; }
 
+    /**
+     * @brief Set the frequency offset, in timer ticks added to every tick and tock
+     */
+    static ICACHE_RAM_ATTR void inline setFreqOffset(int32_t newFreqOffset) { FreqOffset = newFreqOffset; }
+
     /**
      * @brief Get the frequency offset
      */
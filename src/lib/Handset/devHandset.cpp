@@ -43,6 +43,7 @@ static int timeout()
 }
 
 device_t Handset_device = {
+    .name = "Handset",
     .initialize = initialize,
     .start = start,
     .event = nullptr,
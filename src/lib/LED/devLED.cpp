@@ -222,6 +222,7 @@ static int start()
 }
 
 device_t LED_device = {
+    .name = "LED",
     .initialize = initialize,
     .start = start,
     .event = event,
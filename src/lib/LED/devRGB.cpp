@@ -463,6 +463,7 @@ static int timeout()
 }
 
 device_t RGB_device = {
+    .name = "RGB",
     .initialize = initialize,
     .start = start,
     .event = timeout,
@@ -20,7 +20,7 @@ n+8     checksum                uint8, (n= payload size), crc8_dvb_s2 checksum
 // CRC helper function.
 uint8_t crc8_dvb_s2(uint8_t crc, unsigned char a)
 {
-    static GENERIC_CRC8 crc8_dvb_s2_instance(0xD5);
+    static GENERIC_CRC8<0xD5> crc8_dvb_s2_instance;
     return crc8_dvb_s2_instance.calc(crc ^ a);
 }
 
@@ -86,7 +86,11 @@ MSP::processReceivedByte(uint8_t c)
                 m_packet.flags = header->flags;
                 // reset the offset iterator for re-use in payload below
                 m_offset = 0;
-				if (m_packet.payloadSize == 0)
+                if (m_packet.payloadSize > MSP_PORT_INBUF_SIZE) {
+                    DBGLN("MSP payload of %u bytes is too large", m_packet.payloadSize);
+                    m_inputState = MSP_IDLE;
+                }
+				else if (m_packet.payloadSize == 0)
                 	m_inputState = MSP_CHECKSUM_V2_NATIVE;
 				else
                 	m_inputState = MSP_PAYLOAD_V2_NATIVE;
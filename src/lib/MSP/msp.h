@@ -2,9 +2,8 @@
 
 #include "targets.h"
 
-// TODO: MSP_PORT_INBUF_SIZE should be changed to
-// dynamically allocate array length based on the payload size
-// Hardcoding payload size to 64 bytes for now, to match CRSF TLM
+// Hardcoding payload size to 64 bytes, to match CRSF TLM. Frames with a larger payload are dropped
+// by MSP::processReceivedByte(), use MSPStream (msp_stream.h) to receive those
 #define MSP_PORT_INBUF_SIZE 64
 
 #define CHECK_PACKET_PARSING() \
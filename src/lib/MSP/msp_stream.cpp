@@ -0,0 +1,158 @@
+#include "msp_stream.h"
+
+#include <string.h>
+#include "crc.h"
+
+static GENERIC_CRC8<0xD5> crc8_dvb_s2_stream;
+
+#define MSP_V1_JUMBO_SIZE 255
+
+/**
+ * Which header bytes are needed: size and function for v1, plus a 16 bit size for jumbo, or the v2 header
+ */
+static uint8_t headerBytesNeeded(const mspVersion_e version, const uint8_t *headerBytes, const uint8_t headerLen)
+{
+    if (version == MSP_VERSION_V2)
+    {
+        return sizeof(mspHeaderV2_t);
+    }
+    return headerLen >= 1 && headerBytes[0] == MSP_V1_JUMBO_SIZE ? 4 : 2;
+}
+
+void MSPStream::startPayload(MSPStreamHandler &handler)
+{
+    if (header.version == MSP_VERSION_V2)
+    {
+        const mspHeaderV2_t *v2 = (const mspHeaderV2_t *)headerBytes;
+        header.flags = v2->flags;
+        header.function = v2->function;
+        header.payloadSize = v2->payloadSize;
+    }
+    else
+    {
+        header.flags = 0;
+        header.function = headerBytes[1];
+        header.payloadSize = headerBytes[0] == MSP_V1_JUMBO_SIZE ? headerBytes[2] | (headerBytes[3] << 8) : headerBytes[0];
+    }
+    offset = 0;
+    arena = nullptr;
+    skip = !handler.onFrameStart(header, arena);
+    state = header.payloadSize == 0 ? MSP_STREAM_CHECKSUM : MSP_STREAM_PAYLOAD;
+}
+
+void MSPStream::processBytes(const uint8_t *data, const uint32_t len, MSPStreamHandler &handler)
+{
+    const uint8_t *end = data + len;
+    while (data < end)
+    {
+        switch (state)
+        {
+        case MSP_STREAM_IDLE:
+        {
+            // Skip to the next framing char
+            const uint8_t *start = (const uint8_t *)memchr(data, '$', end - data);
+            if (start == nullptr)
+            {
+                return;
+            }
+            data = start + 1;
+            state = MSP_STREAM_HEADER_START;
+            break;
+        }
+
+        case MSP_STREAM_HEADER_START:
+            if (*data == 'M' || *data == 'X')
+            {
+                header.version = *data == 'X' ? MSP_VERSION_V2 : MSP_VERSION_V1;
+                state = MSP_STREAM_HEADER_VERSION;
+            }
+            else
+            {
+                // Could be the start of the next frame, so look at it again
+                state = MSP_STREAM_IDLE;
+                continue;
+            }
+            data++;
+            break;
+
+        case MSP_STREAM_HEADER_VERSION:
+            // Errors ('!') are not passed on
+            if (*data == '<' || *data == '>')
+            {
+                header.type = *data == '<' ? MSP_PACKET_COMMAND : MSP_PACKET_RESPONSE;
+                headerLen = 0;
+                checksum = 0;
+                state = MSP_STREAM_HEADER;
+            }
+            else
+            {
+                state = MSP_STREAM_IDLE;
+            }
+            data++;
+            break;
+
+        case MSP_STREAM_HEADER:
+            headerBytes[headerLen++] = *data;
+            checksum = header.version == MSP_VERSION_V2 ? crc8_dvb_s2_stream.calc(checksum ^ *data) : checksum ^ *data;
+            data++;
+            if (headerLen == headerBytesNeeded(header.version, headerBytes, headerLen))
+            {
+                startPayload(handler);
+            }
+            break;
+
+        case MSP_STREAM_PAYLOAD:
+        {
+            // Everything up to the end of the payload, or the read, in one go
+            const uint16_t remaining = header.payloadSize - offset;
+            const uint16_t count = (uint32_t)(end - data) < remaining ? end - data : remaining;
+            if (header.version == MSP_VERSION_V2)
+            {
+                checksum = crc8_dvb_s2_stream.calc(data, count, checksum);
+            }
+            else
+            {
+                for (uint16_t i = 0; i < count; i++)
+                {
+                    checksum ^= data[i];
+                }
+            }
+            if (skip)
+            {
+                // Nothing to deliver
+            }
+            else if (arena)
+            {
+                memcpy(&arena[offset], data, count);
+            }
+            else
+            {
+                handler.onPayload(header, offset, data, count);
+            }
+            offset += count;
+            data += count;
+            if (offset == header.payloadSize)
+            {
+                state = MSP_STREAM_CHECKSUM;
+            }
+            break;
+        }
+
+        case MSP_STREAM_CHECKSUM:
+        {
+            const bool valid = checksum == *data;
+            if (!valid)
+            {
+                checksumErrors++;
+            }
+            if (!skip)
+            {
+                handler.onFrameEnd(header, valid);
+            }
+            state = MSP_STREAM_IDLE;
+            data++;
+            break;
+        }
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "msp.h"
+
+typedef enum : uint8_t {
+    MSP_VERSION_V1,     // $M, including the jumbo frames with a 16 bit size
+    MSP_VERSION_V2      // $X
+} mspVersion_e;
+
+typedef struct {
+    mspPacketType_e type;
+    mspVersion_e    version;
+    uint8_t         flags;
+    uint16_t        function;
+    uint16_t        payloadSize;
+} mspFrameHeader_t;
+
+/**
+ * Receives the frames found by an MSPStream
+ */
+class MSPStreamHandler
+{
+public:
+    virtual ~MSPStreamHandler() = default;
+
+    /**
+     * A frame's header has been received, its payload follows.
+     *
+     * @param header The header of the frame
+     * @param arena Set to a buffer of at least header.payloadSize bytes to have the payload gathered
+     *              there, leave it nullptr to be given the payload piece by piece in onPayload()
+     * @return false to skip the frame, nothing more is delivered for it
+     */
+    virtual bool onFrameStart(const mspFrameHeader_t &header, uint8_t *&arena) { return true; }
+
+    /**
+     * Part of the payload of a frame which is not gathered in an arena. The data points into the
+     * bytes given to MSPStream::processBytes() and is only valid during the call.
+     *
+     * @param header The header of the frame
+     * @param offset Offset of the data in the payload
+     * @param data The payload bytes
+     * @param len Number of payload bytes
+     */
+    virtual void onPayload(const mspFrameHeader_t &header, uint16_t offset, const uint8_t *data, uint16_t len) {}
+
+    /**
+     * The end of a frame. Until then nothing has been checked, if the checksum does not match
+     * everything delivered for the frame must be thrown away.
+     *
+     * @param header The header of the frame
+     * @param valid true if the checksum matched
+     */
+    virtual void onFrameEnd(const mspFrameHeader_t &header, bool valid) = 0;
+};
+
+/**
+ * Parses MSP v1, v1 jumbo and v2 frames of any size as the bytes arrive, without buffering the payload.
+ *
+ * The header is parsed a byte at a time, then each run of payload bytes in a read is checksummed
+ * and handed over where it is, so the RAM used does not depend on the frame size and the only copy
+ * is the one into the handler's arena, if it asks for one.
+ */
+class MSPStream
+{
+public:
+    /**
+     * Parses bytes read from a port, calling the handler for each part of a frame found.
+     * Frames can span any number of calls.
+     */
+    void processBytes(const uint8_t *data, uint32_t len, MSPStreamHandler &handler);
+    void processByte(uint8_t c, MSPStreamHandler &handler) { processBytes(&c, 1, handler); }
+
+    // Forget a frame which has been started
+    void reset() { state = MSP_STREAM_IDLE; }
+
+    uint32_t getChecksumErrors() const { return checksumErrors; }
+
+private:
+    typedef enum : uint8_t {
+        MSP_STREAM_IDLE,
+        MSP_STREAM_HEADER_START,    // $
+        MSP_STREAM_HEADER_VERSION,  // M or X, waiting for the direction
+        MSP_STREAM_HEADER,          // the size and function, or the v2 header
+        MSP_STREAM_PAYLOAD,
+        MSP_STREAM_CHECKSUM
+    } streamState_e;
+
+    void startPayload(MSPStreamHandler &handler);
+
+    streamState_e state = MSP_STREAM_IDLE;
+    mspFrameHeader_t header {};
+    // The v1 size, function and jumbo size, or the v2 flags, function and size
+    uint8_t headerBytes[sizeof(mspHeaderV2_t)] {};
+    uint8_t headerLen = 0;
+    uint8_t checksum = 0;
+    uint16_t offset = 0;
+    uint8_t *arena = nullptr;
+    bool skip = false;
+    uint32_t checksumErrors = 0;
+};
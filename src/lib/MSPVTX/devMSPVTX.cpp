@@ -401,6 +401,7 @@ static int timeout(void)
 }
 
 device_t MSPVTx_device = {
+    .name = "MSPVTx",
     .initialize = initialize,
     .start = start,
     .event = event,
@@ -19,11 +19,11 @@ bool OtaIsFullRes;
 volatile uint8_t OtaNonce;
 uint16_t OtaCrcInitializer;
 OtaSwitchMode_e OtaSwitchModeCurrent;
+OtaSerializer_e OtaSerializerCurrent;
 
 // CRC
-static Crc2Byte ota_crc;
-ValidatePacketCrc_t OtaValidatePacketCrc;
-GeneratePacketCrc_t OtaGeneratePacketCrc;
+static Crc2ByteRAM<14, ELRS_CRC14_POLY> ota_crc14;
+static Crc2ByteRAM<16, ELRS_CRC16_POLY> ota_crc16;
 
 void OtaUpdateCrcInitFromUid()
 {
@@ -54,35 +54,39 @@ static inline uint8_t ICACHE_RAM_ATTR HybridWideNonceToSwitchIndex(uint8_t const
 
 #include "handset.h"            // need access to handset data for arming
 
-// Current ChannelData generator function being used by TX
-PackChannelData_t OtaPackChannelData;
 #if defined(DEBUG_RCVR_LINKSTATS)
 static uint32_t packetCnt;
 #endif
 
-/******** Decimate 11bit to 10bit functions ********/
-typedef uint32_t (*Decimate11to10_fn)(uint32_t ch11bit);
-
-static uint32_t ICACHE_RAM_ATTR Decimate11to10_Limit(uint32_t ch11bit)
+/******** Decimate 11bit to 10bit policies ********/
+// Passed as a template parameter so the conversion is inlined into the packer
+struct Decimate11to10_Limit
 {
-    // Limit 10-bit result to the range CRSF_CHANNEL_VALUE_MIN/MAX
-    return CRSF_to_UINT10(constrain(ch11bit, CRSF_CHANNEL_VALUE_MIN, CRSF_CHANNEL_VALUE_MAX));
-}
+    static inline uint32_t ICACHE_RAM_ATTR decimate(uint32_t ch11bit)
+    {
+        // Limit 10-bit result to the range CRSF_CHANNEL_VALUE_MIN/MAX
+        return CRSF_to_UINT10(constrain(ch11bit, CRSF_CHANNEL_VALUE_MIN, CRSF_CHANNEL_VALUE_MAX));
+    }
+};
 
-static uint32_t ICACHE_RAM_ATTR Decimate11to10_Div2(uint32_t ch11bit)
+struct Decimate11to10_Div2
 {
-    // Simple divide-by-2 to discard the bit
-    return ch11bit >> 1;
-}
+    static inline uint32_t ICACHE_RAM_ATTR decimate(uint32_t ch11bit)
+    {
+        // Simple divide-by-2 to discard the bit
+        return ch11bit >> 1;
+    }
+};
 
 /***
  * @brief: Pack 4x 11-bit channel array into 4x 10 bit channel struct
  * @desc: Values are packed little-endianish such that bits A987654321 -> 87654321, 000000A9
  *        which is compatible with the 10-bit CRSF subset RC frame structure (0x17) in
- *        Betaflight, but depends on which decimate function is used if it is legacy or CRSFv3 10-bit
+ *        Betaflight, but depends on which Decimate policy is used if it is legacy or CRSFv3 10-bit
  *        destChannels4x10 must be zeroed before this call, the channels are ORed into it
  ***/
-static void ICACHE_RAM_ATTR PackUInt11ToChannels4x10(uint32_t const * const src, OTA_Channels_4x10 * const destChannels4x10, Decimate11to10_fn decimate)
+template <typename Decimate>
+static inline void ICACHE_RAM_ATTR PackUInt11ToChannels4x10(uint32_t const * const src, OTA_Channels_4x10 * const destChannels4x10)
 {
     const unsigned DEST_PRECISION = 10; // number of bits for each dest, must be <SRC
     uint8_t *dest = (uint8_t *)destChannels4x10;
@@ -91,7 +95,7 @@ static void ICACHE_RAM_ATTR PackUInt11ToChannels4x10(uint32_t const * const src,
     for (unsigned ch=0; ch<4; ++ch)
     {
         // Convert to DEST_PRECISION value
-        unsigned chVal = decimate(src[ch]);
+        unsigned chVal = Decimate::decimate(src[ch]);
 
         // Put the low bits in any remaining dest capacity
         *dest++ |= chVal << destShift;
@@ -106,7 +110,7 @@ static void ICACHE_RAM_ATTR PackUInt11ToChannels4x10(uint32_t const * const src,
     }
 }
 
-static void ICACHE_RAM_ATTR PackChannelDataHybridCommon(OTA_Packet4_s * const ota4, const uint32_t *channelData)
+static inline void ICACHE_RAM_ATTR PackChannelDataHybridCommon(OTA_Packet4_s * const ota4, const uint32_t *channelData)
 {
     ota4->type = PACKET_TYPE_RCDATA;
 #if defined(DEBUG_RCVR_LINKSTATS)
@@ -115,7 +119,7 @@ static void ICACHE_RAM_ATTR PackChannelDataHybridCommon(OTA_Packet4_s * const ot
 #else
     // CRSF input is 11bit and OTA will carry only 10bit. Discard the Extended Limits (E.Limits)
     // range and use the full 10bits to carry only 998us - 2012us
-    PackUInt11ToChannels4x10(&channelData[0], &ota4->rc.ch, &Decimate11to10_Limit);
+    PackUInt11ToChannels4x10<Decimate11to10_Limit>(&channelData[0], &ota4->rc.ch);
 
     // send armed status to receiver
     #if defined(UNIT_TEST)
@@ -142,8 +146,8 @@ static uint8_t Hybrid8NextSwitchIndex;
 #if defined(UNIT_TEST)
 void OtaSetHybrid8NextSwitchIndex(uint8_t idx) { Hybrid8NextSwitchIndex = idx; }
 #endif
-void ICACHE_RAM_ATTR GenerateChannelDataHybrid8(OTA_Packet_s * const otaPktPtr, const uint32_t *channelData,
-                                                bool const stubbornAck)
+static inline void ICACHE_RAM_ATTR GenerateChannelDataHybrid8(OTA_Packet_s * const otaPktPtr, const uint32_t *channelData,
+                                              bool const stubbornAck)
 {
     OTA_Packet4_s * const ota4 = &otaPktPtr->std;
     PackChannelDataHybridCommon(ota4, channelData);
@@ -174,7 +178,7 @@ void ICACHE_RAM_ATTR GenerateChannelDataHybrid8(OTA_Packet_s * const otaPktPtr,
  * Return the OTA value respresentation of the switch contained in ChannelData
  * Switches 1-6 (AUX2-AUX7) are 6 bit
  */
-static uint8_t ICACHE_RAM_ATTR HybridWideSwitchToOta(const uint32_t *channelData, uint8_t const switchIdx)
+static inline uint8_t ICACHE_RAM_ATTR HybridWideSwitchToOta(const uint32_t *channelData, uint8_t const switchIdx)
 {
     uint16_t ch = channelData[switchIdx + 4];
     ch = CRSF_to_N(ch, 64);
@@ -192,8 +196,8 @@ static uint8_t ICACHE_RAM_ATTR HybridWideSwitchToOta(const uint32_t *channelData
  * Inputs: cchannelData, stubbornAck
  * Outputs: OTA_Packet4_s
  **/
-void ICACHE_RAM_ATTR GenerateChannelDataHybridWide(OTA_Packet_s * const otaPktPtr, const uint32_t *channelData,
-                                                   bool const stubbornAck)
+static inline void ICACHE_RAM_ATTR GenerateChannelDataHybridWide(OTA_Packet_s * const otaPktPtr, const uint32_t *channelData,
+                                                 bool const stubbornAck)
 {
     OTA_Packet4_s * const ota4 = &otaPktPtr->std;
     PackChannelDataHybridCommon(ota4, channelData);
@@ -213,7 +217,8 @@ void ICACHE_RAM_ATTR GenerateChannelDataHybridWide(OTA_Packet_s * const otaPktPt
     ota4->rc.switches = value;
 }
 
-static void ICACHE_RAM_ATTR GenerateChannelData8ch12ch(OTA_Packet8_s * const ota8, const uint32_t *channelData, bool const stubbornAck, bool const isHighAux)
+template <OtaSwitchMode_e switchMode>
+static inline void ICACHE_RAM_ATTR GenerateChannelData8ch12ch(OTA_Packet8_s * const ota8, const uint32_t *channelData, bool const stubbornAck, bool const isHighAux)
 {
     // All channel data is 10 bit apart from AUX1 which is 1 bit
     ota8->rc.packetType = PACKET_TYPE_RCDATA;
@@ -239,7 +244,7 @@ static void ICACHE_RAM_ATTR GenerateChannelData8ch12ch(OTA_Packet8_s * const ota
     // 16ch isHighAux=true:  low=8 high=12
     uint8_t chSrcLow;
     uint8_t chSrcHigh;
-    if (OtaSwitchModeCurrent == smHybridOr16ch)
+    if (switchMode == smHybridOr16ch)
     {
         // 16ch mode
         if (isHighAux)
@@ -258,28 +263,56 @@ static void ICACHE_RAM_ATTR GenerateChannelData8ch12ch(OTA_Packet8_s * const ota
         chSrcLow = 0;
         chSrcHigh = isHighAux ? 8 : 4;
     }
-    PackUInt11ToChannels4x10(&channelData[chSrcLow], &ota8->rc.chLow, &Decimate11to10_Div2);
-    PackUInt11ToChannels4x10(&channelData[chSrcHigh], &ota8->rc.chHigh, &Decimate11to10_Div2);
+    PackUInt11ToChannels4x10<Decimate11to10_Div2>(&channelData[chSrcLow], &ota8->rc.chLow);
+    PackUInt11ToChannels4x10<Decimate11to10_Div2>(&channelData[chSrcHigh], &ota8->rc.chHigh);
 #endif
 }
 
-static void ICACHE_RAM_ATTR GenerateChannelData8ch(OTA_Packet_s * const otaPktPtr, const uint32_t *channelData, bool const stubbornAck)
+static inline void ICACHE_RAM_ATTR GenerateChannelData8ch(OTA_Packet_s * const otaPktPtr, const uint32_t *channelData, bool const stubbornAck)
 {
-    GenerateChannelData8ch12ch((OTA_Packet8_s * const)otaPktPtr, channelData, stubbornAck, false);
+    GenerateChannelData8ch12ch<smWideOr8ch>((OTA_Packet8_s * const)otaPktPtr, channelData, stubbornAck, false);
 }
 
 static bool FullResIsHighAux;
 #if defined(UNIT_TEST)
 void OtaSetFullResNextChannelSet(bool next) { FullResIsHighAux = next; }
 #endif
-static void ICACHE_RAM_ATTR GenerateChannelData12ch(OTA_Packet_s * const otaPktPtr, const uint32_t *channelData, bool const stubbornAck)
+template <OtaSwitchMode_e switchMode>
+static inline void ICACHE_RAM_ATTR GenerateChannelData12ch(OTA_Packet_s * const otaPktPtr, const uint32_t *channelData, bool const stubbornAck)
 {
     // Every time this function is called, the opposite high Aux channels are sent
     // This tries to ensure a fair split of high and low aux channels packets even
     // at 1:2 ratio and around sync packets
-    GenerateChannelData8ch12ch((OTA_Packet8_s * const)otaPktPtr, channelData, stubbornAck, FullResIsHighAux);
+    GenerateChannelData8ch12ch<switchMode>((OTA_Packet8_s * const)otaPktPtr, channelData, stubbornAck, FullResIsHighAux);
     FullResIsHighAux = !FullResIsHighAux;
 }
+
+/**
+ * Pack the channelData into the OTA packet using the serializer selected by
+ * OtaUpdateSerializers(). Each case is a fully inlined specialization, so
+ * this switch is the only dispatch on the TX hot path
+ */
+void ICACHE_RAM_ATTR OtaPackChannelData(OTA_Packet_s * const otaPktPtr, const uint32_t *channelData, bool const stubbornAck)
+{
+    switch (OtaSerializerCurrent)
+    {
+    case osHybrid8:
+        GenerateChannelDataHybrid8(otaPktPtr, channelData, stubbornAck);
+        break;
+    case osHybridWide:
+        GenerateChannelDataHybridWide(otaPktPtr, channelData, stubbornAck);
+        break;
+    case os8ch:
+        GenerateChannelData8ch(otaPktPtr, channelData, stubbornAck);
+        break;
+    case os12ch:
+        GenerateChannelData12ch<sm12ch>(otaPktPtr, channelData, stubbornAck);
+        break;
+    case os16ch:
+        GenerateChannelData12ch<smHybridOr16ch>(otaPktPtr, channelData, stubbornAck);
+        break;
+    }
+}
 #endif
 
 
@@ -287,15 +320,12 @@ static void ICACHE_RAM_ATTR GenerateChannelData12ch(OTA_Packet_s * const otaPktP
 
 bool isArmed;       // global arming status for other functions
 
-// Current ChannelData unpacker function being used by RX
-UnpackChannelData_t OtaUnpackChannelData;
-
 #if defined(DEBUG_RCVR_LINKSTATS)
 // Sequential PacketID from the TX
 uint32_t debugRcvrLinkstatsPacketId;
 #else
 
-static void UnpackChannels4x10ToUInt11(OTA_Channels_4x10 const * const srcChannels4x10, uint32_t * const dest)
+static inline void ICACHE_RAM_ATTR UnpackChannels4x10ToUInt11(OTA_Channels_4x10 const * const srcChannels4x10, uint32_t * const dest)
 {
     uint8_t const * const payload = (uint8_t const * const)srcChannels4x10;
     constexpr unsigned numOfChannels = 4;
@@ -324,7 +354,7 @@ static void UnpackChannels4x10ToUInt11(OTA_Channels_4x10 const * const srcChanne
 }
 #endif /* !DEBUG_RCVR_LINKSTATS */
 
-static void ICACHE_RAM_ATTR UnpackChannelDataHybridCommon(OTA_Packet4_s const * const ota4, uint32_t *channelData)
+static inline void ICACHE_RAM_ATTR UnpackChannelDataHybridCommon(OTA_Packet4_s const * const ota4, uint32_t *channelData)
 {
     isArmed = ota4->rc.isArmed;
 
@@ -358,7 +388,7 @@ static void ICACHE_RAM_ATTR UnpackChannelDataHybridCommon(OTA_Packet4_s const *
  * Output: channelData
  * Returns: stubbornAck bit
  */
-bool ICACHE_RAM_ATTR UnpackChannelDataHybridSwitch8(OTA_Packet_s const * const otaPktPtr, uint32_t *channelData)
+static inline bool ICACHE_RAM_ATTR UnpackChannelDataHybridSwitch8(OTA_Packet_s const * const otaPktPtr, uint32_t *channelData)
 {
     OTA_Packet4_s const * const ota4 = (OTA_Packet4_s const * const)otaPktPtr;
     UnpackChannelDataHybridCommon(ota4, channelData);
@@ -395,7 +425,7 @@ bool ICACHE_RAM_ATTR UnpackChannelDataHybridSwitch8(OTA_Packet_s const * const o
  * Output: channelData
  * Returns: stubbornAck bit
  */
-bool ICACHE_RAM_ATTR UnpackChannelDataHybridWide(OTA_Packet_s const * const otaPktPtr, uint32_t *channelData)
+static inline bool ICACHE_RAM_ATTR UnpackChannelDataHybridWide(OTA_Packet_s const * const otaPktPtr, uint32_t *channelData)
 {
     OTA_Packet4_s const * const ota4 = (OTA_Packet4_s const * const)otaPktPtr;
     UnpackChannelDataHybridCommon(ota4, channelData);
@@ -417,7 +447,8 @@ bool ICACHE_RAM_ATTR UnpackChannelDataHybridWide(OTA_Packet_s const * const otaP
     return stubbornAck;
 }
 
-bool ICACHE_RAM_ATTR UnpackChannelData8ch(OTA_Packet_s const * const otaPktPtr, uint32_t *channelData)
+template <OtaSwitchMode_e switchMode>
+static inline bool ICACHE_RAM_ATTR UnpackChannelData8ch(OTA_Packet_s const * const otaPktPtr, uint32_t *channelData)
 {
     OTA_Packet8_s const * const ota8 = (OTA_Packet8_s const * const)otaPktPtr;
 
@@ -428,7 +459,7 @@ bool ICACHE_RAM_ATTR UnpackChannelData8ch(OTA_Packet_s const * const otaPktPtr,
 #else
     uint8_t chDstLow;
     uint8_t chDstHigh;
-    if (OtaSwitchModeCurrent == smHybridOr16ch)
+    if (switchMode == smHybridOr16ch)
     {
         if (ota8->rc.isHighAux)
         {
@@ -459,101 +490,115 @@ bool ICACHE_RAM_ATTR UnpackChannelData8ch(OTA_Packet_s const * const otaPktPtr,
     linkStats.uplink_TX_Power = constrain(ota8->rc.uplinkPower + 1, 1, 8);
     return ota8->rc.stubbornAck;
 }
+
+/**
+ * Unpack the OTA packet into channelData using the serializer selected by
+ * OtaUpdateSerializers(). 8ch and 12ch share the same decoding
+ * Returns: stubbornAck bit
+ */
+bool ICACHE_RAM_ATTR OtaUnpackChannelData(OTA_Packet_s const * const otaPktPtr, uint32_t *channelData)
+{
+    switch (OtaSerializerCurrent)
+    {
+    case osHybrid8:
+        return UnpackChannelDataHybridSwitch8(otaPktPtr, channelData);
+    case osHybridWide:
+        return UnpackChannelDataHybridWide(otaPktPtr, channelData);
+    case os16ch:
+        return UnpackChannelData8ch<smHybridOr16ch>(otaPktPtr, channelData);
+    case os8ch:
+    case os12ch:
+    default:
+        return UnpackChannelData8ch<smWideOr8ch>(otaPktPtr, channelData);
+    }
+}
 #endif
 
-bool ICACHE_RAM_ATTR ValidatePacketCrcFull(OTA_Packet_s * const otaPktPtr)
+static inline bool ICACHE_RAM_ATTR ValidatePacketCrcFull(OTA_Packet_s * const otaPktPtr)
 {
     uint16_t nonceValidator = (otaPktPtr->std.type == PACKET_TYPE_SYNC) ? 0 : OtaNonce;
     uint16_t const calculatedCRC =
-        ota_crc.calc((uint8_t*)otaPktPtr, OTA8_CRC_CALC_LEN, OtaCrcInitializer ^ nonceValidator);
+        ota_crc16.calc((uint8_t*)otaPktPtr, OTA8_CRC_CALC_LEN, OtaCrcInitializer ^ nonceValidator);
     return otaPktPtr->full.crc == calculatedCRC;
 }
 
-bool ICACHE_RAM_ATTR ValidatePacketCrcStd(OTA_Packet_s * const otaPktPtr)
+static inline bool ICACHE_RAM_ATTR ValidatePacketCrcStd(OTA_Packet_s * const otaPktPtr)
 {
-    uint16_t const inCRC = ((uint16_t)otaPktPtr->std.crcHigh << 8) + otaPktPtr->std.crcLow;
+    uint8_t const crcHigh = otaPktPtr->std.crcHigh;
+    uint16_t const inCRC = ((uint16_t)crcHigh << 8) + otaPktPtr->std.crcLow;
 
     // Zero the crcHigh bits, as the CRC is calculated before it is ORed in
     otaPktPtr->std.crcHigh = 0;
 
     uint16_t nonceValidator = (otaPktPtr->std.type == PACKET_TYPE_SYNC) ? 0 : OtaNonce;
     uint16_t const calculatedCRC =
-        ota_crc.calc((uint8_t*)otaPktPtr, OTA4_CRC_CALC_LEN, OtaCrcInitializer ^ nonceValidator);
+        ota_crc14.calc((uint8_t*)otaPktPtr, OTA4_CRC_CALC_LEN, OtaCrcInitializer ^ nonceValidator);
+
+    // Put them back so a failed packet is left intact for error correction
+    otaPktPtr->std.crcHigh = crcHigh;
 
     return inCRC == calculatedCRC;
 }
 
-void ICACHE_RAM_ATTR GeneratePacketCrcFull(OTA_Packet_s * const otaPktPtr)
+static inline void ICACHE_RAM_ATTR GeneratePacketCrcFull(OTA_Packet_s * const otaPktPtr)
 {
     uint16_t nonceValidator = (otaPktPtr->std.type == PACKET_TYPE_SYNC) ? 0 : OtaNonce;
-    otaPktPtr->full.crc = ota_crc.calc((uint8_t*)otaPktPtr, OTA8_CRC_CALC_LEN, OtaCrcInitializer ^ nonceValidator);
+    otaPktPtr->full.crc = ota_crc16.calc((uint8_t*)otaPktPtr, OTA8_CRC_CALC_LEN, OtaCrcInitializer ^ nonceValidator);
 }
 
-void ICACHE_RAM_ATTR GeneratePacketCrcStd(OTA_Packet_s * const otaPktPtr)
+static inline void ICACHE_RAM_ATTR GeneratePacketCrcStd(OTA_Packet_s * const otaPktPtr)
 {
     uint16_t nonceValidator = (otaPktPtr->std.type == PACKET_TYPE_SYNC) ? 0 : OtaNonce;
-    uint16_t crc = ota_crc.calc((uint8_t*)otaPktPtr, OTA4_CRC_CALC_LEN, OtaCrcInitializer ^ nonceValidator);
+    uint16_t crc = ota_crc14.calc((uint8_t*)otaPktPtr, OTA4_CRC_CALC_LEN, OtaCrcInitializer ^ nonceValidator);
     otaPktPtr->std.crcHigh = (crc >> 8);
     otaPktPtr->std.crcLow  = crc;
 }
 
+bool ICACHE_RAM_ATTR OtaValidatePacketCrc(OTA_Packet_s * const otaPktPtr)
+{
+    if (OtaIsFullRes)
+        return ValidatePacketCrcFull(otaPktPtr);
+    return ValidatePacketCrcStd(otaPktPtr);
+}
+
+void ICACHE_RAM_ATTR OtaGeneratePacketCrc(OTA_Packet_s * const otaPktPtr)
+{
+    if (OtaIsFullRes)
+        GeneratePacketCrcFull(otaPktPtr);
+    else
+        GeneratePacketCrcStd(otaPktPtr);
+}
+
 void OtaUpdateSerializers(OtaSwitchMode_e const switchMode, uint8_t packetSize)
 {
     OtaIsFullRes = (packetSize == OTA8_PACKET_SIZE);
 
     if (OtaIsFullRes)
     {
-        OtaValidatePacketCrc = &ValidatePacketCrcFull;
-        OtaGeneratePacketCrc = &GeneratePacketCrcFull;
-        ota_crc.init(16, ELRS_CRC16_POLY);
-
-        #if defined(TARGET_TX) || defined(UNIT_TEST)
         if (switchMode == smWideOr8ch)
-            OtaPackChannelData = &GenerateChannelData8ch;
+            OtaSerializerCurrent = os8ch;
+        else if (switchMode == sm12ch)
+            OtaSerializerCurrent = os12ch;
         else
-            OtaPackChannelData = &GenerateChannelData12ch;
-        #endif
-        #if defined(TARGET_RX) || defined(UNIT_TEST)
-        OtaUnpackChannelData = &UnpackChannelData8ch;
-        #endif
+            OtaSerializerCurrent = os16ch;
     } // is8ch
 
     else
     {
-        OtaValidatePacketCrc = &ValidatePacketCrcStd;
-        OtaGeneratePacketCrc = &GeneratePacketCrcStd;
-        ota_crc.init(14, ELRS_CRC14_POLY);
-
         if (switchMode == smWideOr8ch)
-        {
-            #if defined(TARGET_TX) || defined(UNIT_TEST)
-            OtaPackChannelData = &GenerateChannelDataHybridWide;
-            #endif
-            #if defined(TARGET_RX) || defined(UNIT_TEST)
-            OtaUnpackChannelData = &UnpackChannelDataHybridWide;
-            #endif
-        } // !is8ch and smWideOr8ch
-
+            OtaSerializerCurrent = osHybridWide;
         else
-        {
-            #if defined(TARGET_TX) || defined(UNIT_TEST)
-            OtaPackChannelData = &GenerateChannelDataHybrid8;
-            #endif
-            #if defined(TARGET_RX) || defined(UNIT_TEST)
-            OtaUnpackChannelData = &UnpackChannelDataHybridSwitch8;
-            #endif
-        } // !is8ch and smHybridOr16ch
+            OtaSerializerCurrent = osHybrid8;
     }
 
     OtaSwitchModeCurrent = switchMode;
 }
 
-void OtaPackAirportData(OTA_Packet_s * const otaPktPtr, FIFO<AP_MAX_BUF_LEN> *inputBuffer)
+void OtaPackAirportData(OTA_Packet_s * const otaPktPtr, SPSCRing<AP_MAX_BUF_LEN> *inputBuffer)
 {
     otaPktPtr->std.type = PACKET_TYPE_DATA;
 
-    inputBuffer->lock();
-    uint8_t count = inputBuffer->size();
+    uint8_t count = inputBuffer->readable();
     if (OtaIsFullRes)
     {
         count = std::min(count, (uint8_t)ELRS8_DATA_DL_BYTES_PER_CALL);
@@ -566,19 +611,18 @@ void OtaPackAirportData(OTA_Packet_s * const otaPktPtr, FIFO<AP_MAX_BUF_LEN> *in
         otaPktPtr->std.airport.count = count;
         inputBuffer->popBytes(otaPktPtr->std.airport.payload, count);
     }
-    inputBuffer->unlock();
 }
 
-void OtaUnpackAirportData(OTA_Packet_s const * const otaPktPtr, FIFO<AP_MAX_BUF_LEN> *outputBuffer)
+void OtaUnpackAirportData(OTA_Packet_s const * const otaPktPtr, SPSCRing<AP_MAX_BUF_LEN> *outputBuffer)
 {
     if (OtaIsFullRes)
     {
         uint8_t count = otaPktPtr->full.airport.count;
-        outputBuffer->atomicPushBytes(otaPktPtr->full.airport.payload, count);
+        outputBuffer->pushBytes(otaPktPtr->full.airport.payload, count);
     }
     else
     {
         uint8_t count = otaPktPtr->std.airport.count;
-        outputBuffer->atomicPushBytes(otaPktPtr->std.airport.payload, count);
+        outputBuffer->pushBytes(otaPktPtr->std.airport.payload, count);
     }
 }
@@ -7,6 +7,7 @@
 #include "crsf_protocol.h"
 #include "telemetry_protocol.h"
 #include "FIFO.h"
+#include "SPSCRing.h"
 
 #if TARGET_RX
 extern bool isArmed;
@@ -28,6 +29,11 @@ extern bool isArmed;
 // Mask used to XOR the ModelId into the SYNC packet for ModelMatch
 #define MODELMATCH_MASK 0x3f
 
+// OTA_Sync_s.otaProtocol is the TX link mode (tx_transmission_mode_e) in bit 0, and bit 1 if the
+// uplink data uses a window of ELRS_DATA_UL_WINDOW packages, see DATA_UL_WINDOWED
+#define OTA_PROTOCOL_LINK_MODE_MASK 0b01
+#define OTA_PROTOCOL_WINDOWED_DATA 0b10
+
 typedef struct {
     uint8_t fhssIndex;
     uint8_t nonce;
@@ -36,7 +42,7 @@ typedef struct {
             newTlmRatio:3,
             geminiMode:1,
             otaProtocol:2,
-            free:1;
+            fhssBlacklistEpoch:1; // Low bit of FHSSblacklistEpoch, see FHSS_ADAPTIVE
     uint8_t UID4;
     uint8_t UID5;
 } PACKED OTA_Sync_s;
@@ -176,19 +182,20 @@ enum OtaSwitchMode_e { smWideOr8ch = 0, smHybridOr16ch = 1, sm12ch = 2 };
 void OtaUpdateSerializers(OtaSwitchMode_e const mode, uint8_t packetSize);
 extern OtaSwitchMode_e OtaSwitchModeCurrent;
 
+// Channel serializer selected by OtaUpdateSerializers(), combines the switch mode and packet size
+enum OtaSerializer_e : uint8_t { osHybrid8, osHybridWide, os8ch, os12ch, os16ch };
+extern OtaSerializer_e OtaSerializerCurrent;
+
 // CRC
-typedef bool (*ValidatePacketCrc_t)(OTA_Packet_s * const otaPktPtr);
-typedef void (*GeneratePacketCrc_t)(OTA_Packet_s * const otaPktPtr);
-extern ValidatePacketCrc_t OtaValidatePacketCrc;
-extern GeneratePacketCrc_t OtaGeneratePacketCrc;
+bool OtaValidatePacketCrc(OTA_Packet_s * const otaPktPtr);
+void OtaGeneratePacketCrc(OTA_Packet_s * const otaPktPtr);
 // Value is implicit leading 1, comment is Koopman formatting (implicit trailing 1) https://users.ece.cmu.edu/~koopman/crc/
 #define ELRS_CRC_POLY 0x07 // 0x83
 #define ELRS_CRC14_POLY 0x2E57 // 0x372b
 #define ELRS_CRC16_POLY 0x3D65 // 0x9eb2
 
 #if defined(TARGET_TX) || defined(UNIT_TEST)
-typedef void (*PackChannelData_t)(OTA_Packet_s * const otaPktPtr, const uint32_t *channelData, bool stubbornAck);
-extern PackChannelData_t OtaPackChannelData;
+void OtaPackChannelData(OTA_Packet_s * const otaPktPtr, const uint32_t *channelData, bool stubbornAck);
 #if defined(UNIT_TEST)
 void OtaSetHybrid8NextSwitchIndex(uint8_t idx);
 void OtaSetFullResNextChannelSet(bool next);
@@ -196,12 +203,12 @@ void OtaSetFullResNextChannelSet(bool next);
 #endif
 
 #if defined(TARGET_RX) || defined(UNIT_TEST)
-typedef bool (*UnpackChannelData_t)(OTA_Packet_s const * const otaPktPtr, uint32_t *channelData);
-extern UnpackChannelData_t OtaUnpackChannelData;
+bool OtaUnpackChannelData(OTA_Packet_s const * const otaPktPtr, uint32_t *channelData);
 #endif
 
-void OtaPackAirportData(OTA_Packet_s * const otaPktPtr, FIFO<AP_MAX_BUF_LEN> *inputBuffer);
-void OtaUnpackAirportData(OTA_Packet_s const * const otaPktPtr, FIFO<AP_MAX_BUF_LEN> *outputBuffer);
+// The airport buffers have one producer and one consumer, the radio ISR and the serial port
+void OtaPackAirportData(OTA_Packet_s * const otaPktPtr, SPSCRing<AP_MAX_BUF_LEN> *inputBuffer);
+void OtaUnpackAirportData(OTA_Packet_s const * const otaPktPtr, SPSCRing<AP_MAX_BUF_LEN> *outputBuffer);
 
 #if defined(DEBUG_RCVR_LINKSTATS)
 extern uint32_t debugRcvrLinkstatsPacketId;
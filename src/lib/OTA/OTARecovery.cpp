@@ -0,0 +1,306 @@
+/**
+ * This file is part of ExpressLRS
+ * See https://github.com/AlessandroAU/ExpressLRS
+ *
+ * This file provides recovery of OTA packets which have failed CRC
+ */
+
+#include "OTARecovery.h"
+
+#include <cstring>
+
+OtaRecoveryStats_s OtaRecoveryStats;
+
+// The syndrome tables below take about 850 bytes of RAM, only build them for an RX which uses a recovery stage
+#if defined(RX_OTA_CRC_CORRECTION) || defined(RX_OTA_DVDA_COMBINING) || defined(RX_OTA_GEMINI_COMBINING) || defined(UNIT_TEST)
+
+// The CRC engines are stateless, these share their tables with OTA.cpp
+static Crc2ByteRAM<14, ELRS_CRC14_POLY> recovery_crc14;
+static Crc2ByteRAM<16, ELRS_CRC16_POLY> recovery_crc16;
+
+#define OTA_SYNDROME_NONE 0xFF
+
+/**
+ * @brief: Difference between the received and calculated CRC of a packet
+ * @desc: The CRC is linear, so a packet with errors e has syndrome(e) regardless
+ *        of the packet contents or the CRC initializer. Zero for a valid packet
+ ***/
+static uint16_t ICACHE_RAM_ATTR OtaCrcSyndrome(OTA_Packet_s const * const otaPktPtr, bool const isFullRes, uint16_t const crcInit)
+{
+    if (isFullRes)
+    {
+        uint16_t const calculatedCRC = recovery_crc16.calc((uint8_t const *)otaPktPtr, OTA8_CRC_CALC_LEN, crcInit);
+        return otaPktPtr->full.crc ^ calculatedCRC;
+    }
+
+    // The crcHigh bits are not part of the calculation, zero them in a copy
+    uint8_t data[OTA4_CRC_CALC_LEN];
+    memcpy(data, otaPktPtr, OTA4_CRC_CALC_LEN);
+    ((OTA_Packet4_s *)data)->crcHigh = 0;
+    uint16_t const inCRC = ((uint16_t)otaPktPtr->std.crcHigh << 8) + otaPktPtr->std.crcLow;
+    return inCRC ^ recovery_crc14.calc(data, OTA4_CRC_CALC_LEN, crcInit);
+}
+
+/**
+ * Sorted table of the syndrome of flipping each bit of a packet
+ * Bit positions are (byte << 3) | bit, and syndromes shared by more than one bit
+ * are dropped as they can not be corrected unambiguously
+ */
+template <uint8_t packetSize>
+class OtaSyndromeTable
+{
+private:
+    static constexpr unsigned numBits = packetSize * 8;
+    uint16_t syndrome[numBits];
+    uint8_t bitPos[numBits];
+    uint8_t count;
+    uint16_t bitSyndrome[numBits]; // unsorted, indexed by bit position
+
+public:
+    OtaSyndromeTable()
+    {
+        count = 0;
+        for (unsigned pos = 0; pos < numBits; ++pos)
+        {
+            uint8_t pkt[OTA8_PACKET_SIZE] = {0};
+            pkt[pos / 8] = 1 << (pos % 8);
+            uint16_t const s = OtaCrcSyndrome((OTA_Packet_s *)pkt, packetSize == OTA8_PACKET_SIZE, 0);
+            bitSyndrome[pos] = s;
+
+            // Insertion sort, keeping duplicates adjacent
+            unsigned idx = count++;
+            while (idx > 0 && syndrome[idx - 1] > s)
+            {
+                syndrome[idx] = syndrome[idx - 1];
+                bitPos[idx] = bitPos[idx - 1];
+                --idx;
+            }
+            syndrome[idx] = s;
+            bitPos[idx] = pos;
+        }
+
+        for (unsigned idx = 1; idx < count; ++idx)
+        {
+            if (syndrome[idx] == syndrome[idx - 1])
+            {
+                bitPos[idx] = OTA_SYNDROME_NONE;
+                bitPos[idx - 1] = OTA_SYNDROME_NONE;
+            }
+        }
+    }
+
+    uint8_t ICACHE_RAM_ATTR find(uint16_t const s) const
+    {
+        unsigned low = 0;
+        unsigned high = count;
+        while (low < high)
+        {
+            unsigned const mid = (low + high) / 2;
+            if (syndrome[mid] < s)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        return (low < count && syndrome[low] == s) ? bitPos[low] : OTA_SYNDROME_NONE;
+    }
+
+    uint16_t ICACHE_RAM_ATTR syndromeOf(uint8_t const pos) const
+    {
+        return bitSyndrome[pos];
+    }
+};
+
+static OtaSyndromeTable<OTA4_PACKET_SIZE> syndromes4;
+static OtaSyndromeTable<OTA8_PACKET_SIZE> syndromes8;
+
+bool ICACHE_RAM_ATTR OtaCorrectPacketCrc(OTA_Packet_s * const otaPktPtr)
+{
+    // A corrupt packet "corrected" into a SYNC can change the RF mode, never risk it
+    if (otaPktPtr->std.type == PACKET_TYPE_SYNC)
+        return false;
+
+    uint16_t const s = OtaCrcSyndrome(otaPktPtr, OtaIsFullRes, OtaCrcInitializer ^ OtaNonce);
+    uint8_t const pos = OtaIsFullRes ? syndromes8.find(s) : syndromes4.find(s);
+    if (pos == OTA_SYNDROME_NONE)
+        return false;
+
+    uint8_t * const data = (uint8_t *)otaPktPtr;
+    data[pos / 8] ^= 1 << (pos % 8);
+
+    // The flipped bit may have changed the packet type to/from SYNC, which changes the CRC initializer
+    if (otaPktPtr->std.type != PACKET_TYPE_SYNC && OtaValidatePacketCrc(otaPktPtr))
+    {
+        ++OtaRecoveryStats.corrected;
+        return true;
+    }
+
+    data[pos / 8] ^= 1 << (pos % 8);
+    return false;
+}
+
+void ICACHE_RAM_ATTR OtaPacketCombiner::add(OTA_Packet_s const * const otaPktPtr, uint8_t const nonce)
+{
+    if (count >= OTA_COMBINE_MAX_COPIES)
+        return;
+    copies[count] = *otaPktPtr;
+    nonces[count] = nonce;
+    ++count;
+}
+
+/**
+ * @brief: Mask of the bits which are the same in every DVDA repeat of an RC packet
+ * @desc: The packet type, armed bit and CH1-4 (plus AUX2-5 in 8ch mode) are packed
+ *        from the same handset data. Switches, the stubbornAck, 12/16ch high aux
+ *        and the CRC (nonce) can change from one repeat to the next
+ ***/
+static void OtaRepeatSharedMask(uint8_t * const mask, bool const isFullRes)
+{
+    memset(mask, 0, OTA8_PACKET_SIZE);
+    if (isFullRes)
+    {
+        mask[0] = 0b10000011; // isArmed, packetType
+        memset(&mask[1], 0xFF, sizeof(OTA_Channels_4x10));
+        if (OtaSwitchModeCurrent == smWideOr8ch)
+            memset(&mask[1 + sizeof(OTA_Channels_4x10)], 0xFF, sizeof(OTA_Channels_4x10));
+    }
+    else
+    {
+        mask[0] = 0b00000011; // type
+        memset(&mask[1], 0xFF, sizeof(OTA_Channels_4x10));
+        mask[1 + sizeof(OTA_Channels_4x10)] = 0b10000000; // isArmed
+    }
+}
+
+/**
+ * @brief: Try every combination of the searchPos bits of otaPktPtr, starting from its current value
+ * @param s syndrome of otaPktPtr as it is now
+ * @return true with otaPktPtr holding the first valid non-SYNC combination found
+ ***/
+static bool ICACHE_RAM_ATTR OtaSearchCombinations(OTA_Packet_s * const otaPktPtr, uint16_t s,
+    uint8_t const * const searchPos, unsigned const searchBits)
+{
+    uint8_t * const data = (uint8_t *)otaPktPtr;
+    // Gray code walk through every combination of the search bits, one flip per step
+    for (unsigned combo = 0; ; )
+    {
+        // Like OtaCorrectPacketCrc(), never rebuild a SYNC packet (which also uses a different CRC initializer)
+        if (s == 0 && otaPktPtr->std.type != PACKET_TYPE_SYNC)
+            return true;
+        if (++combo == (1U << searchBits))
+            return false;
+        unsigned const flip = __builtin_ctz(combo);
+        uint8_t const pos = searchPos[flip];
+        data[pos / 8] ^= 1 << (pos % 8);
+        s ^= OtaIsFullRes ? syndromes8.syndromeOf(pos) : syndromes4.syndromeOf(pos);
+    }
+}
+
+bool ICACHE_RAM_ATTR OtaCombinePacketPair(OTA_Packet_s * const otaPktPtr, OTA_Packet_s const * const otaPktPtrSecond)
+{
+    uint8_t const packetSize = OtaIsFullRes ? OTA8_PACKET_SIZE : OTA4_PACKET_SIZE;
+    unsigned const maxSearchBits = OtaIsFullRes ? OTA_COMBINE_MAX_SEARCH_BITS8 : OTA_COMBINE_MAX_SEARCH_BITS4;
+
+    // Every bit where the two copies differ is wrong in one of them, the rest is assumed right in both
+    uint8_t const * const first = (uint8_t *)otaPktPtr;
+    uint8_t const * const second = (uint8_t *)otaPktPtrSecond;
+    uint8_t searchPos[OTA_COMBINE_MAX_SEARCH_BITS8];
+    unsigned searchBits = 0;
+    for (unsigned byte = 0; byte < packetSize; ++byte)
+    {
+        uint8_t diff = first[byte] ^ second[byte];
+        while (diff)
+        {
+            if (searchBits == maxSearchBits)
+                return false;
+            searchPos[searchBits++] = byte * 8 + __builtin_ctz(diff);
+            diff &= diff - 1;
+        }
+    }
+
+    // Identical copies are the same as a single copy, leave that to OtaCorrectPacketCrc()
+    if (searchBits == 0)
+        return false;
+
+    OTA_Packet_s candidate = *otaPktPtr;
+    uint16_t const s = OtaCrcSyndrome(&candidate, OtaIsFullRes, OtaCrcInitializer ^ OtaNonce);
+    if (!OtaSearchCombinations(&candidate, s, searchPos, searchBits))
+        return false;
+
+    *otaPktPtr = candidate;
+    ++OtaRecoveryStats.paired;
+    return true;
+}
+
+bool ICACHE_RAM_ATTR OtaPacketCombiner::combine(OTA_Packet_s * const otaPktPtr, uint8_t * const nonce)
+{
+    if (count < 2)
+        return false;
+
+    uint8_t const packetSize = OtaIsFullRes ? OTA8_PACKET_SIZE : OTA4_PACKET_SIZE;
+    unsigned const maxSearchBits = OtaIsFullRes ? OTA_COMBINE_MAX_SEARCH_BITS8 : OTA_COMBINE_MAX_SEARCH_BITS4;
+
+    // Repeats of the same transmission (e.g. both radios) share every bit
+    uint8_t mask[OTA8_PACKET_SIZE];
+    bool sameNonce = true;
+    for (unsigned c = 1; c < count; ++c)
+        sameNonce = sameNonce && (nonces[c] == nonces[0]);
+    if (sameNonce)
+        memset(mask, 0xFF, sizeof(mask));
+    else
+        OtaRepeatSharedMask(mask, OtaIsFullRes);
+
+    // Majority vote each shared bit, noting the bits which have no majority
+    uint8_t voted[OTA8_PACKET_SIZE];
+    uint8_t searchPos[OTA_COMBINE_MAX_SEARCH_BITS8];
+    unsigned searchBits = 0;
+    for (unsigned byte = 0; byte < packetSize; ++byte)
+    {
+        voted[byte] = 0;
+        for (unsigned bit = 0; bit < 8; ++bit)
+        {
+            uint8_t const bitMask = 1 << bit;
+            if ((mask[byte] & bitMask) == 0)
+                continue;
+
+            unsigned ones = 0;
+            for (unsigned c = 0; c < count; ++c)
+                ones += (((uint8_t *)&copies[c])[byte] & bitMask) ? 1 : 0;
+
+            if (ones * 2 > count)
+                voted[byte] |= bitMask;
+            else if (ones * 2 == count)
+            {
+                // Tie, start from the first copy's value and search both
+                if (searchBits == maxSearchBits)
+                    return false;
+                voted[byte] |= ((uint8_t *)&copies[0])[byte] & bitMask;
+                searchPos[searchBits++] = byte * 8 + bit;
+            }
+        }
+    }
+
+    // Check the vote against the unshared bits of each copy, and all combinations of the ties
+    for (unsigned c = 0; c < count; ++c)
+    {
+        // Avoid checking the same candidate twice when every bit is shared
+        if (sameNonce && c > 0)
+            break;
+
+        uint8_t * const candidate = (uint8_t *)otaPktPtr;
+        uint8_t const * const copy = (uint8_t *)&copies[c];
+        for (unsigned byte = 0; byte < packetSize; ++byte)
+            candidate[byte] = (voted[byte] & mask[byte]) | (copy[byte] & ~mask[byte]);
+
+        uint16_t const s = OtaCrcSyndrome(otaPktPtr, OtaIsFullRes, OtaCrcInitializer ^ nonces[c]);
+        if (OtaSearchCombinations(otaPktPtr, s, searchPos, searchBits))
+        {
+            *nonce = nonces[c];
+            ++OtaRecoveryStats.combined;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#endif
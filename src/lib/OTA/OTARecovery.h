@@ -0,0 +1,88 @@
+#pragma once
+
+/**
+ * Recovery of OTA packets which have failed OtaValidatePacketCrc()
+ *
+ * These are optional stages the RX can run before counting a packet as lost.
+ * Every recovered packet has passed OtaValidatePacketCrc() again before being
+ * reported as recovered, each stage only narrows down which bits to try.
+ * They are only built with RX_OTA_CRC_CORRECTION, RX_OTA_DVDA_COMBINING or RX_OTA_GEMINI_COMBINING.
+ */
+
+#include "OTA.h"
+
+typedef struct {
+    uint32_t corrected;  // single bit errors fixed by OtaCorrectPacketCrc()
+    uint32_t combined;   // packets rebuilt from failed copies by OtaPacketCombiner
+    uint32_t paired;     // packets rebuilt from both radios' failed copies by OtaCombinePacketPair()
+} OtaRecoveryStats_s;
+
+extern OtaRecoveryStats_s OtaRecoveryStats;
+
+/**
+ * @brief Attempt to correct a single bit error in a packet which failed CRC
+ * The syndrome (received CRC XOR calculated CRC) of every single bit error is
+ * precomputed, so the cost is one CRC calculation and a binary search, plus one
+ * more CRC calculation to verify a candidate. SYNC packets are never corrected
+ * @param otaPktPtr packet which failed OtaValidatePacketCrc(), corrected in place
+ * @return true if the packet was corrected and now passes OtaValidatePacketCrc()
+ */
+bool OtaCorrectPacketCrc(OTA_Packet_s * const otaPktPtr);
+
+// Maximum number of failed copies of the same packet held for combining (DVDA x4)
+#define OTA_COMBINE_MAX_COPIES 4
+// Maximum number of undecided bits to brute force per packet size. Every combination
+// tried is another chance of accepting a corrupt packet, 2^bits / 2^crcbits ~0.1%.
+// This also bounds the time spent in the RX ISR, at one CRC plus 2^bits XORs
+#define OTA_COMBINE_MAX_SEARCH_BITS4 4
+#define OTA_COMBINE_MAX_SEARCH_BITS8 6
+
+/**
+ * @brief Rebuild a packet from the same transmission received by both radios, where both failed CRC
+ * Bits which differ between the two copies are wrong in one of them, so every
+ * combination of those bits is checked. Gives up without searching when the copies
+ * differ in more than OTA_COMBINE_MAX_SEARCH_BITS bits, which keeps the ISR bounded
+ * @param otaPktPtr first copy, replaced by the rebuilt packet on success
+ * @param otaPktPtrSecond second copy, received with the same OtaNonce
+ * @return true if the rebuilt packet passes CRC
+ */
+bool OtaCombinePacketPair(OTA_Packet_s * const otaPktPtr, OTA_Packet_s const * const otaPktPtrSecond);
+
+/**
+ * Rebuilds a packet from several copies which have all failed CRC
+ *
+ * Copies added with the same nonce are the same transmission and every bit is
+ * expected to match. Copies with different nonces are DVDA repeats, only the
+ * type, armed bit and analog channels are the same in each, the rest
+ * (switches, CRC) is taken from whichever copy is being checked.
+ *
+ * Each expected-equal bit is decided by majority vote, and bits with no majority
+ * (any difference between 2 copies) are searched exhaustively up to
+ * OTA_COMBINE_MAX_SEARCH_BITS. The CRC of every combination is derived from the
+ * single bit syndromes, so the cost is one CRC per copy plus one XOR per combination.
+ */
+class OtaPacketCombiner
+{
+public:
+    void reset() { count = 0; }
+    uint8_t getCount() const { return count; }
+
+    /**
+     * @brief Store a copy of a packet which failed CRC, ignored when full
+     * @param nonce value of OtaNonce when the packet was received
+     */
+    void add(OTA_Packet_s const * const otaPktPtr, uint8_t const nonce);
+
+    /**
+     * @brief Try to rebuild a valid packet from the stored copies
+     * @param otaPktPtr destination for the rebuilt packet
+     * @param nonce set to the nonce the rebuilt packet is valid for
+     * @return true if the rebuilt packet passes CRC
+     */
+    bool combine(OTA_Packet_s * const otaPktPtr, uint8_t * const nonce);
+
+private:
+    OTA_Packet_s copies[OTA_COMBINE_MAX_COPIES];
+    uint8_t nonces[OTA_COMBINE_MAX_COPIES];
+    uint8_t count;
+};
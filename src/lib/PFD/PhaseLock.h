@@ -0,0 +1,181 @@
+#pragma once
+
+#include <math.h>
+#include <stdlib.h>
+#include "targets.h"
+#include "hwTimer.h"
+#include "LowPassFilter.h"
+
+// Once connected, the phase error is corrected over roughly this long at every packet rate (us)
+#define PHASELOCK_RESPONSE_US 16000
+// Largest timer frequency correction, as a fraction of the interval (2000ppm)
+#define PHASELOCK_MAX_FREQ_DIV 500
+
+typedef struct {
+    int32_t min;        // us, PFD results since the last resetStats()
+    int32_t max;
+    float stdDev;
+    uint32_t count;
+} PhaseLockStats_s;
+
+/**
+ * Keeps the RX timer's tock locked to the TX's packets, from one PFD result per packet period.
+ *
+ * Until connected, half of each raw offset is corrected right away to pull in quickly. Once
+ * connected a PI loop takes over: the proportional term shifts the phase and the integral term
+ * is the timer's frequency offset, which keeps tracking the crystal difference through missed
+ * packets. Both carry their fraction of a us (or timer tick) over to the next packet, so small
+ * errors are not rounded away, and a fractional frequency offset is dithered between whole ticks.
+ *
+ * The caller applies the corrections to its timer, so the same loop runs on hardware and in
+ * the native link simulator.
+ */
+class PhaseLock
+{
+public:
+    PhaseLock() : offset(2), offsetDx(4)
+    {
+        setInterval(TimerIntervalUSDefault);
+    }
+
+    /**
+     * @brief Set the loop gains for a packet interval
+     * Kp is about interval / PHASELOCK_RESPONSE_US, from 1/2 to 1/16, so every rate settles in
+     * a similar time and the fast rates average out more of the PFD noise. Ki is Kp^2 / 4, which
+     * puts both poles at 1 - Kp/2 for a critically damped loop
+     */
+    void setInterval(int32_t const newInterval)
+    {
+        interval = newInterval;
+        kpShift = 1;
+        while (kpShift < 4 && (interval << kpShift) < PHASELOCK_RESPONSE_US)
+            kpShift++;
+        kiShift = 2 * kpShift + 2;
+    }
+
+    /**
+     * @brief Forget everything, on connection loss
+     */
+    void reset()
+    {
+        restart();
+        offsetDx.init(0);
+        integral = 0;
+        freqResidual = 0;
+        freqOffset = 0;
+        resetStats();
+    }
+
+    /**
+     * @brief Start a new tentative connection, the slope filter and frequency offset are kept
+     */
+    void restart()
+    {
+        prevRawOffset = 0;
+        offset.init(0);
+        phaseResidual = 0;
+    }
+
+    /**
+     * @brief Filter a PFD result and work out the corrections for the timer
+     * @param rawOffset PFD::calcResult(), positive when the tock came too early
+     * @param connected run the PI loop, otherwise correct half the raw offset
+     */
+    void ICACHE_RAM_ATTR update(int32_t const rawOffset, bool const connected)
+    {
+        offset.update(rawOffset);
+        offsetDx.update(rawOffset - prevRawOffset);
+        prevRawOffset = rawOffset;
+
+        if (!connected)
+        {
+            phaseShift = rawOffset >> 1;
+            return;
+        }
+
+        if (statsCount == 0 || rawOffset < statsMin)
+            statsMin = rawOffset;
+        if (statsCount == 0 || rawOffset > statsMax)
+            statsMax = rawOffset;
+        statsSum += rawOffset;
+        statsSumSq += (int64_t)rawOffset * rawOffset;
+        statsCount++;
+
+        // A packet from the wrong slot must not kick the loop
+        int32_t const limit = interval >> 3;
+        int32_t const err = rawOffset < -limit ? -limit : (rawOffset > limit ? limit : rawOffset);
+
+        // Proportional, in 1/65536us
+        phaseResidual += err * (65536 >> kpShift);
+        phaseShift = phaseResidual >> 16;
+        phaseResidual -= phaseShift * 65536;
+
+        // Integral, in 1/65536 ticks. A packet period is a tick and a tock, so the frequency
+        // offset moves the tock by 2 * FreqOffset / HWTIMER_TICKS_PER_US us every period
+        int32_t const integralMax = interval * (HWTIMER_TICKS_PER_US * 32768 / PHASELOCK_MAX_FREQ_DIV);
+        integral += err * ((HWTIMER_TICKS_PER_US * 32768) >> kiShift);
+        integral = integral < -integralMax ? -integralMax : (integral > integralMax ? integralMax : integral);
+
+        int32_t const freq = freqResidual + integral;
+        freqOffset = freq >> 16;
+        freqResidual = freq - freqOffset * 65536;
+    }
+
+    // Frequency offset for the timer, in timer ticks
+    int32_t getFreqOffset() const { return freqOffset; }
+    // Phase shift to apply to the timer in microseconds
+    int32_t getPhaseShift() const { return phaseShift; }
+
+    // The offset has settled enough for a tentative connection to become connected
+    bool isSettled() const { return abs(offsetDx.value()) <= 10 && offset.value() < 100; }
+    // The offset is steady enough to consider the timer locked
+    bool isSteady() const { return abs(offsetDx.value()) <= 5; }
+
+    int32_t getOffset() const { return offset.value(); }
+    int32_t getOffsetDx() const { return offsetDx.value(); }
+    int32_t getRawOffset() const { return prevRawOffset; }
+
+    /**
+     * @brief Min, max and standard deviation of the PFD results while connected
+     */
+    PhaseLockStats_s getStats() const
+    {
+        PhaseLockStats_s stats = {0, 0, 0.0f, statsCount};
+        if (statsCount)
+        {
+            float const mean = (float)statsSum / statsCount;
+            float const variance = (float)statsSumSq / statsCount - mean * mean;
+            stats.min = statsMin;
+            stats.max = statsMax;
+            stats.stdDev = variance > 0.0f ? sqrtf(variance) : 0.0f;
+        }
+        return stats;
+    }
+
+    void resetStats()
+    {
+        statsCount = 0;
+        statsSum = 0;
+        statsSumSq = 0;
+    }
+
+private:
+    LPF offset;
+    LPF offsetDx;
+    int32_t prevRawOffset = 0;
+    int32_t phaseShift = 0;
+
+    int32_t interval;
+    uint8_t kpShift;
+    uint8_t kiShift;
+    int32_t phaseResidual = 0;
+    int32_t integral = 0;
+    int32_t freqResidual = 0;
+    int32_t freqOffset = 0;
+
+    int32_t statsMin = 0;
+    int32_t statsMax = 0;
+    int64_t statsSum = 0;
+    int64_t statsSumSq = 0;
+    uint32_t statsCount = 0;
+};
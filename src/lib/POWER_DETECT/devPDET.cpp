@@ -82,6 +82,7 @@ static int timeout()
 }
 
 device_t PDET_device = {
+    .name = "PDET",
     .initialize = initialize,
     .start = start,
     .event = event,
@@ -177,6 +177,7 @@ static int timeout()
 }
 
 device_t Screen_device = {
+    .name = "Screen",
     .initialize = initialize,
     .start = start,
     .event = event,
@@ -136,7 +136,8 @@ static const char *ratio_string[] = {
     "1:8",
     "1:4",
     "1:2",
-    "Race"
+    "Race",
+    "Auto"
 };
 
 static const char *ratio_curr_string[] = {
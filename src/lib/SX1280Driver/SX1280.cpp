@@ -514,7 +514,14 @@ bool ICACHE_RAM_ATTR SX1280Driver::RXnbISR(uint16_t irqStatus, SX12XX_Radio_Numb
                ((irqStatus & SX1280_IRQ_SYNCWORD_VALID) ? SX12XX_RX_OK : SX12XX_RX_SYNCWORD_ERROR) |
                ((irqStatus & SX1280_IRQ_SYNCWORD_ERROR) ? SX12XX_RX_SYNCWORD_ERROR : SX12XX_RX_OK);
     }
-    if (fail == SX12XX_RX_OK)
+#if defined(RX_OTA_DVDA_COMBINING) || defined(RX_OTA_GEMINI_COMBINING)
+    // A packet which only failed the FLRC CRC is still read, so the copies can be combined.
+    // Each radio's copy comes through here in its own RXdone, so this covers both Gemini copies
+    bool const readPacket = fail == SX12XX_RX_OK || fail == SX12XX_RX_CRC_FAIL;
+#else
+    bool const readPacket = fail == SX12XX_RX_OK;
+#endif
+    if (readPacket)
     {
         uint8_t const FIFOaddr = GetRxBufferAddr(radioNumber);
         hal.ReadBuffer(FIFOaddr, RXdataBuffer, PayloadLength, radioNumber);
@@ -49,6 +49,7 @@ static int timeout()
 }
 
 device_t SerialUpdate_device = {
+    .name = "SerialUpdate",
     .initialize = initialize,
     .start = nullptr,
     .event = event,
@@ -334,6 +334,7 @@ static int timeout()
 }
 
 device_t ServoOut_device = {
+    .name = "ServoOut",
     .initialize = initialize,
     .start = nullptr,
     .event = event,
@@ -5,6 +5,7 @@
 
 StubbornReceiver::StubbornReceiver()
 {
+    window = 1;
     ResetState();
     data = nullptr;
     length = 0;
@@ -19,16 +20,32 @@ void StubbornReceiver::setMaxPackageIndex(uint8_t maxPackageIndex)
     }
 }
 
+/**
+ * @brief: Accept packages up to window - 1 ahead of the next one expected, must match the
+ * sender's StubbornSender::setWindow(). With a window larger than 1 the ack is GetCurrentAck(),
+ * the count of packages received in order, and every package but the last must be full
+ ***/
+void StubbornReceiver::setWindow(uint8_t window)
+{
+    window = std::max((uint8_t)1, std::min(window, (uint8_t)SRECEIVER_MAX_WINDOW));
+    if (this->window != window)
+    {
+        this->window = window;
+        ResetState();
+    }
+}
+
 void StubbornReceiver::ResetState()
 {
     currentPackage = 1;
     currentOffset = 0;
-    telemetryConfirm = false;
+    ackCount = 0;
+    received = 0;
 }
 
 bool StubbornReceiver::GetCurrentConfirm()
 {
-    return telemetryConfirm;
+    return ackCount & 1;
 }
 
 void StubbornReceiver::SetDataToReceive(uint8_t* dataToReceive, uint8_t maxLength)
@@ -37,6 +54,7 @@ void StubbornReceiver::SetDataToReceive(uint8_t* dataToReceive, uint8_t maxLengt
     data = dataToReceive;
     currentPackage = 1;
     currentOffset = 0;
+    received = 0;
     finishedData = false;
 }
 
@@ -45,9 +63,10 @@ void StubbornReceiver::ReceiveData(uint8_t const packageIndex, uint8_t const * c
     // Resync
     if (packageIndex == maxPackageIndex)
     {
-        telemetryConfirm = !telemetryConfirm;
+        ackCount++;
         currentPackage = 1;
         currentOffset = 0;
+        received = 0;
         finishedData = false;
         return;
     }
@@ -57,6 +76,12 @@ void StubbornReceiver::ReceiveData(uint8_t const packageIndex, uint8_t const * c
         return;
     }
 
+    if (window > 1 && packageIndex != 0)
+    {
+        ReceiveWindowedData(packageIndex, receiveData, dataLen);
+        return;
+    }
+
     bool acceptData = false;
     // If this is the last package, accept as being complete
     if (packageIndex == 0 && currentPackage > 1)
@@ -86,8 +111,36 @@ void StubbornReceiver::ReceiveData(uint8_t const packageIndex, uint8_t const * c
         memcpy(&data[currentOffset], receiveData, len);
         currentPackage++;
         currentOffset += len;
-        telemetryConfirm = !telemetryConfirm;
+        ackCount++;
+    }
+}
+
+/**
+ * @brief: Store a package at its place in the data, and advance past every package now
+ * received in order. Packages behind the next expected one or beyond the window are dropped
+ ***/
+void StubbornReceiver::ReceiveWindowedData(uint8_t const packageIndex, uint8_t const * const receiveData, uint8_t dataLen)
+{
+    const uint8_t ahead = packageIndex - currentPackage;
+    if (ahead >= window || (received & (1 << ahead)))
+    {
+        return;
+    }
+
+    const uint16_t offset = (packageIndex - 1) * dataLen;
+    if (offset < length)
+    {
+        memcpy(&data[offset], receiveData, std::min((uint16_t)(length - offset), (uint16_t)dataLen));
+    }
+
+    received |= 1 << ahead;
+    while (received & 1)
+    {
+        received >>= 1;
+        currentPackage++;
+        ackCount++;
     }
+    currentOffset = std::min((uint16_t)((currentPackage - 1) * dataLen), (uint16_t)length);
 }
 
 bool StubbornReceiver::HasFinishedData()
@@ -101,6 +154,7 @@ void StubbornReceiver::Unlock()
     {
         currentPackage = 1;
         currentOffset = 0;
+        received = 0;
         finishedData = false;
     }
 }
@@ -2,6 +2,9 @@
 
 #include <cstdint>
 
+// The largest window, the ack is a count of packages received in order and only 2 bits wide
+#define SRECEIVER_MAX_WINDOW 3
+
 class StubbornReceiver
 {
 public:
@@ -11,14 +14,22 @@ public:
     void SetDataToReceive(uint8_t* dataToReceive, uint8_t maxLength);
     void ReceiveData(uint8_t const packageIndex, uint8_t const * const receiveData, uint8_t dataLen);
     bool HasFinishedData();
+    // Bytes received of the current data, up to the end of the last package so it can include padding
+    uint8_t GetReceivedLength() const { return currentOffset; }
     void Unlock();
     bool GetCurrentConfirm();
+    uint8_t GetCurrentAck() const { return ackCount & 3; }
+    void setWindow(uint8_t window);
+    uint8_t getWindow() const { return window; }
 private:
     uint8_t *data;
     bool finishedData;
     uint8_t length;
     uint8_t currentOffset;
     uint8_t currentPackage;
-    bool telemetryConfirm;
+    uint8_t ackCount;
     uint8_t maxPackageIndex;
+    uint8_t window;
+    uint8_t received; // packages after currentPackage already received, in windowed mode
+    void ReceiveWindowedData(uint8_t const packageIndex, uint8_t const * const receiveData, uint8_t dataLen);
 };
@@ -4,7 +4,7 @@
 #include "stubborn_sender.h"
 
 StubbornSender::StubbornSender()
-    : data(nullptr), length(0)
+    : data(nullptr), length(0), window(1)
 {
     ResetState();
 }
@@ -18,12 +18,34 @@ void StubbornSender::setMaxPackageIndex(uint8_t maxPackageIndex)
     }
 }
 
+/**
+ * @brief: Set how many data packages can be sent before the first is acked
+ * 1 is stop-and-wait, where the ack is a single bit which toggles with each package received.
+ * With a larger window the ack is the count of packages received in order, mod 4, so the
+ * receiver must use the same window and send both ack bits. Every package must then carry
+ * maxLen bytes, except the last, so the receiver can place them out of order. The final
+ * package (index 0) is only sent once all the others are acked, so it still ends the message
+ ***/
+void StubbornSender::setWindow(uint8_t window)
+{
+    window = std::max((uint8_t)1, std::min(window, (uint8_t)SSENDER_MAX_WINDOW));
+    if (this->window != window)
+    {
+        this->window = window;
+        ResetState();
+    }
+}
+
 void StubbornSender::ResetState()
 {
     bytesLastPayload = 0;
     currentOffset = 0;
     currentPackage = 1;
     telemetryConfirmExpectedValue = true;
+    ackCount = 0;
+    basePackage = 1;
+    nextPackage = 1;
+    lastPackage = 0;
     waitCount = 0;
     // 80 corresponds to UpdateTelemetryRate(ANY, 2, 1), which is what the TX uses in boost mode
     maxWaitCount = 80;
@@ -44,6 +66,9 @@ void StubbornSender::SetDataToTransmit(uint8_t* dataToTransmit, uint8_t lengthTo
     data = dataToTransmit;
     currentOffset = 0;
     currentPackage = 1;
+    basePackage = 1;
+    nextPackage = 1;
+    lastPackage = 0;
     waitCount = 0;
     senderState = (senderState == SENDER_IDLE) ? SEND_PENDING : RESYNC_THEN_SEND;
 }
@@ -68,6 +93,11 @@ uint8_t StubbornSender::GetCurrentPayload(uint8_t *outData, uint8_t maxLen)
         senderState = SENDING;
         // fallthrough
     case SENDING:
+        if (window > 1)
+        {
+            packageIndex = GetWindowedPayload(outData, maxLen);
+        }
+        else
         {
             bytesLastPayload = std::min((uint8_t)(length - currentOffset), maxLen);
             // If this is the last data chunk, and there has been at least one other packet
@@ -87,19 +117,76 @@ uint8_t StubbornSender::GetCurrentPayload(uint8_t *outData, uint8_t maxLen)
     return packageIndex;
 }
 
-void StubbornSender::ConfirmCurrentPayload(bool telemetryConfirmValue)
+/**
+ * @brief: Pick the next package to send in windowed mode: a new one if the window has room,
+ * otherwise the oldest one not acked yet
+ * @returns: packageIndex
+ ***/
+uint8_t StubbornSender::GetWindowedPayload(uint8_t *outData, uint8_t maxLen)
+{
+    if (lastPackage == 0)
+    {
+        chunkLen = maxLen;
+        lastPackage = (length + maxLen - 1) / maxLen;
+        // A single package still needs the blank package 0 after it
+        if (lastPackage < 2)
+            lastPackage = 2;
+    }
+
+    uint8_t package;
+    if (nextPackage < lastPackage && nextPackage < basePackage + window)
+        package = nextPackage++;
+    else if (basePackage == lastPackage)
+    {
+        package = lastPackage;
+        nextPackage = lastPackage + 1;
+    }
+    else
+        package = basePackage;
+
+    const uint16_t offset = (package - 1) * chunkLen;
+    const uint8_t len = (offset < length) ? std::min((uint8_t)(length - offset), chunkLen) : 0;
+    memcpy(outData, &data[offset], len);
+
+    return (package == lastPackage) ? 0 : package;
+}
+
+void StubbornSender::ConfirmCurrentPayload(uint8_t telemetryConfirmValue)
 {
     stubborn_sender_state_e nextSenderState = senderState;
 
     switch (senderState)
     {
     case SENDING:
-        if (telemetryConfirmValue != telemetryConfirmExpectedValue)
+        if (window > 1)
+        {
+            // Packages received in order since the last ack, more than are in flight is a stale ack
+            const uint8_t acked = (telemetryConfirmValue - ackCount) & 3;
+            if (acked == 0 || acked > nextPackage - basePackage)
+            {
+                waitCount++;
+                if (waitCount > maxWaitCount)
+                {
+                    ackCount = telemetryConfirmValue & 3;
+                    nextSenderState = RESYNC;
+                }
+                break;
+            }
+
+            ackCount = (ackCount + acked) & 3;
+            basePackage += acked;
+            if (basePackage > lastPackage)
+                nextSenderState = SENDER_IDLE;
+            waitCount = 0;
+            break;
+        }
+
+        if ((bool)(telemetryConfirmValue & 1) != telemetryConfirmExpectedValue)
         {
             waitCount++;
             if (waitCount > maxWaitCount)
             {
-                telemetryConfirmExpectedValue = !telemetryConfirmValue;
+                telemetryConfirmExpectedValue = !(telemetryConfirmValue & 1);
                 nextSenderState = RESYNC;
             }
             break;
@@ -125,10 +212,12 @@ void StubbornSender::ConfirmCurrentPayload(bool telemetryConfirmValue)
     case RESYNC:
     case RESYNC_THEN_SEND:
     case WAIT_UNTIL_NEXT_CONFIRM:
-        if (telemetryConfirmValue == telemetryConfirmExpectedValue)
+        // A resync is done when the receiver has counted one more package than the last ack
+        if (window > 1 ? ((telemetryConfirmValue - ackCount) & 3) == 1 : (bool)(telemetryConfirmValue & 1) == telemetryConfirmExpectedValue)
         {
             nextSenderState = (senderState == RESYNC_THEN_SEND) ? SENDING : SENDER_IDLE;
-            telemetryConfirmExpectedValue = !telemetryConfirmValue;
+            telemetryConfirmExpectedValue = !(telemetryConfirmValue & 1);
+            ackCount = telemetryConfirmValue & 3;
         }
         // switch to resync if tx does not confirm value fast enough
         else if (senderState == WAIT_UNTIL_NEXT_CONFIRM)
@@ -136,7 +225,7 @@ void StubbornSender::ConfirmCurrentPayload(bool telemetryConfirmValue)
             waitCount++;
             if (waitCount > maxWaitCount)
             {
-                telemetryConfirmExpectedValue = !telemetryConfirmValue;
+                telemetryConfirmExpectedValue = !(telemetryConfirmValue & 1);
                 nextSenderState = RESYNC;
             }
         }
@@ -4,6 +4,8 @@
 
 // The number of times to resend the same package index before going to RESYNC
 #define SSENDER_MAX_MISSED_PACKETS 20
+// The largest window, the ack is a count of packages received in order and only 2 bits wide
+#define SSENDER_MAX_WINDOW 3
 
 typedef enum {
     SENDER_IDLE = 0,
@@ -23,7 +25,9 @@ public:
     void UpdateTelemetryRate(uint16_t airRate, uint8_t tlmRatio, uint8_t tlmBurst);
     void SetDataToTransmit(uint8_t* dataToTransmit, uint8_t lengthToTransmit);
     uint8_t GetCurrentPayload(uint8_t *outData, uint8_t maxLen);
-    void ConfirmCurrentPayload(bool telemetryConfirmValue);
+    void ConfirmCurrentPayload(uint8_t telemetryConfirmValue);
+    void setWindow(uint8_t window);
+    uint8_t getWindow() const { return window; }
     bool IsActive() const { return senderState != SENDER_IDLE; }
     uint16_t GetMaxPacketsBeforeResync() const { return maxWaitCount; }
 private:
@@ -37,4 +41,13 @@ private:
     uint16_t maxWaitCount;
     uint8_t maxPackageIndex;
     stubborn_sender_state_e senderState;
+
+    // Windowed mode, see setWindow()
+    uint8_t window;
+    uint8_t ackCount;
+    uint8_t basePackage;
+    uint8_t nextPackage;
+    uint8_t lastPackage;
+    uint8_t chunkLen;
+    uint8_t GetWindowedPayload(uint8_t *outData, uint8_t maxLen);
 };
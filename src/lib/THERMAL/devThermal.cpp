@@ -247,6 +247,7 @@ static int timeout()
 }
 
 device_t Thermal_device = {
+    .name = "Thermal",
     .initialize = initialize,
     .start = start,
     .event = event,
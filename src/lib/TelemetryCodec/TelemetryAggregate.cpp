@@ -0,0 +1,71 @@
+#include "TelemetryAggregate.h"
+
+#include <string.h>
+#include "crc.h"
+#include "crsf_protocol.h"
+#include "TelemetryCodec.h"
+
+static GENERIC_CRC8<CRSF_CRC_POLY> crsf_crc;
+
+static bool isCodecMessage(const uint8_t first)
+{
+    return first == TLM_CODEC_KEYFRAME || first == TLM_CODEC_DELTA;
+}
+
+uint8_t TlmAggregatePackedLen(const uint8_t *frame, uint8_t frameLen)
+{
+    if (isCodecMessage(frame[0]))
+        return frameLen + 1;
+    return frameLen - CRSF_FRAME_NOT_COUNTED_BYTES - CRSF_TELEMETRY_CRC_LENGTH + 1;
+}
+
+void TlmAggregateBegin(uint8_t *aggregate)
+{
+    aggregate[0] = TLM_AGGREGATE;
+    aggregate[1] = 0;
+}
+
+uint8_t TlmAggregateAppend(uint8_t *aggregate, const uint8_t *frame, uint8_t frameLen)
+{
+    uint8_t *sub = &aggregate[TLM_AGGREGATE_HEADER_LEN + aggregate[1]];
+    if (isCodecMessage(frame[0]))
+    {
+        sub[0] = frameLen;
+        memcpy(&sub[1], frame, frameLen);
+    }
+    else
+    {
+        // Type and payload, without the sync, length and CRC
+        sub[0] = frameLen - CRSF_FRAME_NOT_COUNTED_BYTES - CRSF_TELEMETRY_CRC_LENGTH;
+        memcpy(&sub[1], &frame[CRSF_TELEMETRY_TYPE_INDEX], sub[0]);
+    }
+    aggregate[1] += sub[0] + 1;
+    return TLM_AGGREGATE_HEADER_LEN + aggregate[1];
+}
+
+uint8_t TlmAggregateNext(const uint8_t *aggregate, uint8_t &pos, uint8_t *frame, uint8_t frameBufferLen)
+{
+    const uint8_t end = TLM_AGGREGATE_HEADER_LEN + aggregate[1];
+    if (pos >= end)
+        return 0;
+    const uint8_t *sub = &aggregate[pos];
+    const uint8_t subLen = sub[0];
+    if (subLen == 0 || pos + 1 + subLen > end || subLen + CRSF_FRAME_NOT_COUNTED_BYTES + CRSF_TELEMETRY_CRC_LENGTH > frameBufferLen)
+    {
+        pos = end;
+        return 0;
+    }
+    pos += 1 + subLen;
+
+    if (isCodecMessage(sub[1]))
+    {
+        memcpy(frame, &sub[1], subLen);
+        return subLen;
+    }
+
+    frame[0] = CRSF_SYNC_BYTE;
+    frame[CRSF_TELEMETRY_LENGTH_INDEX] = subLen + CRSF_TELEMETRY_CRC_LENGTH;
+    memcpy(&frame[CRSF_TELEMETRY_TYPE_INDEX], &sub[1], subLen);
+    frame[CRSF_TELEMETRY_TYPE_INDEX + subLen] = crsf_crc.calc(&frame[CRSF_TELEMETRY_TYPE_INDEX], subLen);
+    return subLen + CRSF_FRAME_NOT_COUNTED_BYTES + CRSF_TELEMETRY_CRC_LENGTH;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+// First byte of a message which carries several frames, after the TelemetryCodec markers
+#define TLM_AGGREGATE 0xFA
+// The marker and the length of the sub-frames which follow, like a CRSF frame's
+#define TLM_AGGREGATE_HEADER_LEN 2
+
+/**
+ * Several small telemetry frames packed into one downlink message, so they share the stubborn
+ * sender's minimum of two packages and its final package padding instead of each taking their own.
+ *
+ * Each sub-frame is a length byte and the frame without its sync, length and CRC bytes, which the
+ * TX puts back. A TelemetryCodec message is packed as is, its first byte is never a frame type.
+ */
+
+/**
+ * @brief Most bytes a frame can take in an aggregate, before it is coded
+ */
+static inline uint8_t TlmAggregatePackedMax(uint8_t frameLen)
+{
+    // A codec keyframe keeps all but 2 bytes of the frame, and has a length byte added
+    return frameLen - 1;
+}
+
+/**
+ * @brief Bytes a frame, or codec message, takes in an aggregate
+ */
+uint8_t TlmAggregatePackedLen(const uint8_t *frame, uint8_t frameLen);
+
+void TlmAggregateBegin(uint8_t *aggregate);
+
+/**
+ * @brief Add a frame, or codec message, to the end of an aggregate
+ * @return Length of the aggregate so far
+ */
+uint8_t TlmAggregateAppend(uint8_t *aggregate, const uint8_t *frame, uint8_t frameLen);
+
+/**
+ * @brief Rebuild the next frame of an aggregate, codec messages are copied out to be decoded
+ * @param pos offset of the next sub-frame, start at TLM_AGGREGATE_HEADER_LEN
+ * @param frameBufferLen size of frame, which must fit any CRSF frame
+ * @return Length written to frame, or 0 after the last or if the aggregate is malformed
+ */
+uint8_t TlmAggregateNext(const uint8_t *aggregate, uint8_t &pos, uint8_t *frame, uint8_t frameBufferLen);
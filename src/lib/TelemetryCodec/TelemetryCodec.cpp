@@ -0,0 +1,201 @@
+#include "TelemetryCodec.h"
+
+#include <string.h>
+#include "crc.h"
+#include "crsf_protocol.h"
+
+// Field width in bytes, optionally predicted by a straight line through the last two values
+#define LINEAR 0x80
+#define TLM_CODEC_MAX_FIELDS 6
+
+typedef struct {
+    uint8_t type;
+    uint8_t payloadLen;
+    uint8_t fields[TLM_CODEC_MAX_FIELDS]; // big endian, in payload order
+} frameLayout_t;
+
+static const frameLayout_t layouts[TLM_CODEC_TYPES] = {
+    {CRSF_FRAMETYPE_GPS, 15, {4 | LINEAR, 4 | LINEAR, 2, 2, 2 | LINEAR, 1}},
+    {CRSF_FRAMETYPE_ATTITUDE, 6, {2, 2, 2}},
+    {CRSF_FRAMETYPE_VARIO, 2, {2}},
+    {CRSF_FRAMETYPE_BARO_ALTITUDE, 4, {2, 2}},
+    {CRSF_FRAMETYPE_AIRSPEED, 2, {2}},
+    {CRSF_FRAMETYPE_BATTERY_SENSOR, 8, {2, 2, 3, 1}},
+};
+
+static GENERIC_CRC8<CRSF_CRC_POLY> crsf_crc;
+
+static int8_t layoutOf(uint8_t type)
+{
+    for (uint8_t i = 0; i < TLM_CODEC_TYPES; i++)
+    {
+        if (layouts[i].type == type)
+            return i;
+    }
+    return -1;
+}
+
+static uint32_t readField(const uint8_t *data, uint8_t width)
+{
+    uint32_t value = 0;
+    while (width--)
+        value = (value << 8) | *data++;
+    return value;
+}
+
+static void writeField(uint8_t *data, uint8_t width, uint32_t value)
+{
+    while (width--)
+    {
+        data[width] = value;
+        value >>= 8;
+    }
+}
+
+static uint32_t predict(const uint8_t *last, const uint8_t *prev, uint8_t field)
+{
+    const uint8_t width = field & ~LINEAR;
+    if (field & LINEAR)
+        return 2 * readField(last, width) - readField(prev, width);
+    return readField(last, width);
+}
+
+void TelemetryCodec::reset()
+{
+    memset(states, 0, sizeof(states));
+}
+
+uint8_t TelemetryCodec::encode(uint8_t *frame, uint8_t frameLen)
+{
+    const int8_t layoutIdx = layoutOf(frame[CRSF_TELEMETRY_TYPE_INDEX]);
+    if (layoutIdx < 0)
+        return frameLen;
+
+    const frameLayout_t &layout = layouts[layoutIdx];
+    state_t &state = states[layoutIdx];
+    uint8_t *payload = &frame[CRSF_TELEMETRY_TYPE_INDEX + 1];
+    if (frame[0] != CRSF_SYNC_BYTE || frameLen != layout.payloadLen + 4 || frame[CRSF_TELEMETRY_LENGTH_INDEX] != layout.payloadLen + 2)
+    {
+        // The decoder sees this frame too, and forgets the type as well
+        state.valid = false;
+        return frameLen;
+    }
+
+    // A new chain starts from 0, so the keyframes fall on multiples of the interval
+    state.seq = state.valid ? (state.seq + 1) & 0x1F : 0;
+    uint8_t coded[2 + TLM_CODEC_MAX_FIELDS * 5];
+    uint8_t codedLen = 0;
+    if (state.valid && (state.seq % TLM_CODEC_KEYFRAME_INTERVAL) != 0)
+    {
+        codedLen = 2;
+        const uint8_t *field = layout.fields;
+        for (uint8_t offset = 0; offset < layout.payloadLen; field++)
+        {
+            const uint8_t width = *field & ~LINEAR;
+            const uint8_t shift = 32 - 8 * width;
+            const uint32_t diff = readField(&payload[offset], width) - predict(&state.last[offset], &state.prev[offset], *field);
+            const int32_t residual = (int32_t)(diff << shift) >> shift;
+            uint32_t zigzag = ((uint32_t)residual << 1) ^ (uint32_t)(residual >> 31);
+            while (zigzag >= 0x80)
+            {
+                coded[codedLen++] = zigzag | 0x80;
+                zigzag >>= 7;
+            }
+            coded[codedLen++] = zigzag;
+            offset += width;
+        }
+    }
+
+    const uint8_t header = (state.seq << 3) | layoutIdx;
+
+    // A keyframe if the chain needs restarting, or a big jump makes the delta no smaller
+    if (codedLen == 0 || codedLen >= layout.payloadLen + 2)
+    {
+        // Both histories restart from the keyframe, as the decoder may have missed the frames before it.
+        // The first delta after it is then predicted without the linear term
+        memcpy(state.prev, payload, layout.payloadLen);
+        memcpy(state.last, payload, layout.payloadLen);
+        state.valid = true;
+        frame[0] = TLM_CODEC_KEYFRAME;
+        frame[1] = header;
+        memmove(&frame[2], payload, layout.payloadLen);
+        return layout.payloadLen + 2;
+    }
+
+    memcpy(state.prev, state.last, layout.payloadLen);
+    memcpy(state.last, payload, layout.payloadLen);
+    coded[0] = TLM_CODEC_DELTA;
+    coded[1] = header;
+    memcpy(frame, coded, codedLen);
+    return codedLen;
+}
+
+bool TelemetryCodec::decode(uint8_t *buffer, uint8_t messageLen, uint8_t bufferLen)
+{
+    if (buffer[0] != TLM_CODEC_KEYFRAME && buffer[0] != TLM_CODEC_DELTA)
+    {
+        const int8_t layoutIdx = layoutOf(buffer[CRSF_TELEMETRY_TYPE_INDEX]);
+        if (layoutIdx >= 0)
+            states[layoutIdx].valid = false;
+        return true;
+    }
+
+    const uint8_t layoutIdx = buffer[1] & 0x07;
+    const uint8_t seq = buffer[1] >> 3;
+    if (layoutIdx >= TLM_CODEC_TYPES)
+        return false;
+    const frameLayout_t &layout = layouts[layoutIdx];
+    state_t &state = states[layoutIdx];
+    if (bufferLen < layout.payloadLen + 4)
+        return false;
+
+    uint8_t payload[TLM_CODEC_MAX_PAYLOAD];
+    if (buffer[0] == TLM_CODEC_KEYFRAME)
+    {
+        if (messageLen < layout.payloadLen + 2)
+            return false;
+        memcpy(payload, &buffer[2], layout.payloadLen);
+        // The same restart of both histories as the encoder
+        memcpy(state.last, payload, layout.payloadLen);
+        state.valid = true;
+    }
+    else
+    {
+        if (!state.valid || seq != ((state.seq + 1) & 0x1F))
+        {
+            state.valid = false;
+            return false;
+        }
+
+        uint8_t pos = 2;
+        const uint8_t *field = layout.fields;
+        for (uint8_t offset = 0; offset < layout.payloadLen; field++)
+        {
+            uint32_t zigzag = 0;
+            for (uint8_t shift = 0; ; shift += 7)
+            {
+                if (pos >= messageLen || shift > 28)
+                    return false;
+                const uint8_t b = buffer[pos++];
+                zigzag |= (uint32_t)(b & 0x7F) << shift;
+                if (!(b & 0x80))
+                    break;
+            }
+            const uint32_t residual = (zigzag >> 1) ^ (0 - (zigzag & 1));
+            const uint8_t width = *field & ~LINEAR;
+            writeField(&payload[offset], width, predict(&state.last[offset], &state.prev[offset], *field) + residual);
+            offset += width;
+        }
+    }
+
+    state.seq = seq;
+    memcpy(state.prev, state.last, layout.payloadLen);
+    memcpy(state.last, payload, layout.payloadLen);
+
+    buffer[0] = CRSF_SYNC_BYTE;
+    buffer[CRSF_TELEMETRY_LENGTH_INDEX] = layout.payloadLen + 2;
+    buffer[CRSF_TELEMETRY_TYPE_INDEX] = layout.type;
+    memcpy(&buffer[CRSF_TELEMETRY_TYPE_INDEX + 1], payload, layout.payloadLen);
+    buffer[layout.payloadLen + 3] = crsf_crc.calc(&buffer[CRSF_TELEMETRY_TYPE_INDEX], layout.payloadLen + 1);
+    return true;
+}
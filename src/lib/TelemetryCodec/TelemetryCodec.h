@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+// First byte of a coded message, in place of the CRSF sync byte. No CRSF address is 0xF8 or above
+#define TLM_CODEC_KEYFRAME 0xF8
+#define TLM_CODEC_DELTA 0xF9
+// Every this many frames of a type is a keyframe, which bounds how long a lost message breaks the chain
+#define TLM_CODEC_KEYFRAME_INTERVAL 8
+// Number of frame types which are coded, and the largest payload of them (GPS)
+#define TLM_CODEC_TYPES 6
+#define TLM_CODEC_MAX_PAYLOAD 15
+
+/**
+ * Codes the high rate telemetry frames (GPS, attitude, vario, baro, airspeed and battery) which the
+ * RX sends to the TX, so consecutive frames which barely change don't each cost a full CRSF frame.
+ *
+ * A keyframe is just the type and payload, the sync, length and CRC bytes are implied by the type.
+ * Between keyframes each field is sent as its difference from a prediction, zigzag and varint coded,
+ * so a field which moved by a few LSBs takes one byte. The prediction is the previous value, or a
+ * straight line through the last two for GPS position and altitude.
+ *
+ * The stubborn sender delivers messages in order but drops one if it has to resync, so every
+ * message carries a 5 bit sequence number per type and the decoder drops deltas until the next
+ * keyframe once one is missing. Frames of any other type or length are passed through unchanged.
+ */
+class TelemetryCodec
+{
+public:
+    TelemetryCodec() { reset(); }
+    void reset();
+
+    /**
+     * @brief Code a CRSF frame in place
+     * @return Length of the coded message, which is frameLen if the frame is passed through
+     */
+    uint8_t encode(uint8_t *frame, uint8_t frameLen);
+
+    /**
+     * @brief Rebuild a CRSF frame in place from a coded message, plain CRSF frames are left as is
+     * @param messageLen number of bytes received, nothing past them is read
+     * @param bufferLen size of the buffer, which must fit the rebuilt frame
+     * @return false if it is a delta which can not be rebuilt and must be dropped
+     */
+    bool decode(uint8_t *buffer, uint8_t messageLen, uint8_t bufferLen);
+
+private:
+    typedef struct {
+        uint8_t last[TLM_CODEC_MAX_PAYLOAD];
+        uint8_t prev[TLM_CODEC_MAX_PAYLOAD];
+        uint8_t seq;
+        bool valid;
+    } state_t;
+
+    state_t states[TLM_CODEC_TYPES];
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "targets.h"
+#include "common.h"
+
+// How often the TX re-evaluates the Auto ratio, a change goes to the RX in the next sync packets
+#define TLM_AUTO_INTERVAL_MS 500
+// Uplink LQ needed to give RC packets to telemetry, and the LQ below which they are taken back
+#define TLM_AUTO_LQ_RAISE 80
+#define TLM_AUTO_LQ_DROP 70
+// The most telemetry Auto uses, unless the standard ratio of the packet rate is already more
+#define TLM_AUTO_MAX_RATIO TLM_RATIO_1_8
+
+/**
+ * Chooses the telemetry ratio for TLM_RATIO_AUTO on the TX.
+ *
+ * The RX sends a DATA packet in a telemetry slot while it has a telemetry or MSP message to send,
+ * and LINKSTATS otherwise (plus one every burst), so the share of DATA in the telemetry packets
+ * received shows how backed up its telemetry queue is. While at least half are DATA and the uplink
+ * is healthy the ratio steps up towards TLM_AUTO_MAX_RATIO, and once almost none are it steps back
+ * down to the standard ratio of the packet rate. If the uplink LQ drops it goes straight back.
+ */
+class TelemetryRatioAuto
+{
+public:
+    TelemetryRatioAuto() { reset(TLM_RATIO_STD); }
+
+    /**
+     * @brief Start over from the standard ratio of a (new) packet rate
+     */
+    void reset(expresslrs_tlm_ratio_e stdRatio)
+    {
+        minRatio = stdRatio;
+        maxRatio = stdRatio > TLM_AUTO_MAX_RATIO ? stdRatio : TLM_AUTO_MAX_RATIO;
+        ratio = stdRatio;
+        dataPackets = 0;
+        totalPackets = 0;
+    }
+
+    void ICACHE_RAM_ATTR telemetryReceived(bool isData)
+    {
+        ++totalPackets;
+        if (isData)
+            ++dataPackets;
+    }
+
+    /**
+     * @brief Re-evaluate the ratio from the telemetry received since the last call
+     * @return true if the ratio changed and should be sent to the RX
+     */
+    bool update(uint8_t uplinkLq)
+    {
+        const expresslrs_tlm_ratio_e last = ratio;
+        if (uplinkLq < TLM_AUTO_LQ_DROP)
+        {
+            ratio = minRatio;
+        }
+        else if (totalPackets && dataPackets * 2 >= totalPackets)
+        {
+            if (uplinkLq >= TLM_AUTO_LQ_RAISE && ratio < maxRatio)
+                ratio = (expresslrs_tlm_ratio_e)(ratio + 1);
+        }
+        else if (dataPackets * 8 < totalPackets && ratio > minRatio)
+        {
+            ratio = (expresslrs_tlm_ratio_e)(ratio - 1);
+        }
+        dataPackets = 0;
+        totalPackets = 0;
+        return ratio != last;
+    }
+
+    expresslrs_tlm_ratio_e getRatio() const { return ratio; }
+
+private:
+    expresslrs_tlm_ratio_e ratio;
+    expresslrs_tlm_ratio_e minRatio;
+    expresslrs_tlm_ratio_e maxRatio;
+    volatile uint16_t dataPackets;
+    volatile uint16_t totalPackets;
+};
@@ -13,3 +13,9 @@
 #define ELRS_MSP_MAX_PACKAGES ((ELRS_DATA_UL_BUFFER / ELRS4_DATA_UL_BYTES_PER_CALL)+1)
 
 #define AP_MAX_BUF_LEN  64
+
+// Uplink data packages in flight when windowed data is negotiated in the sync packet (OTA_PROTOCOL_WINDOWED_DATA)
+#define ELRS_DATA_UL_WINDOW 3
+// With windowed uplink data, bit 1 of the uplink ack is sent in the top bit of the downlink packageIndex
+#define ELRS4_DATA_DL_WINDOW_ACK_BIT ((ELRS4_DATA_DL_MAX_PACKAGES + 1) >> 1)
+#define ELRS8_DATA_DL_WINDOW_ACK_BIT ((ELRS8_DATA_DL_MAX_PACKAGES + 1) >> 1)
@@ -184,6 +184,7 @@ static int timeout()
 }
 
 device_t VTX_device = {
+    .name = "VTX",
     .initialize = initialize,
     .start = nullptr,
     .event = event,
@@ -466,6 +466,7 @@ static int timeout()
 }
 
 device_t VTxSPI_device = {
+    .name = "VTxSPI",
     .initialize = initialize,
     .start = start,
     .event = nullptr,
@@ -41,6 +41,10 @@
 
 #include "config.h"
 
+#if defined(CRSF_CAPTURE)
+#include "CRSFCapture.h"
+#endif
+
 #if defined(RADIO_LR1121)
 #include "lr1121.h"
 #endif
@@ -865,6 +869,57 @@ static void WebUpdateGetFirmware(AsyncWebServerRequest *request) {
   request->send(response);
 }
 
+#if defined(CRSF_CAPTURE)
+static size_t getCaptureChunk(uint8_t *data, size_t len, size_t pos)
+{
+  const size_t copied = crsfCapture.read(pos, data, len);
+  if (pos + copied >= crsfCapture.size())
+  {
+    // The whole capture has been sent, carry on recording
+    crsfCapture.setEnabled(true);
+  }
+  return copied;
+}
+
+static void WebUpdateGetCapture(AsyncWebServerRequest *request) {
+  // Recording stops while the capture is sent so the records don't move during the download
+  crsfCapture.setEnabled(false);
+  // and starts again when the connection closes, even if the download was not finished
+  request->onDisconnect([]() { crsfCapture.setEnabled(true); });
+  AsyncWebServerResponse *response = request->beginResponse("application/octet-stream", crsfCapture.size(), &getCaptureChunk);
+  response->addHeader("Content-Disposition", "attachment; filename=\"capture.bin\"");
+  request->send(response);
+}
+
+static void WebUpdateClearCapture(AsyncWebServerRequest *request) {
+  crsfCapture.clear();
+  crsfCapture.setEnabled(true);
+  request->send(200, "text/plain", "Capture cleared");
+}
+#endif
+
+static void WebUpdateGetDeviceStats(AsyncWebServerRequest *request) {
+  // The time each device has spent in its start(), event() and timeout() calls, to find the ones blocking the loop
+  auto *response = new AsyncJsonResponse(true);
+  const auto devices = response->getRoot().as<JsonArray>();
+  const char *name;
+  device_stats_t stats;
+  for (uint8_t i = 0 ; devicesGetStats(i, name, stats) ; i++)
+  {
+    const auto device = devices.add<JsonObject>();
+    device["name"] = name;
+    device["calls"] = stats.calls;
+    device["total_us"] = stats.totalUs;
+    device["max_us"] = stats.maxUs;
+  }
+  if (request->hasArg("reset"))
+  {
+    devicesResetStats();
+  }
+  response->setLength();
+  request->send(response);
+}
+
 static void HandleContinuousWave(AsyncWebServerRequest *request) {
   if (request->hasArg("radio")) {
     SX12XX_Radio_Number_t radio = request->arg("radio").toInt() == 1 ? SX12XX_Radio_1 : SX12XX_Radio_2;
@@ -1091,6 +1146,11 @@ static void startServices()
   server.on("/forceupdate", WebUploadForceUpdateHandler);
   server.on("/forceupdate", HTTP_OPTIONS, corsPreflightResponse);
   server.on("/cw", HandleContinuousWave);
+  server.on("/devices.json", HTTP_GET, WebUpdateGetDeviceStats);
+  #if defined(CRSF_CAPTURE)
+    server.on("/capture.bin", HTTP_GET, WebUpdateGetCapture);
+    server.on("/capture/clear", HTTP_POST, WebUpdateClearCapture);
+  #endif
 
   DefaultHeaders::Instance().addHeader("Access-Control-Allow-Origin", "*");
   DefaultHeaders::Instance().addHeader("Access-Control-Max-Age", "600");
@@ -1316,6 +1376,7 @@ static int timeout()
 }
 
 device_t WIFI_device = {
+  .name = "WIFI",
   .initialize = initialize,
   .start = start,
   .event = event,
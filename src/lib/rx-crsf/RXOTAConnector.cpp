@@ -1,203 +1,325 @@
 #include "RXOTAConnector.h"
 
-#include "helpers.h"
+#include <string.h>
+#include "TelemetryAggregate.h"
 
-#include <functional>
-#include <unordered_map>
+#define KEY(type, a, b) (((uint32_t)1 << 24) | ((uint32_t)(type) << 16) | ((uint32_t)(a) << 8) | (uint32_t)(b))
 
-// Size byte in FIFO contains bit to indicate if the frame is deleted
-#define IS_DEL(size) (size & bit(7))
-#define SET_DEL(size) (size | bit(7))
-#define SIZE(size) (size & ~bit(7))
+// Latency budget of each telemetryClass_e, from when a frame is queued until it is sent (ms)
+static const uint16_t telemetryBudgetMs[TELEM_CLASS_COUNT] = {
+    20,     // TELEM_CLASS_PARAM
+    100,    // TELEM_CLASS_LINK
+    100,    // TELEM_CLASS_ATTITUDE
+    200,    // TELEM_CLASS_GPS
+    250,    // TELEM_CLASS_BATTERY
+    500,    // TELEM_CLASS_SENSOR
+    1000,   // TELEM_CLASS_OTHER
+};
 
-enum action_e
+telemetryClass_e RXOTAConnector::classOf(const crsf_frame_type_e frameType)
 {
-    ACTION_NEXT,      // continue searching queue for other messages
-    ACTION_IGNORE,    // the message matches; ignore the new one
-    ACTION_OVERWRITE, // overwrite the queued message with the new one
-    ACTION_APPEND     // append the message to the end of the queue
-};
+    switch (frameType)
+    {
+    case CRSF_FRAMETYPE_DEVICE_PING:
+    case CRSF_FRAMETYPE_DEVICE_INFO:
+    case CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY:
+    case CRSF_FRAMETYPE_PARAMETER_READ:
+    case CRSF_FRAMETYPE_PARAMETER_WRITE:
+    case CRSF_FRAMETYPE_COMMAND:
+    case CRSF_FRAMETYPE_MSP_RESP:
+        return TELEM_CLASS_PARAM;
+    case CRSF_FRAMETYPE_LINK_STATISTICS:
+        return TELEM_CLASS_LINK;
+    case CRSF_FRAMETYPE_ATTITUDE:
+    case CRSF_FRAMETYPE_VARIO:
+    case CRSF_FRAMETYPE_BARO_ALTITUDE:
+    case CRSF_FRAMETYPE_AIRSPEED:
+        return TELEM_CLASS_ATTITUDE;
+    case CRSF_FRAMETYPE_GPS:
+        return TELEM_CLASS_GPS;
+    case CRSF_FRAMETYPE_BATTERY_SENSOR:
+    case CRSF_FRAMETYPE_CELLS:
+        return TELEM_CLASS_BATTERY;
+    case CRSF_FRAMETYPE_FLIGHT_MODE:
+    case CRSF_FRAMETYPE_RPM:
+    case CRSF_FRAMETYPE_TEMP:
+        return TELEM_CLASS_SENSOR;
+    default:
+        return TELEM_CLASS_OTHER;
+    }
+}
 
-typedef std::function<action_e(const crsf_header_t *newMessage, TelemetryFifo &payloads, uint16_t queuePosition)> comparator_t;
+uint16_t RXOTAConnector::classBudgetMs(const telemetryClass_e telemetryClass)
+{
+    return telemetryBudgetMs[telemetryClass];
+}
 
-// For broadcast messages that have a 'source_id' as the first byte of the payload.
-static action_e sourceId(const crsf_header_t *newMessage, const TelemetryFifo &payloads, const uint16_t queuePosition)
+/**
+ * Key of the queued frame a new message replaces, or 0 if it is always appended
+ */
+static uint32_t dedupKey(const crsf_header_t *message)
 {
-    if (payloads[queuePosition + CRSF_TELEMETRY_TYPE_INDEX + 1] == ((uint8_t *)newMessage)[CRSF_TELEMETRY_TYPE_INDEX + 1])
+    switch (message->type)
     {
-        return ACTION_OVERWRITE;
+    // Broadcast messages that have a 'source_id' as the first byte of the payload
+    case CRSF_FRAMETYPE_RPM:
+    case CRSF_FRAMETYPE_TEMP:
+    case CRSF_FRAMETYPE_CELLS:
+        return KEY(message->type, message->payload[0], 0);
+    // Only the latest Ardupilot status text is kept
+    case CRSF_FRAMETYPE_ARDUPILOT_RESP:
+        return message->payload[0] == CRSF_AP_CUSTOM_TELEM_STATUS_TEXT ? KEY(message->type, CRSF_AP_CUSTOM_TELEM_STATUS_TEXT, 0) : 0;
+    // Extended messages with the same destination and origin address
+    case CRSF_FRAMETYPE_DEVICE_INFO:
+        return KEY(message->type, ((crsf_ext_header_t *)message)->dest_addr, ((crsf_ext_header_t *)message)->orig_addr);
+    // and parameter entries for the same field too, as a bulk reply carries several fields at once
+    case CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY:
+    {
+        const crsf_ext_header_t *ext = (crsf_ext_header_t *)message;
+        return KEY(message->type, ext->orig_addr, ext->payload[0]) | ((uint32_t)ext->dest_addr << 24);
+    }
+    default:
+        // Any other broadcast message is replaced by a newer one of the same type
+        return message->type < CRSF_FRAMETYPE_DEVICE_PING ? KEY(message->type, 0, 0) : 0;
     }
-    return ACTION_NEXT;
 }
 
-// Comparator for Ardupilot Status Text message
-static action_e statusText(const crsf_header_t *newMessage, const TelemetryFifo &payloads, const uint16_t queuePosition)
+static inline uint32_t indexHash(const uint32_t key)
+{
+    return (key * 2654435761U) >> (32 - TELEMETRY_QUEUE_INDEX_BITS);
+}
+static_assert(TELEMETRY_QUEUE_INDEX_SIZE > TELEMETRY_QUEUE_SLOTS, "the index needs a free entry to end each probe");
+
+RXOTAConnector::RXOTAConnector()
+{
+    addDevice(CRSF_ADDRESS_RADIO_TRANSMITTER);
+    addDevice(CRSF_ADDRESS_CRSF_TRANSMITTER);
+    clearQueue();
+    resetAgeStats();
+}
+
+void RXOTAConnector::clearQueue()
 {
-    if (payloads[queuePosition + CRSF_TELEMETRY_TYPE_INDEX + 1] == CRSF_AP_CUSTOM_TELEM_STATUS_TEXT &&
-        newMessage->payload[0] == CRSF_AP_CUSTOM_TELEM_STATUS_TEXT)
+    for (uint8_t slot = 0; slot < TELEMETRY_QUEUE_SLOTS; slot++)
     {
-        return ACTION_OVERWRITE;
+        slots[slot].next = slot + 1 < TELEMETRY_QUEUE_SLOTS ? slot + 1 : TELEMETRY_QUEUE_NONE;
     }
-    return ACTION_NEXT;
+    freeHead = 0;
+    slotsUsed = 0;
+    for (auto &list : lists)
+    {
+        list.head = list.tail = TELEMETRY_QUEUE_NONE;
+    }
+    memset(index, TELEMETRY_QUEUE_NONE, sizeof(index));
+}
+
+void RXOTAConnector::resetAgeStats()
+{
+    memset(ageStats, 0, sizeof(ageStats));
 }
 
-// Comparator for extended messages with the same destination and origin address.
-static action_e extendedSameDestOrigin(const crsf_header_t *newMessage, const TelemetryFifo &payloads, const uint16_t queuePosition)
+uint8_t RXOTAConnector::popSlot(const uint8_t list)
 {
-    if (payloads[queuePosition + 3] == ((crsf_ext_header_t *)newMessage)->dest_addr && payloads[queuePosition + 4] == ((crsf_ext_header_t *)newMessage)->orig_addr)
+    const uint8_t slot = lists[list].head;
+    lists[list].head = slots[slot].next;
+    if (lists[list].head == TELEMETRY_QUEUE_NONE)
     {
-        return ACTION_OVERWRITE;
+        lists[list].tail = TELEMETRY_QUEUE_NONE;
     }
-    return ACTION_NEXT;
+    if (slots[slot].key)
+    {
+        indexRemove(slots[slot].key);
+    }
+    slots[slot].next = freeHead;
+    freeHead = slot;
+    slotsUsed--;
+    return slot;
 }
 
-static std::unordered_map<crsf_frame_type_e, comparator_t> comparators = {
-    {CRSF_FRAMETYPE_RPM, sourceId},
-    {CRSF_FRAMETYPE_TEMP, sourceId},
-    {CRSF_FRAMETYPE_CELLS, sourceId},
-    {CRSF_FRAMETYPE_ARDUPILOT_RESP, statusText},
-    {CRSF_FRAMETYPE_DEVICE_INFO, extendedSameDestOrigin},
-    {CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY, extendedSameDestOrigin },
-};
+void RXOTAConnector::pushSlot(const uint8_t list, const uint8_t slot)
+{
+    slots[slot].next = TELEMETRY_QUEUE_NONE;
+    if (lists[list].tail == TELEMETRY_QUEUE_NONE)
+    {
+        lists[list].head = slot;
+    }
+    else
+    {
+        slots[lists[list].tail].next = slot;
+    }
+    lists[list].tail = slot;
+    slotsUsed++;
+}
 
-inline bool isPrioritised(const crsf_frame_type_e frameType)
+uint8_t RXOTAConnector::findSlot(const uint32_t key) const
 {
-    return frameType >= CRSF_FRAMETYPE_DEVICE_PING && frameType <= CRSF_FRAMETYPE_PARAMETER_WRITE;
+    for (uint32_t pos = indexHash(key); index[pos] != TELEMETRY_QUEUE_NONE; pos = (pos + 1) % TELEMETRY_QUEUE_INDEX_SIZE)
+    {
+        if (slots[index[pos]].key == key)
+        {
+            return index[pos];
+        }
+    }
+    return TELEMETRY_QUEUE_NONE;
 }
 
-RXOTAConnector::RXOTAConnector()
+void RXOTAConnector::indexInsert(const uint32_t key, const uint8_t slot)
 {
-    addDevice(CRSF_ADDRESS_RADIO_TRANSMITTER);
-    addDevice(CRSF_ADDRESS_CRSF_TRANSMITTER);
+    uint32_t pos = indexHash(key);
+    while (index[pos] != TELEMETRY_QUEUE_NONE)
+    {
+        pos = (pos + 1) % TELEMETRY_QUEUE_INDEX_SIZE;
+    }
+    index[pos] = slot;
 }
 
-bool RXOTAConnector::GetNextPayload(uint8_t *nextPayloadSize, uint8_t *payloadData)
+void RXOTAConnector::indexRemove(const uint32_t key)
 {
-#if defined(PLATFORM_ESP32) && SOC_CPU_CORES_NUM > 1
-    std::lock_guard<std::mutex> lock(mutex);
-#endif
-    if (prioritizedCount)
+    uint32_t pos = indexHash(key);
+    while (slots[index[pos]].key != key)
     {
-        // handle prioritised messages first
-        for (uint16_t i = 0; i < messagePayloads.size();)
+        pos = (pos + 1) % TELEMETRY_QUEUE_INDEX_SIZE;
+    }
+    // Shift later entries of the probe run back into the hole, so no tombstone is needed
+    uint32_t next = pos;
+    while (true)
+    {
+        next = (next + 1) % TELEMETRY_QUEUE_INDEX_SIZE;
+        if (index[next] == TELEMETRY_QUEUE_NONE)
+            break;
+        const uint32_t home = indexHash(slots[index[next]].key);
+        // The entry can move back unless its home lies cyclically in (pos, next]
+        if ((next > pos && (home <= pos || home > next)) || (next < pos && home <= pos && home > next))
         {
-            const auto size = messagePayloads[i];
-            // If the message at this point in the queue is not deleted, and it's a SETTINGS_ENTRY then we're going to return it
-            if (isPrioritised((crsf_frame_type_e)messagePayloads[i + 1 + CRSF_TELEMETRY_TYPE_INDEX]))
-            {
-                if (!IS_DEL(size))
-                {
-                    prioritizedCount--;
-                    // If this is the first item in the queue, use pop() instead to free the space
-                    if (i == 0)
-                    {
-                        messagePayloads.pop();
-                        messagePayloads.popBytes(payloadData, size);
-                    }
-                    else // Copy the frame to the current payload
-                    {
-                        for (uint16_t pos = 0 ; pos < size ; pos++)
-                        {
-                            payloadData[pos] = messagePayloads[i + 1 + pos];
-                        }
-                        // Mark the current queued entry as deleted
-                        messagePayloads.set(i, SET_DEL(size));
-                    }
-                    // set the pointers to the payload
-                    *nextPayloadSize = CRSF_FRAME_SIZE(payloadData[CRSF_TELEMETRY_LENGTH_INDEX]);
-                    return true;
-                }
-            }
-            i += 1 + SIZE(size);
+            index[pos] = index[next];
+            pos = next;
         }
-        // Didn't find one, so we'll reset the counter
-        prioritizedCount = 0;
     }
+    index[pos] = TELEMETRY_QUEUE_NONE;
+}
 
-    // return the 'head' of the queue
-    while (messagePayloads.size() > 0)
+/**
+ * The list whose head has the earliest deadline, or TELEM_CLASS_COUNT if all are empty
+ */
+uint8_t RXOTAConnector::nextList() const
+{
+    // The head of each list is the earliest in its class
+    uint8_t list = TELEM_CLASS_COUNT;
+    for (uint8_t cls = 0; cls < TELEM_CLASS_COUNT; cls++)
     {
-        const auto size = messagePayloads.pop();
-        if (IS_DEL(size))
+        const uint8_t head = lists[cls].head;
+        if (head != TELEMETRY_QUEUE_NONE && (list == TELEM_CLASS_COUNT || (int32_t)(slots[head].deadline - slots[lists[list].head].deadline) < 0))
         {
-            // This message is deleted, skip it
-            messagePayloads.skip(SIZE(size));
-            continue;
+            list = cls;
         }
-        messagePayloads.popBytes(payloadData, size);
-        *nextPayloadSize = CRSF_FRAME_SIZE(payloadData[CRSF_TELEMETRY_LENGTH_INDEX]);
-        return true;
     }
-
-    *nextPayloadSize = 0;
-    return false;
+    return list;
 }
 
-void RXOTAConnector::forwardMessage(const crsf_header_t *message)
+/**
+ * Take the head frame of a list, coded if there is a codec
+ * @return Length of the frame written to frame
+ */
+uint8_t RXOTAConnector::popFrame(const uint8_t list, uint8_t *frame, const uint32_t now)
 {
-    const uint8_t messageSize = CRSF_FRAME_SIZE(((uint8_t *)message)[CRSF_TELEMETRY_LENGTH_INDEX]);
+    const uint8_t slot = popSlot(list);
+    const uint8_t *data = slots[slot].data;
+    uint8_t frameLen = CRSF_FRAME_SIZE(data[CRSF_TELEMETRY_LENGTH_INDEX]);
+    memcpy(frame, data, frameLen);
+    if (codec)
+    {
+        frameLen = codec->encode(frame, frameLen);
+    }
 
-    auto action = ACTION_APPEND;
-    uint16_t overwritePosition = 0;
-    const auto comparator = comparators.find(message->type);
+    TelemetryAgeStats_s &stats = ageStats[list];
+    const uint32_t age = now - slots[slot].updated;
+    stats.count++;
+    stats.ageSumMs += age;
+    if (age > stats.ageMaxMs)
+        stats.ageMaxMs = age > UINT16_MAX ? UINT16_MAX : age;
+    if ((int32_t)(now - slots[slot].deadline) > 0)
+        stats.late++;
+    return frameLen;
+}
 
+bool RXOTAConnector::GetNextPayload(uint8_t *nextPayloadSize, uint8_t *payloadData, const uint32_t now)
+{
 #if defined(PLATFORM_ESP32) && SOC_CPU_CORES_NUM > 1
     std::lock_guard<std::mutex> lock(mutex);
 #endif
+    // Earliest deadline first
+    uint8_t list = nextList();
+    if (list == TELEM_CLASS_COUNT)
+    {
+        *nextPayloadSize = 0;
+        return false;
+    }
 
-    // If we have a comparator or this is a 'broadcast' message we will look for a matching message in the queue and default to overwrite if we find one
-    if (comparator != comparators.end() || message->type < CRSF_FRAMETYPE_DEVICE_PING)
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+    uint8_t frameLen = popFrame(list, frame, now);
+    list = nextList();
+    // Only aggregate if the next frame fits too, a single frame goes as it is
+    if (!aggregate || list == TELEM_CLASS_COUNT ||
+        TLM_AGGREGATE_HEADER_LEN + TlmAggregatePackedLen(frame, frameLen) + TlmAggregatePackedMax(CRSF_FRAME_SIZE(slots[lists[list].head].data[CRSF_TELEMETRY_LENGTH_INDEX])) > CRSF_MAX_PACKET_LEN)
     {
-        for (uint16_t i = 0; i < messagePayloads.size();)
-        {
-            const auto size = messagePayloads[i];
-            // If the message at this point in the queue is not deleted, and it matches this comparator, then we check it
-            if (!IS_DEL(size) && messagePayloads[i + 1 + CRSF_TELEMETRY_TYPE_INDEX] == message->type)
-            {
-                const auto whatToDo = comparator == comparators.end() ? ACTION_OVERWRITE : comparator->second(message, messagePayloads, i + 1);
-                if (whatToDo != ACTION_NEXT)
-                {
-                    overwritePosition = i;
-                    action = whatToDo;
-                    break;
-                }
-            }
-            i += 1 + SIZE(size);
-        }
+        memcpy(payloadData, frame, frameLen);
+        *nextPayloadSize = frameLen;
+        return true;
     }
-    if (isPrioritised(message->type))
+
+    TlmAggregateBegin(payloadData);
+    uint8_t payloadLen = TlmAggregateAppend(payloadData, frame, frameLen);
+    do
     {
-        prioritizedCount++;
+        frameLen = popFrame(list, frame, now);
+        payloadLen = TlmAggregateAppend(payloadData, frame, frameLen);
+        list = nextList();
+    } while (list != TELEM_CLASS_COUNT &&
+        payloadLen + TlmAggregatePackedMax(CRSF_FRAME_SIZE(slots[lists[list].head].data[CRSF_TELEMETRY_LENGTH_INDEX])) <= CRSF_MAX_PACKET_LEN);
+    *nextPayloadSize = payloadLen;
+    return true;
+}
+
+void RXOTAConnector::forwardMessage(const crsf_header_t *message)
+{
+    queueMessage(message, millis());
+}
+
+void RXOTAConnector::queueMessage(const crsf_header_t *message, const uint32_t now)
+{
+    const uint8_t messageSize = CRSF_FRAME_SIZE(((uint8_t *)message)[CRSF_TELEMETRY_LENGTH_INDEX]);
+    if (messageSize > CRSF_MAX_PACKET_LEN)
+    {
+        return;
     }
+    const uint32_t key = dedupKey(message);
 
-    switch (action)
+#if defined(PLATFORM_ESP32) && SOC_CPU_CORES_NUM > 1
+    std::lock_guard<std::mutex> lock(mutex);
+#endif
+
+    uint8_t slot = key ? findSlot(key) : TELEMETRY_QUEUE_NONE;
+    if (slot == TELEMETRY_QUEUE_NONE)
     {
-    case ACTION_IGNORE:
-        break;
-    case ACTION_OVERWRITE:
-        // Check again because our initial check was performed without locking
-        if (!IS_DEL(messagePayloads[overwritePosition]))
+        // If there's NOT a free slot for this message, drop the oldest of the lowest priority
+        if (freeHead == TELEMETRY_QUEUE_NONE)
         {
-            if (messagePayloads[overwritePosition] >= messageSize)
-            {
-                for (uint16_t i = 0; i < messageSize; i++)
-                {
-                    messagePayloads.set(overwritePosition + i + 1, ((uint8_t *)message)[i]);
-                }
-                break;
-            }
-            // Mark the current queued entry as deleted
-            messagePayloads.set(overwritePosition, SET_DEL(messagePayloads[overwritePosition]));
+            uint8_t list = TELEM_CLASS_COUNT - 1;
+            while (lists[list].head == TELEMETRY_QUEUE_NONE)
+                list--;
+            popSlot(list);
         }
-        // fallthrough to APPEND
-    default:
-        // If there's NOT enough room on the FIFO for this message, pop until there is
-        while (!messagePayloads.available(messageSize + 1))
+        const telemetryClass_e cls = classOf(message->type);
+        slot = freeHead;
+        freeHead = slots[slot].next;
+        slots[slot].key = key;
+        slots[slot].deadline = now + telemetryBudgetMs[cls];
+        if (key)
         {
-            const uint8_t sz = SIZE(messagePayloads.pop());
-            messagePayloads.skip(sz);
+            indexInsert(key, slot);
         }
-        messagePayloads.push(messageSize);
-        messagePayloads.pushBytes((uint8_t *)message, messageSize);
+        pushSlot(cls, slot);
     }
+    slots[slot].updated = now;
+    memcpy(slots[slot].data, message, messageSize);
 }
@@ -1,14 +1,26 @@
 #ifndef RX_OTA_CONNECTOR_H
 #define RX_OTA_CONNECTOR_H
 #include "CRSFConnector.h"
-#include "FIFO.h"
+#include "TelemetryCodec.h"
+#include "targets.h"
 
 #if defined(PLATFORM_ESP32) && SOC_CPU_CORES_NUM > 1
 #include <mutex>
 #endif
 
-#define TELEMETRY_FIFO_SIZE 512
-typedef FIFO<TELEMETRY_FIFO_SIZE> TelemetryFifo;
+// Number of frames which can be queued for the downlink, each slot holds a whole CRSF frame (80 bytes).
+// Broadcast sensors take a slot per frame type (and source), about 12 with a full set of FC telemetry, and
+// the rest is for replies in flight. The ESP8285 is short of RAM, so it gets 8 slots, about the size of
+// the 512 byte FIFO the queue replaced, and relies more on dropping the oldest low priority frames
+#if defined(PLATFORM_ESP8266)
+#define TELEMETRY_QUEUE_SLOTS 8
+#else
+#define TELEMETRY_QUEUE_SLOTS 16
+#endif
+// Size of the hash index from dedup key to slot, a power of 2 larger than the slot count
+#define TELEMETRY_QUEUE_INDEX_BITS 5
+#define TELEMETRY_QUEUE_INDEX_SIZE (1 << TELEMETRY_QUEUE_INDEX_BITS)
+#define TELEMETRY_QUEUE_NONE 0xFF
 
 enum CustomTelemSubTypeID : uint8_t {
     CRSF_AP_CUSTOM_TELEM_SINGLE_PACKET_PASSTHROUGH = 0xF0,
@@ -16,19 +28,98 @@ enum CustomTelemSubTypeID : uint8_t {
     CRSF_AP_CUSTOM_TELEM_MULTI_PACKET_PASSTHROUGH = 0xF2,
 };
 
+/**
+ * Frame types with the same latency budget share a class, in order of priority
+ */
+typedef enum : uint8_t {
+    TELEM_CLASS_PARAM,      // device, parameter, command and MSP replies
+    TELEM_CLASS_LINK,       // link statistics
+    TELEM_CLASS_ATTITUDE,   // attitude, vario, baro altitude, airspeed
+    TELEM_CLASS_GPS,
+    TELEM_CLASS_BATTERY,    // battery sensor and cells
+    TELEM_CLASS_SENSOR,     // flight mode, RPM, temperature
+    TELEM_CLASS_OTHER,      // passthrough, status text, anything else
+    TELEM_CLASS_COUNT
+} telemetryClass_e;
+
+typedef struct {
+    uint32_t count;     // frames sent since the last resetAgeStats()
+    uint32_t ageSumMs;  // age of the data in each frame when it was sent
+    uint16_t ageMaxMs;
+    uint16_t late;      // frames sent after their deadline
+} TelemetryAgeStats_s;
+
+/**
+ * Queues the frames to be sent to the TX as downlink telemetry, and picks the next one to send
+ * by earliest deadline.
+ *
+ * Every frame takes one slot, and slots are linked into one list per telemetryClass_e. A frame's
+ * deadline is when it was first queued plus its class' latency budget, so each list is already
+ * in deadline order and only the heads need comparing, ties going to the higher priority class.
+ * Frames which only need their latest copy sent, like broadcast sensors or a device's info, have
+ * a dedup key of their type and source/destination and are found through a small hash index, so
+ * a newer copy overwrites the queued one in place and keeps its deadline.
+ *
+ * If every slot is in use, the oldest frame of the lowest priority class is dropped to make room.
+ * The age of the data when each frame is sent is recorded per class.
+ */
 class RXOTAConnector : public CRSFConnector {
 public:
     RXOTAConnector();
     void forwardMessage(const crsf_header_t *message) override;
+    void queueMessage(const crsf_header_t *message, uint32_t now);
+
+    bool GetNextPayload(uint8_t* nextPayloadSize, uint8_t *payloadData, uint32_t now);
+    bool GetNextPayload(uint8_t* nextPayloadSize, uint8_t *payloadData) { return GetNextPayload(nextPayloadSize, payloadData, millis()); }
+    uint8_t GetFifoFullPct() const { return slotsUsed * 100 / TELEMETRY_QUEUE_SLOTS; }
+
+    // Code each frame with the codec as it is taken from the queue, nullptr to send them plain
+    void setCodec(TelemetryCodec *telemetryCodec) { codec = telemetryCodec; }
+    // Pack as many queued frames as fit into each payload, see TelemetryAggregate.h
+    void setAggregate(bool enable) { aggregate = enable; }
 
-    bool GetNextPayload(uint8_t* nextPayloadSize, uint8_t *payloadData);
-    uint8_t GetFifoFullPct() const { return (TELEMETRY_FIFO_SIZE - messagePayloads.free()) * 100 / TELEMETRY_FIFO_SIZE; }
+    static telemetryClass_e classOf(crsf_frame_type_e frameType);
+    static uint16_t classBudgetMs(telemetryClass_e telemetryClass);
+    const TelemetryAgeStats_s &getAgeStats(telemetryClass_e telemetryClass) const { return ageStats[telemetryClass]; }
+    void resetAgeStats();
 
 protected:
-    TelemetryFifo messagePayloads;
-    uint8_t prioritizedCount = 0;
+    // Number of frames queued
+    uint8_t queuedCount() const { return slotsUsed; }
+    // Drop every queued frame
+    void clearQueue();
 
 private:
+    typedef struct {
+        uint32_t key;       // 0 if the frame is never overwritten
+        uint32_t deadline;  // ms
+        uint32_t updated;   // ms, when the data was last written
+        uint8_t next;       // next slot in the same list
+        uint8_t data[CRSF_MAX_PACKET_LEN];
+    } slot_t;
+
+    typedef struct {
+        uint8_t head;
+        uint8_t tail;
+    } list_t;
+
+    slot_t slots[TELEMETRY_QUEUE_SLOTS];
+    list_t lists[TELEM_CLASS_COUNT];
+    uint8_t freeHead;
+    uint8_t slotsUsed;
+    uint8_t index[TELEMETRY_QUEUE_INDEX_SIZE];
+    TelemetryAgeStats_s ageStats[TELEM_CLASS_COUNT];
+    TelemetryCodec *codec = nullptr;
+    bool aggregate = false;
+
+    uint8_t nextList() const;
+    uint8_t popFrame(uint8_t list, uint8_t *frame, uint32_t now);
+    uint8_t popSlot(uint8_t list);
+    void pushSlot(uint8_t list, uint8_t slot);
+    uint8_t findSlot(uint32_t key) const;
+    void indexInsert(uint32_t key, uint8_t slot);
+    void indexRemove(uint32_t key);
+
 #if defined(PLATFORM_ESP32) && SOC_CPU_CORES_NUM > 1
     std::mutex mutex;
 #endif
@@ -17,6 +17,7 @@ static int start()
 }
 
 device_t RXLUA_device = {
+  .name = "RXLUA",
   .initialize = nullptr,
   .start = start,
   .event = event,
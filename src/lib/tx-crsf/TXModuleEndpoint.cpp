@@ -59,6 +59,23 @@ void TXModuleEndpoint::handleMessage(const crsf_header_t *message)
 #endif
         ModelUpdateReq();
     }
+#if defined(FHSS_ADAPTIVE)
+    else if (packetType == CRSF_FRAMETYPE_COMMAND
+        && extMessage->frame_size >= CRSF_EXT_FRAME_SIZE(3 + FHSS_BLACKLIST_BYTES)
+        && extMessage->payload[0] == CRSF_COMMAND_SUBCMD_RX
+        && extMessage->payload[1] == CRSF_COMMAND_SUBCMD_RX_FHSS_BLACKLIST)
+    {
+        // The RX only uses the new blacklist once the SYNC packets carry its epoch, so
+        // anything which differs from the active one is applied (including after a reconnect)
+        const uint8_t epoch = extMessage->payload[2];
+        const uint8_t *bitmap = &extMessage->payload[3];
+        if (epoch != FHSSblacklistEpoch || memcmp(bitmap, FHSSblacklist, FHSS_BLACKLIST_BYTES) != 0)
+        {
+            DBGLN("FHSS blacklist epoch %u", epoch);
+            FHSSqueueBlacklist(bitmap, epoch);
+        }
+    }
+#endif
     else if (packetType == CRSF_FRAMETYPE_DEVICE_PING
         || packetType == CRSF_FRAMETYPE_PARAMETER_READ
         || packetType == CRSF_FRAMETYPE_PARAMETER_WRITE)
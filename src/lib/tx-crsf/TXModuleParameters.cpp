@@ -56,8 +56,8 @@ static char vtxFolderDynamicName[] = "VTX Admin (OFF:C:1 Aux11 )";
 static char modelMatchUnit[] = " (ID: 00)";
 static char tlmBandwidth[] = " (xxxxxbps)";
 static constexpr char folderNameSeparator[2] = {' ',':'};
-static constexpr char tlmRatios[] = "Std;Off;1:128;1:64;1:32;1:16;1:8;1:4;1:2;Race";
-static constexpr char tlmRatiosMav[] = ";;;;;;;;1:2;";
+static constexpr char tlmRatios[] = "Std;Off;1:128;1:64;1:32;1:16;1:8;1:4;1:2;Race;Auto";
+static constexpr char tlmRatiosMav[] = ";;;;;;;;1:2;;";
 static constexpr char switchmodeOpts4ch[] = "Wide;Hybrid";
 static constexpr char switchmodeOpts4chMav[] = ";Hybrid";
 static constexpr char switchmodeOpts8ch[] = "8ch;16ch Rate/2;12ch Mixed";
@@ -408,12 +408,12 @@ void TXModuleEndpoint::updateModelID() {
 void TXModuleEndpoint::updateTlmBandwidth()
 {
   const auto eRatio = (expresslrs_tlm_ratio_e)config.GetTlm();
-  // TLM_RATIO_STD / TLM_RATIO_DISARMED
-  if (eRatio == TLM_RATIO_STD || eRatio == TLM_RATIO_DISARMED)
+  // TLM_RATIO_STD / TLM_RATIO_DISARMED / TLM_RATIO_AUTO
+  if (eRatio == TLM_RATIO_STD || eRatio == TLM_RATIO_DISARMED || eRatio == TLM_RATIO_AUTO)
   {
-    // For Standard ratio, display the ratio instead of bps
+    // For Standard ratio, display the ratio instead of bps, Auto shows the one in use
     strcpy(tlmBandwidth, " (1:");
-    const uint8_t ratioDiv = TLMratioEnumToValue(ExpressLRS_currAirRate_Modparams->TLMinterval);
+    const uint8_t ratioDiv = eRatio == TLM_RATIO_AUTO ? ExpressLRS_currTlmDenom : TLMratioEnumToValue(ExpressLRS_currAirRate_Modparams->TLMinterval);
     itoa(ratioDiv, &tlmBandwidth[4], 10);
     strcat(tlmBandwidth, ")");
   }
@@ -704,7 +704,7 @@ void TXModuleEndpoint::SetAntennaMode(uint8_t idx)
 void TXModuleEndpoint::SetTlmRatio(uint8_t idx)
 {
   const auto eRatio = (expresslrs_tlm_ratio_e)idx;
-  if (eRatio <= TLM_RATIO_DISARMED)
+  if (eRatio <= TLM_RATIO_AUTO)
   {
     const bool isMavlinkMode = config.GetLinkMode() == TX_MAVLINK_MODE;
     // Don't allow TLM ratio changes if using AIRPORT or Mavlink
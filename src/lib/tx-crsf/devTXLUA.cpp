@@ -21,6 +21,7 @@ static int start()
 }
 
 device_t TXLUA_device = {
+  .name = "TXLUA",
   .initialize = nullptr,
   .start = start,
   .event = event,
@@ -6,7 +6,7 @@
 ---- # License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html               #
 ---- #                                                                       #
 ---- #########################################################################
-local EXITVER = "-- EXIT (Lua r16) --"
+local EXITVER = "-- EXIT (Lua r17) --"
 local deviceId = 0xEE
 local handsetId = 0xEF
 local deviceName = nil
@@ -29,6 +29,8 @@ local currentFolderId = nil
 local commandRunningIndicator = 1
 local expectChunksRemain = -1
 local deviceIsELRS_TX = nil
+local paramChanges = nil -- device answers reads of the parameters changed since paramGeneration
+local paramGeneration = nil
 local linkstatTimeout = 100
 local titleShowWarn = nil
 local titleShowWarnTimeout = 100
@@ -69,6 +71,11 @@ local function reloadAllField()
   for fieldId = fields_count, 1, -1 do
     loadQ[#loadQ+1] = fieldId
   end
+  -- Ask for the generation first, the fields loaded after it are current to it
+  paramGeneration = nil
+  if paramChanges then
+    loadQ[#loadQ+1] = 0xFF
+  end
 end
 
 local function getField(line)
@@ -168,6 +175,15 @@ local function fieldGetStrOrOpts(data, offset, last, isOpts)
   return (r or opt), offset, vcnt, collectgarbage("collect")
 end
 
+local function loadQRemove(id)
+  for i = #loadQ, 1, -1 do
+    if loadQ[i] == id then
+      table.remove(loadQ, i)
+      return true
+    end
+  end
+end
+
 local function getDevice(id)
   for _, device in ipairs(devices) do
     if device.id == id then
@@ -383,6 +399,7 @@ local function changeDeviceId(devId) --change to selected device ID
   deviceName = device.name
   fields_count = device.fldcnt
   deviceIsELRS_TX = device.isElrs and devId == 0xEE or nil -- ELRS and ID is TX module
+  paramChanges = device.isElrs and device.paramVer >= 1 or nil
   handsetId = deviceIsELRS_TX and 0xEF or 0xEA -- Address ELRS_LUA vs RADIO_TRANSMITTER
 
   allocateFields()
@@ -403,6 +420,7 @@ local function parseDeviceInfoMessage(data)
   end
   device.name = newName
   device.fldcnt = data[offset + 12]
+  device.paramVer = data[offset + 13] or 0
   device.isElrs = fieldGetValue(data, offset, 4) == 0x454C5253 -- SerialNumber = 'E L R S'
 
   if deviceId == id then
@@ -434,13 +452,63 @@ local functions = {
   { load=nil, save=fieldFolderDeviceOpen, display=fieldFolderDisplay }, --17 deviceFOLDER(16)
 }
 
+local function loadField(field, fieldId, data, offset)
+  if #data > (offset + 2) then
+    field.id = fieldId
+    field.parent = (data[offset] ~= 0) and data[offset] or nil
+    field.type = bit32.band(data[offset+1], 0x7f)
+    field.hidden = bit32.btest(data[offset+1], 0x80) or nil
+    field.name, offset = fieldGetStrOrOpts(data, offset+2, field.name)
+    if functions[field.type+1].load then
+      functions[field.type+1].load(field, data, offset)
+    end
+    if field.min == 0 then field.min = nil end
+    if field.max == 0 then field.max = nil end
+  end
+end
+
+local function parseParameterChanges(data)
+  -- The device's generation, then the ids changed since the one asked for, ending in 0xFF
+  loadQ[#loadQ] = nil
+  local known = paramGeneration
+  paramGeneration = data[5]
+  -- Only the generation is wanted on a full load
+  if known == nil then return end
+  -- Too many changes to list
+  if data[6] == 0xFE then
+    reloadAllField()
+    return
+  end
+  local offset = 6
+  while data[offset] and data[offset] ~= 0xFF do
+    local id = data[offset]
+    if fields[id] then
+      fields[id].nc = true -- the options may have changed too
+      if fields[id].type == 11 then
+        fields[id].name = nil -- folder names show their contents
+      end
+      loadQRemove(id)
+      loadQ[#loadQ+1] = id
+    end
+    offset = offset + 1
+  end
+end
+
 local function parseParameterInfoMessage(data)
   local fieldId = (fieldPopup and fieldPopup.id) or loadQ[#loadQ]
   if data[2] ~= deviceId or data[3] ~= fieldId then
+    -- Changed entries are sent straight after the list of changes, take any which are still queued
+    if data[2] == deviceId and data[3] ~= 0xFF and data[4] == 0 and fields[data[3]] and loadQRemove(data[3]) then
+      loadField(fields[data[3]], data[3], data, 5)
+      return deviceId ~= 0xEE or #loadQ == 0
+    end
     fieldData = nil
     fieldChunk = 0
     return
   end
+  if fieldId == 0xFF then
+    return parseParameterChanges(data)
+  end
   local field = fields[fieldId]
   local chunksRemain = data[4]
   -- If no field or the chunksremain changed when we have data, don't continue
@@ -469,19 +537,7 @@ local function parseParameterInfoMessage(data)
   else
     -- Field data stream is now complete, process into a field
     loadQ[#loadQ] = nil
-
-    if #fieldData > (offset + 2) then
-      field.id = fieldId
-      field.parent = (fieldData[offset] ~= 0) and fieldData[offset] or nil
-      field.type = bit32.band(fieldData[offset+1], 0x7f)
-      field.hidden = bit32.btest(fieldData[offset+1], 0x80) or nil
-      field.name, offset = fieldGetStrOrOpts(fieldData, offset+2, field.name)
-      if functions[field.type+1].load then
-        functions[field.type+1].load(field, fieldData, offset)
-      end
-      if field.min == 0 then field.min = nil end
-      if field.max == 0 then field.max = nil end
-    end
+    loadField(field, fieldId, fieldData, offset)
 
     fieldChunk = 0
     fieldData = nil
@@ -571,7 +627,9 @@ local function refreshNext(skipPush)
     linkstatTimeout = time + 100
   elseif time > fieldTimeout and fields_count ~= 0 then
     if #loadQ > 0 then
-      crossfireTelemetryPush(0x2C, { deviceId, handsetId, loadQ[#loadQ], fieldChunk })
+      -- A read of the changes carries the generation they are since in place of the chunk
+      local fieldId = loadQ[#loadQ]
+      crossfireTelemetryPush(0x2C, { deviceId, handsetId, fieldId, fieldId == 0xFF and paramGeneration or fieldChunk })
       fieldTimeout = time + (deviceIsELRS_TX and 50 or 500) -- 0.5s for local / 5s for remote devices
     end
   end
@@ -615,7 +673,7 @@ local function lcd_title_color()
   end
   -- progress bar
   if #loadQ > 0 and fields_count > 0 then
-    local barW = (COL2-4) * (fields_count - #loadQ) / fields_count
+    local barW = (COL2-4) * math.max(fields_count - #loadQ, 0) / fields_count
     lcd.setColor(CUSTOM_COLOR, EBLUE)
     lcd.drawFilledRectangle(2, barTextSpacing/2+textSize, barW, barTextSpacing, CUSTOM_COLOR)
     lcd.setColor(CUSTOM_COLOR, WHITE)
@@ -634,7 +692,7 @@ local function lcd_title_bw()
 
   if #loadQ > 0 and fields_count > 0 then
     lcd.drawFilledRectangle(COL2, 0, LCD_W, barHeight, GREY_DEFAULT)
-    lcd.drawGauge(0, 0, COL2, barHeight, fields_count - #loadQ, fields_count, 0)
+    lcd.drawGauge(0, 0, COL2, barHeight, math.max(fields_count - #loadQ, 0), fields_count, 0)
   else
     lcd.drawFilledRectangle(0, 0, LCD_W, barHeight, GREY_DEFAULT)
     if titleShowWarn then
@@ -652,27 +710,35 @@ local function lcd_warn()
 end
 
 local function reloadRelatedFields(field)
-  -- Reload the parent folder to update the description
-  if field.parent then
-    loadQ[#loadQ+1] = field.parent
-    fields[field.parent].name = nil
-  end
+  if paramChanges and paramGeneration then
+    -- Reload this field, after whatever the device says changed along with it
+    loadQRemove(field.id)
+    loadQRemove(0xFF)
+    loadQ[#loadQ+1] = field.id
+    loadQ[#loadQ+1] = 0xFF
+  else
+    -- Reload the parent folder to update the description
+    if field.parent then
+      loadQ[#loadQ+1] = field.parent
+      fields[field.parent].name = nil
+    end
 
-  -- Reload all editable fields at the same level as well as the parent item
-  for fieldId = fields_count, 1, -1 do
-    -- Skip this field, will be added to end
-    local fldTest = fields[fieldId]
-    local fldType = fldTest.type or 99 -- type could be nil if still loading
-    if fieldId ~= field.id
-      and fldTest.parent == field.parent
-      and (fldType < 11 or fldType == 12) then -- ignores FOLDER/COMMAND/devices/EXIT
-      fldTest.nc = true -- "no cache" the options
-      loadQ[#loadQ+1] = fieldId
+    -- Reload all editable fields at the same level as well as the parent item
+    for fieldId = fields_count, 1, -1 do
+      -- Skip this field, will be added to end
+      local fldTest = fields[fieldId]
+      local fldType = fldTest.type or 99 -- type could be nil if still loading
+      if fieldId ~= field.id
+        and fldTest.parent == field.parent
+        and (fldType < 11 or fldType == 12) then -- ignores FOLDER/COMMAND/devices/EXIT
+        fldTest.nc = true -- "no cache" the options
+        loadQ[#loadQ+1] = fieldId
+      end
     end
-  end
 
-  -- Reload this field
-  loadQ[#loadQ+1] = field.id
+    -- Reload this field
+    loadQ[#loadQ+1] = field.id
+  end
   -- with a short delay to allow the module EEPROM to commit
   fieldTimeout = getTime() + 20
   -- Also push the next bad/good update further out
@@ -11,27 +11,30 @@ uint32_t SerialAirPort::sendRCFrame(bool frameAvailable, bool frameMissed, uint3
 
 int SerialAirPort::getMaxSerialReadSize()
 {
-    return AP_MAX_BUF_LEN - apInputBuffer.size();
+    return apInputBuffer.free();
 }
 
 void SerialAirPort::processBytes(uint8_t *bytes, u_int16_t size)
 {
     if (connectionState == connected)
     {
-        apInputBuffer.atomicPushBytes(bytes, size);
+        apInputBuffer.pushBytes(bytes, size);
     }
 }
 
 void SerialAirPort::sendQueuedData(uint32_t maxBytesToSend)
 {
-    auto size = apOutputBuffer.size();
-    if (size != 0)
+    // Written straight from the ring, in two pieces if the data wraps
+    const uint8_t *data;
+    for (uint8_t piece = 0; piece < 2; piece++)
     {
-        uint8_t buf[size];
-        apOutputBuffer.lock();
-        apOutputBuffer.popBytes(buf, size);
-        apOutputBuffer.unlock();
-        _outputPort->write(buf, size);
+        const auto size = apOutputBuffer.peekSpan(data);
+        if (size == 0)
+        {
+            break;
+        }
+        _outputPort->write(data, size);
+        apOutputBuffer.commitPop(size);
     }
 }
 #endif
@@ -2,7 +2,7 @@
 
 #include "OTA.h"
 #include "SerialIO.h"
-#include "FIFO.h"
+#include "SPSCRing.h"
 
 class SerialAirPort final : public SerialIO {
 public:
@@ -14,8 +14,9 @@ public:
     int getMaxSerialReadSize() override;
     void sendQueuedData(uint32_t maxBytesToSend) override;
 
-    FIFO<AP_MAX_BUF_LEN> apInputBuffer;
-    FIFO<AP_MAX_BUF_LEN> apOutputBuffer;
+    // Filled from the serial port and emptied by the radio ISR, and the other way around
+    SPSCRing<AP_MAX_BUF_LEN> apInputBuffer;
+    SPSCRing<AP_MAX_BUF_LEN> apOutputBuffer;
 
     bool isTlmQueued() const { return apInputBuffer.size() > 0; }
 private:
@@ -5,12 +5,12 @@
 
 class SerialSUMD final : public SerialIO {
 public:
-    explicit SerialSUMD(Stream &out, Stream &in) : SerialIO(&out, &in) { crc2Byte.init(16, 0x1021); }
+    explicit SerialSUMD(Stream &out, Stream &in) : SerialIO(&out, &in) {}
     ~SerialSUMD() override = default;
 
     uint32_t sendRCFrame(bool frameAvailable, bool frameMissed, uint32_t *channelData) override;
 
 private:
-    Crc2Byte crc2Byte {};
+    Crc2Byte<16, 0x1021> crc2Byte {};
     void processBytes(uint8_t *bytes, uint16_t size) override {};
 };
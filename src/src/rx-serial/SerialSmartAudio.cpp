@@ -17,7 +17,7 @@
 // band/channel or frequency in MHz (3 bits for the band and 3 bits for the channel)
 #define VTXCOMMON_MSP_BANDCHAN_CHKVAL ((uint16_t)((7 << 3) + 7))
 
-GENERIC_CRC8 crc(SMARTAUDIO_CRC_POLY);
+GENERIC_CRC8<SMARTAUDIO_CRC_POLY> crc;
 
 SerialSmartAudio::SerialSmartAudio(Stream &out, Stream &in, int8_t serial1TXpin) : SerialIO(&out, &in)
 {
@@ -295,6 +295,7 @@ static int timeout1()
 #endif
 
 device_t Serial0_device = {
+    .name = "Serial0",
     .initialize = nullptr,
     .start = start,
     .event = event0,
@@ -304,6 +305,7 @@ device_t Serial0_device = {
 
 #if defined(PLATFORM_ESP32)
 device_t Serial1_device = {
+    .name = "Serial1",
     .initialize = nullptr,
     .start = start,
     .event = event1,
@@ -3,12 +3,16 @@
 #include "rxtx_common.h"
 
 #include "crc.h"
+#include "OTARecovery.h"
 #include "stubborn_sender.h"
 #include "stubborn_receiver.h"
+#include "TelemetryCodec.h"
 
 #include "CRSFParameters.h"
+#include "FHSSquality.h"
 #include "MeanAccumulator.h"
 #include "PFD.h"
+#include "PhaseLock.h"
 #include "dynpower.h"
 #include "freqTable.h"
 #include "msp.h"
@@ -98,7 +102,6 @@ uint8_t antenna = 0;    // which antenna is currently in use
 uint8_t geminiMode = 0;
 
 PFD PFDloop;
-Crc2Byte ota_crc;
 ELRS_EEPROM eeprom;
 RxConfig config;
 
@@ -134,6 +137,9 @@ SerialIO *serialIO = nullptr;
 
 StubbornSender DataDlSender;
 uint8_t DataDlBuffer[CRSF_MAX_PACKET_LEN];
+#if defined(RX_TELEMETRY_DELTA)
+static TelemetryCodec telemetryCodec;
+#endif
 static uint8_t telemetryBurstCount;
 static uint8_t telemetryBurstMax;
 
@@ -143,8 +149,7 @@ uint8_t DataUlBuffer[ELRS_DATA_UL_BUFFER];
 static uint8_t NextTelemetryType = PACKET_TYPE_LINKSTATS;
 static bool telemBurstValid;
 /// PFD Filters ////////////////
-LPF LPF_Offset(2);
-LPF LPF_OffsetDx(4);
+PhaseLock phaseLock;
 
 /// LQ/RSSI/SNR Calculation //////////
 LQCALC<100> LQCalc;
@@ -158,7 +163,6 @@ static uint8_t scanIndex;
 uint8_t ExpressLRS_nextAirRateIndex;
 int8_t SwitchModePending;
 
-int32_t PfdPrevRawOffset;
 RXtimerState_e RXtimerState;
 uint32_t GotConnectionMillis = 0;
 const uint32_t ConsiderConnGoodMillis = 1000; // minimum time before we can consider a connection to be 'good'
@@ -181,6 +185,21 @@ int16_t RFnoiseFloor; //measurement of the current RF noise floor
 #if defined(DEBUG_RX_SCOREBOARD)
 static bool lastPacketCrcError;
 #endif
+#if defined(RX_OTA_DVDA_COMBINING)
+static OtaPacketCombiner dvdaCombiner;  // failed copies of the current DVDA frame
+static uint32_t dvdaRescued;  // DVDA frames rebuilt from failed copies since the last signal stats
+#endif
+#if defined(FHSS_ADAPTIVE)
+static FHSSChannelQuality fhssQuality;
+static uint8_t fhssProposal[FHSS_BLACKLIST_BYTES];  // last blacklist sent to the TX
+static uint8_t fhssProposalEpoch;                   // epoch fhssProposal was sent with, == FHSSblacklistEpoch once active
+static uint32_t fhssProposalSentMs;
+static bool fhssLastSlotTlm;                        // the slot ending at the next tock was used for telemetry
+#endif
+#if defined(RX_OTA_GEMINI_COMBINING)
+static WORD_ALIGNED_ATTR OTA_Packet_s geminiFailedPkt;                // failed copy from the other radio, current nonce only
+static SX12XX_Radio_Number_t geminiFailedRadio = SX12XX_Radio_NONE;  // radio geminiFailedPkt came from, NONE if empty
+#endif
 ///////////////////////////////////////////////////////////////
 
 /// Variables for Sync Behaviour ////
@@ -300,6 +319,19 @@ void ICACHE_RAM_ATTR getRFlinkInfo()
     #endif
 }
 
+/**
+ * @brief Use the uplink data window the TX asks for in the sync packet. Bit 1 of the uplink ack
+ * goes in the top bit of the downlink packageIndex, which halves the downlink package count
+ */
+static void ICACHE_RAM_ATTR setDataUlWindowed(bool windowed)
+{
+    DataUlReceiver.setWindow(windowed ? ELRS_DATA_UL_WINDOW : 1);
+    if (windowed)
+        DataDlSender.setMaxPackageIndex((OtaIsFullRes ? ELRS8_DATA_DL_WINDOW_ACK_BIT : ELRS4_DATA_DL_WINDOW_ACK_BIT) - 1);
+    else
+        DataDlSender.setMaxPackageIndex(OtaIsFullRes ? ELRS8_DATA_DL_MAX_PACKAGES : ELRS4_DATA_DL_MAX_PACKAGES);
+}
+
 void SetRFLinkRate(uint8_t index, bool bindMode) // Set speed of RF link
 {
     expresslrs_mod_settings_s *const ModParams = get_elrs_airRateConfig(index);
@@ -314,6 +346,7 @@ void SetRFLinkRate(uint8_t index, bool bindMode) // Set speed of RF link
 #endif
 
     hwTimer::updateInterval(interval);
+    phaseLock.setInterval(interval);
 
     FHSSusePrimaryFreqBand = !(ModParams->radio_type == RADIO_TYPE_LR1121_LORA_2G4) && !(ModParams->radio_type == RADIO_TYPE_LR1121_GFSK_2G4);
     FHSSuseDualBand = ModParams->radio_type == RADIO_TYPE_LR1121_LORA_DUAL;
@@ -348,7 +381,7 @@ void SetRFLinkRate(uint8_t index, bool bindMode) // Set speed of RF link
 
     OtaUpdateSerializers(smWideOr8ch, ModParams->PayloadLength);
     DataUlReceiver.setMaxPackageIndex(ELRS_MSP_MAX_PACKAGES);
-    DataDlSender.setMaxPackageIndex(OtaIsFullRes ? ELRS8_DATA_DL_MAX_PACKAGES : ELRS4_DATA_DL_MAX_PACKAGES);
+    setDataUlWindowed(DataUlReceiver.getWindow() > 1);
 
     // Wait for (11/10) 110% of time it takes to cycle through all freqs in FHSS table (in ms)
     cycleInterval = ((uint32_t)11U * FHSSgetChannelCount() * ModParams->FHSShopInterval * interval) / (10U * 1000U);
@@ -430,12 +463,14 @@ void ICACHE_RAM_ATTR LinkStatsToOta(OTA_LinkStats_s * const ls)
 #define GenerateOtaDataDl(ota, member, ls)  {\
    const size_t dataLen = sizeof(otaPkt.ota.member.payload); \
    otaPkt.ota.data_dl.stubbornAck = DataUlReceiver.GetCurrentConfirm(); \
+   const uint8_t windowAck = (DataUlReceiver.getWindow() > 1 && (DataUlReceiver.GetCurrentAck() & 2)) \
+        ? (OtaIsFullRes ? ELRS8_DATA_DL_WINDOW_ACK_BIT : ELRS4_DATA_DL_WINDOW_ACK_BIT) : 0; \
    if (geminiMode) \
     { \
         sendGeminiBuffer = true; \
         WORD_ALIGNED_ATTR uint8_t geminiSpanBuffer[2 * dataLen] = {0}; \
 \
-        otaPkt.ota.data_dl.packageIndex = DataDlSender.GetCurrentPayload(geminiSpanBuffer, sizeof(geminiSpanBuffer)); \
+        otaPkt.ota.data_dl.packageIndex = DataDlSender.GetCurrentPayload(geminiSpanBuffer, sizeof(geminiSpanBuffer)) | windowAck; \
         memcpy(otaPkt.ota.member.payload, geminiSpanBuffer, dataLen); \
         if (ls) LinkStatsToOta(ls); \
 \
@@ -444,7 +479,7 @@ void ICACHE_RAM_ATTR LinkStatsToOta(OTA_LinkStats_s * const ls)
     } \
     else \
     { \
-        otaPkt.ota.data_dl.packageIndex = DataDlSender.GetCurrentPayload(otaPkt.ota.member.payload, dataLen); \
+        otaPkt.ota.data_dl.packageIndex = DataDlSender.GetCurrentPayload(otaPkt.ota.member.payload, dataLen) | windowAck; \
         if (ls) LinkStatsToOta(ls); \
     } \
 }
@@ -608,38 +643,11 @@ void ICACHE_RAM_ATTR updatePhaseLock()
 {
     if (connectionState != disconnected && PFDloop.hasResult())
     {
-        int32_t RawOffset = PFDloop.calcResult();
-        int32_t Offset = LPF_Offset.update(RawOffset);
-        int32_t OffsetDx = LPF_OffsetDx.update(RawOffset - PfdPrevRawOffset);
-        PfdPrevRawOffset = RawOffset;
-
-        if (RXtimerState == tim_locked)
-        {
-            // limit rate of freq offset adjustment
-            if (OtaNonce % 8 == 0)
-            {
-                if (Offset > 0)
-                {
-                    hwTimer::incFreqOffset();
-                }
-                else if (Offset < 0)
-                {
-                    hwTimer::decFreqOffset();
-                }
-            }
-        }
+        phaseLock.update(PFDloop.calcResult(), connectionState == connected);
+        hwTimer::setFreqOffset(phaseLock.getFreqOffset());
+        hwTimer::phaseShift(phaseLock.getPhaseShift());
 
-        if (connectionState != connected)
-        {
-            hwTimer::phaseShift(RawOffset >> 1);
-        }
-        else
-        {
-            hwTimer::phaseShift(Offset >> 2);
-        }
-
-        DBGVLN("%d:%d:%d:%d:%d", Offset, RawOffset, OffsetDx, hwTimer::getFreqOffset(), uplinkLQ);
-        UNUSED(OffsetDx); // complier warning if no debug
+        DBGVLN("%d:%d:%d:%d:%d", phaseLock.getOffset(), phaseLock.getRawOffset(), phaseLock.getOffsetDx(), hwTimer::getFreqOffset(), uplinkLQ);
     }
 
     PFDloop.reset();
@@ -754,12 +762,40 @@ static void ICACHE_RAM_ATTR updateDiversity()
     }
 }
 
+#if defined(RX_OTA_DVDA_COMBINING)
+static void ICACHE_RAM_ATTR ProcessRfPacket_RC(OTA_Packet_s const * const otaPktPtr);
+
+/**
+ * If every copy of this DVDA frame failed CRC, try to rebuild it from the failed copies
+ **/
+static void ICACHE_RAM_ATTR ProcessDvdaCombined()
+{
+    WORD_ALIGNED_ATTR OTA_Packet_s otaPkt;
+    uint8_t nonce;
+    if (!LQCalcDVDA.currentIsSet() && dvdaCombiner.combine(&otaPkt, &nonce) && otaPkt.std.type == PACKET_TYPE_RCDATA)
+    {
+        // Unpack with the nonce of the copy it was rebuilt from, HybridWide uses it for the switch index
+        uint8_t const currentNonce = OtaNonce;
+        OtaNonce = nonce;
+        ProcessRfPacket_RC(&otaPkt);
+        OtaNonce = currentNonce;
+
+        if (LQCalcDVDA.currentIsSet())
+            dvdaRescued++;
+    }
+    dvdaCombiner.reset();
+}
+#endif
+
 void ICACHE_RAM_ATTR HWtimerCallbackTock()
 {
     PFDloop.intEvent(micros()); // our internal osc just fired
 
     if (ExpressLRS_currAirRate_Modparams->numOfSends > 1 && !(OtaNonce % ExpressLRS_currAirRate_Modparams->numOfSends))
     {
+        #if defined(RX_OTA_DVDA_COMBINING)
+        ProcessDvdaCombined();
+        #endif
         if (LQCalcDVDA.currentIsSet())
         {
             crsfRCFrameAvailable();
@@ -782,10 +818,24 @@ void ICACHE_RAM_ATTR HWtimerCallbackTock()
     // For any serial drivers that need to send on a regular cadence (i.e. CRSF to betaflight)
     sendImmediateRC();
 
+    #if defined(FHSS_ADAPTIVE)
+    // Score the channel of the slot which just ended, before hopping away from it
+    if (connectionState == connected && !fhssLastSlotTlm && FHSSusePrimaryFreqBand)
+    {
+        fhssQuality.update(FHSSgetChannel(FHSSgetCurrIndex()), LQCalc.currentIsSet(), Radio.LastPacketRSSI);
+    }
+    #endif
+
     OtaNonce++;
+    #if defined(RX_OTA_GEMINI_COMBINING)
+    geminiFailedRadio = SX12XX_Radio_NONE;
+    #endif
     HandleFHSS();
     updateDiversity();
     bool tlmSent = HandleSendDataDl();
+    #if defined(FHSS_ADAPTIVE)
+    fhssLastSlotTlm = tlmSent;
+    #endif
     updatePhaseLock();
 
     #if defined(DEBUG_RX_SCOREBOARD)
@@ -806,14 +856,16 @@ void LostConnection(bool resumeRx)
     setConnectionState(disconnected); //set lost connection
     RXtimerState = tim_disconnected;
     hwTimer::resetFreqOffset();
-    PfdPrevRawOffset = 0;
+    phaseLock.reset();
     GotConnectionMillis = 0;
     uplinkLQ = 0;
     LQCalc.reset();
     LQCalcDVDA.reset();
-    LPF_Offset.init(0);
-    LPF_OffsetDx.init(0);
     alreadyTLMresp = false;
+#if defined(RX_TELEMETRY_DELTA)
+    // Start every frame type over with a keyframe once reconnected
+    telemetryCodec.reset();
+#endif
 
     if (!InBindingMode)
     {
@@ -829,6 +881,13 @@ void LostConnection(bool resumeRx)
             Radio.RXnb();
         }
     }
+
+#if defined(FHSS_ADAPTIVE)
+    // The TX drops its blacklist when it loses telemetry, start over from every channel
+    FHSSresetBlacklist();
+    fhssQuality.reset();
+    fhssProposalEpoch = 0;
+#endif
 }
 
 void ICACHE_RAM_ATTR TentativeConnection(unsigned long now)
@@ -838,8 +897,7 @@ void ICACHE_RAM_ATTR TentativeConnection(unsigned long now)
     connectionHasModelMatch = false;
     RXtimerState = tim_disconnected;
     DBGLN("tentative conn");
-    PfdPrevRawOffset = 0;
-    LPF_Offset.init(0);
+    phaseLock.restart();
     SnrMean.reset();
     RFmodeLastCycled = now; // give another 3 sec for lock to occur
 
@@ -1023,7 +1081,7 @@ static bool ICACHE_RAM_ATTR ProcessRfPacket_SYNC(uint32_t const now, OTA_Sync_s
     DBGW('s');
 #endif
 
-    if (otaSync->otaProtocol == TX_MAVLINK_MODE)
+    if ((otaSync->otaProtocol & OTA_PROTOCOL_LINK_MODE_MASK) == TX_MAVLINK_MODE)
     {
         config.SetSerialProtocol(PROTOCOL_MAVLINK);
     }
@@ -1045,6 +1103,8 @@ static bool ICACHE_RAM_ATTR ProcessRfPacket_SYNC(uint32_t const now, OTA_Sync_s
         config.SetAntennaMode(otaSync->geminiMode);
     }
 
+    setDataUlWindowed(otaSync->otaProtocol & OTA_PROTOCOL_WINDOWED_DATA);
+
     // Will change the packet air rate in loop() if this changes
     ExpressLRS_nextAirRateIndex = enumRatetoIndex((expresslrs_RFrates_e)otaSync->rfRateEnum);
     updateSwitchModePendingFromOta(otaSync->switchEncMode);
@@ -1059,6 +1119,14 @@ static bool ICACHE_RAM_ATTR ProcessRfPacket_SYNC(uint32_t const now, OTA_Sync_s
         telemBurstValid = false;
     }
 
+#if defined(FHSS_ADAPTIVE)
+    // The TX has switched to the blacklist we sent it, follow at the next hop
+    if (otaSync->fhssBlacklistEpoch == (fhssProposalEpoch & 1) && FHSSblacklistEpoch != fhssProposalEpoch)
+    {
+        FHSSqueueBlacklist(fhssProposal, fhssProposalEpoch);
+    }
+#endif
+
     // modelId = 0xff indicates modelMatch is disabled, the XOR does nothing in that case
     uint8_t modelXor = (~config.GetModelId()) & MODELMATCH_MASK;
     bool modelMatched = otaSync->UID5 == (UID[5] ^ modelXor);
@@ -1081,9 +1149,39 @@ static bool ICACHE_RAM_ATTR ProcessRfPacket_SYNC(uint32_t const now, OTA_Sync_s
     return false;
 }
 
+#if defined(RX_OTA_GEMINI_COMBINING)
+/**
+ * Each radio's copy of a packet arrives in its own RXdone, hold on to the first
+ * failed copy and when the other radio's copy also fails try to rebuild it from the pair
+ **/
+static bool ICACHE_RAM_ATTR ProcessGeminiCombined(OTA_Packet_s * const otaPktPtr)
+{
+    if (!isDualRadio())
+        return false;
+
+    SX12XX_Radio_Number_t const radio = Radio.GetProcessingPacketRadio();
+    if (geminiFailedRadio == SX12XX_Radio_NONE || geminiFailedRadio == radio)
+    {
+        geminiFailedPkt = *otaPktPtr;
+        geminiFailedRadio = radio;
+        return false;
+    }
+
+    geminiFailedRadio = SX12XX_Radio_NONE;
+    return OtaCombinePacketPair(otaPktPtr, &geminiFailedPkt);
+}
+#endif
+
 bool ICACHE_RAM_ATTR ProcessRFPacket(SX12xxDriverCommon::rx_status const status)
 {
-    if (status != SX12xxDriverCommon::SX12XX_RX_OK)
+#if (defined(RX_OTA_DVDA_COMBINING) || defined(RX_OTA_GEMINI_COMBINING)) && defined(RADIO_SX128X)
+    // The SX1280 driver reads FLRC packets which only failed the hardware CRC, they are recovered
+    // like a packet which failed the OTA CRC
+    bool const hwCrcFailed = status == SX12xxDriverCommon::SX12XX_RX_CRC_FAIL;
+#else
+    bool const hwCrcFailed = false;
+#endif
+    if (status != SX12xxDriverCommon::SX12XX_RX_OK && !hwCrcFailed)
     {
         DBGVLN("HW CRC error");
         #if defined(DEBUG_RX_SCOREBOARD)
@@ -1096,9 +1194,20 @@ bool ICACHE_RAM_ATTR ProcessRFPacket(SX12xxDriverCommon::rx_status const status)
     OTA_Packet_s * const otaPktPtr = (OTA_Packet_s * const)Radio.RXdataBuffer;
     OTA_Packet_s * const otaPktPtrSecond = (OTA_Packet_s * const)Radio.RXdataBufferSecond;
 
-    if (!OtaValidatePacketCrc(otaPktPtr))
+    bool crcValid = !hwCrcFailed && OtaValidatePacketCrc(otaPktPtr);
+#if defined(RX_OTA_CRC_CORRECTION)
+    crcValid = crcValid || OtaCorrectPacketCrc(otaPktPtr);
+#endif
+#if defined(RX_OTA_GEMINI_COMBINING)
+    crcValid = crcValid || ProcessGeminiCombined(otaPktPtr);
+#endif
+    if (!crcValid)
     {
         DBGVLN("CRC error");
+        #if defined(RX_OTA_DVDA_COMBINING)
+        if (ExpressLRS_currAirRate_Modparams->numOfSends > 1)
+            dvdaCombiner.add(otaPktPtr, OtaNonce);
+        #endif
         #if defined(DEBUG_RX_SCOREBOARD)
             lastPacketCrcError = true;
         #endif
@@ -1849,7 +1958,7 @@ static void debugRcvrLinkstats()
         uint8_t fhss = debugRcvrLinkstatsFhssIdx;
         // actually the previous packet's offset since the update happens in tick, and this will
         // fire right after packet reception (a little before tock)
-        int32_t pfd = PfdPrevRawOffset;
+        int32_t pfd = phaseLock.getRawOffset();
 
         // Use serial instead of DBG() because do not necessarily want all the debug in our logs
         char buf[50];
@@ -1863,12 +1972,50 @@ static void debugRcvrLinkstats()
 #endif
 }
 
+#if defined(FHSS_ADAPTIVE)
+/**
+ * Once a second, rebuild the blacklist from the channel stats and send it to the TX if it has
+ * changed. Only one blacklist is in flight at a time, resent until a SYNC confirms the TX has it
+ **/
+static void updateAdaptiveFhss(uint32_t now)
+{
+    if (connectionState != connected || !FHSSusePrimaryFreqBand || now - fhssProposalSentMs < 1000)
+    {
+        return;
+    }
+    fhssProposalSentMs = now;
+
+    if (FHSSblacklistEpoch == fhssProposalEpoch)
+    {
+        uint8_t bitmap[FHSS_BLACKLIST_BYTES];
+        uint8_t const count = fhssQuality.buildBlacklist(bitmap);
+        if (memcmp(bitmap, FHSSblacklist, sizeof(bitmap)) == 0)
+        {
+            return;
+        }
+        DBGLN("FHSS blacklist %u channels", count);
+        memcpy(fhssProposal, bitmap, sizeof(fhssProposal));
+        ++fhssProposalEpoch;
+    }
+
+    constexpr uint8_t payloadLen = 3 + FHSS_BLACKLIST_BYTES;
+    uint8_t frame[CRSF_EXT_FRAME_SIZE(payloadLen) + CRSF_FRAME_NOT_COUNTED_BYTES];
+    crsf_ext_header_t *header = (crsf_ext_header_t *)frame;
+    header->payload[0] = CRSF_COMMAND_SUBCMD_RX;
+    header->payload[1] = CRSF_COMMAND_SUBCMD_RX_FHSS_BLACKLIST;
+    header->payload[2] = fhssProposalEpoch;
+    memcpy(&header->payload[3], fhssProposal, FHSS_BLACKLIST_BYTES);
+    crsfRouter.SetExtendedHeaderAndCrc(header, CRSF_FRAMETYPE_COMMAND, CRSF_EXT_FRAME_SIZE(payloadLen), CRSF_ADDRESS_CRSF_TRANSMITTER, CRSF_ADDRESS_CRSF_RECEIVER);
+    otaConnector.forwardMessage((crsf_header_t *)frame);
+}
+#endif
+
 static void debugRcvrSignalStats(uint32_t now)
 {
 #if defined(DEBUG_RCVR_SIGNAL_STATS)
     static uint32_t lastReport = 0;
 
-    // log column header:  cnt1, rssi1, snr1, snr1_max, telem1, fail1, cnt2, rssi2, snr2, snr2_max, telem2, fail2, or, both
+    // log column header:  cnt1, rssi1, snr1, snr1_max, telem1, fail1, cnt2, rssi2, snr2, snr2_max, telem2, fail2, or, both, pfd_min, pfd_max, pfd_sd, corrected, paired, combined, dvda_rescued
     if(now - lastReport >= 1000 && connectionState == connected)
     {
         for (int i = 0 ; i < (isDualRadio()?2:1) ; i++)
@@ -1890,20 +2037,51 @@ static void debugRcvrSignalStats(uint32_t now)
         }
         if (isDualRadio())
         {
-            DBGLN("%d\t%d", Radio.irq_count_or, Radio.irq_count_both);
-        }
-        else
-        {
-            DBGLN("");
+            DBG("%d\t%d\t", Radio.irq_count_or, Radio.irq_count_both);
         }
+        PhaseLockStats_s const pfdStats = phaseLock.getStats();
+        DBG("%d\t%d\t%f\t", pfdStats.min, pfdStats.max, pfdStats.stdDev);
+        phaseLock.resetStats();
+        DBG("%u\t%u\t%u\t", OtaRecoveryStats.corrected, OtaRecoveryStats.paired, OtaRecoveryStats.combined);
+        #if defined(RX_OTA_DVDA_COMBINING)
+        DBGLN("%u", dvdaRescued);
+        dvdaRescued = 0;
+        #else
+        DBGLN("0");
+        #endif
         Radio.irq_count_or = 0;
         Radio.irq_count_both = 0;
+        OtaRecoveryStats.corrected = 0;
+        OtaRecoveryStats.paired = 0;
+        OtaRecoveryStats.combined = 0;
 
         lastReport = now;
     }
 #endif
 }
 
+static void debugTelemetryAge(uint32_t now)
+{
+#if defined(DEBUG_TELEMETRY_AGE)
+    static uint32_t lastReport = 0;
+
+    // log columns per telemetry class: sent, mean age ms, max age ms, late
+    if (now - lastReport >= 5000)
+    {
+        for (uint8_t cls = 0; cls < TELEM_CLASS_COUNT; cls++)
+        {
+            const TelemetryAgeStats_s &stats = otaConnector.getAgeStats((telemetryClass_e)cls);
+            DBG("%u\t%u\t%u\t%u\t", stats.count, stats.count ? stats.ageSumMs / stats.count : 0, stats.ageMaxMs, stats.late);
+        }
+        DBGLN("");
+        otaConnector.resetAgeStats();
+        lastReport = now;
+    }
+#else
+    UNUSED(now);
+#endif
+}
+
 static void updateSwitchMode()
 {
     // Negative value means waiting for confirm of the new switch mode while connected
@@ -2015,6 +2193,15 @@ void setup()
         }
         crsfRouter.addEndpoint(&crsfReceiver);
         crsfRouter.addConnector(&otaConnector);
+#if defined(CRSF_CAPTURE)
+        crsfRouter.setCapture(&crsfCapture);
+#endif
+#if defined(RX_TELEMETRY_DELTA)
+        otaConnector.setCodec(&telemetryCodec);
+#endif
+#if defined(RX_TELEMETRY_AGGREGATE)
+        otaConnector.setAggregate(true);
+#endif
         setupSerial();
         setupSerial1();
 
@@ -2110,21 +2297,21 @@ void loop()
         LostConnection(true);
     }
 
-    if ((connectionState == tentative) && (abs(LPF_OffsetDx.value()) <= 10) && (LPF_Offset.value() < 100) && (LQCalc.getLQRaw() > minLqForChaos())) //detects when we are connected
+    if ((connectionState == tentative) && phaseLock.isSettled() && (LQCalc.getLQRaw() > minLqForChaos())) //detects when we are connected
     {
         GotConnection(now);
     }
 
     checkSendLinkStatsToFc(now);
 
-    if ((RXtimerState == tim_tentative) && ((now - GotConnectionMillis) > ConsiderConnGoodMillis) && (abs(LPF_OffsetDx.value()) <= 5))
+    if ((RXtimerState == tim_tentative) && ((now - GotConnectionMillis) > ConsiderConnGoodMillis) && phaseLock.isSteady())
     {
         RXtimerState = tim_locked;
         DBGLN("Timer locked");
     }
 
     uint8_t nextPlayloadSize = 0;
-    if (!DataDlSender.IsActive() && otaConnector.GetNextPayload(&nextPlayloadSize, DataDlBuffer))
+    if (!DataDlSender.IsActive() && otaConnector.GetNextPayload(&nextPlayloadSize, DataDlBuffer, now))
     {
         DataDlSender.SetDataToTransmit(DataDlBuffer, nextPlayloadSize);
     }
@@ -2139,8 +2326,12 @@ void loop()
     updateSwitchMode();
     checkGeminiMode();
     DynamicPower_UpdateRx(false);
+#if defined(FHSS_ADAPTIVE)
+    updateAdaptiveFhss(now);
+#endif
     debugRcvrLinkstats();
     debugRcvrSignalStats(now);
+    debugTelemetryAge(now);
 }
 
 #if defined(PLATFORM_ESP32_C3)
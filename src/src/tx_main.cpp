@@ -7,6 +7,9 @@
 #include "msptypes.h"
 #include "stubborn_receiver.h"
 #include "stubborn_sender.h"
+#include "TelemetryAggregate.h"
+#include "TelemetryCodec.h"
+#include "TelemetryRatioAuto.h"
 
 #include "devHandset.h"
 #include "devADC.h"
@@ -47,8 +50,8 @@ TxConfig config;
 Stream *TxUSB;
 
 // Variables / constants for Airport //
-FIFO<AP_MAX_BUF_LEN> apInputBuffer;
-FIFO<AP_MAX_BUF_LEN> apOutputBuffer;
+SPSCRing<AP_MAX_BUF_LEN> apInputBuffer;
+SPSCRing<AP_MAX_BUF_LEN> apOutputBuffer;
 
 #define UART_INPUT_BUF_LEN 1024
 FIFO<UART_INPUT_BUF_LEN> uartInputBuffer;
@@ -70,6 +73,7 @@ volatile uint8_t syncSpamCounterAfterRateChange = 0;
 uint32_t rfModeLastChangedMS = 0;
 uint32_t SyncPacketLastSent = 0;
 static enum { stbIdle, stbRequested, stbBoosting } syncTelemBoostState = stbIdle;
+static TelemetryRatioAuto tlmRatioAuto;
 ////////////////////////////////////////////////
 
 static uint32_t LastTLMpacketRecv_Ms = 0;
@@ -90,6 +94,8 @@ static TxTlmRcvPhase_e TelemetryRcvPhase = ttrpTransmitting;
 StubbornReceiver DataDlReceiver;
 StubbornSender DataUlSender;
 uint8_t CRSFinBuffer[CRSF_MAX_PACKET_LEN+1];
+// Rebuilds the telemetry frames an RX with RX_TELEMETRY_DELTA sends coded
+static TelemetryCodec telemetryCodec;
 
 CRSFRouter crsfRouter;
 TXModuleEndpoint crsfTransmitter;
@@ -180,6 +186,17 @@ void ICACHE_RAM_ATTR LinkStatsFromOta(OTA_LinkStats_s * const ls)
  */
 void ICACHE_RAM_ATTR ProcessOtaDataDl(uint8_t pi1, uint8_t pi2, uint8_t *data1, uint8_t *data2, size_t dataLen, bool stubbornAck)
 {
+  // With windowed uplink data, the top bit of the packageIndex is bit 1 of the ack
+  uint8_t ulAck = stubbornAck;
+  if (DataUlSender.getWindow() > 1)
+  {
+    const uint8_t windowAckBit = OtaIsFullRes ? ELRS8_DATA_DL_WINDOW_ACK_BIT : ELRS4_DATA_DL_WINDOW_ACK_BIT;
+    if (pi1 & windowAckBit)
+      ulAck |= 2;
+    pi1 &= ~windowAckBit;
+    pi2 &= ~windowAckBit;
+  }
+
   static uint8_t packageIndexRadio1 = 0xFF;
   static uint8_t packageIndexRadio2 = 0xFF;
   constexpr size_t geminiSpanBufferSize = 2 * ELRS8_DATA_DL_BYTES_PER_CALL; // 2 * whatever the largest payload will be
@@ -213,7 +230,7 @@ void ICACHE_RAM_ATTR ProcessOtaDataDl(uint8_t pi1, uint8_t pi2, uint8_t *data1,
 
       if (packageIndexRadio1 == packageIndexRadio2 && packageIndexRadio1 != 0xFF)
       {
-          DataUlSender.ConfirmCurrentPayload(stubbornAck);
+          DataUlSender.ConfirmCurrentPayload(ulAck);
           DataDlReceiver.ReceiveData(packageIndexRadio1, geminiSpanBuffer, 2 * dataLen);
           packageIndexRadio1 = 0xFF;
           packageIndexRadio2 = 0xFF;
@@ -221,7 +238,7 @@ void ICACHE_RAM_ATTR ProcessOtaDataDl(uint8_t pi1, uint8_t pi2, uint8_t *data1,
   }
   else
   {
-      DataUlSender.ConfirmCurrentPayload(stubbornAck);
+      DataUlSender.ConfirmCurrentPayload(ulAck);
       DataDlReceiver.ReceiveData(pi1, data1, dataLen);
   }
 }
@@ -245,6 +262,7 @@ static bool ICACHE_RAM_ATTR ProcessDownlinkPacket(SX12xxDriverCommon::rx_status
 
   LastTLMpacketRecv_Ms = millis();
   LqTQly.add();
+  tlmRatioAuto.telemetryReceived(otaPktPtr->std.type == PACKET_TYPE_DATA);
 
   Radio.CheckForSecondPacket();
   if (Radio.hasSecondRadioGotData)
@@ -337,6 +355,28 @@ static bool ICACHE_RAM_ATTR ProcessDownlinkPacket(SX12xxDriverCommon::rx_status
   return true;
 }
 
+/**
+ * @brief Windowed uplink data is only used in normal link mode, where the downlink packageIndex
+ * has a bit to spare for the ack. Announced to the RX in the sync packet
+ */
+static bool ICACHE_RAM_ATTR isDataUlWindowed()
+{
+#if defined(DATA_UL_WINDOWED)
+  return config.GetLinkMode() == TX_NORMAL_MODE;
+#else
+  return false;
+#endif
+}
+
+static void ICACHE_RAM_ATTR setDataUlWindowed(bool windowed)
+{
+  DataUlSender.setWindow(windowed ? ELRS_DATA_UL_WINDOW : 1);
+  if (windowed)
+    DataDlReceiver.setMaxPackageIndex((OtaIsFullRes ? ELRS8_DATA_DL_WINDOW_ACK_BIT : ELRS4_DATA_DL_WINDOW_ACK_BIT) - 1);
+  else
+    DataDlReceiver.setMaxPackageIndex(OtaIsFullRes ? ELRS8_DATA_DL_MAX_PACKAGES : ELRS4_DATA_DL_MAX_PACKAGES);
+}
+
 expresslrs_tlm_ratio_e ICACHE_RAM_ATTR UpdateTlmRatioEffective()
 {
   expresslrs_tlm_ratio_e ratioConfigured = (expresslrs_tlm_ratio_e)config.GetTlm();
@@ -355,6 +395,10 @@ expresslrs_tlm_ratio_e ICACHE_RAM_ATTR UpdateTlmRatioEffective()
     syncTelemBoostState = stbBoosting;
     retVal = TLM_RATIO_1_2;
   }
+  else if (ratioConfigured == TLM_RATIO_AUTO)
+  {
+    retVal = tlmRatioAuto.getRatio();
+  }
   // If Armed, telemetry is disabled, otherwise use STD
   else if (ratioConfigured == TLM_RATIO_DISARMED)
   {
@@ -408,7 +452,10 @@ void ICACHE_RAM_ATTR GenerateSyncPacketData(OTA_Sync_s * const syncPtr)
   syncPtr->switchEncMode = SwitchEncMode;
   syncPtr->newTlmRatio = newTlmRatio - TLM_RATIO_NO_TLM;
   syncPtr->geminiMode = inGeminiMode();
-  syncPtr->otaProtocol = config.GetLinkMode();
+  const bool windowed = isDataUlWindowed();
+  setDataUlWindowed(windowed);
+  syncPtr->otaProtocol = config.GetLinkMode() | (windowed ? OTA_PROTOCOL_WINDOWED_DATA : 0);
+  syncPtr->fhssBlacklistEpoch = FHSSblacklistEpoch & 1;
   syncPtr->UID4 = UID[4];
   syncPtr->UID5 = UID[5];
 
@@ -499,7 +546,8 @@ void SetRFLinkRate(uint8_t index) // Set speed of RF link
 
   OtaUpdateSerializers(newSwitchMode, ModParams->PayloadLength);
   DataUlSender.setMaxPackageIndex(ELRS_MSP_MAX_PACKAGES);
-  DataDlReceiver.setMaxPackageIndex(OtaIsFullRes ? ELRS8_DATA_DL_MAX_PACKAGES : ELRS4_DATA_DL_MAX_PACKAGES);
+  setDataUlWindowed(isDataUlWindowed());
+  tlmRatioAuto.reset(ModParams->TLMinterval);
 
   ExpressLRS_currAirRate_Modparams = ModParams;
   ExpressLRS_currAirRate_RFperfParams = RFperf;
@@ -804,6 +852,18 @@ static void ConfigChangeCommit()
   devicesTriggerEvent(changes);
 }
 
+static void UpdateTlmRatioAuto(uint32_t now)
+{
+  static uint32_t lastUpdateMs;
+  if (config.GetTlm() != TLM_RATIO_AUTO || connectionState != connected || now - lastUpdateMs < TLM_AUTO_INTERVAL_MS)
+    return;
+  lastUpdateMs = now;
+
+  // Send the new ratio now, rather than wait up to 5 seconds for the next sync
+  if (tlmRatioAuto.update(linkStats.uplink_Link_quality))
+    syncSpamCounter = syncSpamAmount;
+}
+
 static void CheckConfigChangePending()
 {
   if (config.IsModified() || ModelUpdatePending)
@@ -930,7 +990,15 @@ static void UpdateConnectDisconnectStatus()
     setConnectionState(disconnected);
     linkStats.uplink_Link_quality = 0;
     LinkStatsLastReported_Ms = 0; // Notify immediately
+    // Reconnect on the standard ratio
+    tlmRatioAuto.reset(ExpressLRS_currAirRate_Modparams->TLMinterval);
     connectionHasModelMatch = true;
+#if defined(FHSS_ADAPTIVE)
+    // The RX drops its blacklist when it loses the connection too
+    FHSSresetBlacklist();
+#endif
+    // and its telemetry codec state, so the keyframes after reconnecting must not use ours
+    telemetryCodec.reset();
   }
 }
 
@@ -1120,14 +1188,17 @@ static void HandleUARTout()
 {
   if (firmwareOptions.is_airport)
   {
-    auto size = apOutputBuffer.size();
-    if (size)
+    // Written straight from the ring, in two pieces if the data wraps
+    const uint8_t *data;
+    for (uint8_t piece = 0; piece < 2; piece++)
     {
-      uint8_t buf[size];
-      apOutputBuffer.lock();
-      apOutputBuffer.popBytes(buf, size);
-      apOutputBuffer.unlock();
-      TxUSB->write(buf, size);
+      const auto size = apOutputBuffer.peekSpan(data);
+      if (size == 0)
+      {
+        break;
+      }
+      TxUSB->write(data, size);
+      apOutputBuffer.commitPop(size);
     }
   }
 }
@@ -1141,9 +1212,7 @@ static void HandleUARTin()
     {
       uint8_t buf[size];
       TxUSB->readBytes(buf, size);
-      apInputBuffer.lock();
       apInputBuffer.pushBytes(buf, size);
-      apInputBuffer.unlock();
     }
     return;
   }
@@ -1423,6 +1492,9 @@ void setup()
     crsfRouter.addConnector(&otaConnector);
     crsfRouter.addEndpoint(&crsfTransmitter);
     crsfRouter.addConnector(&usbConnector);
+#if defined(CRSF_CAPTURE)
+    crsfRouter.setCapture(&crsfCapture);
+#endif
     // When a CRSF handset is detected, it will add itself to the router
 
     handset->registerCallbacks(UARTconnected, firmwareOptions.is_airport ? nullptr : UARTdisconnected);
@@ -1530,6 +1602,7 @@ void loop()
 
   CheckReadyToSend();
   CheckConfigChangePending();
+  UpdateTlmRatioAuto(now);
   DynamicPower_Update(now);
   VtxPitmodeSwitchUpdate();
   checkSendLinkStatsToHandset(now);
@@ -1552,7 +1625,22 @@ void loop()
           }
         }
       }
-      else
+      else if (CRSFinBuffer[0] == TLM_AGGREGATE)
+      {
+        // Several frames from an RX with RX_TELEMETRY_AGGREGATE, each goes to the router on its own
+        uint8_t frame[CRSF_MAX_PACKET_LEN + 1];
+        uint8_t pos = TLM_AGGREGATE_HEADER_LEN;
+        uint8_t frameLen;
+        while ((frameLen = TlmAggregateNext(CRSFinBuffer, pos, frame, sizeof(frame))) != 0)
+        {
+          if (telemetryCodec.decode(frame, frameLen, sizeof(frame)))
+          {
+            crsfRouter.processMessage(&otaConnector, (crsf_header_t *)frame);
+            sendCRSFTelemetryToBackpack(frame);
+          }
+        }
+      }
+      else if (telemetryCodec.decode(CRSFinBuffer, DataDlReceiver.GetReceivedLength(), sizeof(CRSFinBuffer)))
       {
         // Send all other tlm to CRSF router
         crsfRouter.processMessage(&otaConnector, (crsf_header_t *)CRSFinBuffer);
@@ -0,0 +1,227 @@
+/**
+ * This file is part of ExpressLRS
+ * See https://github.com/AlessandroAU/ExpressLRS
+ *
+ * Benchmark for CRSFParser::processBytes(), the bulk path which checks whole frames where they
+ * are in the read buffer, against feeding the same reads to processByte() a byte at a time.
+ *
+ * The input is a stream like a handset sends the TX: RC channels every 4ms with device
+ * pings and parameter reads between them, some line noise and the odd frame with
+ * a bad CRC. It is cut into reads of random length like the UART driver returns them, so some
+ * frames straddle two reads. Both parsers must find exactly the same frames.
+ * A regular native test run executes a short smoke pass. Building with -D BENCHMARK
+ * (env:native_bench) runs much longer and also requires the bulk path to be faster.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <unity.h>
+#include <vector>
+
+#include "CRSFParser.h"
+#include "CRSFRouter.h"
+
+#if defined(BENCHMARK)
+#define BENCH_PARSER_PASSES 4000
+#else
+#define BENCH_PARSER_PASSES 40
+#endif
+// Under 64k bytes, so the whole stream fits in a single processBytes()
+#define BENCH_PARSER_STREAM_FRAMES 2000
+// The most one read returns, the ESP32 UART FIFO holds 128 bytes
+#define BENCH_PARSER_MAX_READ 128
+
+CRSFRouter crsfRouter;
+
+static std::vector<uint8_t> stream;
+static std::vector<uint16_t> reads;
+static uint32_t rngState = 1;
+
+static uint32_t rng()
+{
+    rngState = rngState * 1103515245 + 12345;
+    return rngState >> 16;
+}
+
+static void appendFrame(uint8_t addr, uint8_t type, const uint8_t *payload, uint8_t payloadLen, bool corrupt)
+{
+    const size_t start = stream.size();
+    stream.push_back(addr);
+    stream.push_back(payloadLen + 2);
+    stream.push_back(type);
+    stream.insert(stream.end(), payload, payload + payloadLen);
+    uint8_t crc = crsfRouter.crsf_crc.calc(&stream[start + 2], payloadLen + 1);
+    stream.push_back(corrupt ? crc ^ 0x55 : crc);
+}
+
+static void buildStream()
+{
+    stream.clear();
+    reads.clear();
+    rngState = 1;
+    uint8_t payload[CRSF_MAX_PACKET_LEN];
+    for (int i = 0; i < BENCH_PARSER_STREAM_FRAMES; i++)
+    {
+        // 16 channels of 11 bits moving around
+        for (int b = 0; b < 22; b++)
+            payload[b] = rng();
+        appendFrame(CRSF_SYNC_BYTE, CRSF_FRAMETYPE_RC_CHANNELS_PACKED, payload, 22, rng() % 200 == 0);
+
+        const uint32_t extra = rng() % 100;
+        if (extra < 5)
+        {
+            // Lua parameter read, from the radio to the TX module
+            payload[0] = CRSF_ADDRESS_CRSF_TRANSMITTER;
+            payload[1] = CRSF_ADDRESS_RADIO_TRANSMITTER;
+            payload[2] = rng() % 40;
+            payload[3] = 0;
+            appendFrame(CRSF_SYNC_BYTE, CRSF_FRAMETYPE_PARAMETER_READ, payload, 4, false);
+        }
+        else if (extra < 7)
+        {
+            payload[0] = CRSF_ADDRESS_BROADCAST;
+            payload[1] = CRSF_ADDRESS_RADIO_TRANSMITTER;
+            appendFrame(CRSF_SYNC_BYTE, CRSF_FRAMETYPE_DEVICE_PING, payload, 2, false);
+        }
+        else if (extra < 9)
+        {
+            // A burst of line noise, as when the handset switches the half duplex line
+            const uint32_t noise = 1 + rng() % 40;
+            for (uint32_t n = 0; n < noise; n++)
+                stream.push_back(rng());
+        }
+    }
+
+    for (size_t pos = 0; pos < stream.size();)
+    {
+        uint16_t len = 1 + rng() % BENCH_PARSER_MAX_READ;
+        if (pos + len > stream.size())
+            len = stream.size() - pos;
+        reads.push_back(len);
+        pos += len;
+    }
+}
+
+typedef struct {
+    uint32_t frames;
+    uint32_t checksum;
+    double nsPerByte;
+} parseResult_t;
+
+static void addFrame(parseResult_t &result, const crsf_header_t *message)
+{
+    result.frames++;
+    // Depends on the order and the content, so both parsers must deliver identical frames
+    const uint8_t *data = (const uint8_t *)message;
+    for (uint8_t i = 0; i < CRSF_FRAME_SIZE(message->frame_size); i++)
+        result.checksum = result.checksum * 31 + data[i];
+}
+
+static parseResult_t runByteWise()
+{
+    CRSFParser parser;
+    parseResult_t result = {};
+    const std::function<void(const crsf_header_t *)> found = [&result](const crsf_header_t *message) { addFrame(result, message); };
+
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < BENCH_PARSER_PASSES; pass++)
+    {
+        const uint8_t *data = stream.data();
+        for (uint16_t len : reads)
+        {
+            for (uint16_t i = 0; i < len; i++)
+                parser.processByte(nullptr, data[i], found);
+            data += len;
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    result.nsPerByte = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / BENCH_PARSER_PASSES / stream.size();
+    return result;
+}
+
+static parseResult_t runBulk()
+{
+    CRSFParser parser;
+    parseResult_t result = {};
+
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < BENCH_PARSER_PASSES; pass++)
+    {
+        const uint8_t *data = stream.data();
+        for (uint16_t len : reads)
+        {
+            parser.processBytes(nullptr, data, len, [&result](const crsf_header_t *message) { addFrame(result, message); });
+            data += len;
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    result.nsPerByte = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / BENCH_PARSER_PASSES / stream.size();
+    return result;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_bench_crsf_parser_same_frames(void)
+{
+    buildStream();
+
+    // A single read, and a byte per read, find the same as the chopped up stream
+    CRSFParser whole, bytes;
+    parseResult_t wholeResult = {}, bytesResult = {};
+    whole.processBytes(nullptr, stream.data(), stream.size(), [&](const crsf_header_t *message) { addFrame(wholeResult, message); });
+    for (uint8_t b : stream)
+        bytes.processBytes(nullptr, &b, 1, [&](const crsf_header_t *message) { addFrame(bytesResult, message); });
+
+    const parseResult_t byteWise = runByteWise();
+    const parseResult_t bulk = runBulk();
+    TEST_ASSERT_EQUAL(byteWise.frames, bulk.frames);
+    TEST_ASSERT_EQUAL(byteWise.checksum, bulk.checksum);
+    TEST_ASSERT_EQUAL(byteWise.frames / BENCH_PARSER_PASSES, wholeResult.frames);
+    TEST_ASSERT_EQUAL(byteWise.frames / BENCH_PARSER_PASSES, bytesResult.frames);
+    TEST_ASSERT_EQUAL(wholeResult.checksum, bytesResult.checksum);
+    // Only the frames with a bad CRC are lost
+    TEST_ASSERT_TRUE(wholeResult.frames > BENCH_PARSER_STREAM_FRAMES * 99 / 100);
+
+    printf("%u bytes in %u reads, %u frames\n", (unsigned)stream.size(), (unsigned)reads.size(), wholeResult.frames);
+    printf("byte-wise %6.2f ns/byte\n", byteWise.nsPerByte);
+    printf("bulk      %6.2f ns/byte (x%.2f)\n", bulk.nsPerByte, byteWise.nsPerByte / bulk.nsPerByte);
+#if defined(BENCHMARK)
+    TEST_ASSERT_TRUE_MESSAGE(bulk.nsPerByte < byteWise.nsPerByte, "bulk parser slower than byte-wise");
+#endif
+}
+
+void test_bench_crsf_parser_noise(void)
+{
+    // A long run of bytes which are never a sync byte is skipped without finding anything
+    std::vector<uint8_t> noise(4096);
+    for (size_t i = 0; i < noise.size(); i++)
+        noise[i] = (i * 7) & 0x7F;
+    CRSFParser parser;
+    uint32_t found = 0;
+    parser.processBytes(nullptr, noise.data(), noise.size(), [&found](const crsf_header_t *) { found++; });
+    TEST_ASSERT_EQUAL(0, found);
+
+    // A frame straight after it, and one cut over the next two reads, are still found
+    uint8_t frame[] = {CRSF_SYNC_BYTE, 4, CRSF_FRAMETYPE_DEVICE_PING, CRSF_ADDRESS_BROADCAST, CRSF_ADDRESS_RADIO_TRANSMITTER, 0};
+    frame[5] = crsfRouter.crsf_crc.calc(&frame[2], 3);
+    noise.insert(noise.end(), frame, frame + sizeof(frame));
+    noise.insert(noise.end(), frame, frame + 3);
+    parser.processBytes(nullptr, noise.data(), noise.size(), [&found](const crsf_header_t *) { found++; });
+    TEST_ASSERT_EQUAL(1, found);
+    parser.processBytes(nullptr, frame + 3, sizeof(frame) - 3, [&found](const crsf_header_t *) { found++; });
+    TEST_ASSERT_EQUAL(2, found);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bench_crsf_parser_same_frames);
+    RUN_TEST(test_bench_crsf_parser_noise);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,313 @@
+/**
+ * This file is part of ExpressLRS
+ * See https://github.com/AlessandroAU/ExpressLRS
+ *
+ * Benchmark for CRSFRouter, routed frames per second for the connectors of a TX module: the
+ * handset, the OTA link, USB and the backpack, with the TX module's own endpoint.
+ *
+ * The traffic is what the TX routes while flying with the Lua open: RC channels from the handset
+ * and telemetry from the link, which go to every other connector, parameter reads for the TX
+ * module, and MSP to and from the flight controller, which go to the one connector that knows it.
+ * The same frames are routed by a copy of the previous router which kept its connectors, endpoints
+ * and the devices of each connector in std::set, and every connector must receive the same frames.
+ * A regular native test run executes a short smoke pass. Building with -D BENCHMARK
+ * (env:native_bench) runs much longer and also requires the table driven router to be faster.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <unity.h>
+
+#include "CRSFRouter.h"
+
+#if defined(BENCHMARK)
+#define BENCH_ROUTER_ROUNDS 2000000
+#else
+#define BENCH_ROUTER_ROUNDS 20000
+#endif
+
+CRSFRouter crsfRouter;
+
+class MockConnector final : public CRSFConnector
+{
+public:
+    explicit MockConnector(std::initializer_list<crsf_addr_e> devices)
+    {
+        for (const auto device : devices)
+        {
+            addDevice(device);
+            legacyDevices.insert(device);
+        }
+    }
+
+    void forwardMessage(const crsf_header_t *message) override
+    {
+        forwarded++;
+        checksum += message->type;
+    }
+
+    uint32_t forwarded = 0;
+    uint32_t checksum = 0;
+    std::set<crsf_addr_e> legacyDevices;
+};
+
+class MockEndpoint final : public CRSFEndpoint
+{
+public:
+    MockEndpoint() : CRSFEndpoint(CRSF_ADDRESS_CRSF_TRANSMITTER) {}
+
+    void handleMessage(const crsf_header_t *message) override
+    {
+        handled++;
+    }
+
+    uint32_t handled = 0;
+};
+
+/**
+ * CRSFRouter::processMessage() and deliverMessage() as they were with std::set
+ */
+class LegacyRouter
+{
+public:
+    std::set<MockConnector *> connectors;
+    std::set<CRSFEndpoint *> endpoints;
+
+    void processMessage(MockConnector *connector, const crsf_header_t *message) const
+    {
+        const auto extMessage = (crsf_ext_header_t *)message;
+        const crsf_frame_type_e packetType = message->type;
+        if (connector && packetType >= CRSF_FRAMETYPE_DEVICE_PING && extMessage->orig_addr != 0)
+        {
+            connector->legacyDevices.insert(extMessage->orig_addr);
+        }
+
+        for (const auto endpoint : endpoints)
+        {
+            if (endpoint->handleRaw(message))
+            {
+                return;
+            }
+
+            const crsf_addr_e device_id = endpoint->getDeviceId();
+            if (packetType < CRSF_FRAMETYPE_DEVICE_PING || extMessage->dest_addr == device_id || extMessage->dest_addr == CRSF_ADDRESS_BROADCAST)
+            {
+                endpoint->handleMessage(message);
+                if (packetType >= CRSF_FRAMETYPE_DEVICE_PING && extMessage->dest_addr == device_id)
+                {
+                    return;
+                }
+            }
+        }
+
+        if (packetType >= CRSF_FRAMETYPE_DEVICE_PING && extMessage->dest_addr != CRSF_ADDRESS_BROADCAST)
+        {
+            for (const auto other : connectors)
+            {
+                if (other != connector && other->legacyDevices.find(extMessage->dest_addr) != other->legacyDevices.end())
+                {
+                    other->forwardMessage(message);
+                    return;
+                }
+            }
+        }
+
+        for (const auto other : connectors)
+        {
+            if (other != connector)
+            {
+                other->forwardMessage(message);
+            }
+        }
+    }
+};
+
+typedef struct {
+    MockConnector *from;
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+} benchFrame_t;
+
+static MockConnector handset({CRSF_ADDRESS_RADIO_TRANSMITTER, CRSF_ADDRESS_ELRS_LUA});
+static MockConnector ota({CRSF_ADDRESS_CRSF_RECEIVER, CRSF_ADDRESS_FLIGHT_CONTROLLER});
+static MockConnector usb({});
+static MockConnector backpack({CRSF_ADDRESS_BLUETOOTH_WIFI});
+static MockEndpoint transmitter;
+
+static benchFrame_t frames[8];
+static uint8_t frameCount = 0;
+
+static void addFrame(MockConnector *from, crsf_frame_type_e type, uint8_t payloadLen)
+{
+    benchFrame_t &f = frames[frameCount++];
+    f.from = from;
+    memset(f.frame, 0, sizeof(f.frame));
+    crsfRouter.SetHeaderAndCrc((crsf_header_t *)f.frame, type, CRSF_FRAME_SIZE(payloadLen));
+}
+
+static void addExtFrame(MockConnector *from, crsf_frame_type_e type, uint8_t payloadLen, crsf_addr_e dest, crsf_addr_e orig)
+{
+    benchFrame_t &f = frames[frameCount++];
+    f.from = from;
+    memset(f.frame, 0, sizeof(f.frame));
+    crsfRouter.SetExtendedHeaderAndCrc((crsf_ext_header_t *)f.frame, type, payloadLen + CRSF_FRAME_LENGTH_EXT_TYPE_CRC, dest, orig);
+}
+
+static void buildTraffic()
+{
+    frameCount = 0;
+    // Each round is 4ms at 250Hz: RC channels, telemetry, and a Lua or MSP frame every now and then
+    addFrame(&handset, CRSF_FRAMETYPE_RC_CHANNELS_PACKED, 22);
+    addFrame(&ota, CRSF_FRAMETYPE_LINK_STATISTICS, 10);
+    addFrame(&ota, CRSF_FRAMETYPE_BATTERY_SENSOR, 8);
+    addExtFrame(&handset, CRSF_FRAMETYPE_PARAMETER_READ, 2, CRSF_ADDRESS_CRSF_TRANSMITTER, CRSF_ADDRESS_ELRS_LUA);
+    addExtFrame(&handset, CRSF_FRAMETYPE_MSP_WRITE, 8, CRSF_ADDRESS_FLIGHT_CONTROLLER, CRSF_ADDRESS_RADIO_TRANSMITTER);
+    addExtFrame(&ota, CRSF_FRAMETYPE_MSP_RESP, 8, CRSF_ADDRESS_RADIO_TRANSMITTER, CRSF_ADDRESS_FLIGHT_CONTROLLER);
+    addExtFrame(&backpack, CRSF_FRAMETYPE_MSP_REQ, 8, CRSF_ADDRESS_FLIGHT_CONTROLLER, CRSF_ADDRESS_BLUETOOTH_WIFI);
+    addExtFrame(&usb, CRSF_FRAMETYPE_DEVICE_PING, 0, CRSF_ADDRESS_BROADCAST, CRSF_ADDRESS_USB);
+}
+
+static void resetCounts()
+{
+    for (auto *c : {&handset, &ota, &usb, &backpack})
+    {
+        c->forwarded = 0;
+        c->checksum = 0;
+    }
+    transmitter.handled = 0;
+}
+
+typedef struct {
+    uint32_t forwarded[4];
+    uint32_t checksum[4];
+    uint32_t handled;
+    double framesPerSec;
+} routeResult_t;
+
+static routeResult_t collect(double seconds)
+{
+    routeResult_t result;
+    MockConnector *all[] = {&handset, &ota, &usb, &backpack};
+    for (int i = 0; i < 4; i++)
+    {
+        result.forwarded[i] = all[i]->forwarded;
+        result.checksum[i] = all[i]->checksum;
+    }
+    result.handled = transmitter.handled;
+    result.framesPerSec = (double)BENCH_ROUTER_ROUNDS * frameCount / seconds;
+    return result;
+}
+
+static routeResult_t runTable()
+{
+    resetCounts();
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCH_ROUTER_ROUNDS; round++)
+    {
+        for (uint8_t i = 0; i < frameCount; i++)
+        {
+            crsfRouter.processMessage(frames[i].from, (crsf_header_t *)frames[i].frame);
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return collect(elapsed.count());
+}
+
+static routeResult_t runLegacy(const LegacyRouter &legacy)
+{
+    resetCounts();
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCH_ROUTER_ROUNDS; round++)
+    {
+        for (uint8_t i = 0; i < frameCount; i++)
+        {
+            legacy.processMessage(frames[i].from, (crsf_header_t *)frames[i].frame);
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return collect(elapsed.count());
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_bench_crsf_router_tx_topology(void)
+{
+    // In the order tx_main adds them, then the handset and backpack
+    crsfRouter.addConnector(&ota);
+    crsfRouter.addEndpoint(&transmitter);
+    crsfRouter.addConnector(&usb);
+    crsfRouter.addConnector(&handset);
+    crsfRouter.addConnector(&backpack);
+
+    LegacyRouter legacy;
+    legacy.connectors = {&ota, &usb, &handset, &backpack};
+    legacy.endpoints = {&transmitter};
+
+    buildTraffic();
+    const routeResult_t table = runTable();
+    const routeResult_t old = runLegacy(legacy);
+
+    for (int i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_EQUAL(old.forwarded[i], table.forwarded[i]);
+        TEST_ASSERT_EQUAL(old.checksum[i], table.checksum[i]);
+    }
+    TEST_ASSERT_EQUAL(old.handled, table.handled);
+    // The MSP from the backpack and the handset goes over the link, with the RC and the ping
+    TEST_ASSERT_EQUAL(BENCH_ROUTER_ROUNDS * 4, ota.forwarded);
+    // USB gets the RC and the telemetry but none of the MSP
+    TEST_ASSERT_EQUAL(BENCH_ROUTER_ROUNDS * 3, usb.forwarded);
+    TEST_ASSERT_TRUE(usb.forwardsTo(CRSF_ADDRESS_USB));
+
+    printf("%u frames per round, %u rounds\n", frameCount, BENCH_ROUTER_ROUNDS);
+    printf("std::set %6.2f M frames/s\n", old.framesPerSec / 1e6);
+    printf("table    %6.2f M frames/s (x%.2f)\n", table.framesPerSec / 1e6, table.framesPerSec / old.framesPerSec);
+#if defined(BENCHMARK)
+    TEST_ASSERT_TRUE_MESSAGE(table.framesPerSec > old.framesPerSec, "table router slower than std::set");
+#endif
+
+    crsfRouter.removeConnector(&ota);
+    crsfRouter.removeConnector(&usb);
+    crsfRouter.removeConnector(&handset);
+    crsfRouter.removeConnector(&backpack);
+}
+
+void test_crsf_router_table_follows_connectors(void)
+{
+    CRSFRouter router;
+    MockConnector first({CRSF_ADDRESS_FLIGHT_CONTROLLER});
+    MockConnector second({});
+    router.addConnector(&first);
+    router.addConnector(&second);
+
+    // A device learnt after the connector was added is routed to it
+    second.addDevice(CRSF_ADDRESS_GPS);
+    router.deliverMessageTo(CRSF_ADDRESS_GPS, (crsf_header_t *)frames[4].frame);
+    TEST_ASSERT_EQUAL(0, first.forwarded);
+    TEST_ASSERT_EQUAL(1, second.forwarded);
+
+    // Removing the first connector renumbers the second, which keeps its devices
+    router.removeConnector(&first);
+    router.deliverMessageTo(CRSF_ADDRESS_GPS, (crsf_header_t *)frames[4].frame);
+    router.deliverMessageTo(CRSF_ADDRESS_FLIGHT_CONTROLLER, (crsf_header_t *)frames[4].frame);
+    TEST_ASSERT_EQUAL(0, first.forwarded);
+    TEST_ASSERT_EQUAL(2, second.forwarded);
+
+    // Adding a connector twice does not deliver to it twice
+    router.addConnector(&second);
+    router.deliverMessageTo(CRSF_ADDRESS_BROADCAST, (crsf_header_t *)frames[4].frame);
+    TEST_ASSERT_EQUAL(3, second.forwarded);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bench_crsf_router_tx_topology);
+    RUN_TEST(test_crsf_router_table_follows_connectors);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,220 @@
+/**
+ * This file is part of ExpressLRS
+ * See https://github.com/AlessandroAU/ExpressLRS
+ *
+ * Micro-benchmark for the OTA hot path: channel packing/unpacking for every
+ * serializer and the CRC generate/validate pair for both packet sizes.
+ *
+ * A regular native test run executes a short smoke pass. Building with
+ * -D BENCHMARK (env:native_bench) runs millions of packets with optimisation
+ * enabled and fails any stage that exceeds its ns/packet budget.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <unity.h>
+
+#include "CRSFEndpoint.h"
+#include "common.h"
+#include "targets.h"
+
+#include <OTA.h>
+
+class MockEndpoint : public CRSFEndpoint
+{
+public:
+    MockEndpoint() : CRSFEndpoint((crsf_addr_e)1) {}
+    void handleMessage(const crsf_header_t *message) override {}
+};
+CRSFEndpoint *crsfEndpoint = new MockEndpoint();
+
+uint32_t ChannelData[CRSF_NUM_CHANNELS];      // Current state of channels, CRSF format
+uint8_t UID[6] = {1,2,3,4,5,6};
+elrsLinkStatistics_t linkStats;
+
+#if defined(BENCHMARK)
+#define BENCH_OTA_PACKETS 4000000
+#else
+#define BENCH_OTA_PACKETS 20000
+#endif
+
+// Budgets are deliberately generous (roughly 10x a typical desktop host) so they
+// only trip on a real regression, not on a noisy CI runner
+#if !defined(BENCH_OTA_MAX_PACK_NS)
+#define BENCH_OTA_MAX_PACK_NS 250
+#endif
+#if !defined(BENCH_OTA_MAX_UNPACK_NS)
+#define BENCH_OTA_MAX_UNPACK_NS 250
+#endif
+#if !defined(BENCH_OTA_MAX_CRC_NS)
+#define BENCH_OTA_MAX_CRC_NS 250
+#endif
+
+// Number of distinct randomised channel frames cycled through by the benchmark,
+// large enough to defeat branch prediction on the switch encoders
+#define BENCH_OTA_FRAMES 1024
+
+static uint32_t frames[BENCH_OTA_FRAMES][CRSF_NUM_CHANNELS];
+static uint8_t packets[BENCH_OTA_FRAMES][OTA8_PACKET_SIZE];
+static uint32_t sink;
+
+typedef struct {
+    const char *name;
+    OtaSwitchMode_e mode;
+    uint8_t packetSize;
+} serializer_t;
+
+static const serializer_t serializers[] = {
+    {"Hybrid8",    smHybridOr16ch, OTA4_PACKET_SIZE},
+    {"HybridWide", smWideOr8ch,    OTA4_PACKET_SIZE},
+    {"8ch",        smWideOr8ch,    OTA8_PACKET_SIZE},
+    {"12ch",       sm12ch,         OTA8_PACKET_SIZE},
+    {"16ch",       smHybridOr16ch, OTA8_PACKET_SIZE},
+};
+
+static double nsPerPacket(std::chrono::steady_clock::time_point start)
+{
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / BENCH_OTA_PACKETS;
+}
+
+static void report(const char *stage, const char *name, double ns, unsigned budget)
+{
+    printf("%-8s %-10s %8.1f ns/packet (budget %u)\n", stage, name, ns, budget);
+}
+
+void setUp()
+{
+    srand(0x4f7a);
+    for (unsigned f = 0; f < BENCH_OTA_FRAMES; ++f)
+    {
+        for (unsigned ch = 0; ch < CRSF_NUM_CHANNELS; ++ch)
+            frames[f][ch] = CRSF_CHANNEL_VALUE_MIN + (rand() % (CRSF_CHANNEL_VALUE_MAX - CRSF_CHANNEL_VALUE_MIN + 1));
+    }
+    OtaUpdateCrcInitFromUid();
+    OtaNonce = 0;
+}
+
+void tearDown() {}
+
+static void bench_pack(const serializer_t &s)
+{
+    OtaUpdateSerializers(s.mode, s.packetSize);
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < BENCH_OTA_PACKETS; ++i)
+    {
+        unsigned f = i % BENCH_OTA_FRAMES;
+        OTA_Packet_s * const otaPktPtr = (OTA_Packet_s *)packets[f];
+        ++OtaNonce;
+        OtaPackChannelData(otaPktPtr, frames[f], false);
+    }
+    double ns = nsPerPacket(start);
+
+    for (unsigned f = 0; f < BENCH_OTA_FRAMES; ++f)
+        sink += packets[f][1];
+    report("pack", s.name, ns, BENCH_OTA_MAX_PACK_NS);
+#if defined(BENCHMARK)
+    TEST_ASSERT_LESS_THAN_UINT32(BENCH_OTA_MAX_PACK_NS, (uint32_t)ns);
+#endif
+}
+
+static void bench_unpack(const serializer_t &s)
+{
+    OtaUpdateSerializers(s.mode, s.packetSize);
+    for (unsigned f = 0; f < BENCH_OTA_FRAMES; ++f)
+    {
+        OTA_Packet_s * const otaPktPtr = (OTA_Packet_s *)packets[f];
+        OtaPackChannelData(otaPktPtr, frames[f], false);
+    }
+
+    uint32_t channelsOut[CRSF_NUM_CHANNELS] = {0};
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < BENCH_OTA_PACKETS; ++i)
+    {
+        OTA_Packet_s const * const otaPktPtr = (OTA_Packet_s *)packets[i % BENCH_OTA_FRAMES];
+        OtaUnpackChannelData(otaPktPtr, channelsOut);
+        sink += channelsOut[i % CRSF_NUM_CHANNELS];
+    }
+    double ns = nsPerPacket(start);
+
+    report("unpack", s.name, ns, BENCH_OTA_MAX_UNPACK_NS);
+#if defined(BENCHMARK)
+    TEST_ASSERT_LESS_THAN_UINT32(BENCH_OTA_MAX_UNPACK_NS, (uint32_t)ns);
+#endif
+}
+
+static void bench_crc(const char *name, uint8_t packetSize)
+{
+    OtaUpdateSerializers(smWideOr8ch, packetSize);
+    for (unsigned f = 0; f < BENCH_OTA_FRAMES; ++f)
+    {
+        for (unsigned b = 0; b < packetSize; ++b)
+            packets[f][b] = rand();
+        // RCDATA with crcHigh clear, as the TX builds it. Never a SYNC packet
+        // so the nonce is always folded into the CRC
+        packets[f][0] = PACKET_TYPE_RCDATA;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < BENCH_OTA_PACKETS; ++i)
+    {
+        unsigned f = i % BENCH_OTA_FRAMES;
+        packets[f][0] = PACKET_TYPE_RCDATA;
+        OtaGeneratePacketCrc((OTA_Packet_s *)packets[f]);
+    }
+    double nsGen = nsPerPacket(start);
+    report("crc-gen", name, nsGen, BENCH_OTA_MAX_CRC_NS);
+
+    unsigned valid = 0;
+    start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < BENCH_OTA_PACKETS; ++i)
+        valid += OtaValidatePacketCrc((OTA_Packet_s *)packets[i % BENCH_OTA_FRAMES]);
+    double nsVal = nsPerPacket(start);
+    report("crc-chk", name, nsVal, BENCH_OTA_MAX_CRC_NS);
+
+    // Nonce never changed so every packet must still validate
+    TEST_ASSERT_EQUAL(BENCH_OTA_PACKETS, valid);
+#if defined(BENCHMARK)
+    TEST_ASSERT_LESS_THAN_UINT32(BENCH_OTA_MAX_CRC_NS, (uint32_t)nsGen);
+    TEST_ASSERT_LESS_THAN_UINT32(BENCH_OTA_MAX_CRC_NS, (uint32_t)nsVal);
+#endif
+}
+
+void test_bench_pack_hybrid8()    { bench_pack(serializers[0]); }
+void test_bench_pack_hybridwide() { bench_pack(serializers[1]); }
+void test_bench_pack_8ch()        { bench_pack(serializers[2]); }
+void test_bench_pack_12ch()       { bench_pack(serializers[3]); }
+void test_bench_pack_16ch()       { bench_pack(serializers[4]); }
+
+void test_bench_unpack_hybrid8()    { bench_unpack(serializers[0]); }
+void test_bench_unpack_hybridwide() { bench_unpack(serializers[1]); }
+void test_bench_unpack_8ch()        { bench_unpack(serializers[2]); }
+void test_bench_unpack_12ch()       { bench_unpack(serializers[3]); }
+void test_bench_unpack_16ch()       { bench_unpack(serializers[4]); }
+
+void test_bench_crc_std()  { bench_crc("std", OTA4_PACKET_SIZE); }
+void test_bench_crc_full() { bench_crc("full", OTA8_PACKET_SIZE); }
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bench_pack_hybrid8);
+    RUN_TEST(test_bench_pack_hybridwide);
+    RUN_TEST(test_bench_pack_8ch);
+    RUN_TEST(test_bench_pack_12ch);
+    RUN_TEST(test_bench_pack_16ch);
+    RUN_TEST(test_bench_unpack_hybrid8);
+    RUN_TEST(test_bench_unpack_hybridwide);
+    RUN_TEST(test_bench_unpack_8ch);
+    RUN_TEST(test_bench_unpack_12ch);
+    RUN_TEST(test_bench_unpack_16ch);
+    RUN_TEST(test_bench_crc_std);
+    RUN_TEST(test_bench_crc_full);
+    UNITY_END();
+
+    printf("sink %u\n", sink);
+    return 0;
+}
@@ -0,0 +1,380 @@
+/**
+ * This file is part of ExpressLRS
+ * See https://github.com/AlessandroAU/ExpressLRS
+ *
+ * Benchmark for the RX downlink telemetry queue, comparing RXOTAConnector against
+ * the byte FIFO with linear scan it replaced (kept here as LegacyTelemetryQueue).
+ *
+ * An FC stream of broadcast sensors, per-source RPM/temperature frames and
+ * passthrough frames is fed in faster than the downlink drains it. Each frame
+ * carries the time it was produced, so the age of the data when it is sent is
+ * the queue latency. A regular native test run executes a short smoke pass.
+ * Building with -D BENCHMARK (env:native_bench) runs much longer and also
+ * requires the new queue to be faster than the old one.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <unity.h>
+#include <unordered_map>
+
+#include "FIFO.h"
+#include "RXOTAConnector.h"
+#include "helpers.h"
+
+#if defined(BENCHMARK)
+#define BENCH_TELEM_MS 2000000
+#else
+#define BENCH_TELEM_MS 20000
+#endif
+
+static uint32_t sink;
+
+/***
+ * The previous RXOTAConnector queue, for comparison
+ ***/
+#define LEGACY_FIFO_SIZE 512
+typedef FIFO<LEGACY_FIFO_SIZE> LegacyFifo;
+
+#define IS_DEL(size) (size & bit(7))
+#define SET_DEL(size) (size | bit(7))
+#define SIZE(size) (size & ~bit(7))
+
+enum action_e
+{
+    ACTION_NEXT,
+    ACTION_IGNORE,
+    ACTION_OVERWRITE,
+    ACTION_APPEND
+};
+
+typedef std::function<action_e(const crsf_header_t *newMessage, LegacyFifo &payloads, uint16_t queuePosition)> comparator_t;
+
+static action_e sourceId(const crsf_header_t *newMessage, const LegacyFifo &payloads, const uint16_t queuePosition)
+{
+    if (payloads[queuePosition + CRSF_TELEMETRY_TYPE_INDEX + 1] == ((uint8_t *)newMessage)[CRSF_TELEMETRY_TYPE_INDEX + 1])
+    {
+        return ACTION_OVERWRITE;
+    }
+    return ACTION_NEXT;
+}
+
+static action_e statusText(const crsf_header_t *newMessage, const LegacyFifo &payloads, const uint16_t queuePosition)
+{
+    if (payloads[queuePosition + CRSF_TELEMETRY_TYPE_INDEX + 1] == CRSF_AP_CUSTOM_TELEM_STATUS_TEXT &&
+        newMessage->payload[0] == CRSF_AP_CUSTOM_TELEM_STATUS_TEXT)
+    {
+        return ACTION_OVERWRITE;
+    }
+    return ACTION_NEXT;
+}
+
+static action_e extendedSameDestOrigin(const crsf_header_t *newMessage, const LegacyFifo &payloads, const uint16_t queuePosition)
+{
+    if (payloads[queuePosition + 3] == ((crsf_ext_header_t *)newMessage)->dest_addr && payloads[queuePosition + 4] == ((crsf_ext_header_t *)newMessage)->orig_addr)
+    {
+        return ACTION_OVERWRITE;
+    }
+    return ACTION_NEXT;
+}
+
+static std::unordered_map<crsf_frame_type_e, comparator_t> comparators = {
+    {CRSF_FRAMETYPE_RPM, sourceId},
+    {CRSF_FRAMETYPE_TEMP, sourceId},
+    {CRSF_FRAMETYPE_CELLS, sourceId},
+    {CRSF_FRAMETYPE_ARDUPILOT_RESP, statusText},
+    {CRSF_FRAMETYPE_DEVICE_INFO, extendedSameDestOrigin},
+    {CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY, extendedSameDestOrigin },
+};
+
+static bool isPrioritised(const crsf_frame_type_e frameType)
+{
+    return frameType >= CRSF_FRAMETYPE_DEVICE_PING && frameType <= CRSF_FRAMETYPE_PARAMETER_WRITE;
+}
+
+class LegacyTelemetryQueue
+{
+public:
+    bool GetNextPayload(uint8_t *nextPayloadSize, uint8_t *payloadData)
+    {
+        if (prioritizedCount)
+        {
+            for (uint16_t i = 0; i < messagePayloads.size();)
+            {
+                const auto size = messagePayloads[i];
+                if (isPrioritised((crsf_frame_type_e)messagePayloads[i + 1 + CRSF_TELEMETRY_TYPE_INDEX]))
+                {
+                    if (!IS_DEL(size))
+                    {
+                        prioritizedCount--;
+                        if (i == 0)
+                        {
+                            messagePayloads.pop();
+                            messagePayloads.popBytes(payloadData, size);
+                        }
+                        else
+                        {
+                            for (uint16_t pos = 0 ; pos < size ; pos++)
+                            {
+                                payloadData[pos] = messagePayloads[i + 1 + pos];
+                            }
+                            messagePayloads.set(i, SET_DEL(size));
+                        }
+                        *nextPayloadSize = CRSF_FRAME_SIZE(payloadData[CRSF_TELEMETRY_LENGTH_INDEX]);
+                        return true;
+                    }
+                }
+                i += 1 + SIZE(size);
+            }
+            prioritizedCount = 0;
+        }
+
+        while (messagePayloads.size() > 0)
+        {
+            const auto size = messagePayloads.pop();
+            if (IS_DEL(size))
+            {
+                messagePayloads.skip(SIZE(size));
+                continue;
+            }
+            messagePayloads.popBytes(payloadData, size);
+            *nextPayloadSize = CRSF_FRAME_SIZE(payloadData[CRSF_TELEMETRY_LENGTH_INDEX]);
+            return true;
+        }
+
+        *nextPayloadSize = 0;
+        return false;
+    }
+
+    void forwardMessage(const crsf_header_t *message)
+    {
+        const uint8_t messageSize = CRSF_FRAME_SIZE(((uint8_t *)message)[CRSF_TELEMETRY_LENGTH_INDEX]);
+
+        auto action = ACTION_APPEND;
+        uint16_t overwritePosition = 0;
+        const auto comparator = comparators.find(message->type);
+
+        if (comparator != comparators.end() || message->type < CRSF_FRAMETYPE_DEVICE_PING)
+        {
+            for (uint16_t i = 0; i < messagePayloads.size();)
+            {
+                const auto size = messagePayloads[i];
+                if (!IS_DEL(size) && messagePayloads[i + 1 + CRSF_TELEMETRY_TYPE_INDEX] == message->type)
+                {
+                    const auto whatToDo = comparator == comparators.end() ? ACTION_OVERWRITE : comparator->second(message, messagePayloads, i + 1);
+                    if (whatToDo != ACTION_NEXT)
+                    {
+                        overwritePosition = i;
+                        action = whatToDo;
+                        break;
+                    }
+                }
+                i += 1 + SIZE(size);
+            }
+        }
+        if (isPrioritised(message->type))
+        {
+            prioritizedCount++;
+        }
+
+        switch (action)
+        {
+        case ACTION_IGNORE:
+            break;
+        case ACTION_OVERWRITE:
+            if (!IS_DEL(messagePayloads[overwritePosition]))
+            {
+                if (messagePayloads[overwritePosition] >= messageSize)
+                {
+                    for (uint16_t i = 0; i < messageSize; i++)
+                    {
+                        messagePayloads.set(overwritePosition + i + 1, ((uint8_t *)message)[i]);
+                    }
+                    break;
+                }
+                messagePayloads.set(overwritePosition, SET_DEL(messagePayloads[overwritePosition]));
+            }
+            // fallthrough
+        default:
+            while (!messagePayloads.available(messageSize + 1))
+            {
+                const uint8_t sz = SIZE(messagePayloads.pop());
+                messagePayloads.skip(sz);
+            }
+            messagePayloads.push(messageSize);
+            messagePayloads.pushBytes((uint8_t *)message, messageSize);
+        }
+    }
+
+private:
+    LegacyFifo messagePayloads;
+    uint8_t prioritizedCount = 0;
+};
+
+/***
+ * FC telemetry stream
+ ***/
+typedef struct {
+    crsf_frame_type_e type;
+    uint8_t payloadLen;     // not including the type or CRC
+    uint8_t sourceId;       // first byte of the payload
+} benchFrame_t;
+
+// One frame per ms, repeating every 32ms. Roughly an FC with ESC telemetry and a passthrough link
+static const benchFrame_t schedule[] = {
+    {CRSF_FRAMETYPE_BATTERY_SENSOR, 8, 0},
+    {CRSF_FRAMETYPE_ATTITUDE, 6, 0},
+    {CRSF_FRAMETYPE_RPM, 7, 0},
+    {CRSF_FRAMETYPE_RPM, 7, 1},
+    {CRSF_FRAMETYPE_ARDUPILOT_RESP, 20, CRSF_AP_CUSTOM_TELEM_SINGLE_PACKET_PASSTHROUGH},
+    {CRSF_FRAMETYPE_RPM, 7, 2},
+    {CRSF_FRAMETYPE_RPM, 7, 3},
+    {CRSF_FRAMETYPE_GPS, 15, 0},
+    {CRSF_FRAMETYPE_ATTITUDE, 6, 0},
+    {CRSF_FRAMETYPE_TEMP, 5, 0},
+    {CRSF_FRAMETYPE_TEMP, 5, 1},
+    {CRSF_FRAMETYPE_ARDUPILOT_RESP, 20, CRSF_AP_CUSTOM_TELEM_SINGLE_PACKET_PASSTHROUGH},
+    {CRSF_FRAMETYPE_VARIO, 4, 0},
+    {CRSF_FRAMETYPE_BARO_ALTITUDE, 4, 0},
+    {CRSF_FRAMETYPE_RPM, 7, 4},
+    {CRSF_FRAMETYPE_RPM, 7, 5},
+    {CRSF_FRAMETYPE_ATTITUDE, 6, 0},
+    {CRSF_FRAMETYPE_CELLS, 13, 0},
+    {CRSF_FRAMETYPE_FLIGHT_MODE, 8, 0},
+    {CRSF_FRAMETYPE_ARDUPILOT_RESP, 20, CRSF_AP_CUSTOM_TELEM_SINGLE_PACKET_PASSTHROUGH},
+    {CRSF_FRAMETYPE_RPM, 7, 6},
+    {CRSF_FRAMETYPE_RPM, 7, 7},
+    {CRSF_FRAMETYPE_BATTERY_SENSOR, 8, 0},
+    {CRSF_FRAMETYPE_ATTITUDE, 6, 0},
+    {CRSF_FRAMETYPE_TEMP, 5, 2},
+    {CRSF_FRAMETYPE_TEMP, 5, 3},
+    {CRSF_FRAMETYPE_ARDUPILOT_RESP, 30, CRSF_AP_CUSTOM_TELEM_STATUS_TEXT},
+    {CRSF_FRAMETYPE_GPS, 15, 0},
+    {CRSF_FRAMETYPE_AIRSPEED, 4, 0},
+    {CRSF_FRAMETYPE_VARIO, 4, 0},
+    {CRSF_FRAMETYPE_ARDUPILOT_RESP, 20, CRSF_AP_CUSTOM_TELEM_SINGLE_PACKET_PASSTHROUGH},
+    {CRSF_FRAMETYPE_ATTITUDE, 6, 0},
+};
+
+static void buildFrame(uint8_t *frame, const benchFrame_t &f, uint32_t now)
+{
+    frame[0] = CRSF_ADDRESS_CRSF_RECEIVER;
+    frame[1] = f.payloadLen + 2;
+    frame[2] = f.type;
+    frame[3] = f.sourceId;
+    // The production time goes in the 2nd and 3rd payload bytes, every frame has at least 4
+    frame[4] = now & 0xFF;
+    frame[5] = (now >> 8) & 0xFF;
+    frame[CRSF_FRAME_SIZE(frame[1]) - 1] = 0;
+}
+
+typedef struct {
+    uint32_t sent;
+    uint64_t ageSumMs;
+    uint32_t ageMaxMs;
+} benchAge_t;
+
+typedef struct {
+    double nsPerFrame;
+    benchAge_t all;
+    benchAge_t byClass[TELEM_CLASS_COUNT];
+} benchResult_t;
+
+static void enqueue(LegacyTelemetryQueue &queue, const crsf_header_t *message, uint32_t now) { queue.forwardMessage(message); }
+static void enqueue(RXOTAConnector &queue, const crsf_header_t *message, uint32_t now) { queue.queueMessage(message, now); }
+static bool dequeue(LegacyTelemetryQueue &queue, uint8_t *size, uint8_t *data, uint32_t now) { return queue.GetNextPayload(size, data); }
+static bool dequeue(RXOTAConnector &queue, uint8_t *size, uint8_t *data, uint32_t now) { return queue.GetNextPayload(size, data, now); }
+
+static void addAge(benchAge_t &age, uint32_t ms)
+{
+    age.sent++;
+    age.ageSumMs += ms;
+    age.ageMaxMs = ms > age.ageMaxMs ? ms : age.ageMaxMs;
+}
+
+static double meanAge(const benchAge_t &age)
+{
+    return age.sent ? (double)age.ageSumMs / age.sent : 0.0;
+}
+
+template <class Queue>
+static benchResult_t runStream(Queue &queue, uint32_t drainMs)
+{
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+    uint8_t payload[CRSF_MAX_PACKET_LEN];
+    uint8_t payloadSize;
+    benchResult_t result = {};
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t now = 0; now < BENCH_TELEM_MS; now++)
+    {
+        buildFrame(frame, schedule[now % ARRAY_SIZE(schedule)], now);
+        enqueue(queue, (crsf_header_t *)frame, now);
+
+        if (now % drainMs == 0 && dequeue(queue, &payloadSize, payload, now))
+        {
+            const uint32_t age = (uint16_t)(now - (payload[4] | (payload[5] << 8)));
+            addAge(result.all, age);
+            addAge(result.byClass[RXOTAConnector::classOf((crsf_frame_type_e)payload[CRSF_TELEMETRY_TYPE_INDEX])], age);
+            sink += payloadSize;
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    result.nsPerFrame = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / BENCH_TELEM_MS;
+
+    // Drain what is left so the next run starts empty
+    while (dequeue(queue, &payloadSize, payload, BENCH_TELEM_MS))
+        ;
+    return result;
+}
+
+static void report(const char *name, uint32_t drainMs, const benchResult_t &r)
+{
+    printf("%-8s drain %2ums %6.1f ns/frame  sent %6u  age mean %5.1fms max %3ums  gps %5u %5.1f/%3ums  battery %5u %5.1f/%3ums\n",
+        name, drainMs, r.nsPerFrame, r.all.sent, meanAge(r.all), r.all.ageMaxMs,
+        r.byClass[TELEM_CLASS_GPS].sent, meanAge(r.byClass[TELEM_CLASS_GPS]), r.byClass[TELEM_CLASS_GPS].ageMaxMs,
+        r.byClass[TELEM_CLASS_BATTERY].sent, meanAge(r.byClass[TELEM_CLASS_BATTERY]), r.byClass[TELEM_CLASS_BATTERY].ageMaxMs);
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void bench_queue(uint32_t drainMs)
+{
+    static LegacyTelemetryQueue legacy;
+    static RXOTAConnector connector;
+
+    const benchResult_t before = runStream(legacy, drainMs);
+    const benchResult_t after = runStream(connector, drainMs);
+    report("legacy", drainMs, before);
+    report("indexed", drainMs, after);
+
+    // The downlink is the bottleneck, both send a frame every drain period
+    TEST_ASSERT_EQUAL((BENCH_TELEM_MS + drainMs - 1) / drainMs, after.all.sent);
+    // GPS and battery are sent, and still fresh when they are
+    TEST_ASSERT_TRUE(after.byClass[TELEM_CLASS_GPS].sent > 0);
+    TEST_ASSERT_TRUE(after.byClass[TELEM_CLASS_BATTERY].sent > 0);
+    TEST_ASSERT_TRUE_MESSAGE(after.byClass[TELEM_CLASS_GPS].ageMaxMs <= RXOTAConnector::classBudgetMs(TELEM_CLASS_GPS), "stale GPS sent");
+    TEST_ASSERT_TRUE_MESSAGE(after.byClass[TELEM_CLASS_BATTERY].ageMaxMs <= RXOTAConnector::classBudgetMs(TELEM_CLASS_BATTERY), "stale battery sent");
+#if defined(BENCHMARK)
+    TEST_ASSERT_TRUE_MESSAGE(after.nsPerFrame < before.nsPerFrame, "indexed queue slower than legacy");
+#endif
+}
+
+// A frame every 4ms is 250Hz at 1:2 telemetry, or 500Hz at 1:4 with multi-packet frames
+void test_bench_telemetry_fast() { bench_queue(4); }
+// and every 32ms is a low telemetry ratio, like 250Hz at 1:16 and two packets per frame
+void test_bench_telemetry_slow() { bench_queue(32); }
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bench_telemetry_fast);
+    RUN_TEST(test_bench_telemetry_slow);
+    UNITY_END();
+
+    printf("sink %u\n", sink);
+    return 0;
+}
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <cstdint>
 #include <iostream>
 #include <unity.h>
@@ -11,6 +12,12 @@
 #define NUM_ITERATIONS 1000
 #endif
 
+#ifdef BENCHMARK
+#define BENCH_CRC_BYTES 64000000
+#else
+#define BENCH_CRC_BYTES 64000
+#endif
+
 static char *genMsg(uint8_t bytes[], int len) {
     static char buf[80];
     char hex[4];
@@ -23,7 +30,8 @@ static char *genMsg(uint8_t bytes[], int len) {
     return buf;
 }
 
-void test_crc_implementation_compatibility(uint8_t crcbits, uint16_t poly, uint8_t testlen)
+template <uint8_t crcbits, uint16_t poly>
+void test_crc_implementation_compatibility(uint8_t testlen)
 {
     uint8_t bytes[testlen];
     for (int i = 0; i < testlen; i++)
@@ -33,8 +41,7 @@ void test_crc_implementation_compatibility(uint8_t crcbits, uint16_t poly, uint8
     uCRC_t ccrc = uCRC_t("CRC", crcbits, poly, 0, false, false, 0);
     uint64_t crc = ccrc.get_raw_crc(bytes, testlen, 0);
 
-    Crc2Byte ecrc;
-    ecrc.init(crcbits, poly);
+    Crc2Byte<crcbits, poly> ecrc;
     uint32_t c = ecrc.calc(bytes, testlen, 0);
 
     uint32_t mask = (1 << crcbits) - 1;
@@ -43,19 +50,19 @@ void test_crc_implementation_compatibility(uint8_t crcbits, uint16_t poly, uint8
 
 void test_crc14_implementation_compatibility(void)
 {
-    test_crc_implementation_compatibility(14, ELRS_CRC14_POLY, 7);
+    test_crc_implementation_compatibility<14, ELRS_CRC14_POLY>(7);
 }
 
 void test_crc16_implementation_compatibility(void)
 {
-    test_crc_implementation_compatibility(16, ELRS_CRC16_POLY, 11);
+    test_crc_implementation_compatibility<16, ELRS_CRC16_POLY>(11);
 }
 
-void test_crc_flip_random(uint8_t crcbits, uint16_t poly, uint8_t testlen, int flip)
+template <uint8_t crcbits, uint16_t poly>
+void test_crc_flip_random(uint8_t testlen, int flip)
 {
     int false_positive = 0;
-    Crc2Byte ccrc;
-    ccrc.init(crcbits, poly);
+    Crc2Byte<crcbits, poly> ccrc;
 
     for (int x = 0; x < NUM_ITERATIONS; x++)
     {
@@ -91,19 +98,19 @@ void test_crc_flip_random(uint8_t crcbits, uint16_t poly, uint8_t testlen, int f
 
 void test_crc14_flip_random(int flip)
 {
-    test_crc_flip_random(14, ELRS_CRC14_POLY, 7, flip);
+    test_crc_flip_random<14, ELRS_CRC14_POLY>(7, flip);
 }
 
 void test_crc16_flip_random(int flip)
 {
-    test_crc_flip_random(16, ELRS_CRC16_POLY, 11, flip);
+    test_crc_flip_random<16, ELRS_CRC16_POLY>(11, flip);
 }
 
-void test_crc_flip_sequential(uint8_t crcbits, uint16_t poly, uint8_t testlen, int flip)
+template <uint8_t crcbits, uint16_t poly>
+void test_crc_flip_sequential(uint8_t testlen, int flip)
 {
     int false_positive = 0;
-    Crc2Byte ccrc;
-    ccrc.init(crcbits, poly);
+    Crc2Byte<crcbits, poly> ccrc;
 
     for (int x=0 ; x<NUM_ITERATIONS ; x++) {
         uint8_t bytes[7];
@@ -139,19 +146,19 @@ void test_crc_flip_sequential(uint8_t crcbits, uint16_t poly, uint8_t testlen, i
 
 void test_crc14_flip_sequential(int flip)
 {
-    test_crc_flip_sequential(14, ELRS_CRC14_POLY, 7, flip);
+    test_crc_flip_sequential<14, ELRS_CRC14_POLY>(7, flip);
 }
 
 void test_crc16_flip_sequential(int flip)
 {
-    test_crc_flip_sequential(16, ELRS_CRC16_POLY, 11, flip);
+    test_crc_flip_sequential<16, ELRS_CRC16_POLY>(11, flip);
 }
 
-void test_crc_flip_within(uint8_t crcbits, uint16_t poly, uint8_t testlen, int flip)
+template <uint8_t crcbits, uint16_t poly>
+void test_crc_flip_within(uint8_t testlen, int flip)
 {
     int false_positive = 0;
-    Crc2Byte ccrc;
-    ccrc.init(crcbits, poly);
+    Crc2Byte<crcbits, poly> ccrc;
 
     for (int x = 0; x < NUM_ITERATIONS; x++)
     {
@@ -190,18 +197,18 @@ void test_crc_flip_within(uint8_t crcbits, uint16_t poly, uint8_t testlen, int f
 
 void test_crc14_flip_within(int flip)
 {
-    test_crc_flip_within(14, ELRS_CRC14_POLY, 7, flip);
+    test_crc_flip_within<14, ELRS_CRC14_POLY>(7, flip);
 }
 
 void test_crc16_flip_within(int flip)
 {
-    test_crc_flip_within(16, ELRS_CRC16_POLY, 11, flip);
+    test_crc_flip_within<16, ELRS_CRC16_POLY>(11, flip);
 }
 
-void test_crc_flip5(uint8_t crcbits, uint16_t poly, uint8_t testlen)
+template <uint8_t crcbits, uint16_t poly>
+void test_crc_flip5(uint8_t testlen)
 {
-    Crc2Byte ccrc;
-    ccrc.init(crcbits, poly);
+    Crc2Byte<crcbits, poly> ccrc;
 
     for (int x = 0; x < NUM_ITERATIONS; x++)
     {
@@ -252,12 +259,12 @@ void test_crc_flip5(uint8_t crcbits, uint16_t poly, uint8_t testlen)
 
 void test_crc14_flip5(void)
 {
-    test_crc_flip5(14, ELRS_CRC14_POLY, 7);
+    test_crc_flip5<14, ELRS_CRC14_POLY>(7);
 }
 
 void test_crc16_flip5(void)
 {
-    test_crc_flip5(16, ELRS_CRC16_POLY, 11);
+    test_crc_flip5<16, ELRS_CRC16_POLY>(11);
 }
 
 void test_crc8(void)
@@ -270,12 +277,145 @@ void test_crc8(void)
     uCRC_t ccrc = uCRC_t("CRC8", 8, ELRS_CRC_POLY, 0, false, false, 0);
     uint64_t crc = ccrc.get_raw_crc(bytes, 7, 0);
 
-    GENERIC_CRC8 ecrc = GENERIC_CRC8(ELRS_CRC_POLY);
+    GENERIC_CRC8<ELRS_CRC_POLY> ecrc;
     uint16_t c = ecrc.calc(bytes, 7);
 
     TEST_ASSERT_EQUAL_MESSAGE((int)(crc & 0xFF), c, genMsg(bytes, sizeof(bytes)));
 }
 
+/* Check every slice-by-N variant against ucrc_t for all lengths up to a CRSF frame,
+ * including a non-zero initial value so the register/first-slice merge is covered
+ */
+template <uint8_t slices>
+void test_crc8_slices_compatibility(void)
+{
+    uCRC_t ccrc = uCRC_t("CRC8", 8, CRSF_CRC_POLY, 0, false, false, 0);
+    GENERIC_CRC8<CRSF_CRC_POLY, slices> ecrc;
+
+    uint8_t bytes[CRSF_MAX_PACKET_LEN];
+    for (unsigned len = 0; len <= sizeof(bytes); len++)
+    {
+        for (unsigned i = 0; i < len; i++)
+            bytes[i] = random();
+        uint8_t init = random();
+
+        uint64_t crc = ccrc.get_raw_crc(bytes, len, init);
+        TEST_ASSERT_EQUAL((uint8_t)crc, ecrc.calc(bytes, len, init));
+    }
+}
+
+template <uint8_t crcbits, uint16_t poly, typename Crc>
+void test_crc2byte_compatibility(const Crc &ecrc)
+{
+    uCRC_t ccrc = uCRC_t("CRC", crcbits, poly, 0, false, false, 0);
+    uint16_t mask = (1 << crcbits) - 1;
+
+    uint8_t bytes[CRSF_MAX_PACKET_LEN];
+    for (unsigned len = 0; len <= sizeof(bytes); len++)
+    {
+        for (unsigned i = 0; i < len; i++)
+            bytes[i] = random();
+        // OtaCrcInitializer is 16 bits wide, bits above crcbits must be ignored
+        uint16_t init = random();
+
+        uint64_t crc = ccrc.get_raw_crc(bytes, len, init & mask);
+        TEST_ASSERT_EQUAL_MESSAGE(crc & mask, ecrc.calc(bytes, len, init), genMsg(bytes, std::min(len, 20)));
+    }
+}
+
+template <uint8_t crcbits, uint16_t poly, uint8_t slices>
+void test_crc2byte_slices_compatibility(void)
+{
+    test_crc2byte_compatibility<crcbits, poly>(Crc2Byte<crcbits, poly, slices>());
+}
+
+void test_crc8_slices(void)
+{
+    test_crc8_slices_compatibility<1>();
+    test_crc8_slices_compatibility<2>();
+    test_crc8_slices_compatibility<4>();
+    test_crc8_slices_compatibility<8>();
+}
+
+void test_crc14_slices(void)
+{
+    test_crc2byte_slices_compatibility<14, ELRS_CRC14_POLY, 1>();
+    test_crc2byte_slices_compatibility<14, ELRS_CRC14_POLY, 2>();
+    test_crc2byte_slices_compatibility<14, ELRS_CRC14_POLY, 4>();
+    test_crc2byte_slices_compatibility<14, ELRS_CRC14_POLY, 8>();
+}
+
+void test_crc16_slices(void)
+{
+    test_crc2byte_slices_compatibility<16, ELRS_CRC16_POLY, 1>();
+    test_crc2byte_slices_compatibility<16, ELRS_CRC16_POLY, 2>();
+    test_crc2byte_slices_compatibility<16, ELRS_CRC16_POLY, 4>();
+    test_crc2byte_slices_compatibility<16, ELRS_CRC16_POLY, 8>();
+    // SUMD
+    test_crc2byte_slices_compatibility<16, 0x1021, 1>();
+}
+
+void test_crc_ram_tables(void)
+{
+    // The tables built at runtime for the ISR match the compile-time ones
+    test_crc2byte_compatibility<14, ELRS_CRC14_POLY>(Crc2ByteRAM<14, ELRS_CRC14_POLY>());
+    test_crc2byte_compatibility<16, ELRS_CRC16_POLY>(Crc2ByteRAM<16, ELRS_CRC16_POLY>());
+    test_crc2byte_compatibility<16, ELRS_CRC16_POLY>(Crc2ByteRAM<16, ELRS_CRC16_POLY, 2>());
+}
+
+/* Throughput of each engine on CRSF sized (64B) and OTA sized (8B/13B) buffers
+ * Only prints the results, the OTA budgets are enforced by test_bench_ota
+ */
+template <typename Crc>
+static void bench_crc(const char *name, const Crc &crc, uint8_t len)
+{
+    uint8_t bytes[64];
+    for (unsigned i = 0; i < sizeof(bytes); i++)
+        bytes[i] = random();
+
+    unsigned const iterations = BENCH_CRC_BYTES / len;
+    unsigned sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; i++)
+    {
+        bytes[0] = i;
+        sum += crc.calc(bytes, len, 0);
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    printf("%-12s %2uB %7.1f ns/buffer %7.1f MB/s (%u)\n", name, len, (double)ns / iterations,
+        (double)iterations * len * 1000.0 / ns, sum & 0xff);
+}
+
+void test_crc_throughput(void)
+{
+    GENERIC_CRC8<CRSF_CRC_POLY, 1> crc8x1;
+    GENERIC_CRC8<CRSF_CRC_POLY, 4> crc8x4;
+    GENERIC_CRC8<CRSF_CRC_POLY, 8> crc8x8;
+    Crc2Byte<14, ELRS_CRC14_POLY, 1> crc14x1;
+    Crc2Byte<14, ELRS_CRC14_POLY, 4> crc14x4;
+    Crc2Byte<14, ELRS_CRC14_POLY, 8> crc14x8;
+    Crc2Byte<16, ELRS_CRC16_POLY, 1> crc16x1;
+    Crc2Byte<16, ELRS_CRC16_POLY, 4> crc16x4;
+    Crc2Byte<16, ELRS_CRC16_POLY, 8> crc16x8;
+    Crc2ByteRAM<14, ELRS_CRC14_POLY> crc14ram;
+    Crc2ByteRAM<16, ELRS_CRC16_POLY> crc16ram;
+
+    bench_crc("crc8 x1", crc8x1, 64);
+    bench_crc("crc8 x4", crc8x4, 64);
+    bench_crc("crc8 x8", crc8x8, 64);
+    bench_crc("crc14 x1", crc14x1, OTA4_CRC_CALC_LEN);
+    bench_crc("crc14 x4", crc14x4, OTA4_CRC_CALC_LEN);
+    bench_crc("crc14 x8", crc14x8, OTA4_CRC_CALC_LEN);
+    bench_crc("crc16 x1", crc16x1, OTA8_CRC_CALC_LEN);
+    bench_crc("crc16 x4", crc16x4, OTA8_CRC_CALC_LEN);
+    bench_crc("crc16 x8", crc16x8, OTA8_CRC_CALC_LEN);
+    bench_crc("crc14 RAM", crc14ram, OTA4_CRC_CALC_LEN);
+    bench_crc("crc16 RAM", crc16ram, OTA8_CRC_CALC_LEN);
+    bench_crc("crc16 x1", crc16x1, 64);
+    bench_crc("crc16 x4", crc16x4, 64);
+    bench_crc("crc16 x8", crc16x8, 64);
+}
+
 // Unity setup/teardown
 void setUp() {}
 void tearDown() {}
@@ -290,6 +430,11 @@ int main(int argc, char **argv)
     RUN_TEST(test_crc16_implementation_compatibility);
     RUN_TEST(test_crc16_flip5);
     RUN_TEST(test_crc8);
+    RUN_TEST(test_crc8_slices);
+    RUN_TEST(test_crc14_slices);
+    RUN_TEST(test_crc16_slices);
+    RUN_TEST(test_crc_ram_tables);
+    RUN_TEST(test_crc_throughput);
     UNITY_END();
 #endif
 #ifdef BIG_TEST
@@ -11,7 +11,7 @@ using namespace std;
 
 uint32_t ChannelData[CRSF_NUM_CHANNELS];      // Current state of channels, CRSF format
 
-GENERIC_CRC8 test_crc(CRSF_CRC_POLY);
+GENERIC_CRC8<CRSF_CRC_POLY> test_crc;
 
 class MockEndpoint : public CRSFEndpoint
 {
@@ -83,7 +83,7 @@ void test_device_info(void)
     TEST_ASSERT_EQUAL(DEVICE_INFORMATION_FRAME_SIZE, header->frame_size);
 
     uint8_t *data = connector.data.data() + sizeof(crsf_ext_header_t);
-    uint8_t compare [] = {'t', 'e', 's', 't', 'i', 'n', 'g', 0x0, 0x45, 0x4c, 0x52, 0x53, 0x0, 0x0, 0x0, 0x0, 0x0, 1, 2, 3, 0x0, 0x0};
+    uint8_t compare [] = {'t', 'e', 's', 't', 'i', 'n', 'g', 0x0, 0x45, 0x4c, 0x52, 0x53, 0x0, 0x0, 0x0, 0x0, 0x0, 1, 2, 3, 0x0, CRSF_PARAMETER_VERSION};
 
     TEST_ASSERT_EQUAL_INT8_ARRAY(compare, data, sizeof(compare));
 
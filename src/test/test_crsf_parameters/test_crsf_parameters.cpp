@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unity.h>
+#include <vector>
+
+#include "CRSFRouter.h"
+
+CRSFRouter crsfRouter;
+
+// A round trip to an RX for the Lua script, a parameter read up and a chunk back down over telemetry
+#define REMOTE_ROUND_TRIP_MS 100
+
+static selectionParameter luaSerialProtocol = {
+    {"Protocol", CRSF_TEXT_SELECTION, 0, 0},
+    0,
+    "CRSF;Inverted CRSF;SBUS;Inverted SBUS;SUMD;DJI RS Pro;HoTT Telemetry;MAVLink;DisplayPort;GPS;Tramp;SmartAudio",
+    STR_EMPTYSPACE};
+static selectionParameter luaFailsafeMode = {{"SBUS failsafe", CRSF_TEXT_SELECTION, 0, 0}, 0, "No Pulses;Last Pos", STR_EMPTYSPACE};
+static selectionParameter luaTlmPower = {{"Tlm Power", CRSF_TEXT_SELECTION, 0, 0}, 0, "10;25;50;100;250;500;1000;MatchTX ", "mW"};
+static selectionParameter luaAntennaMode = {{"Ant. Mode", CRSF_TEXT_SELECTION, 0, 0}, 0, "Antenna A;Antenna B;Diversity", STR_EMPTYSPACE};
+static folderParameter luaTeamraceFolder = {{"Team Race", CRSF_FOLDER, 0, 0}, nullptr};
+static selectionParameter luaTeamraceChannel = {{"Channel", CRSF_TEXT_SELECTION, 0, 0}, 0, "AUX2;AUX3;AUX4;AUX5;AUX6;AUX7;AUX8;AUX9;AUX10;AUX11;AUX12", STR_EMPTYSPACE};
+static selectionParameter luaTeamracePosition = {{"Position", CRSF_TEXT_SELECTION, 0, 0}, 0, "Disabled;1/Low;2;3;Mid;4;5;6/High", STR_EMPTYSPACE};
+static stringParameter luaModelNumber = {{"Model Id", CRSF_INFO, 0, 0}, "Off"};
+static stringParameter luaVersion = {{"3.5.3 ISM2G4", CRSF_INFO, 0, 0}, "a1b2c3"};
+static folderParameter luaMappingFolder = {{"Output Mapping", CRSF_FOLDER, 0, 0}, nullptr};
+static int8Parameter luaMappingChannelOut = {{"Output Ch", CRSF_UINT8, 0, 0}, {{1, 1, 16}}, STR_EMPTYSPACE};
+static int8Parameter luaMappingChannelIn = {{"Input Ch", CRSF_UINT8, 0, 0}, {{1, 1, 16}}, STR_EMPTYSPACE};
+static selectionParameter luaMappingOutputMode = {
+    {"Output Mode", CRSF_TEXT_SELECTION, 0, 0},
+    0,
+    "50Hz;60Hz;100Hz;160Hz;333Hz;400Hz;10kHzDuty;On/Off;DShot;DShot 3D;Serial RX;Serial TX;I2C SCL;I2C SDA",
+    STR_EMPTYSPACE};
+static selectionParameter luaMappingInverted = {{"Invert", CRSF_TEXT_SELECTION, 0, 0}, 0, "Normal;Inverted", STR_EMPTYSPACE};
+static commandParameter luaSetFailsafe = {{"Set Failsafe Pos", CRSF_COMMAND, 0, 0}, lcsIdle, STR_EMPTYSPACE};
+static selectionParameter luaBindStorage = {{"Bind Storage", CRSF_TEXT_SELECTION, 0, 0}, 0, "Persistent;Volatile;Returnable;Administered", STR_EMPTYSPACE};
+static commandParameter luaBindMode = {{"Enter Bind Mode", CRSF_COMMAND, 0, 0}, lcsIdle, STR_EMPTYSPACE};
+static selectionParameter luaHidden = {{"ELRS only", (crsf_value_type_e)(CRSF_TEXT_SELECTION | CRSF_FIELD_ELRS_HIDDEN), 0, 0}, 0, "Off;On", STR_EMPTYSPACE};
+
+static const uint8_t pwmInputs[] = {1, 2, 3, 4, 5, 6, 7, 8};
+static const uint8_t pwmModes[] = {0, 0, 0, 0, 1, 2, 7, 8};
+
+class MockEndpoint : public CRSFEndpoint
+{
+public:
+    MockEndpoint() : CRSFEndpoint(CRSF_ADDRESS_CRSF_RECEIVER) {}
+    void handleMessage(const crsf_header_t *message) override {}
+
+    void registerParameters() override
+    {
+        registerParameter(&luaSerialProtocol, [](propertiesCommon *, uint8_t) {});
+        registerParameter(&luaFailsafeMode, [](propertiesCommon *, uint8_t) {});
+        registerParameter(&luaTlmPower, [](propertiesCommon *, uint8_t) {});
+        registerParameter(&luaAntennaMode, [](propertiesCommon *, uint8_t) {});
+        registerParameter(&luaTeamraceFolder);
+        registerParameter(&luaTeamraceChannel, [](propertiesCommon *, uint8_t) {}, luaTeamraceFolder.common.id);
+        registerParameter(&luaTeamracePosition, [](propertiesCommon *, uint8_t) {}, luaTeamraceFolder.common.id);
+        registerParameter(&luaModelNumber);
+        registerParameter(&luaMappingFolder);
+        // Selecting an output shows its input, mode and inversion, like RXParameters
+        registerParameter(&luaMappingChannelOut, [this](propertiesCommon *, uint8_t arg) {
+            setUint8Value(&luaMappingChannelOut, arg);
+            setUint8Value(&luaMappingChannelIn, pwmInputs[arg - 1]);
+            setTextSelectionValue(&luaMappingOutputMode, pwmModes[arg - 1]);
+            setTextSelectionValue(&luaMappingInverted, 0);
+        }, luaMappingFolder.common.id);
+        registerParameter(&luaMappingChannelIn, [](propertiesCommon *, uint8_t) {}, luaMappingFolder.common.id);
+        registerParameter(&luaMappingOutputMode, [](propertiesCommon *, uint8_t) {}, luaMappingFolder.common.id);
+        registerParameter(&luaMappingInverted, [](propertiesCommon *, uint8_t) {}, luaMappingFolder.common.id);
+        registerParameter(&luaSetFailsafe, [](propertiesCommon *, uint8_t) {});
+        registerParameter(&luaBindStorage, [](propertiesCommon *, uint8_t) {});
+        registerParameter(&luaBindMode, [](propertiesCommon *, uint8_t) {});
+        registerParameter(&luaHidden, [](propertiesCommon *, uint8_t) {});
+        registerParameter(&luaVersion);
+        count = luaVersion.common.id;
+    }
+
+    // mock class helper methods
+    void read(uint8_t id, uint8_t chunk, bool isElrs = false)
+    {
+        parameterUpdateReq(CRSF_ADDRESS_RADIO_TRANSMITTER, isElrs, CRSF_FRAMETYPE_PARAMETER_READ, id, chunk);
+    }
+    void write(uint8_t id, uint8_t value)
+    {
+        parameterUpdateReq(CRSF_ADDRESS_RADIO_TRANSMITTER, false, CRSF_FRAMETYPE_PARAMETER_WRITE, id, value);
+    }
+    void setAntennaMode(uint8_t value) { setTextSelectionValue(&luaAntennaMode, value); }
+
+    uint8_t count = 0;
+};
+
+class MockConnector : public CRSFConnector
+{
+public:
+    MockConnector() { addDevice(CRSF_ADDRESS_RADIO_TRANSMITTER); }
+
+    void forwardMessage(const crsf_header_t *message) override
+    {
+        const uint8_t *data = (const uint8_t *)message;
+        frames.emplace_back(data, data + CRSF_FRAME_SIZE(message->frame_size));
+    }
+    uint8_t GetMaxPacketBytes() const override { return maxPacket; }
+
+    std::vector<std::vector<uint8_t>> frames;
+    uint8_t maxPacket = CRSF_MAX_PACKET_LEN;
+};
+
+static MockEndpoint endpoint;
+static MockConnector connector;
+
+/**
+ * Reads a parameter chunk by chunk like the Lua script, one round trip per chunk
+ * @return round trips taken
+ */
+static unsigned readParameter(uint8_t id, std::vector<uint8_t> &entry, bool isElrs = false)
+{
+    entry.clear();
+    unsigned trips = 0;
+    for (uint8_t chunk = 0;; chunk++)
+    {
+        connector.frames.clear();
+        endpoint.read(id, chunk, isElrs);
+        trips++;
+        TEST_ASSERT_EQUAL(1, connector.frames.size());
+        const std::vector<uint8_t> &frame = connector.frames[0];
+        TEST_ASSERT_EQUAL(CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY, frame[2]);
+        TEST_ASSERT_EQUAL(id, frame[5]);
+        // Payload after the ext header, field id and chunks remaining, without the CRC
+        entry.insert(entry.end(), frame.begin() + 7, frame.end() - 1);
+        if (frame[6] == 0)
+            return trips;
+    }
+}
+
+/**
+ * Asks for the parameters changed since generation `since`
+ * @param bulk if given, gets the entries sent after the list by id
+ * @return the current generation
+ */
+static uint8_t readChanges(uint8_t since, std::vector<uint8_t> &ids, std::vector<std::vector<uint8_t>> *bulk = nullptr)
+{
+    connector.frames.clear();
+    endpoint.read(CRSF_PARAMETER_CHANGES_ID, since);
+    TEST_ASSERT_TRUE(connector.frames.size() >= 1);
+    const std::vector<uint8_t> &frame = connector.frames[0];
+    TEST_ASSERT_EQUAL(CRSF_PARAMETER_CHANGES_ID, frame[5]);
+    TEST_ASSERT_EQUAL(0, frame[6]);
+    // The generation, the ids and 0xFF
+    TEST_ASSERT_EQUAL(0xFF, frame[frame.size() - 2]);
+    ids.assign(frame.begin() + 8, frame.end() - 2);
+
+    // Then up to CRSF_PARAMETER_CHANGES_BULK of the changed entries, each in one chunk
+    TEST_ASSERT_TRUE(connector.frames.size() <= 1 + CRSF_PARAMETER_CHANGES_BULK);
+    for (size_t i = 1; i < connector.frames.size(); i++)
+    {
+        const std::vector<uint8_t> &entry = connector.frames[i];
+        TEST_ASSERT_EQUAL(CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY, entry[2]);
+        TEST_ASSERT_TRUE(std::find(ids.begin(), ids.end(), entry[5]) != ids.end());
+        TEST_ASSERT_EQUAL(0, entry[6]);
+        if (bulk)
+        {
+            (*bulk)[entry[5]].assign(entry.begin() + 7, entry.end() - 1);
+        }
+    }
+    return frame[7];
+}
+
+static unsigned loadAll(std::vector<std::vector<uint8_t>> &entries)
+{
+    unsigned trips = 0;
+    entries.resize(endpoint.count + 1);
+    for (uint8_t id = 1; id <= endpoint.count; id++)
+        trips += readParameter(id, entries[id]);
+    return trips;
+}
+
+void setUp()
+{
+    connector.maxPacket = CRSF_MAX_PACKET_LEN;
+    connector.frames.clear();
+}
+
+void tearDown() {}
+
+void test_parameter_chunks_match_entry(void)
+{
+    // Chunks read through a small packet size join up to the same entry as a single chunk
+    std::vector<uint8_t> whole, chunked;
+    readParameter(luaMappingOutputMode.common.id, whole);
+    connector.maxPacket = 32;
+    TEST_ASSERT_TRUE(readParameter(luaMappingOutputMode.common.id, chunked) > 3);
+    TEST_ASSERT_EQUAL(whole.size(), chunked.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(whole.data(), chunked.data(), whole.size());
+
+    // Reading the first chunk of something else in between does not mix up the entries
+    std::vector<uint8_t> entry;
+    connector.frames.clear();
+    endpoint.read(luaMappingOutputMode.common.id, 0);
+    endpoint.read(luaSerialProtocol.common.id, 0);
+    endpoint.read(luaMappingOutputMode.common.id, 1);
+    TEST_ASSERT_EQUAL(3, connector.frames.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&chunked[32 - 8], &connector.frames[2][7], 32 - 8);
+
+    // A chunk past the end is not answered with garbage
+    connector.frames.clear();
+    endpoint.read(luaMappingInverted.common.id, 5);
+    TEST_ASSERT_EQUAL(0, connector.frames.size());
+
+    // The ELRS hidden flag only applies to the ELRS Lua
+    readParameter(luaHidden.common.id, entry);
+    TEST_ASSERT_EQUAL(CRSF_TEXT_SELECTION, entry[1]);
+    readParameter(luaHidden.common.id, entry, true);
+    TEST_ASSERT_EQUAL(CRSF_TEXT_SELECTION | 0x80, entry[1]);
+}
+
+void test_parameter_changes_since_generation(void)
+{
+    std::vector<std::vector<uint8_t>> entries;
+    std::vector<uint8_t> ids;
+    const uint8_t start = readChanges(0, ids);
+    loadAll(entries);
+    uint8_t generation = readChanges(start, ids);
+    TEST_ASSERT_EQUAL(0, ids.size());
+
+    // A setter
+    endpoint.setAntennaMode(2);
+    generation = readChanges(generation, ids);
+    TEST_ASSERT_EQUAL(1, ids.size());
+    TEST_ASSERT_EQUAL(luaAntennaMode.common.id, ids[0]);
+
+    // Setting the same value again is not a change
+    endpoint.setAntennaMode(2);
+    generation = readChanges(generation, ids);
+    TEST_ASSERT_EQUAL(0, ids.size());
+
+    // Changes made without a setter are found as well
+    luaFailsafeMode.options = "No Pulses;Last Pos;Hold";
+    LUA_FIELD_HIDE(luaBindStorage);
+    generation = readChanges(generation, ids);
+    TEST_ASSERT_EQUAL(2, ids.size());
+    TEST_ASSERT_EQUAL(luaFailsafeMode.common.id, ids[0]);
+    TEST_ASSERT_EQUAL(luaBindStorage.common.id, ids[1]);
+    LUA_FIELD_SHOW(luaBindStorage);
+
+    // A read of a changed entry has the new value
+    std::vector<uint8_t> entry;
+    readParameter(luaAntennaMode.common.id, entry);
+    TEST_ASSERT_FALSE(entry == entries[luaAntennaMode.common.id]);
+
+    // Asking from an older generation lists everything since then
+    generation = readChanges(start, ids);
+    TEST_ASSERT_TRUE(generation != start);
+    TEST_ASSERT_EQUAL(3, ids.size());
+
+    // Changes between two reads are one generation
+    endpoint.setAntennaMode(0);
+    endpoint.setAntennaMode(1);
+    TEST_ASSERT_EQUAL((uint8_t)(generation + 1), readChanges(generation, ids));
+}
+
+void test_parameter_changes_generation_wraps(void)
+{
+    std::vector<uint8_t> ids;
+    uint8_t generation = readChanges(0, ids);
+    luaFailsafeMode.options = "No Pulses;Last Pos";
+    generation = readChanges(generation, ids);
+    TEST_ASSERT_EQUAL(1, ids.size());
+
+    // A handset refreshing after every change keeps seeing only the new one, well past 256 generations
+    for (unsigned i = 0; i < 300; i++)
+    {
+        endpoint.setAntennaMode(i % 3);
+        const uint8_t next = readChanges(generation, ids);
+        TEST_ASSERT_EQUAL((uint8_t)(generation + 1), next);
+        TEST_ASSERT_EQUAL(1, ids.size());
+        TEST_ASSERT_EQUAL(luaAntennaMode.common.id, ids[0]);
+        generation = next;
+    }
+}
+
+void test_parameter_changes_too_many(void)
+{
+    std::vector<uint8_t> ids;
+    const uint8_t generation = readChanges(0, ids);
+    // At most 8 bytes in a chunk, room for 6 ids
+    connector.maxPacket = 16;
+    selectionParameter *changed[] = {&luaSerialProtocol, &luaFailsafeMode, &luaTlmPower, &luaAntennaMode, &luaTeamraceChannel, &luaTeamracePosition, &luaBindStorage};
+    for (selectionParameter *parameter : changed)
+        LUA_FIELD_HIDE((*parameter));
+    readChanges(generation, ids);
+    TEST_ASSERT_EQUAL(1, ids.size());
+    TEST_ASSERT_EQUAL(CRSF_PARAMETER_CHANGES_ALL, ids[0]);
+
+    for (selectionParameter *parameter : changed)
+        LUA_FIELD_SHOW((*parameter));
+    connector.maxPacket = CRSF_MAX_PACKET_LEN;
+    readChanges(generation, ids);
+    TEST_ASSERT_EQUAL(7, ids.size());
+}
+
+void test_parameter_load_time(void)
+{
+    std::vector<std::vector<uint8_t>> entries;
+    std::vector<uint8_t> ids;
+    // Over telemetry the TX gives the Lua 64 byte frames
+    connector.maxPacket = 64;
+    endpoint.write(luaMappingChannelOut.common.id, 1);
+    const uint8_t start = readChanges(0, ids);
+    const unsigned fullTrips = loadAll(entries);
+    uint8_t generation = readChanges(start, ids);
+
+    // Selecting another output changes the fields next to it, the script used to read them all again.
+    // The changed entries come with the list, the script only reads the ones which did not.
+    endpoint.write(luaMappingChannelOut.common.id, 5);
+    unsigned refreshTrips = 1;
+    std::vector<std::vector<uint8_t>> bulk(endpoint.count + 1);
+    generation = readChanges(generation, ids, &bulk);
+    std::vector<uint8_t> entry;
+    for (uint8_t id : ids)
+    {
+        if (bulk[id].empty())
+        {
+            refreshTrips += readParameter(id, bulk[id]);
+        }
+        entries[id] = bulk[id];
+    }
+    TEST_ASSERT_EQUAL(3, ids.size());
+
+    // What the script has is what a full load gives
+    std::vector<std::vector<uint8_t>> reloaded;
+    loadAll(reloaded);
+    for (uint8_t id = 1; id <= endpoint.count; id++)
+    {
+        TEST_ASSERT_EQUAL(reloaded[id].size(), entries[id].size());
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(reloaded[id].data(), entries[id].data(), entries[id].size());
+    }
+
+    printf("%u parameters, full load %u round trips (%u ms at %u ms each)\n",
+        endpoint.count, fullTrips, fullTrips * REMOTE_ROUND_TRIP_MS, REMOTE_ROUND_TRIP_MS);
+    printf("refresh after an edit: %u changed, %u round trips (%u ms)\n",
+        (unsigned)ids.size(), refreshTrips, refreshTrips * REMOTE_ROUND_TRIP_MS);
+    TEST_ASSERT_TRUE(refreshTrips * 3 < fullTrips);
+}
+
+int main(int argc, char **argv)
+{
+    endpoint.registerParameters();
+    crsfRouter.addEndpoint(&endpoint);
+    crsfRouter.addConnector(&connector);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_parameter_chunks_match_entry);
+    RUN_TEST(test_parameter_changes_since_generation);
+    RUN_TEST(test_parameter_changes_generation_wraps);
+    RUN_TEST(test_parameter_changes_too_many);
+    RUN_TEST(test_parameter_load_time);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,552 @@
+/**
+ * This file is part of ExpressLRS
+ * See https://github.com/AlessandroAU/ExpressLRS
+ *
+ * Replays a CRSFCapture through the receiver's CRSF path and reports the CPU time of each stage
+ * and how long telemetry waits in the downlink queue.
+ *
+ * Every frame recorded coming in from a connector is given to a CRSFParser for that connector,
+ * which routes it through the CRSFRouter. Connector 0 is the OTA link on the TX and RX, it is
+ * replayed by an RXOTAConnector whose queue is drained by a StubbornSender every telemetry slot
+ * of the recorded time. The other connectors turn MSP back into MSP frames and into CRSF again,
+ * as the TCP MSP connector does.
+ *
+ * A capture downloaded from a device built with -D CRSF_CAPTURE (http://<device>/capture.bin)
+ * is replayed by naming it in the CRSF_CAPTURE_FILE environment variable. Without it a few
+ * seconds of a receiver connected to a flight controller sending telemetry and answering MSP
+ * are made up and replayed.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unity.h>
+#include <vector>
+
+#include "CRSFCapture.h"
+#include "CRSFParser.h"
+#include "CRSFRouter.h"
+#include "RXOTAConnector.h"
+#include "crsf2msp.h"
+#include "msp2crsf.h"
+#include "stubborn_receiver.h"
+#include "stubborn_sender.h"
+#include "telemetry_protocol.h"
+
+// 8ms between telemetry packets, 500Hz at 1:4
+#define REPLAY_TLM_INTERVAL_MS 8
+#define REPLAY_SYNTHETIC_MS 3000
+
+CRSFRouter crsfRouter;
+
+typedef enum {
+    STAGE_PARSE,
+    STAGE_ROUTE,
+    STAGE_QUEUE,
+    STAGE_MSP,
+    STAGE_DOWNLINK,
+    STAGE_COUNT
+} replayStage_e;
+
+static const char *stageNames[STAGE_COUNT] = {"parse", "route", "queue", "msp", "downlink"};
+static uint64_t stageNs[STAGE_COUNT];
+static uint32_t stageCalls[STAGE_COUNT];
+// Time spent in the timers started inside the current one
+static uint64_t nestedNs;
+
+/**
+ * Adds the time until it goes out of scope to a stage, less the time of the timers inside it
+ */
+class StageTimer
+{
+public:
+    explicit StageTimer(const replayStage_e stage) : stage(stage), outerNested(nestedNs), start(std::chrono::steady_clock::now())
+    {
+        nestedNs = 0;
+    }
+
+    ~StageTimer()
+    {
+        const uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        stageNs[stage] += elapsed - nestedNs;
+        stageCalls[stage]++;
+        nestedNs = outerNested + elapsed;
+    }
+
+private:
+    replayStage_e stage;
+    uint64_t outerNested;
+    std::chrono::steady_clock::time_point start;
+};
+
+static uint32_t replayNowMs;
+
+class ReplayOTAConnector final : public RXOTAConnector
+{
+public:
+    void forwardMessage(const crsf_header_t *message) override
+    {
+        StageTimer timer(STAGE_QUEUE);
+        forwarded++;
+        queueMessage(message, replayNowMs);
+    }
+
+    uint32_t forwarded = 0;
+};
+
+class ReplayConnector final : public CRSFConnector
+{
+public:
+    void forwardMessage(const crsf_header_t *message) override
+    {
+        forwarded++;
+        if (message->type != CRSF_FRAMETYPE_MSP_REQ && message->type != CRSF_FRAMETYPE_MSP_WRITE && message->type != CRSF_FRAMETYPE_MSP_RESP)
+        {
+            return;
+        }
+        StageTimer timer(STAGE_MSP);
+        crsf2msp.parse((const uint8_t *)message, [this](const uint8_t *frame, const uint32_t frameLen) {
+            mspFrames++;
+            // Back to CRSF for the receiver, which takes it for itself
+            msp2crsf.parse(this, frame, frameLen, CRSF_ADDRESS_BLUETOOTH_WIFI, CRSF_ADDRESS_CRSF_RECEIVER);
+        });
+    }
+
+    uint32_t forwarded = 0;
+    uint32_t mspFrames = 0;
+
+private:
+    CROSSFIRE2MSP crsf2msp;
+    MSP2CROSSFIRE msp2crsf;
+};
+
+class ReplayEndpoint final : public CRSFEndpoint
+{
+public:
+    ReplayEndpoint() : CRSFEndpoint(CRSF_ADDRESS_CRSF_RECEIVER) {}
+
+    void handleMessage(const crsf_header_t *message) override
+    {
+        // Only the frames sent to the receiver, it is offered every broadcast too
+        if (message->type >= CRSF_FRAMETYPE_DEVICE_PING && ((const crsf_ext_header_t *)message)->dest_addr == getDeviceId())
+            handled++;
+    }
+
+    uint32_t handled = 0;
+};
+
+typedef struct {
+    uint32_t framesIn;
+    uint32_t framesOut;
+    uint32_t recordsOut;    // frames the capture has going out to a connector
+    uint32_t payloads;
+    uint32_t packages;
+    uint32_t durationMs;
+} replayResult_t;
+
+static std::vector<uint8_t> captureData;
+
+static bool loadCaptureFile(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return false;
+    }
+    uint8_t buffer[4096];
+    size_t len;
+    captureData.clear();
+    while ((len = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        captureData.insert(captureData.end(), buffer, buffer + len);
+    }
+    fclose(file);
+    return true;
+}
+
+static void addFrame(CRSFCapture &capture, const uint8_t connector, const uint32_t timeMs, const crsf_frame_type_e type, const uint8_t *payload, const uint8_t payloadLen)
+{
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+    memcpy(&frame[sizeof(crsf_header_t)], payload, payloadLen);
+    crsfRouter.SetHeaderAndCrc((crsf_header_t *)frame, type, CRSF_FRAME_SIZE(payloadLen));
+    capture.add(connector, CRSF_CAPTURE_IN, (crsf_header_t *)frame, timeMs * 1000);
+}
+
+static void addMspFrame(CRSFCapture &capture, const uint8_t connector, const uint32_t timeMs, const crsf_frame_type_e type, const crsf_addr_e dest, const crsf_addr_e orig, const uint8_t function, const uint8_t mspLen)
+{
+    static uint8_t seq = 0;
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+    uint8_t *payload = &frame[sizeof(crsf_ext_header_t)];
+    // A whole MSPv1 frame in one chunk: status, length, function and the payload
+    payload[0] = (1 << 5) | (1 << 4) | (seq++ & 0b1111);
+    payload[1] = mspLen;
+    payload[2] = function;
+    for (uint8_t i = 0; i < mspLen; i++)
+    {
+        payload[3 + i] = i + timeMs;
+    }
+    crsfRouter.SetExtendedHeaderAndCrc((crsf_ext_header_t *)frame, type, 3 + mspLen + CRSF_FRAME_LENGTH_EXT_TYPE_CRC, dest, orig);
+    capture.add(connector, CRSF_CAPTURE_IN, (crsf_header_t *)frame, timeMs * 1000);
+}
+
+/**
+ * A receiver (connector 0 is the link) with a flight controller on its serial port (connector 1).
+ * The flight controller sends the usual telemetry and the handset reads MSP from it.
+ */
+static void makeCapture(CRSFCapture &capture)
+{
+    uint8_t payload[CRSF_MAX_PACKET_LEN] = {};
+    capture.clear();
+
+    // The flight controller answers a device ping, so the router learns where it is
+    payload[0] = CRSF_ADDRESS_CRSF_RECEIVER;
+    payload[1] = CRSF_ADDRESS_FLIGHT_CONTROLLER;
+    memcpy(&payload[2], "Betaflight\0", 11);
+    addFrame(capture, 1, 0, CRSF_FRAMETYPE_DEVICE_INFO, payload, 2 + 11 + 14);
+
+    for (uint32_t now = 1; now < REPLAY_SYNTHETIC_MS; now++)
+    {
+        payload[0] = now;
+        if (now % 100 == 0)
+        {
+            addFrame(capture, 1, now, CRSF_FRAMETYPE_ATTITUDE, payload, 6);
+            addFrame(capture, 1, now, CRSF_FRAMETYPE_VARIO, payload, 2);
+            addFrame(capture, 1, now, CRSF_FRAMETYPE_BARO_ALTITUDE, payload, 4);
+        }
+        if (now % 200 == 0)
+            addFrame(capture, 1, now, CRSF_FRAMETYPE_GPS, payload, 15);
+        if (now % 500 == 0)
+        {
+            addFrame(capture, 1, now, CRSF_FRAMETYPE_BATTERY_SENSOR, payload, 8);
+            memcpy(payload, "ACRO\0", 5);
+            addFrame(capture, 1, now, CRSF_FRAMETYPE_FLIGHT_MODE, payload, 5);
+        }
+        // The handset reads MSP from the flight controller, which answers a little later
+        if (now % 100 == 0)
+            addMspFrame(capture, 0, now, CRSF_FRAMETYPE_MSP_REQ, CRSF_ADDRESS_FLIGHT_CONTROLLER, CRSF_ADDRESS_RADIO_TRANSMITTER, 101, 0);
+        if (now % 100 == 3)
+            addMspFrame(capture, 1, now, CRSF_FRAMETYPE_MSP_RESP, CRSF_ADDRESS_RADIO_TRANSMITTER, CRSF_ADDRESS_FLIGHT_CONTROLLER, 101, 22);
+        // and the Lua script on it polls the receiver's parameters
+        if (now % 250 == 0)
+        {
+            payload[0] = CRSF_ADDRESS_CRSF_RECEIVER;
+            payload[1] = CRSF_ADDRESS_ELRS_LUA;
+            payload[2] = now / 250 % 20;
+            payload[3] = 0;
+            addFrame(capture, 0, now, CRSF_FRAMETYPE_PARAMETER_READ, payload, 4);
+        }
+    }
+}
+
+static replayResult_t replay(const uint8_t *capture, const uint32_t captureLen, ReplayOTAConnector &ota, ReplayConnector *others, const uint8_t otherCount)
+{
+    replayResult_t result = {};
+    CRSFParser parsers[CRSF_ROUTER_MAX_CONNECTORS];
+    CRSFConnector *connectors[CRSF_ROUTER_MAX_CONNECTORS] = {&ota};
+    for (uint8_t i = 0; i < otherCount; i++)
+    {
+        connectors[i + 1] = &others[i];
+    }
+
+    StubbornSender sender;
+    StubbornReceiver receiver;
+    sender.setMaxPackageIndex(ELRS4_DATA_DL_MAX_PACKAGES);
+    sender.ResetState();
+    receiver.setMaxPackageIndex(ELRS4_DATA_DL_MAX_PACKAGES);
+    receiver.ResetState();
+    uint8_t received[CRSF_MAX_PACKET_LEN + 1];
+    receiver.SetDataToReceive(received, sizeof(received));
+    uint8_t payload[CRSF_MAX_PACKET_LEN];
+    uint8_t package[ELRS4_DATA_DL_BYTES_PER_CALL];
+    uint32_t nextSlotMs = 0;
+    const auto runSlots = [&](const uint32_t untilMs) {
+        for (; nextSlotMs <= untilMs; nextSlotMs += REPLAY_TLM_INTERVAL_MS)
+        {
+            StageTimer timer(STAGE_DOWNLINK);
+            uint8_t payloadLen;
+            if (!sender.IsActive() && ota.GetNextPayload(&payloadLen, payload, nextSlotMs))
+            {
+                sender.SetDataToTransmit(payload, payloadLen);
+                result.payloads++;
+            }
+            if (!sender.IsActive())
+                continue;
+            // A lossless link, the TX confirms every package
+            const uint8_t packageIndex = sender.GetCurrentPayload(package, sizeof(package));
+            receiver.ReceiveData(packageIndex, package, sizeof(package));
+            sender.ConfirmCurrentPayload(receiver.GetCurrentConfirm());
+            result.packages++;
+            if (receiver.HasFinishedData())
+                receiver.Unlock();
+        }
+    };
+
+    uint32_t pos = 0;
+    uint32_t firstUs = 0;
+    const crsfCaptureRecord_t *record;
+    const crsf_header_t *message;
+    while (CRSFCapture::next(capture, captureLen, pos, record, message))
+    {
+        if (result.framesIn + result.recordsOut == 0)
+            firstUs = record->timeUs;
+        replayNowMs = (record->timeUs - firstUs) / 1000;
+        runSlots(replayNowMs);
+
+        if (record->direction == CRSF_CAPTURE_OUT)
+        {
+            result.recordsOut++;
+            continue;
+        }
+        result.framesIn++;
+        const uint8_t connector = record->connector;
+        if (connector > otherCount)
+            continue;
+        // The parser routes every frame it finds, the route stage is split from it below
+        StageTimer timer(STAGE_PARSE);
+        parsers[connector].processBytes(connectors[connector], (const uint8_t *)message, CRSF_FRAME_SIZE(message->frame_size));
+    }
+    result.durationMs = replayNowMs;
+    // Let the queue empty, with the same slots
+    while (ota.GetFifoFullPct() > 0 || sender.IsActive())
+    {
+        replayNowMs += REPLAY_TLM_INTERVAL_MS;
+        runSlots(replayNowMs);
+    }
+
+    result.framesOut = ota.forwarded;
+    for (uint8_t i = 0; i < otherCount; i++)
+    {
+        result.framesOut += others[i].forwarded;
+    }
+    return result;
+}
+
+/**
+ * The parser alone, routing to a router without any connectors or endpoints
+ */
+static uint64_t parseOnlyNs(const uint8_t *capture, const uint32_t captureLen)
+{
+    CRSFParser parsers[CRSF_ROUTER_MAX_CONNECTORS];
+    uint32_t pos = 0;
+    const crsfCaptureRecord_t *record;
+    const crsf_header_t *message;
+    const auto start = std::chrono::steady_clock::now();
+    while (CRSFCapture::next(capture, captureLen, pos, record, message))
+    {
+        if (record->direction == CRSF_CAPTURE_IN && record->connector < CRSF_ROUTER_MAX_CONNECTORS)
+            parsers[record->connector].processBytes(nullptr, (const uint8_t *)message, CRSF_FRAME_SIZE(message->frame_size));
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static uint8_t connectorsIn(const uint8_t *capture, const uint32_t captureLen)
+{
+    uint8_t count = 1;
+    uint32_t pos = 0;
+    const crsfCaptureRecord_t *record;
+    const crsf_header_t *message;
+    while (CRSFCapture::next(capture, captureLen, pos, record, message))
+    {
+        if (record->connector < CRSF_ROUTER_MAX_CONNECTORS && record->connector >= count)
+            count = record->connector + 1;
+    }
+    return count;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_capture_ring_keeps_newest(void)
+{
+    static CRSFCapture capture;
+    uint8_t frame[CRSF_MAX_PACKET_LEN] = {};
+    const uint32_t frames = CRSF_CAPTURE_SIZE / 10;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        // Lengths vary, so records wrap around the end of the ring at any byte
+        frame[3] = i;
+        crsfRouter.SetHeaderAndCrc((crsf_header_t *)frame, CRSF_FRAMETYPE_BATTERY_SENSOR, CRSF_FRAME_SIZE(1 + i % 20));
+        capture.add(i % 3, (crsfCaptureDirection_e)(i & 1), (crsf_header_t *)frame, i);
+    }
+
+    // Read in odd sized pieces like the web server asks for them
+    std::vector<uint8_t> download(capture.size());
+    uint32_t offset = 0;
+    while (const uint32_t copied = capture.read(offset, &download[offset], 97))
+    {
+        offset += copied;
+    }
+    TEST_ASSERT_EQUAL(capture.size(), offset);
+    TEST_ASSERT_TRUE(capture.size() <= sizeof(crsfCaptureHeader_t) + CRSF_CAPTURE_SIZE);
+
+    const auto header = (const crsfCaptureHeader_t *)download.data();
+    TEST_ASSERT_EQUAL(CRSF_CAPTURE_VERSION, header->version);
+    TEST_ASSERT_TRUE(header->dropped > 0);
+
+    uint32_t pos = 0;
+    uint32_t records = 0;
+    uint32_t expected = header->dropped;
+    const crsfCaptureRecord_t *record;
+    const crsf_header_t *message;
+    while (CRSFCapture::next(download.data(), download.size(), pos, record, message))
+    {
+        TEST_ASSERT_EQUAL(expected, record->timeUs);
+        TEST_ASSERT_EQUAL(expected % 3, record->connector);
+        TEST_ASSERT_EQUAL(expected & 1, record->direction);
+        TEST_ASSERT_EQUAL(CRSF_FRAME_SIZE(1 + expected % 20), message->frame_size);
+        TEST_ASSERT_EQUAL((uint8_t)expected, ((const uint8_t *)message)[3]);
+        expected++;
+        records++;
+    }
+    TEST_ASSERT_EQUAL(download.size(), pos);
+    TEST_ASSERT_EQUAL(frames, header->dropped + records);
+
+    // Nothing more once the ring is read, and nothing recorded while it is stopped
+    TEST_ASSERT_EQUAL(0, capture.read(capture.size(), download.data(), 97));
+    capture.setEnabled(false);
+    capture.add(0, CRSF_CAPTURE_IN, (crsf_header_t *)frame, 0);
+    TEST_ASSERT_EQUAL(download.size(), capture.size());
+    capture.clear();
+    TEST_ASSERT_EQUAL(sizeof(crsfCaptureHeader_t), capture.size());
+}
+
+void test_capture_router_records_in_and_out(void)
+{
+    static CRSFCapture capture;
+    CRSFRouter router;
+    ReplayConnector handset, link;
+    router.addConnector(&handset);
+    router.addConnector(&link);
+    router.setCapture(&capture);
+
+    uint8_t frame[CRSF_MAX_PACKET_LEN] = {};
+    // A ping from the handset goes out over the link, then the FC's answer comes back to the handset only
+    router.SetExtendedHeaderAndCrc((crsf_ext_header_t *)frame, CRSF_FRAMETYPE_DEVICE_PING, CRSF_FRAME_LENGTH_EXT_TYPE_CRC, CRSF_ADDRESS_BROADCAST, CRSF_ADDRESS_RADIO_TRANSMITTER);
+    router.processMessage(&handset, (crsf_header_t *)frame);
+    router.SetExtendedHeaderAndCrc((crsf_ext_header_t *)frame, CRSF_FRAMETYPE_DEVICE_INFO, CRSF_FRAME_LENGTH_EXT_TYPE_CRC, CRSF_ADDRESS_RADIO_TRANSMITTER, CRSF_ADDRESS_FLIGHT_CONTROLLER);
+    router.processMessage(&link, (crsf_header_t *)frame);
+    router.processMessage(nullptr, (crsf_header_t *)frame);
+    router.setCapture(nullptr);
+    router.processMessage(&link, (crsf_header_t *)frame);
+
+    std::vector<uint8_t> download(capture.size());
+    TEST_ASSERT_EQUAL(download.size(), capture.read(0, download.data(), download.size()));
+    const uint8_t expected[][3] = {
+        {0, CRSF_CAPTURE_IN, CRSF_FRAMETYPE_DEVICE_PING},
+        {1, CRSF_CAPTURE_OUT, CRSF_FRAMETYPE_DEVICE_PING},
+        {1, CRSF_CAPTURE_IN, CRSF_FRAMETYPE_DEVICE_INFO},
+        {0, CRSF_CAPTURE_OUT, CRSF_FRAMETYPE_DEVICE_INFO},
+        {CRSF_CAPTURE_NO_CONNECTOR, CRSF_CAPTURE_IN, CRSF_FRAMETYPE_DEVICE_INFO},
+        {0, CRSF_CAPTURE_OUT, CRSF_FRAMETYPE_DEVICE_INFO},
+    };
+    uint32_t pos = 0;
+    const crsfCaptureRecord_t *record;
+    const crsf_header_t *message;
+    for (const auto &e : expected)
+    {
+        TEST_ASSERT_TRUE(CRSFCapture::next(download.data(), download.size(), pos, record, message));
+        TEST_ASSERT_EQUAL(e[0], record->connector);
+        TEST_ASSERT_EQUAL(e[1], record->direction);
+        TEST_ASSERT_EQUAL(e[2], message->type);
+    }
+    TEST_ASSERT_FALSE(CRSFCapture::next(download.data(), download.size(), pos, record, message));
+    TEST_ASSERT_EQUAL(3, handset.forwarded);
+}
+
+void test_capture_replay(void)
+{
+    const char *path = getenv("CRSF_CAPTURE_FILE");
+    const bool synthetic = path == nullptr;
+    if (synthetic)
+    {
+        static CRSFCapture capture;
+        makeCapture(capture);
+        captureData.resize(capture.size());
+        capture.read(0, captureData.data(), captureData.size());
+    }
+    else
+    {
+        TEST_ASSERT_TRUE_MESSAGE(loadCaptureFile(path), "CRSF_CAPTURE_FILE can not be read");
+    }
+    const auto header = (const crsfCaptureHeader_t *)captureData.data();
+    uint32_t pos = 0;
+    const crsfCaptureRecord_t *record;
+    const crsf_header_t *message;
+    TEST_ASSERT_TRUE_MESSAGE(CRSFCapture::next(captureData.data(), captureData.size(), pos, record, message), "not a capture");
+
+    const uint64_t parseNs = parseOnlyNs(captureData.data(), captureData.size());
+
+    ReplayOTAConnector ota;
+    ReplayConnector others[CRSF_ROUTER_MAX_CONNECTORS - 1];
+    static ReplayEndpoint endpoint;
+    const uint8_t otherCount = connectorsIn(captureData.data(), captureData.size()) - 1;
+    crsfRouter.addEndpoint(&endpoint);
+    crsfRouter.addConnector(&ota);
+    for (uint8_t i = 0; i < otherCount; i++)
+    {
+        crsfRouter.addConnector(&others[i]);
+    }
+    memset(stageNs, 0, sizeof(stageNs));
+    memset(stageCalls, 0, sizeof(stageCalls));
+    nestedNs = 0;
+
+    const replayResult_t result = replay(captureData.data(), captureData.size(), ota, others, otherCount);
+    // The parse stage timed the parser and the router together
+    const uint64_t routeNs = stageNs[STAGE_PARSE] > parseNs ? stageNs[STAGE_PARSE] - parseNs : 0;
+    stageNs[STAGE_ROUTE] = routeNs;
+    stageCalls[STAGE_ROUTE] = stageCalls[STAGE_PARSE];
+    stageNs[STAGE_PARSE] -= routeNs;
+
+    printf("%s capture, %u bytes, %u dropped, %u ms, %u frames in, %u forwarded (%u recorded)\n",
+        synthetic ? "made up" : path, (unsigned)captureData.size(), header->dropped, result.durationMs,
+        result.framesIn, result.framesOut, result.recordsOut);
+    for (uint8_t stage = 0; stage < STAGE_COUNT; stage++)
+    {
+        printf("%-8s %8u calls %10.1f us %8.1f ns/call\n", stageNames[stage], stageCalls[stage], stageNs[stage] / 1e3,
+            stageCalls[stage] ? (double)stageNs[stage] / stageCalls[stage] : 0.0);
+    }
+    printf("downlink %u payloads in %u packages\n", result.payloads, result.packages);
+    for (uint8_t c = 0; c < TELEM_CLASS_COUNT; c++)
+    {
+        const TelemetryAgeStats_s &stats = ota.getAgeStats((telemetryClass_e)c);
+        if (stats.count)
+        {
+            printf("class %u %5u frames, queued %6.1f ms avg %5u ms max, %u late\n", c, stats.count,
+                (float)stats.ageSumMs / stats.count, stats.ageMaxMs, stats.late);
+        }
+    }
+
+    TEST_ASSERT_TRUE(result.framesIn > 0);
+    if (synthetic)
+    {
+        // Every MSP request reached the flight controller and went round the converters
+        TEST_ASSERT_EQUAL(REPLAY_SYNTHETIC_MS / 100 - 1, others[0].mspFrames);
+        // The receiver gets the parameter reads, the flight controller's device info and the converted MSP
+        TEST_ASSERT_EQUAL(REPLAY_SYNTHETIC_MS / 250 - 1 + 1 + others[0].mspFrames, endpoint.handled);
+        // and every frame for the handset was sent down the link
+        uint32_t sent = 0;
+        for (uint8_t c = 0; c < TELEM_CLASS_COUNT; c++)
+            sent += ota.getAgeStats((telemetryClass_e)c).count;
+        TEST_ASSERT_TRUE(sent > 0);
+        TEST_ASSERT_TRUE(sent <= ota.forwarded);
+    }
+
+    crsfRouter.removeConnector(&ota);
+    for (uint8_t i = 0; i < otherCount; i++)
+    {
+        crsfRouter.removeConnector(&others[i]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_capture_ring_keeps_newest);
+    RUN_TEST(test_capture_router_records_in_and_out);
+    RUN_TEST(test_capture_replay);
+    UNITY_END();
+
+    return 0;
+}
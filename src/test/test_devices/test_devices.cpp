@@ -0,0 +1,182 @@
+#include <cstdint>
+#include <unity.h>
+#include <vector>
+
+#include "device.h"
+
+// Normally defined in common.cpp
+bool connectionHasModelMatch = true;
+bool teamraceHasModelMatch = true;
+
+static std::vector<char> calls;
+static int fastDelay = 10;
+
+static int fastTimeout()
+{
+    calls.push_back('f');
+    return fastDelay;
+}
+
+static int slowStart()
+{
+    return 25;
+}
+
+static int slowTimeout()
+{
+    calls.push_back('s');
+    return 25;
+}
+
+static int onceTimeout()
+{
+    calls.push_back('o');
+    return DURATION_NEVER;
+}
+
+static int onceEvent()
+{
+    calls.push_back('e');
+    return 5;
+}
+
+static device_t fastDevice = {
+    .name = "Fast",
+    .initialize = nullptr,
+    .start = fastTimeout,
+    .event = nullptr,
+    .timeout = fastTimeout
+};
+
+static device_t slowDevice = {
+    .name = "Slow",
+    .initialize = nullptr,
+    .start = slowStart,
+    .event = nullptr,
+    .timeout = slowTimeout
+};
+
+static device_t onceDevice = {
+    .name = "Once",
+    .initialize = nullptr,
+    .start = nullptr,
+    .event = onceEvent,
+    .timeout = onceTimeout,
+    .subscribe = EVENT_CONFIG_MAIN_CHANGED
+};
+
+static device_affinity_t devices[] = {
+    {&slowDevice, 1},
+    {&onceDevice, 1},
+    {&fastDevice, 1},
+};
+
+static void startDevices()
+{
+    fastDelay = 10;
+    devicesRegister(devices, sizeof(devices) / sizeof(devices[0]));
+    devicesInit();
+    devicesStart();
+    calls.clear();
+}
+
+void test_devices_deadlines()
+{
+    startDevices();
+
+    // Fast is due every 10ms and slow every 25ms, so the first time they're both due is at 50ms
+    for (unsigned long now = 0; now <= 50; now++)
+    {
+        devicesUpdate(now);
+    }
+    // and when several are due they're called in the order they were registered
+    TEST_ASSERT_EQUAL(7, calls.size());
+    TEST_ASSERT_EQUAL_MEMORY("ffsffsf", calls.data(), 7);
+
+    // Missed deadlines are only called once
+    calls.clear();
+    devicesUpdate(200);
+    TEST_ASSERT_EQUAL(2, calls.size());
+    TEST_ASSERT_EQUAL('s', calls[0]);
+    TEST_ASSERT_EQUAL('f', calls[1]);
+}
+
+void test_devices_events()
+{
+    startDevices();
+
+    // An event schedules the timeout of a device which had none
+    devicesTriggerEvent(EVENT_CONFIG_MAIN_CHANGED);
+    devicesUpdate(1);
+    TEST_ASSERT_EQUAL(1, calls.size());
+    TEST_ASSERT_EQUAL('e', calls[0]);
+    devicesUpdate(6);
+    TEST_ASSERT_EQUAL(2, calls.size());
+    TEST_ASSERT_EQUAL('o', calls[1]);
+
+    // Events a device isn't subscribed to don't call it
+    calls.clear();
+    devicesTriggerEvent(EVENT_CONFIG_FAN_CHANGED);
+    devicesUpdate(7);
+    TEST_ASSERT_EQUAL(0, calls.size());
+
+    // A device which asks to be called immediately is called once per update
+    fastDelay = DURATION_IMMEDIATELY;
+    devicesUpdate(10);
+    devicesUpdate(10);
+    devicesUpdate(10);
+    TEST_ASSERT_EQUAL(3, calls.size());
+
+    // and one which returns DURATION_NEVER is not called again
+    fastDelay = DURATION_NEVER;
+    devicesUpdate(11);
+    calls.clear();
+    devicesUpdate(1000);
+    TEST_ASSERT_EQUAL(1, calls.size());
+    TEST_ASSERT_EQUAL('s', calls[0]);
+}
+
+void test_devices_stats()
+{
+    startDevices();
+    for (unsigned long now = 1; now <= 100; now++)
+    {
+        devicesUpdate(now);
+    }
+
+    const char *name;
+    device_stats_t stats;
+    // The start() calls are counted too
+    TEST_ASSERT_TRUE(devicesGetStats(0, name, stats));
+    TEST_ASSERT_EQUAL_STRING("Slow", name);
+    TEST_ASSERT_EQUAL(1 + 4, stats.calls);
+    TEST_ASSERT_TRUE(stats.maxUs <= stats.totalUs);
+    TEST_ASSERT_TRUE(devicesGetStats(1, name, stats));
+    TEST_ASSERT_EQUAL_STRING("Once", name);
+    TEST_ASSERT_EQUAL(0, stats.calls);
+    TEST_ASSERT_TRUE(devicesGetStats(2, name, stats));
+    TEST_ASSERT_EQUAL_STRING("Fast", name);
+    TEST_ASSERT_EQUAL(1 + 10, stats.calls);
+    TEST_ASSERT_FALSE(devicesGetStats(3, name, stats));
+
+    devicesResetStats();
+    devicesGetStats(2, name, stats);
+    TEST_ASSERT_EQUAL(0, stats.calls);
+    TEST_ASSERT_EQUAL(0, stats.totalUs);
+    TEST_ASSERT_EQUAL(0, stats.maxUs);
+}
+
+// Unity setup/teardown
+void setUp() {}
+void tearDown() {}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_devices_deadlines);
+    RUN_TEST(test_devices_events);
+    RUN_TEST(test_devices_stats);
+    UNITY_END();
+
+    return 0;
+}
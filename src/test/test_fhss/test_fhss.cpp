@@ -1,6 +1,9 @@
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <SX1280_Regs.h>
 #include <FHSS.h>
+#include <FHSSquality.h>
 #include <unity.h>
 #include <set>
 
@@ -84,6 +87,167 @@ void test_fhss_reg_same(void)
     }
 }
 
+void test_fhss_freq_correction(void)
+{
+    FHSSrandomiseFHSSsequence(0x01020304L);
+    FreqCorrection = -37;
+    FreqCorrection_2 = 12;
+
+    const uint32_t numFhss = FHSSgetChannelCount();
+    for (unsigned int i = 1; i < 2 * FHSSgetSequenceCount(); i++) {
+        // Table lookups must match calculating each hop with the correction applied
+        uint32_t freq = FHSSgetNextFreq();
+        uint8_t channel = FHSSsequence[FHSSgetCurrIndex()];
+        TEST_ASSERT_EQUAL(FHSSconfig->freq_start + freq_spread * channel / FREQ_SPREAD_SCALE - FreqCorrection, freq);
+
+        uint8_t geminiChannel = (channel + numFhss / 2) % numFhss;
+        TEST_ASSERT_EQUAL(FHSSconfig->freq_start + freq_spread * geminiChannel / FREQ_SPREAD_SCALE - FreqCorrection_2, FHSSgetGeminiFreq());
+    }
+
+    FreqCorrection = 0;
+    FreqCorrection_2 = 0;
+}
+
+static void blacklistChannel(uint8_t *bitmap, uint8_t channel)
+{
+    bitmap[channel / 8] |= 1 << (channel % 8);
+}
+
+void test_fhss_blacklist_sanitize(void)
+{
+    FHSSrandomiseFHSSsequence(0x01020304L);
+
+    // The sync channel, channels past freq_count and anything over the limit are dropped
+    uint8_t bitmap[FHSS_BLACKLIST_BYTES];
+    memset(bitmap, 0xFF, sizeof(bitmap));
+    FHSSsanitizeBlacklist(bitmap);
+
+    unsigned count = 0;
+    for (unsigned ch = 0; ch < FHSS_BLACKLIST_BYTES * 8; ch++)
+        count += FHSSisBlacklisted(bitmap, ch) ? 1 : 0;
+    TEST_ASSERT_EQUAL(FHSSgetChannelCount() / FHSS_BLACKLIST_MAX_DIV, count);
+    TEST_ASSERT_FALSE(FHSSisBlacklisted(bitmap, sync_channel));
+}
+
+void test_fhss_blacklist_substitute(void)
+{
+    FHSSrandomiseFHSSsequence(0x01020304L);
+
+    uint8_t bitmap[FHSS_BLACKLIST_BYTES] = {0};
+    for (unsigned ch = 10; ch < 20; ch++)
+        blacklistChannel(bitmap, ch);
+
+    // Nothing changes until the next hop
+    TEST_ASSERT_TRUE(FHSSqueueBlacklist(bitmap, 1));
+    TEST_ASSERT_FALSE(FHSSqueueBlacklist(bitmap, 2));
+    TEST_ASSERT_EQUAL(0, FHSSblacklistEpoch);
+
+    const uint32_t numFhss = FHSSgetChannelCount();
+    const uint32_t initFreq = FHSSgetInitialFreq();
+    for (unsigned int i = 1; i < 2 * FHSSgetSequenceCount(); i++) {
+        uint32_t freq = FHSSgetNextFreq();
+        TEST_ASSERT_EQUAL(1, FHSSblacklistEpoch);
+
+        uint8_t channel = FHSSgetChannel(FHSSgetCurrIndex());
+        TEST_ASSERT_FALSE(FHSSisBlacklisted(bitmap, channel));
+        TEST_ASSERT_EQUAL(FHSSfreqRegs[channel], freq);
+
+        // Sync slots are never moved
+        if ((FHSSgetCurrIndex() % numFhss) == 0)
+            TEST_ASSERT_EQUAL(initFreq, freq);
+        else if (!FHSSisBlacklisted(bitmap, FHSSsequence[FHSSgetCurrIndex()]))
+            TEST_ASSERT_EQUAL(FHSSsequence[FHSSgetCurrIndex()], channel);
+    }
+
+    // The reset leaves the replacements the ISR may be reading alone
+    uint8_t goodChannels[FHSS_MAX_CHANNELS];
+    memcpy(goodChannels, FHSSgoodChannels, sizeof(goodChannels));
+    const uint8_t goodCount = FHSSgoodCount;
+    FHSSresetBlacklist();
+    TEST_ASSERT_EQUAL(0, FHSSblacklistEpoch);
+    TEST_ASSERT_EQUAL(goodCount, FHSSgoodCount);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(goodChannels, FHSSgoodChannels, sizeof(goodChannels));
+    for (unsigned int i = 0; i < FHSSgetSequenceCount(); i++)
+        TEST_ASSERT_EQUAL(FHSSsequence[i], FHSSgetChannel(i));
+}
+
+// Deterministic xorshift for the link simulation
+static uint32_t simRngState;
+static uint32_t simRng()
+{
+    simRngState ^= simRngState << 13;
+    simRngState ^= simRngState >> 17;
+    simRngState ^= simRngState << 5;
+    return simRngState;
+}
+
+/* Simulate a 500Hz link hopping every 4 packets, where the channels in [jamFirst, jamLast]
+ * lose jamLossPct% of packets and the rest lose baseLossPct%. The RX updates the channel
+ * stats every packet and the blacklist once a second, the blacklist is assumed to reach the
+ * TX immediately. Returns the LQ over the second half of the run
+ */
+static float simulateLink(bool adaptive, unsigned jamFirst, unsigned jamLast, unsigned jamLossPct, unsigned baseLossPct, unsigned *blacklisted)
+{
+    const unsigned rate = 500;
+    const unsigned hopInterval = 4;
+    const unsigned packets = rate * 60;
+
+    FHSSrandomiseFHSSsequence(0x01020304L);
+    simRngState = 0x2545F491;
+    FHSSChannelQuality quality;
+    uint8_t epoch = 0;
+    unsigned received = 0;
+    *blacklisted = 0;
+
+    for (unsigned pkt = 0; pkt < packets; pkt++)
+    {
+        if (pkt % hopInterval == 0)
+            FHSSgetNextFreq();
+
+        const uint8_t channel = FHSSgetChannel(FHSSgetCurrIndex());
+        const unsigned lossPct = (channel >= jamFirst && channel <= jamLast) ? jamLossPct : baseLossPct;
+        const bool ok = (simRng() % 100) >= lossPct;
+        quality.update(channel, ok, -70 + (int8_t)(simRng() % 7));
+        if (pkt >= packets / 2)
+            received += ok ? 1 : 0;
+
+        if (adaptive && pkt % rate == 0)
+        {
+            uint8_t bitmap[FHSS_BLACKLIST_BYTES];
+            *blacklisted = quality.buildBlacklist(bitmap);
+            if (memcmp(bitmap, FHSSblacklist, sizeof(bitmap)) != 0)
+                FHSSqueueBlacklist(bitmap, ++epoch);
+        }
+    }
+
+    FHSSresetBlacklist();
+    return 100.0f * received / (packets / 2);
+}
+
+void test_fhss_adaptive_jammed(void)
+{
+    // A WiFi/video TX sitting on 16MHz of the band, 80% loss, with 2% loss elsewhere
+    unsigned blacklisted;
+    const float lqFixed = simulateLink(false, 30, 45, 80, 2, &blacklisted);
+    const float lqAdaptive = simulateLink(true, 30, 45, 80, 2, &blacklisted);
+    printf("jammed 30-45: LQ fixed %.1f%%, adaptive %.1f%% (%u blacklisted)\n", lqFixed, lqAdaptive, blacklisted);
+
+    TEST_ASSERT_GREATER_OR_EQUAL(10, blacklisted);
+    TEST_ASSERT_TRUE(lqAdaptive > lqFixed + 10.0f);
+}
+
+void test_fhss_adaptive_uniform(void)
+{
+    // Uniform loss is range, not interference, and should not blacklist (or cost) much
+    unsigned blacklisted;
+    const float lqFixed = simulateLink(false, 0, 0, 30, 30, &blacklisted);
+    const float lqAdaptive = simulateLink(true, 0, 0, 30, 30, &blacklisted);
+    printf("uniform 30%% loss: LQ fixed %.1f%%, adaptive %.1f%% (%u blacklisted)\n", lqFixed, lqAdaptive, blacklisted);
+
+    TEST_ASSERT_LESS_OR_EQUAL(4, blacklisted);
+    TEST_ASSERT_TRUE(lqAdaptive > lqFixed - 1.0f);
+}
+
 // Unity setup/teardown
 void setUp() {}
 void tearDown() {}
@@ -96,6 +260,11 @@ int main(int argc, char **argv)
     RUN_TEST(test_fhss_unique);
     RUN_TEST(test_fhss_same);
     RUN_TEST(test_fhss_reg_same);
+    RUN_TEST(test_fhss_freq_correction);
+    RUN_TEST(test_fhss_blacklist_sanitize);
+    RUN_TEST(test_fhss_blacklist_substitute);
+    RUN_TEST(test_fhss_adaptive_jammed);
+    RUN_TEST(test_fhss_adaptive_uniform);
     UNITY_END();
 
     return 0;
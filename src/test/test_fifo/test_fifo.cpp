@@ -1,8 +1,16 @@
+#include <chrono>
 #include <cstdint>
+#include <cstdio>
 #include <FIFO.h>
 #include <unity.h>
 #include <set>
 
+#if defined(BENCHMARK)
+#define BENCH_FIFO_PASSES 200000
+#else
+#define BENCH_FIFO_PASSES 2000
+#endif
+
 using namespace std;
 
 const uint32_t fifoSize = 256;
@@ -159,6 +167,196 @@ void test_fifo_skip_empty()
     TEST_ASSERT_EQUAL(42, f.pop());
 }
 
+void test_fifo_pushBytes_wrap()
+{
+    // Every offset of the head, so some of the pushes and pops are split where the buffer wraps
+    uint8_t in[100], out[100];
+    for (int i = 0; i < 100; i++)
+        in[i] = i * 3;
+    for (uint32_t start = 0; start < fifoSize; start += 7)
+    {
+        f.flush();
+        for (uint32_t i = 0; i < start; i++)
+        {
+            f.push(0);
+            f.pop();
+        }
+        TEST_ASSERT_TRUE(f.pushBytes(in, 100));
+        TEST_ASSERT_EQUAL(100, f.size());
+        TEST_ASSERT_EQUAL(in[99], f[99]);
+        f.popBytes(out, 100);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(in, out, 100);
+        TEST_ASSERT_EQUAL(0, f.size());
+    }
+}
+
+void test_fifo_overflow_flush()
+{
+    FIFO<16> fifo;
+    const uint8_t data[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    TEST_ASSERT_TRUE(fifo.pushBytes(data, 10));
+    TEST_ASSERT_FALSE(fifo.pushBytes(data, 10));
+    TEST_ASSERT_EQUAL(0, fifo.size());
+    TEST_ASSERT_EQUAL(1, fifo.getOverflows());
+}
+
+void test_fifo_overflow_drop_newest()
+{
+    FIFO<16, FIFO_OVERFLOW_DROP_NEWEST> fifo;
+    const uint8_t data[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    TEST_ASSERT_TRUE(fifo.pushBytes(data, 10));
+    // The first 6 bytes fit, the rest are dropped
+    TEST_ASSERT_FALSE(fifo.pushBytes(data, 10));
+    TEST_ASSERT_EQUAL(16, fifo.size());
+    TEST_ASSERT_FALSE(fifo.push(11));
+    uint8_t out[16];
+    fifo.popBytes(out, 16);
+    TEST_ASSERT_EQUAL(10, out[9]);
+    TEST_ASSERT_EQUAL(1, out[10]);
+    TEST_ASSERT_EQUAL(6, out[15]);
+    TEST_ASSERT_EQUAL(2, fifo.getOverflows());
+}
+
+void test_fifo_overflow_drop_oldest_frame()
+{
+    FIFO<32, FIFO_OVERFLOW_DROP_OLDEST_FRAME> fifo;
+    // Three 9 byte packets with a 1 byte length header
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        const uint8_t packet[10] = {9, i, i, i, i, i, i, i, i, i};
+        TEST_ASSERT_TRUE(fifo.pushBytes(packet, 10));
+    }
+    // A fourth makes the first one go
+    const uint8_t packet[10] = {9, 3, 3, 3, 3, 3, 3, 3, 3, 3};
+    TEST_ASSERT_TRUE(fifo.pushBytes(packet, 10));
+    TEST_ASSERT_EQUAL(30, fifo.size());
+    TEST_ASSERT_EQUAL(9, fifo.pop());
+    TEST_ASSERT_EQUAL(1, fifo.pop());
+    TEST_ASSERT_EQUAL(1, fifo.getOverflows());
+    // Too large to ever fit
+    uint8_t large[40] = {39};
+    TEST_ASSERT_FALSE(fifo.pushBytes(large, 40));
+    TEST_ASSERT_EQUAL(28, fifo.size());
+}
+
+void test_fifo_overflow_reject()
+{
+    FIFO<16, FIFO_OVERFLOW_REJECT> fifo;
+    const uint8_t data[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    TEST_ASSERT_TRUE(fifo.pushBytes(data, 10));
+    TEST_ASSERT_FALSE(fifo.pushBytes(data, 10));
+    TEST_ASSERT_EQUAL(10, fifo.size());
+    TEST_ASSERT_TRUE(fifo.pushBytes(data, 6));
+    TEST_ASSERT_FALSE(fifo.push(11));
+    TEST_ASSERT_EQUAL(16, fifo.size());
+    TEST_ASSERT_EQUAL(1, fifo.pop());
+}
+
+void test_fifo_spans()
+{
+    f.flush();
+    for (uint32_t i = 0; i < fifoSize - 10; i++)
+    {
+        f.push(0);
+        f.pop();
+    }
+
+    // Read straight into the FIFO, the free space is in two pieces
+    uint8_t *write;
+    uint16_t len = f.reserveSpan(write);
+    TEST_ASSERT_EQUAL(10, len);
+    for (int i = 0; i < len; i++)
+        write[i] = i;
+    f.commitPush(len);
+    len = f.reserveSpan(write);
+    TEST_ASSERT_EQUAL(fifoSize - 10, len);
+    for (int i = 0; i < 20; i++)
+        write[i] = 10 + i;
+    f.commitPush(20);
+    TEST_ASSERT_EQUAL(30, f.size());
+
+    // And write it out the same way
+    const uint8_t *read;
+    len = f.peekSpan(read);
+    TEST_ASSERT_EQUAL(10, len);
+    TEST_ASSERT_EQUAL(9, read[9]);
+    f.commitPop(len);
+    len = f.peekSpan(read);
+    TEST_ASSERT_EQUAL(20, len);
+    TEST_ASSERT_EQUAL(10, read[0]);
+    TEST_ASSERT_EQUAL(29, read[19]);
+    f.commitPop(len);
+    TEST_ASSERT_EQUAL(0, f.size());
+    TEST_ASSERT_EQUAL(0, f.peekSpan(read));
+}
+
+void test_fifo_bench()
+{
+    // Telemetry sized packets through a FIFO the size of the serial output queue
+    static FIFO<256> bulk, byteWise, spans;
+    uint8_t packet[64], out[64];
+    for (int i = 0; i < 64; i++)
+        packet[i] = i;
+    uint32_t check[3] = {0, 0, 0};
+
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < BENCH_FIFO_PASSES; pass++)
+    {
+        for (uint8_t len = 13; len < 64; len += 17)
+        {
+            for (int i = 0; i < len; i++)
+                byteWise.push(packet[i]);
+            for (int i = 0; i < len; i++)
+                out[i] = byteWise.pop();
+            check[0] += out[len - 1];
+        }
+    }
+    const double byteSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < BENCH_FIFO_PASSES; pass++)
+    {
+        for (uint8_t len = 13; len < 64; len += 17)
+        {
+            bulk.pushBytes(packet, len);
+            bulk.popBytes(out, len);
+            check[1] += out[len - 1];
+        }
+    }
+    const double bulkSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Written out in place, as to a UART, instead of popped into a buffer
+    start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < BENCH_FIFO_PASSES; pass++)
+    {
+        for (uint8_t len = 13; len < 64; len += 17)
+        {
+            spans.pushBytes(packet, len);
+            const uint8_t *data;
+            uint8_t last = 0;
+            while (uint16_t count = spans.peekSpan(data))
+            {
+                last = data[count - 1];
+                spans.commitPop(count);
+            }
+            check[2] += last;
+        }
+    }
+    const double spanSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    TEST_ASSERT_EQUAL(check[0], check[1]);
+    TEST_ASSERT_EQUAL(check[0], check[2]);
+
+    const double total = (13 + 30 + 47) * (double)BENCH_FIFO_PASSES;
+    printf("%d passes of 13, 30 and 47 byte packets\n", BENCH_FIFO_PASSES);
+    printf("byte-wise  %8.1f MB/s\n", total / byteSeconds / 1e6);
+    printf("bulk       %8.1f MB/s (x%.2f)\n", total / bulkSeconds / 1e6, byteSeconds / bulkSeconds);
+    printf("spans      %8.1f MB/s (x%.2f)\n", total / spanSeconds / 1e6, byteSeconds / spanSeconds);
+#if defined(BENCHMARK)
+    TEST_ASSERT_TRUE_MESSAGE(bulkSeconds < byteSeconds, "bulk push/pop slower than byte-wise");
+#endif
+}
+
 // Unity setup/teardown
 void setUp() {}
 void tearDown() {}
@@ -174,6 +372,13 @@ int main(int argc, char **argv)
     RUN_TEST(test_fifo_skip_wraparound);
     RUN_TEST(test_fifo_skip_zero);
     RUN_TEST(test_fifo_skip_empty);
+    RUN_TEST(test_fifo_pushBytes_wrap);
+    RUN_TEST(test_fifo_overflow_flush);
+    RUN_TEST(test_fifo_overflow_drop_newest);
+    RUN_TEST(test_fifo_overflow_drop_oldest_frame);
+    RUN_TEST(test_fifo_overflow_reject);
+    RUN_TEST(test_fifo_spans);
+    RUN_TEST(test_fifo_bench);
     UNITY_END();
 
     return 0;
@@ -0,0 +1,726 @@
+/**
+ * This file is part of ExpressLRS
+ * See https://github.com/AlessandroAU/ExpressLRS
+ *
+ * Native end-to-end link simulator: a TX and an RX, each with its own drifting
+ * crystal, talking over a lossy channel. Both ends run the real OTA packing and
+ * CRC, FHSS, LQCALC, PFD and PhaseLock code, in the order tx_main and rx_main
+ * call them from their timer and radio ISRs (which cannot be built natively).
+ *
+ * Reports time-to-connected, time-to-lock, steady-state phase jitter and LQ for
+ * each air rate. A regular native test run simulates a few seconds per rate,
+ * -D BENCHMARK (env:native_bench) runs longer and adds more drift and loss.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unity.h>
+
+#include "CRSFEndpoint.h"
+#include "common.h"
+#include "targets.h"
+
+#include <FHSS.h>
+#include <LQCALC.h>
+#include <OTA.h>
+#include <PFD.h>
+#include <PhaseLock.h>
+
+class MockEndpoint : public CRSFEndpoint
+{
+public:
+    MockEndpoint() : CRSFEndpoint((crsf_addr_e)1) {}
+    void handleMessage(const crsf_header_t *message) override {}
+};
+CRSFEndpoint *crsfEndpoint = new MockEndpoint();
+
+uint32_t ChannelData[CRSF_NUM_CHANNELS];      // Current state of channels, CRSF format
+uint8_t UID[6] = {1,2,3,4,5,6};
+elrsLinkStatistics_t linkStats;
+
+#if defined(BENCHMARK)
+#define SIM_DURATION_MS 60000
+#else
+#define SIM_DURATION_MS 8000
+#endif
+
+#define SIM_NEVER INT64_MAX
+#define PACKET_TO_TOCK_SLACK 200        // as rx_main
+#define CONSIDER_CONN_GOOD_MILLIS 1000  // as rx_main
+#define SIM_IRQ_LATENCY_US 20           // end of a packet on air to the RXdone ISR reading micros()
+#define SIM_RX_PROCESSING_US 80         // RXdone ISR to the first tock after hwTimer::resume()
+#define SIM_SETTLED_US 5
+#define SIM_SETTLED_TOCKS 32
+
+// Air rates from the SX128x ExpressLRS_AirRateConfig/ExpressLRS_AirRateRFperf, common.cpp is not built natively
+typedef struct {
+    const char *name;
+    int32_t interval;               // us
+    uint16_t TOA;                   // us
+    uint8_t FHSShopInterval;
+    uint8_t numOfSends;
+    uint8_t tlmDenom;               // TLMinterval as 1:N
+    uint8_t PayloadLength;
+    uint16_t DisconnectTimeoutMs;
+    uint16_t RxLockTimeoutMs;
+    uint16_t SyncPktIntervalDisconnected;
+    uint16_t SyncPktIntervalConnected;
+} SimRate_s;
+
+static const SimRate_s simRates[] = {
+    {"F1000",      1000,   389, 2, 1, 128, OTA4_PACKET_SIZE, 2500, 2500,  3, 5000},
+    {"F500",       2000,   389, 2, 1, 128, OTA4_PACKET_SIZE, 2500, 2500,  3, 5000},
+    {"D500",       1000,   389, 2, 2, 128, OTA4_PACKET_SIZE, 2500, 2500,  3, 5000},
+    {"D250",       1000,   389, 2, 4, 128, OTA4_PACKET_SIZE, 2500, 2500,  3, 5000},
+    {"500Hz",      2000,  1507, 4, 1, 128, OTA4_PACKET_SIZE, 2500, 2500,  3, 5000},
+    {"333Hz Full", 3003,  2374, 4, 1, 128, OTA8_PACKET_SIZE, 2500, 2500,  4, 5000},
+    {"250Hz",      4000,  3300, 4, 1,  64, OTA4_PACKET_SIZE, 3000, 2500,  6, 5000},
+    {"150Hz",      6666,  5871, 4, 1,  32, OTA4_PACKET_SIZE, 3500, 2500, 10, 5000},
+    {"100Hz Full", 10000, 7605, 4, 1,  32, OTA8_PACKET_SIZE, 3500, 2500, 11, 5000},
+    {"50Hz",       20000, 10798, 2, 1, 16, OTA4_PACKET_SIZE, 4000, 2500,  0, 5000},
+};
+
+typedef struct {
+    double txPpm;           // crystal error, positive runs fast
+    double rxPpm;
+    double rxPpmPerSec;     // RX crystal drift, e.g. warming up
+    uint8_t lossPercent;    // random loss in both directions
+    uint16_t fadeEveryMs;   // every packet is lost for fadeMs out of every fadeEveryMs, 0 for no fades
+    uint16_t fadeMs;
+    uint8_t rxIrqJitterUs;  // RXdone ISR latency varies by up to this much
+} SimConfig_s;
+
+typedef struct {
+    int32_t connectedMs;    // since the TX started, -1 if never connected
+    int32_t lockedMs;       // -1 if the timer never locked
+    int32_t settledMs;      // first SIM_SETTLED_TOCKS tocks in a row within SIM_SETTLED_US, -1 if never
+    uint32_t disconnects;   // after the first connection
+    double phaseMean;       // us, of each tock against where it should be after lock, positive is early
+    double phaseStdDev;
+    double phaseMax;
+    PhaseLockStats_s pfd;   // PFD results after lock
+    double uplinkLQ;        // mean LQ reported by the RX after lock
+    double downlinkLQ;      // mean telemetry LQ seen by the TX after lock
+} SimResult_s;
+
+// Deterministic xorshift so results are reproducible
+static uint32_t rngState;
+static uint32_t simRng()
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+/**
+ * A free running crystal, converts between true time (ns) and local time (us)
+ */
+class SimClock
+{
+public:
+    SimClock(double ppm, double ppmPerSec, double startUs) : localUs(startUs), ppm(ppm), ppmPerSec(ppmPerSec) {}
+
+    void advanceTo(int64_t nowNs)
+    {
+        double const dtNs = (double)(nowNs - lastNs);
+        localUs += dtNs / 1000.0 * (1.0 + ppm * 1e-6);
+        ppm += ppmPerSec * dtNs * 1e-9;
+        lastNs = nowNs;
+    }
+
+    uint32_t micros() const { return (uint32_t)(uint64_t)localUs; }
+    uint32_t millis() const { return (uint32_t)(uint64_t)(localUs / 1000.0); }
+    // True time a local delay takes
+    int64_t toTrueNs(double us) const { return (int64_t)llround(us * 1000.0 / (1.0 + ppm * 1e-6)); }
+
+private:
+    double localUs;
+    double ppm;
+    double ppmPerSec;
+    int64_t lastNs = 0;
+};
+
+/**
+ * RX timer with the same tick/tock, FreqOffset and PhaseShift sequencing as the ESP32 hwTimer
+ */
+class SimTimer
+{
+public:
+    void updateInterval(uint32_t time) { HWtimerInterval = time * HWTIMER_TICKS_PER_US; }
+    void resetFreqOffset() { FreqOffset = 0; }
+    void setFreqOffset(int32_t newFreqOffset) { FreqOffset = newFreqOffset; }
+    int32_t getFreqOffset() const { return FreqOffset; }
+
+    void phaseShift(int32_t newPhaseShift)
+    {
+        int32_t const maxVal = HWtimerInterval >> 2;
+        PhaseShift = (newPhaseShift < -maxVal ? -maxVal : (newPhaseShift > maxVal ? maxVal : newPhaseShift)) * HWTIMER_TICKS_PER_US;
+    }
+
+    // Fires tock first, right away
+    void resume(int64_t nowNs)
+    {
+        if (running)
+            return;
+        running = true;
+        isTick = false;
+        nextNs = nowNs;
+    }
+
+    void stop()
+    {
+        running = false;
+        nextNs = SIM_NEVER;
+    }
+
+    // Schedules the next event, returns true if this one is a tock
+    bool fire(const SimClock &clock, int64_t nowNs)
+    {
+        int32_t NextInterval = (HWtimerInterval >> 1) + FreqOffset;
+        bool const tock = !isTick;
+        if (tock)
+        {
+            NextInterval += PhaseShift;
+            PhaseShift = 0;
+        }
+        nextNs = nowNs + clock.toTrueNs((double)NextInterval / HWTIMER_TICKS_PER_US);
+        isTick = !isTick;
+        return tock;
+    }
+
+    int64_t nextNs = SIM_NEVER;
+    bool running = false;
+
+private:
+    bool isTick = false;
+    uint32_t HWtimerInterval = 0;
+    int32_t PhaseShift = 0;
+    int32_t FreqOffset = 0;
+};
+
+typedef struct {
+    OTA_Packet_s pkt;
+    uint32_t freq;
+    int64_t arriveNs;       // SIM_NEVER when nothing is on air
+    bool lost;
+} SimAirPacket_s;
+
+/**
+ * OtaNonce and FHSSptr are globals, each end keeps its own copy while the other runs
+ */
+class SimEnd
+{
+public:
+    void enter() { OtaNonce = nonce; FHSSptr = fhssIndex; }
+    void leave() { nonce = OtaNonce; fhssIndex = FHSSptr; }
+
+private:
+    uint8_t nonce = 0;
+    uint8_t fhssIndex = 0;
+};
+
+class LinkSim
+{
+public:
+    LinkSim(const SimRate_s &rate, const SimConfig_s &config)
+        : rate(rate), config(config),
+          txClock(config.txPpm, 0, 0), rxClock(config.rxPpm, config.rxPpmPerSec, (double)(simRng() % 1000000))
+    {
+        FHSSrandomiseFHSSsequence(0x01020304L);
+        OtaUpdateCrcInitFromUid();
+        OtaUpdateSerializers(smHybridOr16ch, rate.PayloadLength);
+        for (unsigned ch = 0; ch < CRSF_NUM_CHANNELS; ++ch)
+            ChannelData[ch] = CRSF_CHANNEL_VALUE_MID;
+
+        uplink.arriveNs = SIM_NEVER;
+        downlink.arriveNs = SIM_NEVER;
+        txFreq = FHSSgetInitialFreq();
+        rxTimer.updateInterval(rate.interval);
+        phaseLock.setInterval(rate.interval);
+        // The TX boots some time into the simulation, the RX is already listening
+        txNextNs = (int64_t)(simRng() % 500000) * 1000;
+        txStartNs = txNextNs;
+        LostConnection();
+        memset(&result, 0, sizeof(result));
+        result.connectedMs = -1;
+        result.lockedMs = -1;
+        result.settledMs = -1;
+    }
+
+    void run(uint32_t durationMs)
+    {
+        int64_t const endNs = (int64_t)durationMs * 1000000;
+        while (true)
+        {
+            int64_t const nowNs = nextEventNs();
+            if (nowNs > endNs)
+                break;
+            txClock.advanceTo(nowNs);
+            rxClock.advanceTo(nowNs);
+
+            if (nowNs == uplink.arriveNs)
+                rxPacketArrived(nowNs);
+            else if (nowNs == downlink.arriveNs)
+                txTelemetryArrived(nowNs);
+            else if (nowNs == rxTimer.nextNs)
+                rxTimerFired(nowNs);
+            else if (nowNs == txNextNs)
+                txTimerFired(nowNs);
+            else
+                rxLoop(nowNs);
+        }
+
+        if (phaseCount)
+        {
+            result.phaseMean = phaseSum / phaseCount;
+            result.phaseStdDev = sqrt(fmax(0.0, phaseSumSq / phaseCount - result.phaseMean * result.phaseMean));
+        }
+        result.pfd = phaseLock.getStats();
+        if (lqSamples)
+        {
+            result.uplinkLQ = (double)uplinkLQSum / lqSamples;
+            result.downlinkLQ = (double)downlinkLQSum / lqSamples;
+        }
+    }
+
+    SimResult_s result;
+
+private:
+    int64_t nextEventNs() const
+    {
+        int64_t next = loopNextNs;
+        if (uplink.arriveNs < next) next = uplink.arriveNs;
+        if (downlink.arriveNs < next) next = downlink.arriveNs;
+        if (rxTimer.nextNs < next) next = rxTimer.nextNs;
+        if (txNextNs < next) next = txNextNs;
+        return next;
+    }
+
+    bool inFade(int64_t nowNs) const
+    {
+        if (config.fadeEveryMs == 0)
+            return false;
+        return (nowNs / 1000000) % config.fadeEveryMs >= (int64_t)(config.fadeEveryMs - config.fadeMs);
+    }
+
+    bool packetLost(int64_t nowNs) const
+    {
+        return inFade(nowNs) || (simRng() % 100) < config.lossPercent;
+    }
+
+    uint32_t simMillis(int64_t nowNs) const { return (uint32_t)(nowNs / 1000000); }
+
+    /*** TX, as tx_main timerCallback(), SendRCdataToRF() and HandleFHSS() ***/
+
+    void txTimerFired(int64_t nowNs)
+    {
+        txNextNs = nowNs + txClock.toTrueNs(rate.interval);
+        txEnd.enter();
+
+        OtaNonce++;
+        txSentNs[OtaNonce] = nowNs;
+
+        uint32_t const now = txClock.millis();
+        txConnected = txLastTlmMs != 0 && (now - txLastTlmMs) < rate.DisconnectTimeoutMs;
+
+        if (txTlmPhase == ttrpPreReceiveGap)
+        {
+            txTlmPhase = ttrpExpectingTelem;
+            txDownlinkLQ = txTlmLq.getLQ();
+            txTlmLq.inc();
+            txEnd.leave();
+            return;
+        }
+        txTlmPhase = ttrpTransmitting;
+
+        SimAirPacket_s &air = uplink;
+        memset(&air.pkt, 0, sizeof(air.pkt));
+        uint32_t const SyncInterval = txConnected ? rate.SyncPktIntervalConnected : rate.SyncPktIntervalDisconnected;
+        uint8_t const NonceFHSSresult = OtaNonce % rate.FHSShopInterval;
+        if ((txSyncSlot / 2) <= NonceFHSSresult && (now - txSyncLastSent > SyncInterval) && FHSSonSyncChannel())
+        {
+            OTA_Sync_s * const syncPtr = OtaIsFullRes ? &air.pkt.full.sync.sync : &air.pkt.std.sync;
+            air.pkt.std.type = PACKET_TYPE_SYNC;
+            syncPtr->fhssIndex = FHSSgetCurrIndex();
+            syncPtr->nonce = OtaNonce;
+            syncPtr->UID4 = UID[4];
+            syncPtr->UID5 = UID[5];
+            txSyncLastSent = now;
+            txSyncSlot = (txSyncSlot + 1) % (rate.FHSShopInterval * 2);
+        }
+        else
+        {
+            OtaPackChannelData(&air.pkt, ChannelData, false);
+        }
+        OtaGeneratePacketCrc(&air.pkt);
+        air.freq = txFreq;
+        air.arriveNs = nowNs + (int64_t)(rate.TOA + SIM_IRQ_LATENCY_US + simRng() % (config.rxIrqJitterUs + 1)) * 1000;
+        air.lost = packetLost(nowNs);
+
+        // HandleFHSS() on TXdone, for the next packet
+        if ((OtaNonce + 1) % rate.FHSShopInterval == 0)
+        {
+            txFreq = FHSSgetNextFreq();
+        }
+        if (rate.tlmDenom != 1 && ((OtaNonce + 1) % rate.tlmDenom) == 0)
+        {
+            txTlmPhase = ttrpPreReceiveGap;
+        }
+        txEnd.leave();
+    }
+
+    void txTelemetryArrived(int64_t nowNs)
+    {
+        SimAirPacket_s &air = downlink;
+        air.arriveNs = SIM_NEVER;
+        if (air.lost || air.freq != txFreq || txTlmPhase == ttrpTransmitting)
+            return;
+
+        txEnd.enter();
+        if (OtaValidatePacketCrc(&air.pkt))
+        {
+            txTlmLq.add();
+            txLastTlmMs = txClock.millis();
+        }
+        txEnd.leave();
+    }
+
+    /*** RX, as rx_main HWtimerCallbackTick/Tock(), ProcessRFPacket() and loop() ***/
+
+    uint8_t minLqForChaos() const
+    {
+        uint32_t const numfhss = FHSSgetChannelCount();
+        uint8_t const interval = rate.FHSShopInterval;
+        return interval * ((interval * numfhss + 99) / (interval * numfhss));
+    }
+
+    void rxTimerFired(int64_t nowNs)
+    {
+        rxEnd.enter();
+        if (rxTimer.fire(rxClock, nowNs))
+            rxTock(nowNs);
+        else
+            rxTick();
+        rxEnd.leave();
+    }
+
+    void rxTick()
+    {
+        if (rate.numOfSends == 1)
+        {
+            uplinkLQ = LQCalc.getLQ();
+        }
+        else if (!((OtaNonce - 1) % rate.numOfSends))
+        {
+            uplinkLQ = LQCalcDVDA.getLQ();
+            LQCalcDVDA.inc();
+        }
+
+        if (!alreadyTLMresp)
+            LQCalc.inc();
+        alreadyTLMresp = false;
+
+        if (result.lockedMs >= 0)
+        {
+            uplinkLQSum += uplinkLQ;
+            downlinkLQSum += txDownlinkLQ;
+            lqSamples++;
+        }
+    }
+
+    void rxTock(int64_t nowNs)
+    {
+        PFDloop.intEvent(rxClock.micros());
+        if (connectionState == connected)
+            recordPhase(nowNs);
+
+        OtaNonce++;
+
+        // HandleFHSS()
+        if (OtaNonce % rate.FHSShopInterval == 0 && connectionState != disconnected)
+        {
+            rxFreq = FHSSgetNextFreq();
+        }
+
+        // HandleSendDataDl()
+        if (connectionState != disconnected && rate.tlmDenom != 1 && !alreadyTLMresp && (OtaNonce % rate.tlmDenom) == 0)
+        {
+            alreadyTLMresp = true;
+            SimAirPacket_s &air = downlink;
+            memset(&air.pkt, 0, sizeof(air.pkt));
+            air.pkt.std.type = PACKET_TYPE_LINKSTATS;
+            OtaGeneratePacketCrc(&air.pkt);
+            air.freq = rxFreq;
+            air.arriveNs = nowNs + (int64_t)(rate.TOA + SIM_IRQ_LATENCY_US) * 1000;
+            air.lost = packetLost(nowNs);
+            rxTransmittingUntilNs = air.arriveNs;
+        }
+
+        // updatePhaseLock()
+        if (connectionState != disconnected && PFDloop.hasResult())
+        {
+            phaseLock.update(PFDloop.calcResult(), connectionState == connected);
+            rxTimer.setFreqOffset(phaseLock.getFreqOffset());
+            rxTimer.phaseShift(phaseLock.getPhaseShift());
+        }
+        PFDloop.reset();
+    }
+
+    // Where the tock should be is known exactly from when the TX sent the packet for this nonce
+    void recordPhase(int64_t nowNs)
+    {
+        int32_t const slack = std::max(rate.interval - 2 * rate.TOA, (int32_t)PACKET_TO_TOCK_SLACK);
+        int64_t const idealNs = txSentNs[OtaNonce] + (int64_t)(rate.TOA + SIM_IRQ_LATENCY_US + slack) * 1000;
+        double const err = (idealNs - nowNs) / 1000.0;
+
+        if (result.settledMs < 0)
+        {
+            settledTocks = fabs(err) <= SIM_SETTLED_US ? settledTocks + 1 : 0;
+            if (settledTocks == SIM_SETTLED_TOCKS)
+                result.settledMs = simMillis(nowNs) - simMillis(txStartNs);
+        }
+
+        if (result.lockedMs >= 0)
+        {
+            phaseSum += err;
+            phaseSumSq += err * err;
+            phaseCount++;
+            result.phaseMax = fmax(result.phaseMax, fabs(err));
+        }
+    }
+
+    void rxPacketArrived(int64_t nowNs)
+    {
+        SimAirPacket_s &air = uplink;
+        air.arriveNs = SIM_NEVER;
+        if (air.lost || air.freq != rxFreq || nowNs < rxTransmittingUntilNs)
+            return;
+        // RXdoneISR()
+        if (LQCalc.currentIsSet() && connectionState == connected)
+            return;
+
+        rxEnd.enter();
+        uint32_t const beginProcessing = rxClock.micros();
+        OTA_Packet_s otaPkt = air.pkt;
+        if (OtaValidatePacketCrc(&otaPkt))
+        {
+            int32_t const slack = std::max(rate.interval - 2 * rate.TOA, (int32_t)PACKET_TO_TOCK_SLACK);
+            PFDloop.extEvent(beginProcessing + slack);
+
+            bool doStartTimer = false;
+            uint32_t const now = rxClock.millis();
+            LastValidPacket = now;
+
+            if (otaPkt.std.type == PACKET_TYPE_RCDATA)
+            {
+                if (connectionState == connected && rate.numOfSends > 1 && !LQCalcDVDA.currentIsSet())
+                    LQCalcDVDA.add();
+            }
+            else if (otaPkt.std.type == PACKET_TYPE_SYNC)
+            {
+                OTA_Sync_s const * const otaSync = OtaIsFullRes ? &otaPkt.full.sync.sync : &otaPkt.std.sync;
+                LastSyncPacket = now;
+                if (connectionState == disconnected
+                    || OtaNonce != otaSync->nonce
+                    || FHSSgetCurrIndex() != otaSync->fhssIndex)
+                {
+                    FHSSsetCurrIndex(otaSync->fhssIndex);
+                    OtaNonce = otaSync->nonce;
+                    TentativeConnection();
+                    doStartTimer = true;
+                }
+            }
+
+            LQCalc.add();
+            if (doStartTimer)
+                rxTimer.resume(nowNs + SIM_RX_PROCESSING_US * 1000);
+        }
+        rxEnd.leave();
+    }
+
+    void rxLoop(int64_t nowNs)
+    {
+        loopNextNs = nowNs + 1000000;
+        uint32_t const now = rxClock.millis();
+
+        if (connectionState == tentative && (now - LastSyncPacket > rate.RxLockTimeoutMs))
+        {
+            LostConnection();
+        }
+
+        if (connectionState == connected && (int32_t)rate.DisconnectTimeoutMs < (int32_t)(now - LastValidPacket))
+        {
+            LostConnection();
+            result.disconnects++;
+        }
+
+        if (connectionState == tentative && phaseLock.isSettled() && LQCalc.getLQRaw() > minLqForChaos())
+        {
+            connectionState = connected;
+            RXtimerState = tim_tentative;
+            GotConnectionMillis = now;
+            if (result.connectedMs < 0)
+                result.connectedMs = simMillis(nowNs) - simMillis(txStartNs);
+        }
+
+        if (RXtimerState == tim_tentative && (now - GotConnectionMillis) > CONSIDER_CONN_GOOD_MILLIS && phaseLock.isSteady())
+        {
+            RXtimerState = tim_locked;
+            phaseLock.resetStats();
+            if (result.lockedMs < 0)
+                result.lockedMs = simMillis(nowNs) - simMillis(txStartNs);
+        }
+    }
+
+    void LostConnection()
+    {
+        connectionState = disconnected;
+        RXtimerState = tim_disconnected;
+        rxTimer.resetFreqOffset();
+        phaseLock.reset();
+        GotConnectionMillis = 0;
+        uplinkLQ = 0;
+        LQCalc.reset();
+        LQCalcDVDA.reset();
+        rxTimer.stop();
+        rxEnd.enter();
+        FHSSsetCurrIndex(0);
+        rxFreq = FHSSgetInitialFreq();
+        rxEnd.leave();
+    }
+
+    void TentativeConnection()
+    {
+        PFDloop.reset();
+        connectionState = tentative;
+        RXtimerState = tim_disconnected;
+        phaseLock.restart();
+    }
+
+    const SimRate_s &rate;
+    const SimConfig_s &config;
+
+    SimClock txClock;
+    SimClock rxClock;
+    int64_t loopNextNs = 0;
+    SimAirPacket_s uplink;
+    SimAirPacket_s downlink;
+
+    // TX
+    SimEnd txEnd;
+    int64_t txNextNs;
+    int64_t txStartNs;
+    int64_t txSentNs[256];
+    uint32_t txFreq;
+    TxTlmRcvPhase_e txTlmPhase = ttrpTransmitting;
+    uint8_t txSyncSlot = 0;
+    uint32_t txSyncLastSent = 0;
+    uint32_t txLastTlmMs = 0;
+    bool txConnected = false;
+    LQCALC<100> txTlmLq;
+    uint8_t txDownlinkLQ = 0;
+
+    // RX
+    SimEnd rxEnd;
+    SimTimer rxTimer;
+    PFD PFDloop;
+    PhaseLock phaseLock;
+    LQCALC<100> LQCalc;
+    LQCALC<100> LQCalcDVDA;
+    connectionState_e connectionState = disconnected;
+    RXtimerState_e RXtimerState = tim_disconnected;
+    uint32_t rxFreq = 0;
+    int64_t rxTransmittingUntilNs = 0;
+    bool alreadyTLMresp = false;
+    uint8_t uplinkLQ = 0;
+    uint32_t LastValidPacket = 0;
+    uint32_t LastSyncPacket = 0;
+    uint32_t GotConnectionMillis = 0;
+
+    // Stats
+    double phaseSum = 0, phaseSumSq = 0;
+    uint32_t phaseCount = 0;
+    uint32_t settledTocks = 0;
+    uint64_t uplinkLQSum = 0, downlinkLQSum = 0;
+    uint32_t lqSamples = 0;
+};
+
+void setUp()
+{
+    rngState = 0x2545F491;
+}
+
+void tearDown() {}
+
+static SimResult_s runRate(const SimRate_s &rate, const SimConfig_s &config)
+{
+    LinkSim sim(rate, config);
+    sim.run(SIM_DURATION_MS);
+    const SimResult_s &r = sim.result;
+    printf("  %-10s conn %5dms lock %5dms settle %5dms  phase %5.1f +-%4.1fus (max %5.1f)  pfd %4d..%-4d sd %4.1f  LQ up %5.1f dn %5.1f  disc %u\n",
+        rate.name, (int)r.connectedMs, (int)r.lockedMs, (int)r.settledMs, r.phaseMean, r.phaseStdDev, r.phaseMax,
+        (int)r.pfd.min, (int)r.pfd.max, r.pfd.stdDev, r.uplinkLQ, r.downlinkLQ, r.disconnects);
+    return r;
+}
+
+/* Every rate must connect, lock, and hold the lock with the expected LQ for the loss */
+static void test_link(const char *name, const SimConfig_s &config, uint8_t minLQ)
+{
+    printf("%s: %+.0fppm/%+.0fppm %+.1fppm/s, %u%% loss, fade %u/%ums, irq jitter %uus\n", name,
+        config.txPpm, config.rxPpm, config.rxPpmPerSec, config.lossPercent, config.fadeMs, config.fadeEveryMs, config.rxIrqJitterUs);
+    for (unsigned i = 0; i < sizeof(simRates) / sizeof(simRates[0]); ++i)
+    {
+        const SimRate_s &rate = simRates[i];
+        SimResult_s r = runRate(rate, config);
+
+        TEST_ASSERT_TRUE_MESSAGE(r.connectedMs >= 0, rate.name);
+        TEST_ASSERT_TRUE_MESSAGE(r.lockedMs >= 0, rate.name);
+        TEST_ASSERT_EQUAL_MESSAGE(0, r.disconnects, rate.name);
+        // Steady state the tock must stay well inside the slack after the packet
+        TEST_ASSERT_TRUE_MESSAGE(r.phaseStdDev < PACKET_TO_TOCK_SLACK / 4, rate.name);
+        TEST_ASSERT_TRUE_MESSAGE(r.uplinkLQ >= minLQ, rate.name);
+    }
+}
+
+void test_link_ideal()
+{
+    SimConfig_s config = {0, 0, 0, 0, 0, 0, 0};
+    test_link("ideal", config, 99);
+}
+
+void test_link_drift()
+{
+    SimConfig_s config = {20, -20, 0, 0, 0, 0, 4};
+    test_link("drift", config, 99);
+}
+
+void test_link_drift_loss()
+{
+    SimConfig_s config = {20, -20, 0.5, 10, 0, 0, 4};
+    test_link("drift+loss", config, 85);
+}
+
+#if defined(BENCHMARK)
+void test_link_worst_case()
+{
+    SimConfig_s config = {50, -50, 1, 20, 2000, 200, 10};
+    test_link("worst case", config, 65);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_link_ideal);
+    RUN_TEST(test_link_drift);
+    RUN_TEST(test_link_drift_loss);
+#if defined(BENCHMARK)
+    RUN_TEST(test_link_worst_case);
+#endif
+    UNITY_END();
+
+    return 0;
+}
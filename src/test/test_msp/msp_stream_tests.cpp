@@ -0,0 +1,254 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <unity.h>
+#include <vector>
+#include "crc.h"
+#include "msp.h"
+#include "msp_stream.h"
+
+#if defined(BENCHMARK)
+#define BENCH_MSP_STREAM_PASSES 2000
+#else
+#define BENCH_MSP_STREAM_PASSES 20
+#endif
+
+extern MSP MSPProtocol;
+
+static GENERIC_CRC8<0xD5> crc8_dvb_s2_test;
+
+static std::vector<uint8_t> makeFrameV2(uint8_t direction, uint16_t function, uint16_t payloadSize, uint8_t seed)
+{
+    std::vector<uint8_t> frame = {'$', 'X', direction, 0, (uint8_t)function, (uint8_t)(function >> 8), (uint8_t)payloadSize, (uint8_t)(payloadSize >> 8)};
+    for (uint32_t i = 0; i < payloadSize; i++)
+        frame.push_back(i * 7 + seed);
+    frame.push_back(crc8_dvb_s2_test.calc(&frame[3], frame.size() - 3));
+    return frame;
+}
+
+static std::vector<uint8_t> makeFrameV1(uint8_t direction, uint8_t function, uint16_t payloadSize, uint8_t seed)
+{
+    std::vector<uint8_t> frame = {'$', 'M', direction};
+    if (payloadSize >= 255)
+    {
+        frame.insert(frame.end(), {255, function, (uint8_t)payloadSize, (uint8_t)(payloadSize >> 8)});
+    }
+    else
+    {
+        frame.insert(frame.end(), {(uint8_t)payloadSize, function});
+    }
+    for (uint32_t i = 0; i < payloadSize; i++)
+        frame.push_back(i * 7 + seed);
+    uint8_t checksum = 0;
+    for (size_t i = 3; i < frame.size(); i++)
+        checksum ^= frame[i];
+    frame.push_back(checksum);
+    return frame;
+}
+
+class CollectingHandler final : public MSPStreamHandler
+{
+public:
+    bool onFrameStart(const mspFrameHeader_t &header, uint8_t *&frameArena) override
+    {
+        current.clear();
+        if (header.function == skipFunction)
+            return false;
+        if (arena.size() >= header.payloadSize)
+            frameArena = arena.data();
+        return true;
+    }
+
+    void onPayload(const mspFrameHeader_t &header, uint16_t offset, const uint8_t *data, uint16_t len) override
+    {
+        // Slices arrive in order and without gaps
+        TEST_ASSERT_EQUAL(current.size(), offset);
+        current.insert(current.end(), data, data + len);
+        slices++;
+    }
+
+    void onFrameEnd(const mspFrameHeader_t &header, bool valid) override
+    {
+        if (!valid)
+        {
+            invalid++;
+            return;
+        }
+        headers.push_back(header);
+        if (arena.size() >= header.payloadSize)
+            payloads.emplace_back(arena.begin(), arena.begin() + header.payloadSize);
+        else
+            payloads.push_back(current);
+    }
+
+    std::vector<mspFrameHeader_t> headers;
+    std::vector<std::vector<uint8_t>> payloads;
+    std::vector<uint8_t> current;
+    std::vector<uint8_t> arena;
+    uint32_t slices = 0;
+    uint32_t invalid = 0;
+    uint16_t skipFunction = 0xFFFF;
+};
+
+static void feed(MSPStream &stream, const std::vector<uint8_t> &bytes, MSPStreamHandler &handler, uint32_t seed)
+{
+    // Reads of 1 to 128 bytes, like the UART returns them
+    for (size_t pos = 0; pos < bytes.size();)
+    {
+        seed = seed * 1103515245 + 12345;
+        size_t len = 1 + (seed >> 16) % 128;
+        if (pos + len > bytes.size())
+            len = bytes.size() - pos;
+        stream.processBytes(&bytes[pos], len, handler);
+        pos += len;
+    }
+}
+
+static void assertPayload(const std::vector<uint8_t> &frame, size_t payloadStart, const std::vector<uint8_t> &payload)
+{
+    TEST_ASSERT_EQUAL(frame.size() - payloadStart - 1, payload.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&frame[payloadStart], payload.data(), payload.size());
+}
+
+void test_msp_stream_large_frames(void)
+{
+    // A VTX table sized reply, a v1 jumbo dump and a small command, with line noise between them
+    const auto vtxTable = makeFrameV2('>', 0x3001, 6000, 1);
+    const auto jumbo = makeFrameV1('>', 116, 1500, 2);
+    const auto small = makeFrameV1('<', 101, 0, 3);
+    std::vector<uint8_t> bytes = {'$', 'X', 0x20, 'M'};
+    bytes.insert(bytes.end(), vtxTable.begin(), vtxTable.end());
+    bytes.insert(bytes.end(), {'$', '$'});
+    bytes.insert(bytes.end(), jumbo.begin(), jumbo.end());
+    bytes.insert(bytes.end(), small.begin(), small.end());
+
+    MSPStream stream;
+    CollectingHandler handler;
+    feed(stream, bytes, handler, 1);
+
+    TEST_ASSERT_EQUAL(3, handler.headers.size());
+    TEST_ASSERT_EQUAL(0, handler.invalid);
+    TEST_ASSERT_EQUAL(MSP_VERSION_V2, handler.headers[0].version);
+    TEST_ASSERT_EQUAL(MSP_PACKET_RESPONSE, handler.headers[0].type);
+    TEST_ASSERT_EQUAL(0x3001, handler.headers[0].function);
+    TEST_ASSERT_EQUAL(6000, handler.headers[0].payloadSize);
+    assertPayload(vtxTable, 8, handler.payloads[0]);
+    // The payload was handed over in many slices, each straight from a read
+    TEST_ASSERT_TRUE(handler.slices > 6000 / 128);
+
+    TEST_ASSERT_EQUAL(MSP_VERSION_V1, handler.headers[1].version);
+    TEST_ASSERT_EQUAL(116, handler.headers[1].function);
+    TEST_ASSERT_EQUAL(1500, handler.headers[1].payloadSize);
+    assertPayload(jumbo, 7, handler.payloads[1]);
+
+    TEST_ASSERT_EQUAL(MSP_PACKET_COMMAND, handler.headers[2].type);
+    TEST_ASSERT_EQUAL(101, handler.headers[2].function);
+    TEST_ASSERT_EQUAL(0, handler.payloads[2].size());
+}
+
+void test_msp_stream_arena_skip_and_errors(void)
+{
+    const auto first = makeFrameV2('<', 0x1234, 3000, 4);
+    auto damaged = makeFrameV2('>', 0x1235, 2000, 5);
+    damaged[1000] ^= 0x40;
+    const auto &corrupt = damaged;
+    const auto skipped = makeFrameV2('>', 0x1236, 4000, 6);
+    const auto last = makeFrameV2('>', 0x1237, 100, 7);
+    std::vector<uint8_t> bytes;
+    for (const auto *frame : {&first, &corrupt, &skipped, &last})
+        bytes.insert(bytes.end(), frame->begin(), frame->end());
+
+    MSPStream stream;
+    CollectingHandler handler;
+    handler.arena.resize(3000);
+    handler.skipFunction = 0x1236;
+    feed(stream, bytes, handler, 2);
+
+    // The first and last were gathered in the arena, the corrupt one was reported and the skipped one not seen
+    TEST_ASSERT_EQUAL(0, handler.slices);
+    TEST_ASSERT_EQUAL(1, handler.invalid);
+    TEST_ASSERT_EQUAL(1, stream.getChecksumErrors());
+    TEST_ASSERT_EQUAL(2, handler.headers.size());
+    TEST_ASSERT_EQUAL(0x1234, handler.headers[0].function);
+    assertPayload(first, 8, handler.payloads[0]);
+    TEST_ASSERT_EQUAL(0x1237, handler.headers[1].function);
+    assertPayload(last, 8, handler.payloads[1]);
+}
+
+void test_msp_receive_too_large(void)
+{
+    // The fixed size packet drops a frame which does not fit, and finds the next one
+    const auto large = makeFrameV2('<', 1, MSP_PORT_INBUF_SIZE + 1, 0x55);
+    const auto small = makeFrameV2('<', 2, 4, 0x55);
+    int received = 0;
+    for (const auto *frame : {&large, &small})
+    {
+        for (uint8_t c : *frame)
+        {
+            if (MSPProtocol.processReceivedByte(c))
+            {
+                received++;
+                TEST_ASSERT_EQUAL(2, MSPProtocol.getReceivedPacket()->function);
+                MSPProtocol.markPacketReceived();
+            }
+        }
+    }
+    TEST_ASSERT_EQUAL(1, received);
+}
+
+class CountingHandler final : public MSPStreamHandler
+{
+public:
+    void onPayload(const mspFrameHeader_t &header, uint16_t offset, const uint8_t *data, uint16_t len) override
+    {
+        bytes += len;
+    }
+
+    void onFrameEnd(const mspFrameHeader_t &header, bool valid) override
+    {
+        frames += valid;
+    }
+
+    uint32_t bytes = 0;
+    uint32_t frames = 0;
+};
+
+void test_msp_stream_bench(void)
+{
+    std::vector<uint8_t> bytes;
+    for (uint16_t size : {4096, 64, 1024, 8, 8192})
+    {
+        const auto frame = makeFrameV2('>', size, size, size);
+        bytes.insert(bytes.end(), frame.begin(), frame.end());
+    }
+
+    // The same reads of 128 bytes, given whole and a byte at a time
+    CountingHandler bulk, byteWise;
+    MSPStream bulkStream, byteStream;
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < BENCH_MSP_STREAM_PASSES; pass++)
+    {
+        for (size_t pos = 0; pos < bytes.size(); pos += 128)
+            bulkStream.processBytes(&bytes[pos], std::min((size_t)128, bytes.size() - pos), bulk);
+    }
+    const double bulkSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < BENCH_MSP_STREAM_PASSES; pass++)
+    {
+        for (uint8_t c : bytes)
+            byteStream.processByte(c, byteWise);
+    }
+    const double byteSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    TEST_ASSERT_EQUAL(5 * BENCH_MSP_STREAM_PASSES, bulk.frames);
+    TEST_ASSERT_EQUAL(bulk.frames, byteWise.frames);
+    TEST_ASSERT_EQUAL(bulk.bytes, byteWise.bytes);
+
+    const double total = (double)bytes.size() * BENCH_MSP_STREAM_PASSES;
+    printf("%u byte stream, %d passes\n", (unsigned)bytes.size(), BENCH_MSP_STREAM_PASSES);
+    printf("byte-wise %8.1f MB/s\n", total / byteSeconds / 1e6);
+    printf("reads     %8.1f MB/s (x%.2f)\n", total / bulkSeconds / 1e6, byteSeconds / bulkSeconds);
+#if defined(BENCHMARK)
+    TEST_ASSERT_TRUE_MESSAGE(bulkSeconds < byteSeconds, "streaming whole reads slower than byte-wise");
+#endif
+}
@@ -107,6 +107,10 @@ void test_msp_send(void)
 
 extern void test_encapsulated_msp_send(void);
 extern void test_encapsulated_msp_send_too_long(void);
+extern void test_msp_stream_large_frames(void);
+extern void test_msp_stream_arena_skip_and_errors(void);
+extern void test_msp_receive_too_large(void);
+extern void test_msp_stream_bench(void);
 
 // Unity setup/teardown
 void setUp() {}
@@ -121,6 +125,11 @@ int main(int argc, char **argv)
     RUN_TEST(test_encapsulated_msp_send);
     RUN_TEST(test_encapsulated_msp_send_too_long);
 
+    RUN_TEST(test_msp_stream_large_frames);
+    RUN_TEST(test_msp_stream_arena_skip_and_errors);
+    RUN_TEST(test_msp_receive_too_large);
+    RUN_TEST(test_msp_stream_bench);
+
     UNITY_END();
 
     return 0;
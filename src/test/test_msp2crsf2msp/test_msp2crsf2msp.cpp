@@ -2,12 +2,16 @@
 #include "common.h"
 #include "crsf2msp.h"
 #include "msp2crsf.h"
+#include "msppipeline.h"
+#include <array>
+#include <deque>
 #include <iostream>
 #include <unity.h>
+#include <vector>
 
 using namespace std;
 
-GENERIC_CRC8 crsf_crc(CRSF_CRC_POLY);
+GENERIC_CRC8<CRSF_CRC_POLY> crsf_crc;
 
 MSP2CROSSFIRE msp2crsf;
 CROSSFIRE2MSP crsf2msp;
@@ -135,6 +139,284 @@ void MSPV2_SERIAL_SETTINGS_TEST()
     // cout << endl;
 }
 
+class CaptureConnector : public CRSFConnector
+{
+public:
+    explicit CaptureConnector(crsf_addr_e device)
+    {
+        addDevice(device);
+    }
+
+    void forwardMessage(const crsf_header_t *message) override
+    {
+        packets.emplace_back((const uint8_t *)message, (const uint8_t *)message + CRSF_FRAME_SIZE(message->frame_size));
+    }
+
+    std::vector<std::vector<uint8_t>> packets;
+};
+
+static std::vector<uint8_t> makeMspV2(uint8_t direction, uint16_t function, uint16_t payloadSize)
+{
+    std::vector<uint8_t> frame = {'$', 'X', direction, 0, (uint8_t)function, (uint8_t)(function >> 8), (uint8_t)payloadSize, (uint8_t)(payloadSize >> 8)};
+    for (uint32_t i = 0; i < payloadSize; i++)
+        frame.push_back(i + function);
+    frame.push_back(crsf_crc.calc(&frame[3], frame.size() - 3));
+    return frame;
+}
+
+void MSP_TAGGED_OUT_OF_ORDER_TEST()
+{
+    crsfRouter.removeConnector(&crsfConnector);
+    CaptureConnector fc(CRSF_ADDRESS_FLIGHT_CONTROLLER);
+    crsfRouter.addConnector(&fc);
+
+    // Two frames of several chunks each, interleaved and with each one's chunks in reverse order
+    msp2crsf.parseTagged(nullptr, MSPV1_JUMBO_289, sizeof(MSPV1_JUMBO_289), 3, CRSF_ADDRESS_CRSF_TRANSMITTER, CRSF_ADDRESS_FLIGHT_CONTROLLER);
+    const size_t jumboChunks = fc.packets.size();
+    msp2crsf.parseTagged(nullptr, MSPV2_SERIAL_SETTINGS, sizeof(MSPV2_SERIAL_SETTINGS), 4, CRSF_ADDRESS_CRSF_TRANSMITTER, CRSF_ADDRESS_FLIGHT_CONTROLLER);
+    const auto hello = makeMspV2('<', 0x1001, 150);
+    msp2crsf.parseTagged(nullptr, hello.data(), hello.size(), 5, CRSF_ADDRESS_CRSF_TRANSMITTER, CRSF_ADDRESS_FLIGHT_CONTROLLER);
+    TEST_ASSERT_EQUAL(6, jumboChunks);
+    TEST_ASSERT_EQUAL(6 + 1 + 3, fc.packets.size());
+
+    std::vector<std::vector<uint8_t>> shuffled;
+    for (size_t i = 0; i < jumboChunks; i++)
+    {
+        shuffled.push_back(fc.packets[jumboChunks - 1 - i]);
+        if (i < 3)
+            shuffled.push_back(fc.packets[fc.packets.size() - 1 - i]);
+    }
+    shuffled.push_back(fc.packets[jumboChunks]);
+
+    CROSSFIRE2MSP reassembly;
+    std::vector<std::pair<uint8_t, std::vector<uint8_t>>> frames;
+    for (const auto &packet : shuffled)
+    {
+        reassembly.parse(packet.data(), [&](const uint8_t *frame, const uint32_t len) {
+            frames.emplace_back(reassembly.getTag(), std::vector<uint8_t>(frame, frame + len));
+        });
+    }
+    TEST_ASSERT_EQUAL(CRSF_MSP_NO_TAG, reassembly.getTag());
+
+    TEST_ASSERT_EQUAL(3, frames.size());
+    TEST_ASSERT_EQUAL(5, frames[0].first);
+    TEST_ASSERT_EQUAL(hello.size(), frames[0].second.size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(hello.data(), frames[0].second.data(), hello.size());
+    TEST_ASSERT_EQUAL(3, frames[1].first);
+    TEST_ASSERT_EQUAL(sizeof(MSPV1_JUMBO_289), frames[1].second.size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(MSPV1_JUMBO_289, frames[1].second.data(), sizeof(MSPV1_JUMBO_289));
+    TEST_ASSERT_EQUAL(4, frames[2].first);
+    TEST_ASSERT_EQUAL(sizeof(MSPV2_SERIAL_SETTINGS), frames[2].second.size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(MSPV2_SERIAL_SETTINGS, frames[2].second.data(), sizeof(MSPV2_SERIAL_SETTINGS));
+
+    crsfRouter.removeConnector(&fc);
+    crsfRouter.addConnector(&crsfConnector);
+}
+
+void MSP_TAGGED_MAX_LEN_TEST()
+{
+    crsfRouter.removeConnector(&crsfConnector);
+    CaptureConnector fc(CRSF_ADDRESS_FLIGHT_CONTROLLER);
+    crsfRouter.addConnector(&fc);
+
+    // The largest frame the receiver takes is sent and comes back whole, one byte more is not sent at all
+    const auto largest = makeMspV2('<', 0x1001, CRSF_MSP_TAGGED_MAX_FRAME_LEN - 5);
+    msp2crsf.parseTagged(nullptr, largest.data(), largest.size(), 1, CRSF_ADDRESS_CRSF_TRANSMITTER, CRSF_ADDRESS_FLIGHT_CONTROLLER);
+    CROSSFIRE2MSP reassembly;
+    std::vector<uint8_t> received;
+    for (const auto &packet : fc.packets)
+    {
+        reassembly.parse(packet.data(), [&](const uint8_t *frame, const uint32_t len) {
+            received.assign(frame, frame + len);
+        });
+    }
+    TEST_ASSERT_EQUAL(largest.size(), received.size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(largest.data(), received.data(), largest.size());
+
+    fc.packets.clear();
+    const auto tooLarge = makeMspV2('<', 0x1001, CRSF_MSP_TAGGED_MAX_FRAME_LEN - 4);
+    msp2crsf.parseTagged(nullptr, tooLarge.data(), tooLarge.size(), 2, CRSF_ADDRESS_CRSF_TRANSMITTER, CRSF_ADDRESS_FLIGHT_CONTROLLER);
+    TEST_ASSERT_EQUAL(0, fc.packets.size());
+
+    crsfRouter.removeConnector(&fc);
+    crsfRouter.addConnector(&crsfConnector);
+}
+
+void MSP_PIPELINE_TAGS_TEST()
+{
+    MSPPipeline pipeline(2, 100);
+    const uint8_t first = pipeline.startRequest(1, 0);
+    const uint8_t second = pipeline.startRequest(2, 0);
+    TEST_ASSERT_NOT_EQUAL(first, second);
+    TEST_ASSERT_EQUAL(CRSF_MSP_NO_TAG, pipeline.startRequest(3, 0));
+
+    // A response for the wrong function, then the right one, then a duplicate
+    TEST_ASSERT_FALSE(pipeline.completeRequest(second, 1));
+    TEST_ASSERT_TRUE(pipeline.completeRequest(second, 2));
+    TEST_ASSERT_FALSE(pipeline.completeRequest(second, 2));
+    TEST_ASSERT_EQUAL(1, pipeline.inFlight());
+
+    // The first one times out, and its late response is not taken for the next request
+    TEST_ASSERT_TRUE(pipeline.canSend(100));
+    TEST_ASSERT_EQUAL(0, pipeline.inFlight());
+    TEST_ASSERT_EQUAL(1, pipeline.getTimeouts());
+    const uint8_t third = pipeline.startRequest(1, 100);
+    TEST_ASSERT_NOT_EQUAL(first, third);
+    TEST_ASSERT_FALSE(pipeline.completeRequest(first, 1));
+    TEST_ASSERT_TRUE(pipeline.completeRequest(third, 1));
+}
+
+/**
+ * One direction of a simulated link: chunks are sent one at a time, each taking a slot of
+ * the link, and arrive half a round trip later unless they are lost.
+ */
+class SimulatedLink : public CRSFConnector
+{
+public:
+    SimulatedLink(crsf_addr_e device, uint32_t &now, uint32_t slotUs, uint32_t delayUs, uint32_t lossPercent)
+        : now(now), slotUs(slotUs), delayUs(delayUs), lossPercent(lossPercent)
+    {
+        addDevice(device);
+    }
+
+    void forwardMessage(const crsf_header_t *message) override
+    {
+        const uint32_t start = busyUntil > now ? busyUntil : now;
+        busyUntil = start + slotUs;
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 100 < lossPercent)
+        {
+            lost++;
+            return;
+        }
+        std::array<uint8_t, CRSF_MAX_PACKET_LEN> packet {};
+        memcpy(packet.data(), message, CRSF_FRAME_SIZE(message->frame_size));
+        inFlight.push_back({busyUntil + delayUs, packet});
+    }
+
+    template <typename F>
+    void deliver(F received)
+    {
+        while (!inFlight.empty() && inFlight.front().first <= now)
+        {
+            const auto packet = inFlight.front().second;
+            inFlight.pop_front();
+            received(packet.data());
+        }
+    }
+
+    uint32_t lost = 0;
+
+private:
+    uint32_t &now;
+    const uint32_t slotUs;
+    const uint32_t delayUs;
+    const uint32_t lossPercent;
+    uint32_t busyUntil = 0;
+    uint32_t seed = 1;
+    std::deque<std::pair<uint32_t, std::array<uint8_t, CRSF_MAX_PACKET_LEN>>> inFlight;
+};
+
+#define LOOPBACK_REQUESTS 32
+#define LOOPBACK_RESPONSE_SIZE 150  // three chunks
+#define LOOPBACK_RTT_US 100000
+#define LOOPBACK_SLOT_US 4000
+#define LOOPBACK_LOSS_PERCENT 5
+#define LOOPBACK_TIMEOUT_MS 400
+
+/**
+ * A configurator reading LOOPBACK_REQUESTS values from the flight controller over the link,
+ * returns the time taken in ms. A window of 1 uses the untagged chunks, as today.
+ */
+static uint32_t runLoopback(const uint8_t window, uint32_t &lost, uint32_t &timeouts)
+{
+    const bool tagged = window > 1;
+    uint32_t now = 0;
+    SimulatedLink uplink(CRSF_ADDRESS_FLIGHT_CONTROLLER, now, LOOPBACK_SLOT_US, LOOPBACK_RTT_US / 2, LOOPBACK_LOSS_PERCENT);
+    SimulatedLink downlink(CRSF_ADDRESS_CRSF_TRANSMITTER, now, LOOPBACK_SLOT_US, LOOPBACK_RTT_US / 2, LOOPBACK_LOSS_PERCENT);
+    crsfRouter.addConnector(&uplink);
+    crsfRouter.addConnector(&downlink);
+
+    MSP2CROSSFIRE configuratorOut, fcOut;
+    CROSSFIRE2MSP configuratorIn, fcIn;
+    MSPPipeline pipeline(window, LOOPBACK_TIMEOUT_MS);
+    bool done[LOOPBACK_REQUESTS] {};
+    bool sent[LOOPBACK_REQUESTS] {};
+    uint32_t sentAt[LOOPBACK_REQUESTS] {};
+    uint8_t untaggedTag = CRSF_MSP_NO_TAG;
+    uint32_t completed = 0;
+
+    while (completed < LOOPBACK_REQUESTS && now < 60 * 1000000)
+    {
+        // Requests which timed out are sent again
+        for (uint32_t i = 0; i < LOOPBACK_REQUESTS; i++)
+        {
+            if (sent[i] && !done[i] && now / 1000 - sentAt[i] >= LOOPBACK_TIMEOUT_MS)
+                sent[i] = false;
+        }
+        for (uint32_t i = 0; i < LOOPBACK_REQUESTS && pipeline.canSend(now / 1000); i++)
+        {
+            if (sent[i] || done[i])
+                continue;
+            const auto request = makeMspV2('<', 0x1000 + i, 2);
+            const uint8_t tag = pipeline.startRequest(0x1000 + i, now / 1000);
+            sent[i] = true;
+            sentAt[i] = now / 1000;
+            if (tagged)
+                configuratorOut.parseTagged(&downlink, request.data(), request.size(), tag, CRSF_ADDRESS_CRSF_TRANSMITTER, CRSF_ADDRESS_FLIGHT_CONTROLLER);
+            else
+                configuratorOut.parse(&downlink, request.data(), request.size(), CRSF_ADDRESS_CRSF_TRANSMITTER, CRSF_ADDRESS_FLIGHT_CONTROLLER);
+            untaggedTag = tag;
+        }
+
+        now += 1000;
+        // The flight controller answers each request, with the tag it came with
+        uplink.deliver([&](const uint8_t *packet) {
+            fcIn.parse(packet, [&](const uint8_t *frame, const uint32_t) {
+                const uint8_t tag = fcIn.getTag();
+                const auto response = makeMspV2('>', MSPPipeline::getFunction(frame), LOOPBACK_RESPONSE_SIZE);
+                if (tag != CRSF_MSP_NO_TAG)
+                    fcOut.parseTagged(&uplink, response.data(), response.size(), tag, CRSF_ADDRESS_FLIGHT_CONTROLLER, CRSF_ADDRESS_CRSF_TRANSMITTER);
+                else
+                    fcOut.parse(&uplink, response.data(), response.size(), CRSF_ADDRESS_FLIGHT_CONTROLLER, CRSF_ADDRESS_CRSF_TRANSMITTER);
+            });
+        });
+        downlink.deliver([&](const uint8_t *packet) {
+            configuratorIn.parse(packet, [&](const uint8_t *frame, const uint32_t len) {
+                const uint16_t function = MSPPipeline::getFunction(frame);
+                const uint8_t tag = configuratorIn.getTag() != CRSF_MSP_NO_TAG ? configuratorIn.getTag() : untaggedTag;
+                TEST_ASSERT_EQUAL(LOOPBACK_RESPONSE_SIZE + 9, len);
+                if (pipeline.completeRequest(tag, function) && !done[function - 0x1000])
+                {
+                    done[function - 0x1000] = true;
+                    completed++;
+                }
+            });
+        });
+    }
+
+    crsfRouter.removeConnector(&uplink);
+    crsfRouter.removeConnector(&downlink);
+    TEST_ASSERT_EQUAL(LOOPBACK_REQUESTS, completed);
+    lost = uplink.lost + downlink.lost;
+    timeouts = pipeline.getTimeouts();
+    return now / 1000;
+}
+
+void MSP_PIPELINED_LOOPBACK_TEST()
+{
+    crsfRouter.removeConnector(&crsfConnector);
+    uint32_t lost, timeouts;
+    const uint32_t singleMs = runLoopback(1, lost, timeouts);
+    printf("%d requests, %d ms RTT, %d%% loss\n", LOOPBACK_REQUESTS, LOOPBACK_RTT_US / 1000, LOOPBACK_LOSS_PERCENT);
+    printf("one at a time %5u ms (%u chunks lost, %u timeouts)\n", singleMs, lost, timeouts);
+    const uint32_t pipelinedMs = runLoopback(4, lost, timeouts);
+    printf("4 in flight   %5u ms (%u chunks lost, %u timeouts, x%.2f)\n", pipelinedMs, lost, timeouts, (double)singleMs / pipelinedMs);
+    crsfRouter.addConnector(&crsfConnector);
+
+    TEST_ASSERT_TRUE(pipelinedMs * 2 < singleMs);
+}
+
 // Unity setup/teardown
 void setUp()
 {
@@ -155,6 +437,10 @@ int main(int argc, char **argv)
     RUN_TEST(MSPV1_JUMBO_289_TEST);
     RUN_TEST(MSP_BOARD_INFO_81_TEST);
     RUN_TEST(MSPV2_SERIAL_SETTINGS_TEST);
+    RUN_TEST(MSP_TAGGED_OUT_OF_ORDER_TEST);
+    RUN_TEST(MSP_TAGGED_MAX_LEN_TEST);
+    RUN_TEST(MSP_PIPELINE_TAGS_TEST);
+    RUN_TEST(MSP_PIPELINED_LOOPBACK_TEST);
 
     UNITY_END();
 
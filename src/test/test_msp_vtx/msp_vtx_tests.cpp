@@ -10,7 +10,7 @@ using namespace std;
 
 uint32_t ChannelData[CRSF_NUM_CHANNELS];      // Current state of channels, CRSF format
 
-GENERIC_CRC8 test_crc(CRSF_CRC_POLY);
+GENERIC_CRC8<CRSF_CRC_POLY> test_crc;
 
 class MockEndpoint : public CRSFEndpoint
 {
@@ -0,0 +1,461 @@
+/**
+ * This file is part of ExpressLRS
+ * See https://github.com/AlessandroAU/ExpressLRS
+ *
+ * Unit tests for recovering OTA packets which fail CRC
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unity.h>
+
+#include "CRSFEndpoint.h"
+#include "common.h"
+#include "targets.h"
+
+#include <OTA.h>
+#include <OTARecovery.h>
+
+class MockEndpoint : public CRSFEndpoint
+{
+public:
+    MockEndpoint() : CRSFEndpoint((crsf_addr_e)1) {}
+    void handleMessage(const crsf_header_t *message) override {}
+};
+CRSFEndpoint *crsfEndpoint = new MockEndpoint();
+
+uint32_t ChannelData[CRSF_NUM_CHANNELS];      // Current state of channels, CRSF format
+uint8_t UID[6] = {1,2,3,4,5,6};
+elrsLinkStatistics_t linkStats;
+
+#ifdef BIG_TEST
+#define NUM_PACKETS 1000000
+#else
+#define NUM_PACKETS 20000
+#endif
+
+// Deterministic xorshift so failures are reproducible
+static uint32_t rngState;
+static uint32_t rng()
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static uint8_t packetSize()
+{
+    return OtaIsFullRes ? OTA8_PACKET_SIZE : OTA4_PACKET_SIZE;
+}
+
+// Build a valid RC packet with random channels for the current nonce
+static void makePacket(OTA_Packet_s * const otaPktPtr)
+{
+    for (unsigned ch = 0; ch < CRSF_NUM_CHANNELS; ++ch)
+        ChannelData[ch] = CRSF_CHANNEL_VALUE_MIN + rng() % (CRSF_CHANNEL_VALUE_MAX - CRSF_CHANNEL_VALUE_MIN + 1);
+    memset(otaPktPtr, 0, sizeof(*otaPktPtr));
+    OtaPackChannelData(otaPktPtr, ChannelData, false);
+    OtaGeneratePacketCrc(otaPktPtr);
+}
+
+// Flip each bit independently with probability 1/ber
+static unsigned injectErrors(OTA_Packet_s * const otaPktPtr, uint32_t const ber)
+{
+    unsigned flips = 0;
+    uint8_t * const data = (uint8_t *)otaPktPtr;
+    for (unsigned bit = 0; bit < packetSize() * 8U; ++bit)
+    {
+        if (rng() % ber == 0)
+        {
+            data[bit / 8] ^= 1 << (bit % 8);
+            ++flips;
+        }
+    }
+    return flips;
+}
+
+void setUp()
+{
+    rngState = 0x2545F491;
+    OtaUpdateCrcInitFromUid();
+    OtaNonce = 0;
+    memset(&OtaRecoveryStats, 0, sizeof(OtaRecoveryStats));
+}
+
+void tearDown() {}
+
+/* Every single bit error, including in the CRC itself, must be corrected back to the original
+ */
+void test_correct_single_bit(OtaSwitchMode_e mode, uint8_t size)
+{
+    OtaUpdateSerializers(mode, size);
+    unsigned corrected = 0;
+    for (unsigned nonce = 0; nonce < 256; nonce += 37)
+    {
+        OtaNonce = nonce;
+        OTA_Packet_s orig;
+        makePacket(&orig);
+
+        for (unsigned bit = 0; bit < size * 8U; ++bit)
+        {
+            OTA_Packet_s pkt = orig;
+            ((uint8_t *)&pkt)[bit / 8] ^= 1 << (bit % 8);
+            TEST_ASSERT_FALSE(OtaValidatePacketCrc(&pkt));
+
+            // Flipping a type bit to SYNC is not corrected, that is the only exception
+            bool const toSync = pkt.std.type == PACKET_TYPE_SYNC;
+            TEST_ASSERT_EQUAL(!toSync, OtaCorrectPacketCrc(&pkt));
+            if (!toSync)
+            {
+                TEST_ASSERT_EQUAL_UINT8_ARRAY((uint8_t *)&orig, (uint8_t *)&pkt, size);
+                ++corrected;
+            }
+        }
+    }
+    TEST_ASSERT_EQUAL(corrected, OtaRecoveryStats.corrected);
+}
+
+void test_correct_single_bit_std()
+{
+    test_correct_single_bit(smHybridOr16ch, OTA4_PACKET_SIZE);
+}
+
+void test_correct_single_bit_full()
+{
+    test_correct_single_bit(smWideOr8ch, OTA8_PACKET_SIZE);
+}
+
+/* A valid packet has a zero syndrome and must not be modified
+ */
+void test_correct_valid_packet_untouched()
+{
+    OtaUpdateSerializers(smHybridOr16ch, OTA4_PACKET_SIZE);
+    OTA_Packet_s orig, pkt;
+    makePacket(&orig);
+    pkt = orig;
+
+    TEST_ASSERT_FALSE(OtaCorrectPacketCrc(&pkt));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY((uint8_t *)&orig, (uint8_t *)&pkt, OTA4_PACKET_SIZE);
+    TEST_ASSERT_EQUAL(0, OtaRecoveryStats.corrected);
+}
+
+/* Simulate a link with random bit errors and compare the LQ with and without
+ * correction, and how many corrupt packets get accepted as valid because of it
+ */
+void test_correct_lq_gain(OtaSwitchMode_e mode, uint8_t size, const char *name)
+{
+    OtaUpdateSerializers(mode, size);
+    printf("%s: BER     LQ    LQ+fix  false accept (per corrupt packet)\n", name);
+
+    // 1 in N bits flipped
+    static const uint32_t bers[] = { 1000, 300, 100, 30 };
+    for (unsigned b = 0; b < sizeof(bers) / sizeof(bers[0]); ++b)
+    {
+        unsigned valid = 0, fixed = 0, falseAccept = 0, corrupt = 0;
+        for (unsigned i = 0; i < NUM_PACKETS; ++i)
+        {
+            OtaNonce = i;
+            OTA_Packet_s orig, pkt;
+            makePacket(&orig);
+            pkt = orig;
+
+            if (injectErrors(&pkt, bers[b]) == 0)
+            {
+                ++valid;
+                continue;
+            }
+            ++corrupt;
+
+            bool accepted = OtaValidatePacketCrc(&pkt);
+            if (!accepted)
+            {
+                accepted = OtaCorrectPacketCrc(&pkt);
+                if (accepted && memcmp(&orig, &pkt, size) == 0)
+                {
+                    ++fixed;
+                    continue;
+                }
+            }
+            if (accepted)
+                ++falseAccept;
+        }
+
+        float const lq = 100.0f * valid / NUM_PACKETS;
+        float const lqFixed = 100.0f * (valid + fixed) / NUM_PACKETS;
+        float const falseRate = corrupt ? 100.0f * falseAccept / corrupt : 0.0f;
+        printf("  1/%-5u %5.1f%% %5.1f%%  %u (%.3f%%)\n", bers[b], lq, lqFixed, falseAccept, falseRate);
+
+        // Correction must always help, and stay below 1% of corrupt packets being accepted
+        TEST_ASSERT_GREATER_THAN(valid, valid + fixed);
+        TEST_ASSERT_LESS_THAN(corrupt / 100 + 1, falseAccept);
+    }
+}
+
+void test_correct_lq_gain_std()
+{
+    test_correct_lq_gain(smHybridOr16ch, OTA4_PACKET_SIZE, "OTA4");
+}
+
+void test_correct_lq_gain_full()
+{
+    test_correct_lq_gain(smWideOr8ch, OTA8_PACKET_SIZE, "OTA8");
+}
+
+/* Four DVDA repeats each with a different bit error in the channels, majority vote must fix them
+ */
+void test_combine_dvda_majority()
+{
+    OtaUpdateSerializers(smWideOr8ch, OTA4_PACKET_SIZE);
+    OtaPacketCombiner combiner;
+    combiner.reset();
+
+    OTA_Packet_s orig[4];
+    makePacket(&orig[0]);
+    for (unsigned c = 0; c < 4; ++c)
+    {
+        // Same channels, but HybridWide switch and CRC change with the nonce
+        OtaNonce = c + 1;
+        memset(&orig[c], 0, sizeof(orig[c]));
+        OtaPackChannelData(&orig[c], ChannelData, false);
+        OtaGeneratePacketCrc(&orig[c]);
+
+        OTA_Packet_s pkt = orig[c];
+        ((uint8_t *)&pkt)[1 + c] ^= 1 << c;
+        TEST_ASSERT_FALSE(OtaValidatePacketCrc(&pkt));
+        combiner.add(&pkt, OtaNonce);
+    }
+
+    OTA_Packet_s result;
+    uint8_t nonce;
+    TEST_ASSERT_TRUE(combiner.combine(&result, &nonce));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY((uint8_t *)&orig[nonce - 1], (uint8_t *)&result, OTA4_PACKET_SIZE);
+    TEST_ASSERT_EQUAL(1, OtaRecoveryStats.combined);
+
+    // Unpacking with the nonce of the copy it was rebuilt from gives the original channels
+    uint32_t channels[CRSF_NUM_CHANNELS] = {0};
+    OtaNonce = nonce;
+    OtaUnpackChannelData(&result, channels);
+    for (unsigned ch = 0; ch < 4; ++ch)
+        TEST_ASSERT_UINT32_WITHIN(1, ChannelData[ch], channels[ch]);
+}
+
+/* A single copy can't be combined, and a full combiner ignores more copies
+ */
+void test_combine_needs_copies()
+{
+    OtaUpdateSerializers(smHybridOr16ch, OTA4_PACKET_SIZE);
+    OtaPacketCombiner combiner;
+    combiner.reset();
+
+    OTA_Packet_s pkt, result;
+    uint8_t nonce;
+    makePacket(&pkt);
+    ((uint8_t *)&pkt)[2] ^= 0x10;
+    combiner.add(&pkt, 0);
+    TEST_ASSERT_FALSE(combiner.combine(&result, &nonce));
+
+    for (unsigned c = 0; c < OTA_COMBINE_MAX_COPIES + 2; ++c)
+        combiner.add(&pkt, 0);
+    TEST_ASSERT_EQUAL(OTA_COMBINE_MAX_COPIES, combiner.getCount());
+}
+
+/* Simulate DVDA frames over a link with random bit errors. A frame is received if any
+ * repeat passes CRC, otherwise the failed repeats are combined
+ */
+void test_combine_dvda_lq_gain(uint8_t numOfSends)
+{
+    OtaUpdateSerializers(smWideOr8ch, OTA4_PACKET_SIZE);
+    printf("DVDA x%u: BER     LQ    LQ+comb  false accept (per lost frame)\n", numOfSends);
+
+    static const uint32_t bers[] = { 300, 100, 50, 30 };
+    for (unsigned b = 0; b < sizeof(bers) / sizeof(bers[0]); ++b)
+    {
+        unsigned received = 0, rescued = 0, falseAccept = 0, lost = 0;
+        for (unsigned frame = 0; frame < NUM_PACKETS / numOfSends; ++frame)
+        {
+            OtaPacketCombiner combiner;
+            combiner.reset();
+            OTA_Packet_s orig[4];
+            bool anyValid = false;
+
+            makePacket(&orig[0]);
+            for (unsigned c = 0; c < numOfSends; ++c)
+            {
+                OtaNonce = frame * numOfSends + c + 1;
+                memset(&orig[c], 0, sizeof(orig[c]));
+                OtaPackChannelData(&orig[c], ChannelData, false);
+                OtaGeneratePacketCrc(&orig[c]);
+
+                OTA_Packet_s pkt = orig[c];
+                injectErrors(&pkt, bers[b]);
+                if (OtaValidatePacketCrc(&pkt))
+                    anyValid = true;
+                else
+                    combiner.add(&pkt, OtaNonce);
+            }
+
+            if (anyValid)
+            {
+                ++received;
+                continue;
+            }
+            ++lost;
+
+            OTA_Packet_s result;
+            uint8_t nonce;
+            if (combiner.combine(&result, &nonce))
+            {
+                // Compare against the repeat which was sent with that nonce
+                unsigned c = (uint8_t)(nonce - 1) % numOfSends;
+                if (memcmp(&orig[c], &result, OTA4_PACKET_SIZE) == 0)
+                    ++rescued;
+                else
+                    ++falseAccept;
+            }
+        }
+
+        unsigned const frames = NUM_PACKETS / numOfSends;
+        printf("  1/%-5u %5.1f%% %5.1f%%  %u (%.3f%%)\n", bers[b], 100.0f * received / frames,
+            100.0f * (received + rescued) / frames, falseAccept, lost ? 100.0f * falseAccept / lost : 0.0f);
+
+        TEST_ASSERT_GREATER_OR_EQUAL(falseAccept, rescued);
+        TEST_ASSERT_LESS_THAN(lost / 100 + 1, falseAccept);
+    }
+}
+
+void test_combine_dvda_lq_gain_x2()
+{
+    test_combine_dvda_lq_gain(2);
+}
+
+void test_combine_dvda_lq_gain_x4()
+{
+    test_combine_dvda_lq_gain(4);
+}
+
+/* Both radios received the packet, with different bit errors. Every differing bit is
+ * tried so the original is found
+ */
+void test_pair_disjoint_errors()
+{
+    OtaUpdateSerializers(smWideOr8ch, OTA8_PACKET_SIZE);
+    OTA_Packet_s orig, first, second;
+    makePacket(&orig);
+    first = orig;
+    second = orig;
+    ((uint8_t *)&first)[2] ^= 0x21;
+    ((uint8_t *)&second)[7] ^= 0x80;
+    ((uint8_t *)&second)[OTA8_PACKET_SIZE - 1] ^= 0x04;
+    TEST_ASSERT_FALSE(OtaValidatePacketCrc(&first));
+    TEST_ASSERT_FALSE(OtaValidatePacketCrc(&second));
+
+    TEST_ASSERT_TRUE(OtaCombinePacketPair(&first, &second));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY((uint8_t *)&orig, (uint8_t *)&first, OTA8_PACKET_SIZE);
+    TEST_ASSERT_EQUAL(1, OtaRecoveryStats.paired);
+}
+
+/* Copies which differ in more bits than the search limit are not searched, and
+ * identical copies can not be improved on. The packet is left alone in both cases
+ */
+void test_pair_limits()
+{
+    OtaUpdateSerializers(smHybridOr16ch, OTA4_PACKET_SIZE);
+    OTA_Packet_s orig, first, second;
+    makePacket(&orig);
+    first = orig;
+    second = orig;
+    ((uint8_t *)&first)[1] ^= 0x01;
+    for (unsigned bit = 0; bit < OTA_COMBINE_MAX_SEARCH_BITS4; ++bit)
+        ((uint8_t *)&second)[3] ^= 1 << bit;
+    OTA_Packet_s const firstBefore = first;
+    TEST_ASSERT_FALSE(OtaCombinePacketPair(&first, &second));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY((uint8_t *)&firstBefore, (uint8_t *)&first, OTA4_PACKET_SIZE);
+
+    second = first;
+    TEST_ASSERT_FALSE(OtaCombinePacketPair(&first, &second));
+    TEST_ASSERT_EQUAL(0, OtaRecoveryStats.paired);
+}
+
+/* Simulate both radios receiving every packet with independent bit errors. A packet
+ * is received if either copy passes CRC, otherwise the pair is combined
+ */
+void test_pair_lq_gain(OtaSwitchMode_e mode, uint8_t size, const char *name)
+{
+    OtaUpdateSerializers(mode, size);
+    printf("%s pair: BER     LQ    LQ+pair  false accept (per lost packet)  ns/combine\n", name);
+
+    static const uint32_t bers[] = { 300, 100, 50, 30 };
+    for (unsigned b = 0; b < sizeof(bers) / sizeof(bers[0]); ++b)
+    {
+        unsigned received = 0, paired = 0, falseAccept = 0, lost = 0;
+        double totalNs = 0;
+        for (unsigned i = 0; i < NUM_PACKETS; ++i)
+        {
+            OtaNonce = i;
+            OTA_Packet_s orig, first, second;
+            makePacket(&orig);
+            first = orig;
+            second = orig;
+            injectErrors(&first, bers[b]);
+            injectErrors(&second, bers[b]);
+
+            if (OtaValidatePacketCrc(&first) || OtaValidatePacketCrc(&second))
+            {
+                ++received;
+                continue;
+            }
+            ++lost;
+
+            auto const start = std::chrono::steady_clock::now();
+            bool const accepted = OtaCombinePacketPair(&first, &second);
+            auto const elapsed = std::chrono::steady_clock::now() - start;
+            double const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+            totalNs += ns;
+
+            if (accepted && memcmp(&orig, &first, size) == 0)
+                ++paired;
+            else if (accepted)
+                ++falseAccept;
+        }
+
+        printf("  1/%-5u %5.1f%% %5.1f%%  %u (%.3f%%)  %.0f\n", bers[b], 100.0f * received / NUM_PACKETS,
+            100.0f * (received + paired) / NUM_PACKETS, falseAccept, lost ? 100.0f * falseAccept / lost : 0.0f, lost ? totalNs / lost : 0.0);
+
+        TEST_ASSERT_GREATER_OR_EQUAL(falseAccept, paired);
+        TEST_ASSERT_LESS_THAN(lost / 100 + 1, falseAccept);
+    }
+}
+
+void test_pair_lq_gain_std()
+{
+    test_pair_lq_gain(smHybridOr16ch, OTA4_PACKET_SIZE, "OTA4");
+}
+
+void test_pair_lq_gain_full()
+{
+    test_pair_lq_gain(smWideOr8ch, OTA8_PACKET_SIZE, "OTA8");
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_correct_single_bit_std);
+    RUN_TEST(test_correct_single_bit_full);
+    RUN_TEST(test_correct_valid_packet_untouched);
+    RUN_TEST(test_correct_lq_gain_std);
+    RUN_TEST(test_correct_lq_gain_full);
+    RUN_TEST(test_combine_dvda_majority);
+    RUN_TEST(test_combine_needs_copies);
+    RUN_TEST(test_combine_dvda_lq_gain_x2);
+    RUN_TEST(test_combine_dvda_lq_gain_x4);
+    RUN_TEST(test_pair_disjoint_errors);
+    RUN_TEST(test_pair_limits);
+    RUN_TEST(test_pair_lq_gain_std);
+    RUN_TEST(test_pair_lq_gain_full);
+    UNITY_END();
+
+    return 0;
+}
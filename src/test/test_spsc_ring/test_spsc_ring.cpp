@@ -0,0 +1,277 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <unity.h>
+
+#include "FIFO.h"
+#include "SPSCRing.h"
+#include "crsf_protocol.h"
+
+#if defined(BENCHMARK)
+#define STRESS_BYTES 50000000
+#else
+#define STRESS_BYTES 1000000
+#endif
+
+static uint32_t nextRandom(uint32_t &seed)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+void test_spsc_wrap()
+{
+    static SPSCRing<64> ring;
+    uint8_t in[40], out[40];
+    for (int i = 0; i < 40; i++)
+        in[i] = i + 1;
+
+    // Every offset of the head, so some of the copies are split where the buffer wraps
+    for (int pass = 0; pass < 64; pass++)
+    {
+        TEST_ASSERT_TRUE(ring.pushBytes(in, 40));
+        TEST_ASSERT_EQUAL(24, ring.free());
+        // All or nothing
+        TEST_ASSERT_FALSE(ring.pushBytes(in, 25));
+        TEST_ASSERT_TRUE(ring.popBytes(out, 39));
+        TEST_ASSERT_FALSE(ring.popBytes(out, 2));
+        TEST_ASSERT_EQUAL(40, ring.pop());
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(in, out, 39);
+        TEST_ASSERT_EQUAL(0, ring.size());
+        ring.push(0);
+        ring.pop();
+    }
+}
+
+void test_spsc_spans_and_flush()
+{
+    static SPSCRing<64> ring;
+    uint8_t buf[60] = {};
+    ring.pushBytes(buf, 60);
+    ring.popBytes(buf, 60);
+
+    // The free space is in two pieces
+    uint8_t *write;
+    TEST_ASSERT_EQUAL(4, ring.reserveSpan(write));
+    memcpy(write, "abcd", 4);
+    ring.commitPush(4);
+    TEST_ASSERT_EQUAL(60, ring.reserveSpan(write));
+    memcpy(write, "ef", 2);
+    ring.commitPush(2);
+
+    const uint8_t *read;
+    TEST_ASSERT_EQUAL(4, ring.peekSpan(read));
+    TEST_ASSERT_EQUAL_MEMORY("abcd", read, 4);
+    ring.commitPop(4);
+    TEST_ASSERT_EQUAL(2, ring.peekSpan(read));
+    TEST_ASSERT_EQUAL_MEMORY("ef", read, 2);
+
+    // A flush from the producer's side takes effect when the consumer next looks
+    ring.flush();
+    TEST_ASSERT_EQUAL(0, ring.peekSpan(read));
+    TEST_ASSERT_EQUAL(0, ring.size());
+    TEST_ASSERT_TRUE(ring.push(7));
+    TEST_ASSERT_EQUAL(7, ring.pop());
+}
+
+void test_spsc_frames()
+{
+    static SPSCFrameRing<64> ring;
+    uint8_t frame[40], out[40];
+    for (int i = 0; i < 40; i++)
+        frame[i] = i;
+
+    for (uint8_t len = 1; len < 40; len += 3)
+    {
+        TEST_ASSERT_TRUE(ring.pushFrame(frame, len));
+        TEST_ASSERT_TRUE(ring.pushFrame(frame, 64 - len - 4));
+        TEST_ASSERT_FALSE(ring.pushFrame(frame, 1));
+        TEST_ASSERT_EQUAL(len, ring.peekFrameSize());
+        TEST_ASSERT_EQUAL(len, ring.popFrame(out, sizeof(out)));
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(frame, out, len);
+        // Too large for the buffer given, so it is dropped
+        TEST_ASSERT_EQUAL(0, ring.popFrame(out, 1));
+        TEST_ASSERT_EQUAL(0, ring.size());
+        TEST_ASSERT_EQUAL(0, ring.popFrame(out, sizeof(out)));
+    }
+}
+
+/**
+ * A producer and a consumer thread passing a counting sequence through a ring, in randomly
+ * sized pieces. Every byte must arrive once and in order.
+ */
+void test_spsc_stress_bytes()
+{
+    static SPSCRing<256> ring;
+    std::thread producer([] {
+        uint32_t seed = 1;
+        uint8_t chunk[64];
+        for (uint32_t sent = 0; sent < STRESS_BYTES;)
+        {
+            const uint32_t len = std::min(1 + nextRandom(seed) % 64, STRESS_BYTES - sent);
+            for (uint32_t i = 0; i < len; i++)
+                chunk[i] = sent + i;
+            while (!ring.pushBytes(chunk, len))
+                std::this_thread::yield();
+            sent += len;
+        }
+    });
+
+    uint32_t received = 0;
+    uint32_t errors = 0;
+    uint32_t seed = 2;
+    while (received < STRESS_BYTES)
+    {
+        const uint8_t *data;
+        uint16_t len = ring.peekSpan(data);
+        if (len == 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        len = std::min(len, (uint16_t)(1 + nextRandom(seed) % 64));
+        for (uint16_t i = 0; i < len; i++)
+            errors += data[i] != (uint8_t)(received + i);
+        ring.commitPop(len);
+        received += len;
+    }
+    producer.join();
+    TEST_ASSERT_EQUAL(0, errors);
+    TEST_ASSERT_EQUAL(0, ring.size());
+}
+
+void test_spsc_stress_frames()
+{
+    static SPSCFrameRing<512> ring;
+    const uint32_t frames = STRESS_BYTES / 32;
+    std::thread producer([frames] {
+        uint32_t seed = 3;
+        uint8_t frame[CRSF_MAX_PACKET_LEN];
+        for (uint32_t n = 0; n < frames; n++)
+        {
+            const uint8_t len = 4 + nextRandom(seed) % (CRSF_MAX_PACKET_LEN - 4);
+            memcpy(frame, &n, sizeof(n));
+            for (uint8_t i = 4; i < len; i++)
+                frame[i] = n + i;
+            while (!ring.pushFrame(frame, len))
+                std::this_thread::yield();
+        }
+    });
+
+    uint32_t seed = 3;
+    uint32_t errors = 0;
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+    for (uint32_t n = 0; n < frames;)
+    {
+        const uint16_t len = ring.popFrame(frame, sizeof(frame));
+        if (len == 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        // Same sizes as the producer, whole frames and nothing else
+        errors += len != 4 + nextRandom(seed) % (CRSF_MAX_PACKET_LEN - 4);
+        uint32_t sequence;
+        memcpy(&sequence, frame, sizeof(sequence));
+        errors += sequence != n;
+        for (uint8_t i = 4; i < len; i++)
+            errors += frame[i] != (uint8_t)(n + i);
+        n++;
+    }
+    producer.join();
+    TEST_ASSERT_EQUAL(0, errors);
+}
+
+/**
+ * The FIFO with the lock taken as on the ESP32, a spinlock around each call
+ */
+class SpinLockedFifo
+{
+public:
+    bool pushBytes(const uint8_t *data, uint16_t len)
+    {
+        lock();
+        const bool pushed = fifo.free() >= len && fifo.pushBytes(data, len);
+        unlock();
+        return pushed;
+    }
+
+    bool popBytes(uint8_t *data, uint16_t len)
+    {
+        lock();
+        const bool popped = fifo.size() >= len;
+        if (popped)
+            fifo.popBytes(data, len);
+        unlock();
+        return popped;
+    }
+
+private:
+    void lock()
+    {
+        while (flag.test_and_set(std::memory_order_acquire))
+            ;
+    }
+    void unlock() { flag.clear(std::memory_order_release); }
+
+    FIFO<256> fifo;
+    std::atomic_flag flag = ATOMIC_FLAG_INIT;
+};
+
+template <typename Queue>
+static double runContention(Queue &queue)
+{
+    const auto start = std::chrono::steady_clock::now();
+    std::thread producer([&queue] {
+        uint8_t chunk[32] = {};
+        for (uint32_t sent = 0; sent < STRESS_BYTES; sent += sizeof(chunk))
+        {
+            while (!queue.pushBytes(chunk, sizeof(chunk)))
+                std::this_thread::yield();
+        }
+    });
+    uint8_t chunk[32];
+    for (uint32_t received = 0; received < STRESS_BYTES; received += sizeof(chunk))
+    {
+        while (!queue.popBytes(chunk, sizeof(chunk)))
+            std::this_thread::yield();
+    }
+    producer.join();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void test_spsc_contention_bench()
+{
+    static SpinLockedFifo locked;
+    static SPSCRing<256> ring;
+    const double lockedSeconds = runContention(locked);
+    const double ringSeconds = runContention(ring);
+
+    printf("%u bytes in 32 byte pieces, producer and consumer threads (%u cores)\n", STRESS_BYTES, std::thread::hardware_concurrency());
+    printf("locked FIFO %8.1f MB/s\n", STRESS_BYTES / lockedSeconds / 1e6);
+    printf("SPSC ring   %8.1f MB/s (x%.2f)\n", STRESS_BYTES / ringSeconds / 1e6, lockedSeconds / ringSeconds);
+#if defined(BENCHMARK)
+    TEST_ASSERT_TRUE_MESSAGE(ringSeconds < lockedSeconds, "SPSC ring slower than the locked FIFO");
+#endif
+}
+
+// Unity setup/teardown
+void setUp() {}
+void tearDown() {}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_spsc_wrap);
+    RUN_TEST(test_spsc_spans_and_flush);
+    RUN_TEST(test_spsc_frames);
+    RUN_TEST(test_spsc_stress_bytes);
+    RUN_TEST(test_spsc_stress_frames);
+    RUN_TEST(test_spsc_contention_bench);
+    UNITY_END();
+
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include <cstdint>
 #include <iostream>
 #include <bitset>
+#include <cstdio>
 #include <telemetry_protocol.h>
 #include <stubborn_sender.h>
 #include <stubborn_receiver.h>
@@ -504,6 +505,235 @@ void test_stubborn_link_forlorn_receiver(void)
     receiver.Unlock();
 }
 
+/***
+ * @brief: With a window, new packages are sent ahead of the acks and the oldest is repeated once the window is full
+*/
+void test_stubborn_window_sends_ahead(void)
+{
+    uint8_t testSequence[] = {1,2,3,4,5,6,7,8,9,10};
+    sender.setMaxPackageIndex(ELRS_MSP_MAX_PACKAGES);
+    sender.setWindow(3);
+    sender.ResetState();
+    sender.SetDataToTransmit(testSequence, sizeof(testSequence));
+    uint8_t data[2];
+
+    TEST_ASSERT_EQUAL(1, sender.GetCurrentPayload(data, 2));
+    TEST_ASSERT_EQUAL(2, sender.GetCurrentPayload(data, 2));
+    TEST_ASSERT_EQUAL(3, sender.GetCurrentPayload(data, 2));
+    TEST_ASSERT_EQUAL(5, data[0]);
+    // Window full, repeat the oldest
+    TEST_ASSERT_EQUAL(1, sender.GetCurrentPayload(data, 2));
+    TEST_ASSERT_EQUAL(1, data[0]);
+
+    // An ack for more packages than are in flight is stale and ignored
+    sender.ConfirmCurrentPayload(0);
+    TEST_ASSERT_EQUAL(1, sender.GetCurrentPayload(data, 2));
+
+    // Ack the first two, package 4 is sent but the final one waits for everything before it
+    sender.ConfirmCurrentPayload(2);
+    TEST_ASSERT_EQUAL(4, sender.GetCurrentPayload(data, 2));
+    TEST_ASSERT_EQUAL(3, sender.GetCurrentPayload(data, 2));
+    sender.ConfirmCurrentPayload(3);
+    TEST_ASSERT_EQUAL(4, sender.GetCurrentPayload(data, 2));
+    sender.ConfirmCurrentPayload(0); // 4 mod 4
+    TEST_ASSERT_EQUAL(0, sender.GetCurrentPayload(data, 2));
+    TEST_ASSERT_EQUAL(9, data[0]);
+    TEST_ASSERT_EQUAL(10, data[1]);
+    TEST_ASSERT_EQUAL(true, sender.IsActive());
+    sender.ConfirmCurrentPayload(1);
+    TEST_ASSERT_EQUAL(false, sender.IsActive());
+
+    sender.setWindow(1);
+}
+
+/***
+ * @brief: Packages received out of order are kept, and the ack jumps once the gap is filled
+*/
+void test_stubborn_window_receives_out_of_order(void)
+{
+    uint8_t testSequence[] = {1,2,3,4,5,6,7,8,9,10,11};
+    uint8_t buffer[20] = {0};
+    receiver.setMaxPackageIndex(ELRS_MSP_MAX_PACKAGES);
+    receiver.setWindow(3);
+    receiver.ResetState();
+    receiver.SetDataToReceive(buffer, sizeof(buffer));
+
+    receiver.ReceiveData(2, &testSequence[3], 3);
+    receiver.ReceiveData(3, &testSequence[6], 3);
+    TEST_ASSERT_EQUAL(0, receiver.GetCurrentAck());
+    // Outside of the window
+    receiver.ReceiveData(4, &testSequence[9], 3);
+    // The final package is not accepted until everything before it is
+    receiver.ReceiveData(0, &testSequence[9], 3);
+    TEST_ASSERT_EQUAL(false, receiver.HasFinishedData());
+
+    receiver.ReceiveData(1, &testSequence[0], 3);
+    TEST_ASSERT_EQUAL(3, receiver.GetCurrentAck());
+    TEST_ASSERT_EQUAL(true, receiver.GetCurrentConfirm());
+    // A repeat does not move the ack
+    receiver.ReceiveData(2, &testSequence[3], 3);
+    TEST_ASSERT_EQUAL(3, receiver.GetCurrentAck());
+
+    receiver.ReceiveData(0, &testSequence[9], 3);
+    TEST_ASSERT_EQUAL(true, receiver.HasFinishedData());
+    TEST_ASSERT_EQUAL(0, receiver.GetCurrentAck());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(testSequence, buffer, sizeof(testSequence));
+
+    receiver.Unlock();
+    receiver.setWindow(1);
+}
+
+/***
+ * @brief: A windowed sender which stops getting valid acks gives up on the message and resyncs, after
+ * which the next message goes through
+*/
+void test_stubborn_window_resyncs(void)
+{
+    uint8_t testSequence[] = {1,2,3,4,5,6,7,8,9,10};
+    uint8_t buffer[20] = {0};
+    uint8_t data[2];
+    uint8_t packageIndex;
+
+    sender.setMaxPackageIndex(ELRS_MSP_MAX_PACKAGES);
+    sender.setWindow(3);
+    sender.ResetState();
+    receiver.setMaxPackageIndex(ELRS_MSP_MAX_PACKAGES);
+    receiver.setWindow(3);
+    receiver.ResetState();
+    receiver.SetDataToReceive(buffer, sizeof(buffer));
+
+    // The receiver is one package ahead of the sender, so every ack looks wrong
+    receiver.ReceiveData(ELRS_MSP_MAX_PACKAGES, data, 0);
+    sender.SetDataToTransmit(testSequence, sizeof(testSequence));
+    sender.GetCurrentPayload(data, 2);
+    for (uint16_t i = 0; i <= sender.GetMaxPacketsBeforeResync(); i++)
+    {
+        sender.ConfirmCurrentPayload(3);
+    }
+    TEST_ASSERT_EQUAL(ELRS_MSP_MAX_PACKAGES, sender.GetCurrentPayload(data, 2));
+
+    int maxSends = 100;
+    while (sender.IsActive() && --maxSends)
+    {
+        packageIndex = sender.GetCurrentPayload(data, 2);
+        receiver.ReceiveData(packageIndex, data, 2);
+        sender.ConfirmCurrentPayload(receiver.GetCurrentAck());
+    }
+    TEST_ASSERT_NOT_EQUAL(0, maxSends);
+    TEST_ASSERT_EQUAL(false, receiver.HasFinishedData());
+
+    sender.SetDataToTransmit(testSequence, sizeof(testSequence));
+    maxSends = 100;
+    while (!receiver.HasFinishedData() && --maxSends)
+    {
+        packageIndex = sender.GetCurrentPayload(data, 2);
+        receiver.ReceiveData(packageIndex, data, 2);
+        sender.ConfirmCurrentPayload(receiver.GetCurrentAck());
+    }
+    TEST_ASSERT_NOT_EQUAL(0, maxSends);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(testSequence, buffer, sizeof(testSequence));
+
+    receiver.Unlock();
+    sender.setWindow(1);
+    receiver.setWindow(1);
+}
+
+static uint32_t lossyRng = 1;
+static bool lossyLinkDrops(uint8_t lossPct)
+{
+    lossyRng = lossyRng * 1103515245 + 12345;
+    return ((lossyRng >> 16) % 100) < lossPct;
+}
+
+/***
+ * @brief: Run MSP sized messages over a link where the RX acks in each telemetry slot and the TX
+ * sends data on every other packet between them, like the uplink, with both directions dropping
+ * packets. Every message must arrive intact
+ * @returns: messages delivered
+*/
+static uint32_t runLossyLink(uint8_t window, uint8_t tlmDenom, uint8_t lossPct, uint32_t slots)
+{
+    uint8_t message[ELRS_DATA_UL_BUFFER];
+    uint8_t buffer[ELRS_DATA_UL_BUFFER];
+    uint8_t data[ELRS4_DATA_UL_BYTES_PER_CALL];
+    uint32_t delivered = 0;
+    bool nextIsData = true;
+
+    lossyRng = 1;
+    sender.setMaxPackageIndex(ELRS_MSP_MAX_PACKAGES);
+    sender.setWindow(window);
+    sender.ResetState();
+    receiver.setMaxPackageIndex(ELRS_MSP_MAX_PACKAGES);
+    receiver.setWindow(window);
+    receiver.ResetState();
+    receiver.SetDataToReceive(buffer, sizeof(buffer));
+
+    for (uint32_t slot = 0; slot < slots; slot++)
+    {
+        if (!sender.IsActive())
+        {
+            for (uint8_t i = 0; i < sizeof(message); i++)
+                message[i] = delivered + i;
+            sender.SetDataToTransmit(message, sizeof(message));
+        }
+
+        if (slot % tlmDenom == 0)
+        {
+            if (!lossyLinkDrops(lossPct))
+                sender.ConfirmCurrentPayload(receiver.GetCurrentAck());
+        }
+        else if (nextIsData)
+        {
+            uint8_t packageIndex = sender.GetCurrentPayload(data, sizeof(data));
+            if (!lossyLinkDrops(lossPct))
+                receiver.ReceiveData(packageIndex, data, sizeof(data));
+            nextIsData = false;
+        }
+        else
+        {
+            nextIsData = true;
+        }
+
+        if (receiver.HasFinishedData())
+        {
+            TEST_ASSERT_EQUAL_UINT8_ARRAY(message, buffer, sizeof(message));
+            delivered++;
+            receiver.Unlock();
+        }
+    }
+
+    sender.setWindow(1);
+    receiver.setWindow(1);
+    return delivered;
+}
+
+/***
+ * @brief: Compare the uplink throughput of stop-and-wait and a window of 3 at a few telemetry ratios and loss rates
+*/
+void test_stubborn_window_lossy_throughput(void)
+{
+    const uint32_t slots = 20000;
+    const uint8_t tlmDenoms[] = {2, 4, 8, 16};
+    const uint8_t lossPcts[] = {0, 10, 30};
+
+    for (uint8_t tlmDenom : tlmDenoms)
+    {
+        for (uint8_t lossPct : lossPcts)
+        {
+            uint32_t stopAndWait = runLossyLink(1, tlmDenom, lossPct, slots);
+            uint32_t windowed = runLossyLink(ELRS_DATA_UL_WINDOW, tlmDenom, lossPct, slots);
+            printf("tlm 1:%-2u loss %2u%%: stop-and-wait %4u msgs, window %u %4u msgs (x%.2f)\n",
+                tlmDenom, lossPct, stopAndWait, ELRS_DATA_UL_WINDOW, windowed, (float)windowed / stopAndWait);
+
+            TEST_ASSERT_TRUE(stopAndWait > 0);
+            TEST_ASSERT_TRUE(windowed >= stopAndWait);
+            // Once the acks are the bottleneck, a window of 3 should get well over twice as much through
+            if (tlmDenom >= 8 && lossPct == 0)
+                TEST_ASSERT_TRUE(windowed > 2 * stopAndWait);
+        }
+    }
+}
+
 // Unity setup/teardown
 void setUp() {}
 void tearDown() {}
@@ -524,6 +754,10 @@ int main(int argc, char **argv)
     RUN_TEST(test_stubborn_link_variable_size_per_call);
     RUN_TEST(test_stubborn_link_premature_advance);
     RUN_TEST(test_stubborn_link_forlorn_receiver);
+    RUN_TEST(test_stubborn_window_sends_ahead);
+    RUN_TEST(test_stubborn_window_receives_out_of_order);
+    RUN_TEST(test_stubborn_window_resyncs);
+    RUN_TEST(test_stubborn_window_lossy_throughput);
     UNITY_END();
 
     return 0;
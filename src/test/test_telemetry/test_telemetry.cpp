@@ -40,28 +40,12 @@ public:
 
     void ResetState()
     {
-        while (messagePayloads.size() > 0)
-        {
-            const int size = messagePayloads.pop();
-            uint8_t buffer[size];
-            messagePayloads.popBytes(buffer, size);
-        }
+        clearQueue();
     }
 
     int UpdatedPayloadCount()
     {
-        int retVal = 0;
-        unsigned pos = 0;
-        while (pos < messagePayloads.size())
-        {
-            const uint8_t sz = messagePayloads[pos];
-            if (!(sz & bit(7)))
-            {
-                retVal++;
-            }
-            pos += 1 + (sz & ~bit(7));
-        }
-        return retVal;
+        return queuedCount();
     }
     std::vector<uint8_t> data;
 } connector;
@@ -182,14 +166,17 @@ void test_function_add_type(void)
 
     uint8_t data[CRSF_MAX_PACKET_LEN];
     uint8_t receivedLength;
-    connector.GetNextPayload(&receivedLength, data);
-
+    // Attitude has the shorter latency budget so goes first
     bool hasData = connector.GetNextPayload(&receivedLength, data);
     TEST_ASSERT_TRUE(hasData);
     for (int i = 0; i < length; i++)
     {
         TEST_ASSERT_EQUAL(attitudeSequence[i], data[i]);
     }
+
+    hasData = connector.GetNextPayload(&receivedLength, data);
+    TEST_ASSERT_TRUE(hasData);
+    TEST_ASSERT_EQUAL(CRSF_FRAMETYPE_BATTERY_SENSOR, data[CRSF_TELEMETRY_TYPE_INDEX]);
 }
 
 void test_function_recover_from_junk(void)
@@ -378,6 +365,144 @@ void test_prioritised_settings_entry_messages(void)
     TEST_ASSERT_EQUAL(CRSF_FRAMETYPE_BATTERY_SENSOR, payload[CRSF_TELEMETRY_TYPE_INDEX]);
 }
 
+void test_settings_entry_messages_per_field(void)
+{
+    uint8_t settingsSequence[] = {0xEC,0,0,0,0,0,0,0,0,0,0,0};
+    uint8_t payloadSize;
+    uint8_t payload[CRSF_MAX_PACKET_LEN];
+
+    // A list of changed fields followed by the entries of fields 1 and 2 are all queued
+    for (uint8_t field : {0xFF, 1, 2})
+    {
+        settingsSequence[5] = field;
+        settingsSequence[6] = 0;
+        crsfRouter.SetExtendedHeaderAndCrc((crsf_ext_header_t *)settingsSequence, CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY, sizeof(settingsSequence)-CRSF_FRAME_NOT_COUNTED_BYTES, CRSF_ADDRESS_CRSF_RECEIVER, CRSF_ADDRESS_RADIO_TRANSMITTER);
+        connector.forwardMessage((crsf_header_t *)settingsSequence);
+    }
+    TEST_ASSERT_EQUAL(3, connector.UpdatedPayloadCount());
+
+    // but a newer copy of the same field replaces the queued one
+    settingsSequence[5] = 1;
+    settingsSequence[6] = 1;
+    crsfRouter.SetExtendedHeaderAndCrc((crsf_ext_header_t *)settingsSequence, CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY, sizeof(settingsSequence)-CRSF_FRAME_NOT_COUNTED_BYTES, CRSF_ADDRESS_CRSF_RECEIVER, CRSF_ADDRESS_RADIO_TRANSMITTER);
+    connector.forwardMessage((crsf_header_t *)settingsSequence);
+    TEST_ASSERT_EQUAL(3, connector.UpdatedPayloadCount());
+
+    const uint8_t expected[][2] = {{0xFF, 0}, {1, 1}, {2, 0}};
+    for (const auto &entry : expected)
+    {
+        TEST_ASSERT_TRUE(connector.GetNextPayload(&payloadSize, payload));
+        TEST_ASSERT_EQUAL(entry[0], payload[5]);
+        TEST_ASSERT_EQUAL(entry[1], payload[6]);
+    }
+}
+
+void test_overwrite_keeps_queue_position(void)
+{
+    uint8_t batterySequence[] =  {CRSF_ADDRESS_CRSF_RECEIVER,10,CRSF_FRAMETYPE_BATTERY_SENSOR,0,0,0,0,0,0,0,0,109};
+    uint8_t batterySequence2[] = {CRSF_ADDRESS_CRSF_RECEIVER,10,CRSF_FRAMETYPE_BATTERY_SENSOR,1,0,0,0,0,0,0,0,46};
+    uint8_t cellsSequence[] = {CRSF_ADDRESS_CRSF_RECEIVER,6, CRSF_FRAMETYPE_CELLS,0,0,0,0,0};
+
+    sendData(batterySequence, sizeof(batterySequence));
+    connector.forwardMessage((crsf_header_t *)cellsSequence);
+    sendData(batterySequence2, sizeof(batterySequence2));
+    TEST_ASSERT_EQUAL(2, connector.UpdatedPayloadCount());
+
+    uint8_t data[CRSF_MAX_PACKET_LEN];
+    uint8_t receivedLength;
+    TEST_ASSERT_TRUE(connector.GetNextPayload(&receivedLength, data));
+    TEST_ASSERT_EQUAL(sizeof(batterySequence2), receivedLength);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(batterySequence2, data, sizeof(batterySequence2));
+    TEST_ASSERT_TRUE(connector.GetNextPayload(&receivedLength, data));
+    TEST_ASSERT_EQUAL(CRSF_FRAMETYPE_CELLS, data[CRSF_TELEMETRY_TYPE_INDEX]);
+    TEST_ASSERT_FALSE(connector.GetNextPayload(&receivedLength, data));
+}
+
+static void sendRpm(uint8_t source, uint8_t value)
+{
+    uint8_t rpm[] = {CRSF_ADDRESS_CRSF_RECEIVER,6,CRSF_FRAMETYPE_RPM,source,0,0,value,0};
+    connector.forwardMessage((crsf_header_t *)rpm);
+}
+
+void test_overwrite_per_source_id_when_full(void)
+{
+    // More sources than slots, the oldest are dropped and every remaining source is still found
+    for (int source = 0; source < TELEMETRY_QUEUE_SLOTS * 2; source++)
+    {
+        sendRpm(source, 1);
+    }
+    TEST_ASSERT_EQUAL(TELEMETRY_QUEUE_SLOTS, connector.UpdatedPayloadCount());
+    TEST_ASSERT_EQUAL(100, connector.GetFifoFullPct());
+    for (int source = TELEMETRY_QUEUE_SLOTS; source < TELEMETRY_QUEUE_SLOTS * 2; source++)
+    {
+        sendRpm(source, 2);
+    }
+    TEST_ASSERT_EQUAL(TELEMETRY_QUEUE_SLOTS, connector.UpdatedPayloadCount());
+
+    uint8_t data[CRSF_MAX_PACKET_LEN];
+    uint8_t receivedLength;
+    for (int source = TELEMETRY_QUEUE_SLOTS; source < TELEMETRY_QUEUE_SLOTS * 2; source++)
+    {
+        TEST_ASSERT_TRUE(connector.GetNextPayload(&receivedLength, data));
+        TEST_ASSERT_EQUAL(source, data[3]);
+        TEST_ASSERT_EQUAL(2, data[6]);
+        // Sending a source's frame frees its key, so the next update is queued again
+        sendRpm(source, 3);
+    }
+    for (int source = TELEMETRY_QUEUE_SLOTS; source < TELEMETRY_QUEUE_SLOTS * 2; source++)
+    {
+        TEST_ASSERT_TRUE(connector.GetNextPayload(&receivedLength, data));
+        TEST_ASSERT_EQUAL(source, data[3]);
+        TEST_ASSERT_EQUAL(3, data[6]);
+    }
+    TEST_ASSERT_EQUAL(0, connector.UpdatedPayloadCount());
+}
+
+void test_earliest_deadline_first(void)
+{
+    uint8_t passthrough[] = {CRSF_ADDRESS_CRSF_RECEIVER,4,CRSF_FRAMETYPE_ARDUPILOT_RESP,CRSF_AP_CUSTOM_TELEM_SINGLE_PACKET_PASSTHROUGH,0,0};
+    uint8_t gps[] = {CRSF_ADDRESS_CRSF_RECEIVER,17,CRSF_FRAMETYPE_GPS,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+    uint8_t battery[] = {CRSF_ADDRESS_CRSF_RECEIVER,10,CRSF_FRAMETYPE_BATTERY_SENSOR,0,0,0,0,0,0,0,0,0};
+
+    // A GPS frame queued long after a passthrough frame is due after it
+    const uint32_t budget = RXOTAConnector::classBudgetMs(TELEM_CLASS_OTHER);
+    connector.queueMessage((crsf_header_t *)passthrough, 0);
+    connector.queueMessage((crsf_header_t *)gps, budget - RXOTAConnector::classBudgetMs(TELEM_CLASS_GPS) + 1);
+    // but a battery frame queued at the same time is not
+    connector.queueMessage((crsf_header_t *)battery, budget - RXOTAConnector::classBudgetMs(TELEM_CLASS_BATTERY) - 1);
+
+    uint8_t data[CRSF_MAX_PACKET_LEN];
+    uint8_t receivedLength;
+    TEST_ASSERT_TRUE(connector.GetNextPayload(&receivedLength, data, budget));
+    TEST_ASSERT_EQUAL(CRSF_FRAMETYPE_BATTERY_SENSOR, data[CRSF_TELEMETRY_TYPE_INDEX]);
+    TEST_ASSERT_TRUE(connector.GetNextPayload(&receivedLength, data, budget));
+    TEST_ASSERT_EQUAL(CRSF_FRAMETYPE_ARDUPILOT_RESP, data[CRSF_TELEMETRY_TYPE_INDEX]);
+    TEST_ASSERT_TRUE(connector.GetNextPayload(&receivedLength, data, budget));
+    TEST_ASSERT_EQUAL(CRSF_FRAMETYPE_GPS, data[CRSF_TELEMETRY_TYPE_INDEX]);
+}
+
+void test_age_at_delivery(void)
+{
+    uint8_t gps[] = {CRSF_ADDRESS_CRSF_RECEIVER,17,CRSF_FRAMETYPE_GPS,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+    uint8_t data[CRSF_MAX_PACKET_LEN];
+    uint8_t receivedLength;
+
+    connector.resetAgeStats();
+    // Overwriting keeps the deadline of the first copy, but the age is of the latest data
+    connector.queueMessage((crsf_header_t *)gps, 1000);
+    connector.queueMessage((crsf_header_t *)gps, 1150);
+    TEST_ASSERT_TRUE(connector.GetNextPayload(&receivedLength, data, 1250));
+    connector.queueMessage((crsf_header_t *)gps, 1300);
+    TEST_ASSERT_TRUE(connector.GetNextPayload(&receivedLength, data, 1310));
+
+    const TelemetryAgeStats_s &stats = connector.getAgeStats(TELEM_CLASS_GPS);
+    TEST_ASSERT_EQUAL(2, stats.count);
+    TEST_ASSERT_EQUAL(110, stats.ageSumMs);
+    TEST_ASSERT_EQUAL(100, stats.ageMaxMs);
+    TEST_ASSERT_EQUAL(1, stats.late);
+    TEST_ASSERT_EQUAL(0, connector.getAgeStats(TELEM_CLASS_BATTERY).count);
+}
+
 // Unity setup/teardown
 void setUp()
 {
@@ -412,6 +537,11 @@ int main(int argc, char **argv)
     RUN_TEST(test_only_one_device_info);
     RUN_TEST(test_only_one_device_info_per_source);
     RUN_TEST(test_prioritised_settings_entry_messages);
+    RUN_TEST(test_settings_entry_messages_per_field);
+    RUN_TEST(test_overwrite_keeps_queue_position);
+    RUN_TEST(test_overwrite_per_source_id_when_full);
+    RUN_TEST(test_earliest_deadline_first);
+    RUN_TEST(test_age_at_delivery);
     UNITY_END();
 
     return 0;
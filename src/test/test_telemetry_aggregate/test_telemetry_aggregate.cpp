@@ -0,0 +1,232 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unity.h>
+
+#include "RXOTAConnector.h"
+#include "TelemetryAggregate.h"
+#include "TelemetryCodec.h"
+#include "crc.h"
+#include "crsf_protocol.h"
+#include "stubborn_receiver.h"
+#include "stubborn_sender.h"
+#include "telemetry_protocol.h"
+
+static GENERIC_CRC8<CRSF_CRC_POLY> crsf_crc;
+
+static uint8_t buildFrame(uint8_t *frame, uint8_t type, uint8_t payloadLen, uint8_t fill)
+{
+    frame[0] = CRSF_SYNC_BYTE;
+    frame[CRSF_TELEMETRY_LENGTH_INDEX] = payloadLen + 2;
+    frame[CRSF_TELEMETRY_TYPE_INDEX] = type;
+    // Only the last byte changes with fill, like a sensor value moving slowly
+    for (uint8_t i = 0; i < payloadLen; i++)
+        frame[3 + i] = i;
+    frame[payloadLen + 2] = fill;
+    frame[payloadLen + 3] = crsf_crc.calc(&frame[CRSF_TELEMETRY_TYPE_INDEX], payloadLen + 1);
+    return payloadLen + 4;
+}
+
+static bool frameCrcValid(const uint8_t *frame, uint8_t frameLen)
+{
+    return frame[frameLen - 1] == crsf_crc.calc(&frame[CRSF_TELEMETRY_TYPE_INDEX], frameLen - 3);
+}
+
+void test_aggregate_round_trip(void)
+{
+    uint8_t frames[4][CRSF_MAX_PACKET_LEN];
+    uint8_t lens[4];
+    lens[0] = buildFrame(frames[0], CRSF_FRAMETYPE_BATTERY_SENSOR, 8, 10);
+    lens[1] = buildFrame(frames[1], CRSF_FRAMETYPE_BARO_ALTITUDE, 4, 20);
+    lens[2] = buildFrame(frames[2], CRSF_FRAMETYPE_VARIO, 2, 30);
+    lens[3] = buildFrame(frames[3], CRSF_FRAMETYPE_FLIGHT_MODE, 5, 40);
+
+    uint8_t aggregate[CRSF_MAX_PACKET_LEN + 1];
+    TlmAggregateBegin(aggregate);
+    uint8_t aggregateLen = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_EQUAL(lens[i] - 2, TlmAggregatePackedLen(frames[i], lens[i]));
+        aggregateLen = TlmAggregateAppend(aggregate, frames[i], lens[i]);
+    }
+    // Each frame loses its sync, length and CRC and gains a length byte, and 2 for the header
+    TEST_ASSERT_EQUAL(2 + (12 - 2) + (8 - 2) + (6 - 2) + (9 - 2), aggregateLen);
+    TEST_ASSERT_EQUAL(TLM_AGGREGATE, aggregate[0]);
+    TEST_ASSERT_EQUAL(aggregateLen - TLM_AGGREGATE_HEADER_LEN, aggregate[1]);
+
+    uint8_t frame[CRSF_MAX_PACKET_LEN + 1];
+    uint8_t pos = TLM_AGGREGATE_HEADER_LEN;
+    for (int i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_EQUAL(lens[i], TlmAggregateNext(aggregate, pos, frame, sizeof(frame)));
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(frames[i], frame, lens[i]);
+    }
+    TEST_ASSERT_EQUAL(0, TlmAggregateNext(aggregate, pos, frame, sizeof(frame)));
+
+    // A sub-frame running past the end stops the split
+    aggregate[1] -= 1;
+    pos = TLM_AGGREGATE_HEADER_LEN;
+    for (int i = 0; i < 3; i++)
+        TEST_ASSERT_EQUAL(lens[i], TlmAggregateNext(aggregate, pos, frame, sizeof(frame)));
+    TEST_ASSERT_EQUAL(0, TlmAggregateNext(aggregate, pos, frame, sizeof(frame)));
+}
+
+void test_aggregate_connector_packs_what_fits(void)
+{
+    RXOTAConnector connector;
+    connector.setAggregate(true);
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+    uint8_t payload[CRSF_MAX_PACKET_LEN];
+    uint8_t payloadLen;
+
+    // A lone frame goes as it is
+    uint8_t frameLen = buildFrame(frame, CRSF_FRAMETYPE_BATTERY_SENSOR, 8, 1);
+    connector.queueMessage((crsf_header_t *)frame, 0);
+    TEST_ASSERT_TRUE(connector.GetNextPayload(&payloadLen, payload, 0));
+    TEST_ASSERT_EQUAL(frameLen, payloadLen);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(frame, payload, frameLen);
+
+    // Small frames are packed, but the 40 byte one after them no longer fits
+    buildFrame(frame, CRSF_FRAMETYPE_BATTERY_SENSOR, 8, 1);
+    connector.queueMessage((crsf_header_t *)frame, 0);
+    buildFrame(frame, CRSF_FRAMETYPE_ATTITUDE, 6, 2);
+    connector.queueMessage((crsf_header_t *)frame, 0);
+    buildFrame(frame, CRSF_FRAMETYPE_GPS, 15, 3);
+    connector.queueMessage((crsf_header_t *)frame, 0);
+    buildFrame(frame, CRSF_FRAMETYPE_FLIGHT_MODE, 40, 4);
+    connector.queueMessage((crsf_header_t *)frame, 0);
+
+    TEST_ASSERT_TRUE(connector.GetNextPayload(&payloadLen, payload, 0));
+    TEST_ASSERT_EQUAL(TLM_AGGREGATE, payload[0]);
+    TEST_ASSERT_TRUE(payloadLen <= CRSF_MAX_PACKET_LEN);
+    uint8_t pos = TLM_AGGREGATE_HEADER_LEN;
+    uint8_t out[CRSF_MAX_PACKET_LEN + 1];
+    const uint8_t expectedTypes[] = {CRSF_FRAMETYPE_ATTITUDE, CRSF_FRAMETYPE_GPS, CRSF_FRAMETYPE_BATTERY_SENSOR};
+    for (uint8_t type : expectedTypes)
+    {
+        uint8_t outLen = TlmAggregateNext(payload, pos, out, sizeof(out));
+        TEST_ASSERT_EQUAL(type, out[CRSF_TELEMETRY_TYPE_INDEX]);
+        TEST_ASSERT_TRUE(frameCrcValid(out, outLen));
+    }
+    TEST_ASSERT_EQUAL(0, TlmAggregateNext(payload, pos, out, sizeof(out)));
+
+    TEST_ASSERT_TRUE(connector.GetNextPayload(&payloadLen, payload, 0));
+    TEST_ASSERT_EQUAL(CRSF_FRAMETYPE_FLIGHT_MODE, payload[CRSF_TELEMETRY_TYPE_INDEX]);
+    TEST_ASSERT_FALSE(connector.GetNextPayload(&payloadLen, payload, 0));
+}
+
+typedef struct {
+    uint32_t frames;
+    uint32_t packages;
+} linkResult_t;
+
+/**
+ * A saturated downlink of small sensor frames, one stubborn package per telemetry slot on a
+ * lossless link. Every frame the TX rebuilds must have a valid CRC
+ */
+static linkResult_t runLink(bool aggregate, bool delta)
+{
+    RXOTAConnector connector;
+    TelemetryCodec encoder, decoder;
+    StubbornSender sender;
+    StubbornReceiver receiver;
+    uint8_t payload[CRSF_MAX_PACKET_LEN];
+    uint8_t received[CRSF_MAX_PACKET_LEN + 1];
+    uint8_t package[ELRS4_DATA_DL_BYTES_PER_CALL];
+    uint8_t frame[CRSF_MAX_PACKET_LEN + 1];
+    linkResult_t result = {0, 0};
+
+    connector.setAggregate(aggregate);
+    connector.setCodec(delta ? &encoder : nullptr);
+    sender.setMaxPackageIndex(ELRS4_DATA_DL_MAX_PACKAGES);
+    sender.ResetState();
+    receiver.setMaxPackageIndex(ELRS4_DATA_DL_MAX_PACKAGES);
+    receiver.ResetState();
+    receiver.SetDataToReceive(received, sizeof(received));
+
+    for (uint32_t now = 0; now < 20000; now++)
+    {
+        // Battery, baro, vario and attitude at 25Hz, far more than the link carries
+        if (now % 40 == 0)
+        {
+            buildFrame(frame, CRSF_FRAMETYPE_BATTERY_SENSOR, 8, now / 40);
+            connector.queueMessage((crsf_header_t *)frame, now);
+            buildFrame(frame, CRSF_FRAMETYPE_BARO_ALTITUDE, 4, now / 40);
+            connector.queueMessage((crsf_header_t *)frame, now);
+            buildFrame(frame, CRSF_FRAMETYPE_VARIO, 2, now / 40);
+            connector.queueMessage((crsf_header_t *)frame, now);
+            buildFrame(frame, CRSF_FRAMETYPE_ATTITUDE, 6, now / 40);
+            connector.queueMessage((crsf_header_t *)frame, now);
+        }
+        // A DATA telemetry slot every 8ms
+        if (now % 8 != 0)
+            continue;
+
+        uint8_t payloadLen;
+        if (!sender.IsActive() && connector.GetNextPayload(&payloadLen, payload, now))
+            sender.SetDataToTransmit(payload, payloadLen);
+        if (!sender.IsActive())
+            continue;
+        const uint8_t packageIndex = sender.GetCurrentPayload(package, sizeof(package));
+        receiver.ReceiveData(packageIndex, package, sizeof(package));
+        sender.ConfirmCurrentPayload(receiver.GetCurrentConfirm());
+        result.packages++;
+
+        if (!receiver.HasFinishedData())
+            continue;
+        if (received[0] == TLM_AGGREGATE)
+        {
+            uint8_t pos = TLM_AGGREGATE_HEADER_LEN;
+            uint8_t frameLen;
+            while ((frameLen = TlmAggregateNext(received, pos, frame, sizeof(frame))) != 0)
+            {
+                TEST_ASSERT_TRUE(decoder.decode(frame, frameLen, sizeof(frame)));
+                TEST_ASSERT_TRUE(frameCrcValid(frame, CRSF_FRAME_SIZE(frame[CRSF_TELEMETRY_LENGTH_INDEX])));
+                result.frames++;
+            }
+        }
+        else
+        {
+            TEST_ASSERT_TRUE(decoder.decode(received, receiver.GetReceivedLength(), sizeof(received)));
+            TEST_ASSERT_TRUE(frameCrcValid(received, CRSF_FRAME_SIZE(received[CRSF_TELEMETRY_LENGTH_INDEX])));
+            result.frames++;
+        }
+        receiver.Unlock();
+    }
+    return result;
+}
+
+void test_aggregate_frames_per_slot(void)
+{
+    const linkResult_t plain = runLink(false, false);
+    const linkResult_t aggregated = runLink(true, false);
+    const linkResult_t delta = runLink(false, true);
+    const linkResult_t both = runLink(true, true);
+    const linkResult_t *results[] = {&plain, &aggregated, &delta, &both};
+    const char *names[] = {"plain", "aggregate", "delta", "aggregate+delta"};
+    for (int i = 0; i < 4; i++)
+    {
+        printf("%-16s %5u frames in %5u packages, %.3f frames per slot\n",
+            names[i], results[i]->frames, results[i]->packages, (float)results[i]->frames / results[i]->packages);
+    }
+
+    TEST_ASSERT_TRUE(plain.frames > 0);
+    // The link is saturated, so every run uses the same slots and the frames are the gain
+    TEST_ASSERT_TRUE(aggregated.frames * 10 > plain.frames * 13);
+    TEST_ASSERT_TRUE(both.frames > delta.frames);
+}
+
+// Unity setup/teardown
+void setUp() {}
+void tearDown() {}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_aggregate_round_trip);
+    RUN_TEST(test_aggregate_connector_packs_what_fits);
+    RUN_TEST(test_aggregate_frames_per_slot);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,287 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unity.h>
+
+#include "TelemetryCodec.h"
+#include "crc.h"
+#include "crsf_protocol.h"
+#include "telemetry_protocol.h"
+
+static TelemetryCodec encoder;
+static TelemetryCodec decoder;
+static GENERIC_CRC8<CRSF_CRC_POLY> crsf_crc;
+
+static uint8_t buildFrame(uint8_t *frame, uint8_t type, const uint8_t *payload, uint8_t payloadLen)
+{
+    frame[0] = CRSF_SYNC_BYTE;
+    frame[CRSF_TELEMETRY_LENGTH_INDEX] = payloadLen + 2;
+    frame[CRSF_TELEMETRY_TYPE_INDEX] = type;
+    memcpy(&frame[3], payload, payloadLen);
+    frame[payloadLen + 3] = crsf_crc.calc(&frame[CRSF_TELEMETRY_TYPE_INDEX], payloadLen + 1);
+    return payloadLen + 4;
+}
+
+static void putBE(uint8_t *data, uint8_t width, uint32_t value)
+{
+    while (width--)
+    {
+        data[width] = value;
+        value >>= 8;
+    }
+}
+
+static uint8_t buildGps(uint8_t *frame, int32_t lat, int32_t lon, uint16_t speed, uint16_t heading, uint16_t alt, uint8_t sats)
+{
+    uint8_t payload[15];
+    putBE(&payload[0], 4, lat);
+    putBE(&payload[4], 4, lon);
+    putBE(&payload[8], 2, speed);
+    putBE(&payload[10], 2, heading);
+    putBE(&payload[12], 2, alt);
+    payload[14] = sats;
+    return buildFrame(frame, CRSF_FRAMETYPE_GPS, payload, sizeof(payload));
+}
+
+static uint8_t buildAttitude(uint8_t *frame, int16_t pitch, int16_t roll, int16_t yaw)
+{
+    uint8_t payload[6];
+    putBE(&payload[0], 2, pitch);
+    putBE(&payload[2], 2, roll);
+    putBE(&payload[4], 2, yaw);
+    return buildFrame(frame, CRSF_FRAMETYPE_ATTITUDE, payload, sizeof(payload));
+}
+
+static uint8_t buildBattery(uint8_t *frame, uint16_t voltage, uint16_t current, uint32_t capacity, uint8_t remaining)
+{
+    uint8_t payload[8];
+    putBE(&payload[0], 2, voltage);
+    putBE(&payload[2], 2, current);
+    putBE(&payload[4], 3, capacity);
+    payload[7] = remaining;
+    return buildFrame(frame, CRSF_FRAMETYPE_BATTERY_SENSOR, payload, sizeof(payload));
+}
+
+/**
+ * Encode a frame, pass it through the decoder in a separate buffer like it arrives at the TX,
+ * and check the same frame comes out
+ * @return coded length
+ */
+static uint8_t roundTrip(const uint8_t *frame, uint8_t frameLen)
+{
+    uint8_t coded[CRSF_MAX_PACKET_LEN + 1] = {0};
+    memcpy(coded, frame, frameLen);
+    const uint8_t codedLen = encoder.encode(coded, frameLen);
+    TEST_ASSERT_TRUE(codedLen <= frameLen);
+
+    TEST_ASSERT_TRUE(decoder.decode(coded, codedLen, sizeof(coded)));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(frame, coded, frameLen);
+    return codedLen;
+}
+
+void test_codec_round_trip_gps(void)
+{
+    encoder.reset();
+    decoder.reset();
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+
+    int32_t lat = -337512345;
+    int32_t lon = 1512345678;
+    for (int i = 0; i < 40; i++)
+    {
+        // Moving in a straight line, the linear prediction is exact for position
+        uint8_t frameLen = buildGps(frame, lat + i * 130, lon - i * 75, 540 + (i & 3), 21000, 1120 + i, 12);
+        uint8_t codedLen = roundTrip(frame, frameLen);
+        // A keyframe restarts the prediction, so after the first delta following it there are two
+        // points to predict from, and every field takes 1 byte
+        if (i % TLM_CODEC_KEYFRAME_INTERVAL == 0)
+            TEST_ASSERT_EQUAL(2 + 15, codedLen);
+        else if (i % TLM_CODEC_KEYFRAME_INTERVAL > 1)
+            TEST_ASSERT_EQUAL(2 + 6, codedLen);
+    }
+}
+
+void test_codec_round_trip_wraps(void)
+{
+    encoder.reset();
+    decoder.reset();
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+
+    // Yaw and latitude crossing their signed limits, and unsigned fields wrapping
+    const int16_t yaws[] = {32700, 32767, -32768, -32700, 0, 31415, -31415, 5};
+    for (unsigned i = 0; i < sizeof(yaws) / sizeof(yaws[0]); i++)
+    {
+        roundTrip(frame, buildAttitude(frame, -i, i, yaws[i]));
+        roundTrip(frame, buildGps(frame, INT32_MAX - 100 + i * 50, INT32_MIN + i, 65535 - i, i, 0xFFFF * (i & 1), i));
+        roundTrip(frame, buildBattery(frame, 0xFFFF - i * 1000, i * 9000, 0xFFFFFF - i, 100 - i));
+    }
+}
+
+void test_codec_passes_other_frames(void)
+{
+    encoder.reset();
+    decoder.reset();
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+    const uint8_t flightMode[] = "ACRO";
+    uint8_t frameLen = buildFrame(frame, CRSF_FRAMETYPE_FLIGHT_MODE, flightMode, sizeof(flightMode));
+    TEST_ASSERT_EQUAL(frameLen, roundTrip(frame, frameLen));
+
+    // A baro frame with the 3 byte variant payload is not coded
+    const uint8_t baro[] = {0x81, 0x02, 0x03};
+    frameLen = buildFrame(frame, CRSF_FRAMETYPE_BARO_ALTITUDE, baro, sizeof(baro));
+    TEST_ASSERT_EQUAL(frameLen, roundTrip(frame, frameLen));
+}
+
+void test_codec_drops_deltas_after_a_lost_message(void)
+{
+    encoder.reset();
+    decoder.reset();
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+    uint8_t coded[CRSF_MAX_PACKET_LEN + 1];
+
+    for (int i = 0; i < 3 * TLM_CODEC_KEYFRAME_INTERVAL; i++)
+    {
+        uint8_t frameLen = buildAttitude(frame, 100 + i, -200 - i, 3000 + 3 * i);
+        memcpy(coded, frame, frameLen);
+        const uint8_t codedLen = encoder.encode(coded, frameLen);
+        // Lose the 3rd message, the decoder must not rebuild anything until the next keyframe
+        if (i == 2)
+            continue;
+        bool decoded = decoder.decode(coded, codedLen, sizeof(coded));
+        TEST_ASSERT_EQUAL(i < 2 || i >= TLM_CODEC_KEYFRAME_INTERVAL, decoded);
+        if (decoded)
+            TEST_ASSERT_EQUAL_UINT8_ARRAY(frame, coded, frameLen);
+    }
+}
+
+void test_codec_gps_after_a_lost_message(void)
+{
+    // GPS position and altitude are predicted from the last two frames, both must match the
+    // encoder's again after the keyframe which follows a lost message
+    encoder.reset();
+    decoder.reset();
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+    uint8_t coded[CRSF_MAX_PACKET_LEN + 1];
+
+    for (int i = 0; i < 5 * TLM_CODEC_KEYFRAME_INTERVAL; i++)
+    {
+        uint8_t frameLen = buildGps(frame, 1000000 + 500 * i, 2000000 - 300 * i, 540, 9000, 1000 + 2 * i, 14);
+        memcpy(coded, frame, frameLen);
+        const uint8_t codedLen = encoder.encode(coded, frameLen);
+        if (i == 2)
+            continue;
+        bool decoded = decoder.decode(coded, codedLen, sizeof(coded));
+        TEST_ASSERT_EQUAL(i < 2 || i >= TLM_CODEC_KEYFRAME_INTERVAL, decoded);
+        if (decoded)
+            TEST_ASSERT_EQUAL_UINT8_ARRAY(frame, coded, frameLen);
+    }
+}
+
+void test_codec_reads_only_the_message(void)
+{
+    encoder.reset();
+    decoder.reset();
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+    uint8_t coded[CRSF_MAX_PACKET_LEN + 1];
+
+    uint8_t frameLen = buildGps(frame, 1000000, 2000000, 540, 9000, 1000, 14);
+    TEST_ASSERT_EQUAL(17, roundTrip(frame, frameLen));
+    // A delta cut short must not be finished with whatever follows it in the buffer
+    frameLen = buildGps(frame, 1000100, 2000000, 540, 9000, 1000, 14);
+    memset(coded, 0, sizeof(coded));
+    memcpy(coded, frame, frameLen);
+    const uint8_t codedLen = encoder.encode(coded, frameLen);
+    TEST_ASSERT_FALSE(decoder.decode(coded, codedLen - 1, sizeof(coded)));
+}
+
+/**
+ * Stubborn packages needed for a message on a std packet rate downlink, a single package also
+ * needs the blank final one
+ */
+static uint32_t stubbornPackages(uint8_t len)
+{
+    uint32_t packages = (len + ELRS4_DATA_DL_BYTES_PER_CALL - 1) / ELRS4_DATA_DL_BYTES_PER_CALL;
+    return packages < 2 ? 2 : packages;
+}
+
+/**
+ * A minute of flight, GPS and vario at 10Hz, attitude at 25Hz, battery at 5Hz, like Betaflight
+ * sends them. The quad circles at 15m/s with some noise on everything
+ */
+void test_codec_flight_trace_savings(void)
+{
+    encoder.reset();
+    decoder.reset();
+    uint32_t rng = 1;
+    auto noise = [&rng](int range) {
+        rng = rng * 1103515245 + 12345;
+        return (int)((rng >> 16) % (2 * range + 1)) - range;
+    };
+
+    uint32_t frames = 0, plainBytes = 0, codedBytes = 0, plainPackages = 0, codedPackages = 0;
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+    for (int ms = 0; ms < 60000; ms += 10)
+    {
+        const float t = ms / 1000.0f;
+        const float angle = t * 15.0f / 100.0f;
+        uint8_t frameLen = 0;
+        if (ms % 100 == 0)
+        {
+            // 100m radius circle, 1e-7 degrees is about 1.1cm
+            frameLen = buildGps(frame, -337500000 + (int32_t)(100.0f * sinf(angle) / 0.0111f),
+                1512300000 + (int32_t)(100.0f * cosf(angle) / 0.0111f / 0.832f),
+                540 + noise(3), (uint16_t)(fmodf(angle * 5729.58f + 27000.0f, 36000.0f)), 1050 + noise(1), 14);
+        }
+        else if (ms % 100 == 50)
+        {
+            uint8_t vario[2];
+            putBE(vario, 2, noise(20));
+            frameLen = buildFrame(frame, CRSF_FRAMETYPE_VARIO, vario, sizeof(vario));
+        }
+        else if (ms % 40 == 20)
+        {
+            frameLen = buildAttitude(frame, -1500 + noise(60), 4000 + noise(60), (int16_t)(fmodf(angle, 6.2832f) * 10000.0f - 31416.0f));
+        }
+        else if (ms % 200 == 30)
+        {
+            frameLen = buildBattery(frame, 1580 - ms / 1000 + noise(2), 180 + noise(15), ms / 300, 95 - ms / 1500);
+        }
+        if (frameLen == 0)
+            continue;
+
+        const uint8_t codedLen = roundTrip(frame, frameLen);
+        frames++;
+        plainBytes += frameLen;
+        codedBytes += codedLen;
+        plainPackages += stubbornPackages(frameLen);
+        codedPackages += stubbornPackages(codedLen);
+    }
+
+    printf("%u frames: %u bytes coded to %u (%.1f%%), %u stubborn packages to %u (%.1f%%)\n",
+        frames, plainBytes, codedBytes, 100.0f * codedBytes / plainBytes,
+        plainPackages, codedPackages, 100.0f * codedPackages / plainPackages);
+    // Attitude and vario frames already fit in the 2 packages a message takes at least, so the
+    // packages saved come from GPS and battery frames
+    TEST_ASSERT_TRUE(codedBytes * 10 < plainBytes * 6);
+    TEST_ASSERT_TRUE(codedPackages * 100 < plainPackages * 85);
+}
+
+// Unity setup/teardown
+void setUp() {}
+void tearDown() {}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_codec_round_trip_gps);
+    RUN_TEST(test_codec_round_trip_wraps);
+    RUN_TEST(test_codec_passes_other_frames);
+    RUN_TEST(test_codec_drops_deltas_after_a_lost_message);
+    RUN_TEST(test_codec_gps_after_a_lost_message);
+    RUN_TEST(test_codec_reads_only_the_message);
+    RUN_TEST(test_codec_flight_trace_savings);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,402 @@
+/**
+ * This file is part of ExpressLRS
+ * See https://github.com/AlessandroAU/ExpressLRS
+ *
+ * Tests for the Auto telemetry ratio, and a simulation of the downlink at 250Hz which compares
+ * the standard 1:64, a fixed 1:8 and Auto on the RC packet rate they leave and the telemetry
+ * latency they give. The RX side is RXOTAConnector feeding a StubbornSender the way rx_main does,
+ * with its LINKSTATS/DATA burst choice, and the TX side a StubbornReceiver acking in the RC
+ * packets. Each frame carries the time it was queued, so the latency is from the FC to the TX.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unity.h>
+
+#include "targets.h"
+#include "common.h"
+#include "RXOTAConnector.h"
+#include "TelemetryRatioAuto.h"
+#include "stubborn_receiver.h"
+#include "stubborn_sender.h"
+#include "telemetry_protocol.h"
+
+#define SIM_RATE_HZ 250
+#define SIM_INTERVAL_US 4000
+#define SIM_STD_RATIO TLM_RATIO_1_64
+#define SIM_DURATION_MS 60000
+// The sync spam which carries a new ratio goes out on the next FHSS hop, and replaces RC packets
+#define SIM_SYNC_DELAY_MS 16
+#define SIM_SYNC_SPAM 3
+// A Lua parameter load, each entry is requested when the previous one arrives
+#define SIM_PARAMS 20
+#define SIM_PARAM_START_MS 1000
+#define SIM_PARAM_TURNAROUND_MS 20
+#define SIM_PARAM_FRAME_LEN 48
+
+static TelemetryRatioAuto autoRatio;
+
+// As TLMratioEnumToValue() in src/common.cpp
+static uint8_t ratioDenom(expresslrs_tlm_ratio_e ratio)
+{
+    return 1 << (8 + TLM_RATIO_NO_TLM - ratio);
+}
+
+// As TLMBurstMaxForRateRatio() in src/common.cpp
+static uint8_t burstMax(uint16_t rateHz, uint8_t ratioDiv)
+{
+    unsigned burst = 512U * rateHz / ratioDiv / 1000U;
+    return burst > 1 ? burst - 1 : 1;
+}
+
+void test_auto_ratio_steps_up_while_backlogged(void)
+{
+    autoRatio.reset(TLM_RATIO_1_64);
+    for (int i = 0; i < 10; i++)
+    {
+        autoRatio.telemetryReceived(true);
+        autoRatio.telemetryReceived(false);
+        const bool changed = autoRatio.update(100);
+        TEST_ASSERT_EQUAL(i < 3, changed);
+    }
+    TEST_ASSERT_EQUAL(TLM_AUTO_MAX_RATIO, autoRatio.getRatio());
+
+    // Some data but not saturated holds the ratio
+    autoRatio.telemetryReceived(true);
+    for (int i = 0; i < 4; i++)
+        autoRatio.telemetryReceived(false);
+    TEST_ASSERT_FALSE(autoRatio.update(100));
+
+    // Backlogged on a poor uplink does not take more RC packets
+    autoRatio.reset(TLM_RATIO_1_64);
+    autoRatio.telemetryReceived(true);
+    TEST_ASSERT_FALSE(autoRatio.update(TLM_AUTO_LQ_RAISE - 1));
+    TEST_ASSERT_EQUAL(TLM_RATIO_1_64, autoRatio.getRatio());
+}
+
+void test_auto_ratio_falls_back(void)
+{
+    autoRatio.reset(TLM_RATIO_1_64);
+    for (int i = 0; i < 3; i++)
+    {
+        autoRatio.telemetryReceived(true);
+        autoRatio.update(100);
+    }
+    TEST_ASSERT_EQUAL(TLM_RATIO_1_8, autoRatio.getRatio());
+
+    // Drained steps back one ratio at a time
+    for (int i = 0; i < 8; i++)
+        autoRatio.telemetryReceived(false);
+    TEST_ASSERT_TRUE(autoRatio.update(100));
+    TEST_ASSERT_EQUAL(TLM_RATIO_1_16, autoRatio.getRatio());
+
+    // LQ dropping goes straight back to the standard ratio even if still backlogged
+    autoRatio.telemetryReceived(true);
+    TEST_ASSERT_TRUE(autoRatio.update(TLM_AUTO_LQ_DROP - 1));
+    TEST_ASSERT_EQUAL(TLM_RATIO_1_64, autoRatio.getRatio());
+    for (int i = 0; i < 8; i++)
+        autoRatio.telemetryReceived(false);
+    TEST_ASSERT_FALSE(autoRatio.update(100));
+
+    // A rate with a standard ratio above the Auto limit stays there
+    autoRatio.reset(TLM_RATIO_1_4);
+    autoRatio.telemetryReceived(true);
+    TEST_ASSERT_FALSE(autoRatio.update(100));
+    TEST_ASSERT_EQUAL(TLM_RATIO_1_4, autoRatio.getRatio());
+}
+
+/***
+ * Simulation
+ ***/
+typedef struct {
+    const char *name;
+    uint8_t lossPct;
+    bool sensors;
+    bool params;
+} SimScenario_s;
+
+typedef struct {
+    uint32_t rcPackets;
+    uint32_t frames;
+    uint32_t latencySumMs;
+    uint32_t latencyMaxMs;
+    uint32_t paramsMs;
+    uint32_t ratioChanges;
+} SimResult_s;
+
+static const SimScenario_s scenarios[] = {
+    {"link stats only", 0, false, false},
+    {"fc sensors", 0, true, false},
+    {"param load", 0, false, true},
+    {"param load 40%", 40, false, true},
+};
+
+static uint32_t simRngState;
+static bool simDrops(uint8_t lossPct)
+{
+    simRngState = simRngState * 1103515245 + 12345;
+    return ((simRngState >> 16) % 100) < lossPct;
+}
+
+/**
+ * Build a frame of the given type and total length, with the time it was made in the last two
+ * bytes before the CRC (which is not checked)
+ */
+static void buildFrame(uint8_t *frame, uint8_t type, uint8_t frameLen, uint32_t now)
+{
+    memset(frame, 0, frameLen);
+    frame[0] = CRSF_ADDRESS_CRSF_RECEIVER;
+    frame[CRSF_TELEMETRY_LENGTH_INDEX] = frameLen - CRSF_FRAME_NOT_COUNTED_BYTES;
+    frame[CRSF_TELEMETRY_TYPE_INDEX] = type;
+    if (type >= CRSF_FRAMETYPE_DEVICE_PING)
+    {
+        frame[3] = CRSF_ADDRESS_RADIO_TRANSMITTER;
+        frame[4] = CRSF_ADDRESS_CRSF_RECEIVER;
+    }
+    frame[frameLen - 3] = now;
+    frame[frameLen - 2] = now >> 8;
+}
+
+static void queueSensors(RXOTAConnector &connector, uint32_t now)
+{
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+    if (now % 40 == 0)
+    {
+        buildFrame(frame, CRSF_FRAMETYPE_ATTITUDE, 10, now);
+        connector.queueMessage((crsf_header_t *)frame, now);
+    }
+    if (now % 100 == 10)
+    {
+        buildFrame(frame, CRSF_FRAMETYPE_GPS, 19, now);
+        connector.queueMessage((crsf_header_t *)frame, now);
+    }
+    if (now % 100 == 60)
+    {
+        buildFrame(frame, CRSF_FRAMETYPE_VARIO, 6, now);
+        connector.queueMessage((crsf_header_t *)frame, now);
+    }
+    if (now % 200 == 30)
+    {
+        buildFrame(frame, CRSF_FRAMETYPE_BATTERY_SENSOR, 12, now);
+        connector.queueMessage((crsf_header_t *)frame, now);
+    }
+    if (now % 1000 == 500)
+    {
+        buildFrame(frame, CRSF_FRAMETYPE_FLIGHT_MODE, 9, now);
+        connector.queueMessage((crsf_header_t *)frame, now);
+    }
+}
+
+/**
+ * @param ratio fixed ratio, or TLM_RATIO_AUTO
+ */
+static SimResult_s runSim(const SimScenario_s &scenario, expresslrs_tlm_ratio_e ratio)
+{
+    RXOTAConnector connector;
+    StubbornSender dlSender;
+    StubbornReceiver dlReceiver;
+    uint8_t dlBuffer[CRSF_MAX_PACKET_LEN];
+    uint8_t txBuffer[CRSF_MAX_PACKET_LEN + 1];
+    uint8_t package[ELRS4_DATA_DL_BYTES_PER_CALL];
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+    SimResult_s result = {};
+
+    simRngState = 1;
+    autoRatio.reset(SIM_STD_RATIO);
+    dlSender.setMaxPackageIndex(ELRS4_DATA_DL_MAX_PACKAGES);
+    dlSender.ResetState();
+    dlReceiver.setMaxPackageIndex(ELRS4_DATA_DL_MAX_PACKAGES);
+    dlReceiver.ResetState();
+    dlReceiver.SetDataToReceive(txBuffer, sizeof(txBuffer));
+
+    expresslrs_tlm_ratio_e current = ratio == TLM_RATIO_AUTO ? SIM_STD_RATIO : ratio;
+    expresslrs_tlm_ratio_e pending = current;
+    uint32_t pendingAtMs = 0;
+    uint8_t denom = ratioDenom(current);
+    uint8_t burst = burstMax(SIM_RATE_HZ, denom);
+    dlSender.UpdateTelemetryRate(SIM_RATE_HZ, denom, burst);
+    uint8_t burstCount = 0;
+    bool nextIsLinkStats = true;
+    uint8_t syncSpam = 0;
+
+    uint32_t uplinkSent = 0, uplinkReceived = 0, nextUpdateMs = TLM_AUTO_INTERVAL_MS;
+    uint8_t paramsRequested = 0, paramsReceived = 0;
+    uint32_t nextParamMs = scenario.params ? SIM_PARAM_START_MS : UINT32_MAX;
+    uint32_t lastMs = UINT32_MAX;
+
+    for (uint32_t nonce = 0; nonce < SIM_DURATION_MS * 1000ULL / SIM_INTERVAL_US; nonce++)
+    {
+        const uint32_t now = nonce * (uint64_t)SIM_INTERVAL_US / 1000U;
+
+        // The FC side, one call per ms
+        for (uint32_t ms = lastMs + 1; ms <= now && lastMs != now; ms++)
+        {
+            if (scenario.sensors)
+                queueSensors(connector, ms);
+            if (ms >= nextParamMs)
+            {
+                buildFrame(frame, CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY, SIM_PARAM_FRAME_LEN, ms);
+                connector.queueMessage((crsf_header_t *)frame, ms);
+                paramsRequested++;
+                nextParamMs = UINT32_MAX;
+            }
+        }
+        lastMs = now;
+
+        if (current != pending && now >= pendingAtMs)
+        {
+            current = pending;
+            denom = ratioDenom(current);
+            burst = burstMax(SIM_RATE_HZ, denom);
+            dlSender.UpdateTelemetryRate(SIM_RATE_HZ, denom, burst);
+        }
+
+        // RX loop, as HandleDataDl in rx_main
+        uint8_t size;
+        if (!dlSender.IsActive() && connector.GetNextPayload(&size, dlBuffer, now))
+            dlSender.SetDataToTransmit(dlBuffer, size);
+
+        if (nonce % denom == 0)
+        {
+            // RX telemetry slot, as HandleSendDataDl in rx_main
+            bool isData = false;
+            uint8_t packageIndex = 0;
+            if (nextIsLinkStats || !dlSender.IsActive())
+            {
+                nextIsLinkStats = false;
+                burstCount = 1;
+            }
+            else
+            {
+                if (burstCount < burst)
+                    burstCount++;
+                else
+                    nextIsLinkStats = true;
+                isData = true;
+                packageIndex = dlSender.GetCurrentPayload(package, sizeof(package));
+            }
+
+            if (!simDrops(scenario.lossPct))
+            {
+                autoRatio.telemetryReceived(isData);
+                if (isData)
+                    dlReceiver.ReceiveData(packageIndex, package, sizeof(package));
+            }
+        }
+        else
+        {
+            // TX RC packet, or a sync carrying a new ratio
+            uplinkSent++;
+            if (syncSpam)
+                syncSpam--;
+            else
+                result.rcPackets++;
+            if (!simDrops(scenario.lossPct))
+            {
+                uplinkReceived++;
+                dlSender.ConfirmCurrentPayload(dlReceiver.GetCurrentConfirm());
+            }
+        }
+
+        // TX loop
+        if (dlReceiver.HasFinishedData())
+        {
+            const uint8_t frameLen = CRSF_FRAME_SIZE(txBuffer[CRSF_TELEMETRY_LENGTH_INDEX]);
+            const uint32_t latency = (uint16_t)(now - (txBuffer[frameLen - 3] | (txBuffer[frameLen - 2] << 8)));
+            result.frames++;
+            result.latencySumMs += latency;
+            if (latency > result.latencyMaxMs)
+                result.latencyMaxMs = latency;
+            if (txBuffer[CRSF_TELEMETRY_TYPE_INDEX] == CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY)
+            {
+                if (++paramsReceived == SIM_PARAMS)
+                    result.paramsMs = now - SIM_PARAM_START_MS;
+                else
+                    nextParamMs = now + SIM_PARAM_TURNAROUND_MS;
+            }
+            dlReceiver.Unlock();
+        }
+
+        if (ratio == TLM_RATIO_AUTO && now >= nextUpdateMs)
+        {
+            nextUpdateMs = now + TLM_AUTO_INTERVAL_MS;
+            const uint8_t lq = uplinkSent ? uplinkReceived * 100 / uplinkSent : 0;
+            uplinkSent = uplinkReceived = 0;
+            if (autoRatio.update(lq))
+            {
+                pending = autoRatio.getRatio();
+                pendingAtMs = now + SIM_SYNC_DELAY_MS;
+                syncSpam = SIM_SYNC_SPAM;
+                result.ratioChanges++;
+            }
+        }
+    }
+
+    TEST_ASSERT_TRUE(paramsRequested <= SIM_PARAMS);
+    return result;
+}
+
+static void report(const SimScenario_s &scenario, const char *ratioName, const SimResult_s &r)
+{
+    char params[16] = "-";
+    if (scenario.params)
+    {
+        if (r.paramsMs)
+            snprintf(params, sizeof(params), "%.1fs", r.paramsMs / 1000.0f);
+        else
+            strcpy(params, "unfinished");
+    }
+    printf("%-16s %-5s RC %5.1fHz  frames %5u  latency mean %6.1fms max %5ums  params %-10s  changes %u\n",
+        scenario.name, ratioName, r.rcPackets * 1000.0f / SIM_DURATION_MS, r.frames,
+        r.frames ? (float)r.latencySumMs / r.frames : 0.0f, r.latencyMaxMs, params, r.ratioChanges);
+}
+
+void test_auto_ratio_sim_tradeoff(void)
+{
+    for (const SimScenario_s &scenario : scenarios)
+    {
+        const SimResult_s std = runSim(scenario, SIM_STD_RATIO);
+        const SimResult_s fixed = runSim(scenario, TLM_AUTO_MAX_RATIO);
+        const SimResult_s automatic = runSim(scenario, TLM_RATIO_AUTO);
+        report(scenario, "1:64", std);
+        report(scenario, "1:8", fixed);
+        report(scenario, "Auto", automatic);
+
+        // Auto never costs more RC packets than the fixed ratio it is limited to
+        TEST_ASSERT_TRUE(automatic.rcPackets >= fixed.rcPackets);
+        if (scenario.lossPct >= 100 - TLM_AUTO_LQ_RAISE || (!scenario.sensors && !scenario.params))
+        {
+            // Nothing to send, or a poor uplink, keeps the standard ratio
+            TEST_ASSERT_EQUAL(0, automatic.ratioChanges);
+            TEST_ASSERT_EQUAL(std.rcPackets, automatic.rcPackets);
+        }
+        else if (scenario.params)
+        {
+            // A parameter load goes much faster, and the ratio falls back once it is done
+            TEST_ASSERT_TRUE(automatic.paramsMs > 0);
+            TEST_ASSERT_TRUE(std.paramsMs == 0 || automatic.paramsMs * 3 < std.paramsMs);
+            TEST_ASSERT_TRUE(automatic.rcPackets * 100 > std.rcPackets * 97);
+        }
+        else
+        {
+            // A steady telemetry stream is delivered fresher
+            TEST_ASSERT_TRUE(automatic.latencySumMs / automatic.frames * 2 < std.latencySumMs / std.frames);
+        }
+    }
+}
+
+// Unity setup/teardown
+void setUp() {}
+void tearDown() {}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_auto_ratio_steps_up_while_backlogged);
+    RUN_TEST(test_auto_ratio_falls_back);
+    RUN_TEST(test_auto_ratio_sim_tradeoff);
+    UNITY_END();
+
+    return 0;
+}